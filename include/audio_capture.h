@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Microphone capture task
+//
+// A core-pinned FreeRTOS task keeps M5.Mic.record() fed with fixed-size frames
+// and pushes each completed frame into a single-producer/single-consumer ring
+// buffer. loop() (and anything else on the consumer side) drains the ring with
+// audio_capture_read(), so stalls in networking, touch or display code no
+// longer drop microphone frames.
+
+#define CAPTURE_FRAME_SAMPLES 320    // 20 ms at 16kHz
+#define CAPTURE_RING_SAMPLES 16384   // ~1 s of headroom at 16kHz, must be a power of two
+#define CAPTURE_TASK_PRIORITY 5      // above loopTask (1) and the M5Unified mic task
+#define CAPTURE_TASK_CORE 1          // keep off the Wi-Fi core
+#define CAPTURE_TASK_STACK 4096
+
+// Called from the capture task on every completed frame, before it is queued
+typedef void (*CaptureFrameHook)(int16_t *frame, size_t samples);
+
+struct CaptureStats
+{
+    uint32_t frames_captured;  // frames completed by the mic
+    uint32_t frames_dropped;   // frames lost because the ring was full (overflow)
+    uint32_t short_reads;      // consumer reads that found less data than requested (underflow)
+    size_t ring_high_water;    // most samples ever queued at once
+};
+
+// Allocate the ring and start the capture task (call after M5.Mic.begin())
+bool audio_capture_begin(uint32_t sample_rate);
+
+// Install the per-frame processing hook (call before audio_capture_begin())
+void audio_capture_set_frame_hook(CaptureFrameHook hook);
+
+// Frames are only queued while capture is active; inactive frames are discarded
+void audio_capture_set_active(bool active);
+bool audio_capture_is_active();
+
+// Consumer side: samples ready, non-blocking read, and dropping stale samples
+size_t audio_capture_available();
+size_t audio_capture_read(int16_t *dst, size_t max_samples);
+void audio_capture_discard();
+
+// Drop the oldest samples so at most max_samples stay queued (keeps a pre-roll window)
+void audio_capture_retain(size_t max_samples);
+
+CaptureStats audio_capture_stats();
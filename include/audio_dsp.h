@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-point audio processing stages
+//
+// Samples are Q15 (int16_t) and processed in place, one block at a time.
+// Every stage keeps its state in a caller-owned struct and never allocates,
+// so a chain can run inside the capture task. Coefficients are computed once
+// at init time; the per-sample paths are integer only.
+
+#define DSP_MAX_STAGES 8
+
+typedef void (*DspProcessFn)(void *state, int16_t *samples, size_t n);
+
+// One processing step: a function plus the state it works on
+struct DspStage
+{
+    DspProcessFn process;
+    void *state;
+};
+
+// Ordered list of stages run over each block
+class DspChain
+{
+public:
+    DspChain() : count_(0) {}
+
+    bool add(DspProcessFn process, void *state);
+    void process(int16_t *samples, size_t n) const;
+    size_t size() const { return count_; }
+
+private:
+    DspStage stages_[DSP_MAX_STAGES];
+    size_t count_;
+};
+
+// DC blocker: y[n] = x[n] - x[n-1] + R * y[n-1]
+struct DcBlocker
+{
+    int32_t r_q15;
+    int32_t x1;
+    int32_t y1_q8; // previous output with 8 extra fractional bits
+};
+
+void dc_blocker_init(DcBlocker *dc, uint32_t sample_rate, uint32_t cutoff_hz);
+void dc_blocker_process(void *state, int16_t *samples, size_t n);
+
+// Second-order IIR section (direct form I), coefficients in Q14 so |b| may reach 2
+struct Biquad
+{
+    int32_t b0, b1, b2, a1, a2;
+    int32_t x1, x2;
+    int32_t y1, y2; // previous outputs with 8 extra fractional bits
+};
+
+void biquad_init_highpass(Biquad *bq, uint32_t sample_rate, uint32_t cutoff_hz, float q);
+void biquad_process(void *state, int16_t *samples, size_t n);
+
+// Automatic gain control: peak envelope with attack/release, gain eased toward
+// target / envelope once per block, held while the input is below the gate
+struct Agc
+{
+    int32_t target;        // desired envelope peak (Q15 amplitude)
+    int32_t gate;          // below this envelope the gain is frozen (noise)
+    int32_t max_gain_q12;  // 4096 = unity
+    int32_t min_gain_q12;
+    int32_t attack_q15;    // envelope rise per sample
+    int32_t release_q15;   // envelope fall per sample
+    int32_t envelope;
+    int32_t gain_q12;
+};
+
+void agc_init(Agc *agc, uint32_t sample_rate, int32_t target, int32_t gate, uint32_t attack_ms, uint32_t release_ms,
+              int32_t max_gain_q12);
+void agc_process(void *state, int16_t *samples, size_t n);
+
+// Soft limiter: transparent below threshold, rational knee approaching full scale above it
+struct SoftLimiter
+{
+    int32_t threshold;
+};
+
+void soft_limiter_init(SoftLimiter *lim, int32_t threshold);
+void soft_limiter_process(void *state, int16_t *samples, size_t n);
+
+// Look-ahead peak limiter: the signal is delayed by the look-ahead so the gain
+// can come down smoothly before a peak reaches the output
+#define LIMITER_MAX_LOOKAHEAD 128
+
+struct LookaheadLimiter
+{
+    int32_t threshold;
+    uint32_t lookahead;   // delay in samples, even so interleaved stereo stays paired
+    int32_t attack_q15;   // reaches ~99% of a gain drop within the look-ahead
+    int32_t release_q15;
+    int32_t gain_q24;     // 1 << 24 = unity
+    int32_t hold_q24;     // lowest gain needed by a sample still in the delay line
+    uint32_t hold_count;  // samples until that sample has left it
+    uint32_t pos;
+    int16_t delay[LIMITER_MAX_LOOKAHEAD];
+};
+
+void lookahead_limiter_init(LookaheadLimiter *lim, uint32_t sample_rate, int32_t threshold, uint32_t lookahead_us,
+                            uint32_t release_ms);
+void lookahead_limiter_reset(LookaheadLimiter *lim); // clear the delay line between streams
+void lookahead_limiter_process(void *state, int16_t *samples, size_t n);
+
+// Loudness normalization: slow gain toward a target RMS. The level estimate is
+// averaged over a long window and frozen while the input is below the gate
+// (pauses), and gain changes are ramped across each block.
+struct LoudnessNormalizer
+{
+    int32_t target_rms;
+    int32_t gate_rms;
+    int32_t min_gain_q12; // 4096 = unity
+    int32_t max_gain_q12;
+    uint32_t window_samples;
+    uint32_t mean_square; // smoothed level estimate
+    bool primed;          // first block above the gate seeds the estimate
+    int32_t gain_q12;
+};
+
+void loudness_normalizer_init(LoudnessNormalizer *ln, uint32_t sample_rate, int32_t target_rms, int32_t gate_rms,
+                              uint32_t window_ms, int32_t min_gain_q12, int32_t max_gain_q12);
+void loudness_normalizer_process(void *state, int16_t *samples, size_t n);
+
+// Gain envelope for click-free transitions: the gain moves linearly to 0 or
+// unity over a given number of samples and then holds there
+struct GainEnvelope
+{
+    int32_t gain_q24;   // 1 << 24 = unity
+    int32_t target_q24;
+    int32_t step_q24;   // per sample while ramping
+};
+
+void gain_envelope_init(GainEnvelope *env, bool open); // start at unity (open) or silence
+void gain_envelope_ramp(GainEnvelope *env, bool open, size_t samples); // from the current gain
+bool gain_envelope_settled(const GainEnvelope *env);
+void gain_envelope_process(void *state, int16_t *samples, size_t n);
+
+// Linear crossfade of two equal-length blocks: out runs from all of a to all of b
+void crossfade_linear(const int16_t *a, const int16_t *b, int16_t *out, size_t n);
+
+// Shared saturation helper
+inline int16_t dsp_saturate(int32_t v)
+{
+    return (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "spsc_ring_buffer.h"
+
+// Software mixer that overlays short mono sounds (earcons, status prompts) on
+// the playback output
+//
+// Up to MIXER_MAX_VOICES voices play at once, each from a caller-owned buffer
+// at its own rate (linearly interpolated to the output rate) and with its own
+// gain. While a voice plays it can duck the bed, the audio it is mixed into:
+// the bed gain follows the deepest duck of the voices playing, with a fast
+// attack and a slow release. When every voice is busy a new one takes the slot
+// of the lowest-priority voice at or below its own priority (the oldest on a
+// tie), which fades out over a few milliseconds first; otherwise it is dropped.
+//
+// play() and stop() may be called from another task than mix(): requests go
+// through a small SPSC queue and are picked up at the start of the next mix().
+// mix() works in blocks of MIXER_BLOCK_FRAMES with 32-bit accumulators and
+// saturates once per output sample.
+
+#define MIXER_MAX_VOICES 4
+#define MIXER_BLOCK_FRAMES 32
+#define MIXER_QUEUE_DEPTH 8      // requests between two mix() calls, power of two
+#define MIXER_DUCK_ATTACK_MS 20
+#define MIXER_DUCK_RELEASE_MS 250
+#define MIXER_RELEASE_MS 4       // fade of a stopped or replaced voice
+#define MIXER_UNITY_Q12 4096
+
+struct MixerVoiceParams
+{
+    uint8_t priority;  // higher wins a slot
+    uint16_t gain_q12; // MIXER_UNITY_Q12 = unity
+    uint16_t duck_q12; // bed gain while this voice plays; MIXER_UNITY_Q12 = no ducking
+};
+
+class AudioMixer
+{
+public:
+    AudioMixer();
+
+    // Producer side. play() returns a handle for stop(), or 0 if the request queue is full
+    uint32_t play(const int16_t *samples, size_t count, uint32_t sample_rate, const MixerVoiceParams &params);
+    void stop(uint32_t handle);
+    void stop_all();
+
+    // Consumer side: true while a voice is playing or waiting to start
+    bool active();
+
+    // Add the voices to frames of out (interleaved if channels is 2), ducking what is already there
+    void mix(int16_t *out, size_t frames, uint8_t channels, uint32_t output_rate);
+
+    // The bed is still below unity (ducked, or recovering); keep calling mix() over it
+    bool bed_ducked() const { return bed_gain_q15_ != 32768; }
+
+    // Nothing is being mixed into: the bed gain may jump back to unity
+    void reset_bed();
+
+private:
+    struct Request
+    {
+        const int16_t *samples; // nullptr = stop handle (0 = all)
+        size_t count;
+        uint32_t sample_rate;
+        MixerVoiceParams params;
+        uint32_t handle;
+    };
+
+    struct Voice
+    {
+        const int16_t *samples;
+        size_t count;
+        size_t index;
+        uint32_t frac_q16;
+        uint32_t sample_rate;
+        MixerVoiceParams params;
+        uint32_t handle;
+        uint32_t order;    // start order, for stealing the oldest
+        int32_t level_q12; // release fade
+        bool active;
+        bool releasing;
+    };
+
+    bool send(const Request &request);
+    void take_requests();
+    int slot_for(uint8_t priority);
+    void release(Voice &voice);
+    void render(Voice &voice, int32_t *acc, size_t frames, uint32_t step_q16, int32_t release_step);
+
+    SpscRingBuffer<Request> requests_;
+    Request request_storage_[MIXER_QUEUE_DEPTH];
+    uint32_t next_handle_; // producer only
+
+    Voice voices_[MIXER_MAX_VOICES];
+    uint32_t next_order_;
+    int32_t bed_gain_q15_; // 32768 = unity
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "signal_stats.h"
+#include "audio_mixer.h"
+
+// Streaming TTS playback through an adaptive jitter buffer
+//
+// The network side writes decoded PCM into a PSRAM ring as chunks arrive.
+// playback_service() starts the speaker once the buffered audio reaches a
+// low-water mark derived from the observed chunk inter-arrival jitter, then
+// queues slices on the speaker straight from the ring and releases them only
+// after they have played. If the ring runs dry mid-stream playback rebuffers
+// and the mark is raised for the next turn.
+//
+// Streams arrive in the format the server declares. The producer side folds
+// them to mono 16-bit at the declared rate; if that rate is not the speaker's
+// native rate the consumer runs them through a polyphase resampler into small
+// output slices, otherwise slices are still queued straight from the ring.
+//
+// Streams can be played faster than they were spoken. The producer side then
+// runs the folded samples through a WSOLA time stretcher (see time_stretch.h)
+// before they enter the ring, so the jitter buffer works in playback time and
+// the pitch is kept. Buffered clips always play at normal speed.
+//
+// Every slice passes through an output dynamics stage (slow loudness
+// normalization, then a look-ahead peak limiter) in place just before it is
+// queued, so loud responses don't distort the small speaker.
+//
+// A gain envelope follows the dynamics so the speaker never sees a step: audio
+// fades in when it starts and when it resumes after an underrun, and fades out
+// at its end and just before the ring runs dry. An abort ramps the channel
+// volume down before stopping it, and a clip started while another is playing
+// is crossfaded from it.
+//
+// Short sounds (earcons) are voices of a software mixer (see audio_mixer.h)
+// rather than a second speaker channel. They are mixed into each slice after
+// the envelope, ducking the response while they play, so they start with the
+// next slice queued; with no response playing the feeder queues slices of the
+// voices alone on the same channel.
+//
+// The consumer side runs in its own pinned feeder task, so nothing here blocks
+// the caller. The core keeps no Arduino dependencies: it reaches the speaker
+// and the clock only through a PlaybackSink, which the task glue
+// (audio_playback_task.cpp) points at M5.Speaker and the host tests at a fake. Fully buffered responses are played as clips: slices are queued
+// straight from the caller's buffer, which must stay valid until the clip has
+// finished (see playback_take_finished()) or playback_stop() has returned; when
+// one clip replaces another, both buffers must stay valid until then.
+
+#define PLAYBACK_CHANNEL 0
+#define PLAYBACK_SLICE_SAMPLES 4096         // largest slice per playRaw() call
+#define PLAYBACK_STREAM_SLICE_SAMPLES 1024  // ~43 ms at 24kHz; smaller slices start sooner
+#define PLAYBACK_MAX_IN_FLIGHT 2            // M5.Speaker holds one playing + one queued per channel
+#define PLAYBACK_RING_SAMPLES (1 << 19)     // ~21 s at 24kHz in PSRAM, power of two
+#define PLAYBACK_RESAMPLE_SLICE_SAMPLES 2048 // resampler output slices, at the native rate
+#define PLAYBACK_FADE_MS 5                  // start, end, underrun and resume ramps
+#define PLAYBACK_TAIL_MARGIN_MS 10          // headroom for fading a slice that is already playing
+#define PLAYBACK_STOP_FADE_MS 8             // channel volume ramp before an abort cuts the speaker
+#define PLAYBACK_CROSSFADE_MS 20            // clip replacing a playing clip
+#define PLAYBACK_CROSSFADE_MAX_SAMPLES 1024 // caps the crossfade at high rates
+#define PLAYBACK_VOICE_SLICE_SAMPLES 1024   // voices alone between responses; short so a response isn't held up
+#define PLAYBACK_TASK_PRIORITY 4            // below capture, above loopTask
+#define PLAYBACK_TASK_CORE 1                // keep off the Wi-Fi core
+#define PLAYBACK_TASK_STACK 4096
+#define PLAYBACK_SERVICE_MS 5               // feeder period; well inside one slice
+#define PLAYBACK_DYNAMICS 1                 // output loudness normalization + limiter
+#define PLAYBACK_LOUDNESS_TARGET_RMS 3000   // ~-21 dBFS
+#define PLAYBACK_LOUDNESS_GATE_RMS 300      // pauses don't pull the level estimate down
+#define PLAYBACK_LOUDNESS_WINDOW_MS 3000
+#define PLAYBACK_LOUDNESS_MIN_GAIN_Q12 1024 // -12 dB
+#define PLAYBACK_LOUDNESS_MAX_GAIN_Q12 16384 // +12 dB
+#define PLAYBACK_LIMITER_THRESHOLD 24000    // ~-2.7 dBFS
+#define PLAYBACK_LIMITER_LOOKAHEAD_US 2000  // also the latency the limiter adds
+#define PLAYBACK_LIMITER_RELEASE_MS 80
+#define PLAYBACK_MAX_SPEED 150              // percent; time stretching above 100
+#define JITTER_MIN_MS 80                    // low-water mark bounds; underruns are click-free
+#define JITTER_MAX_MS 1500
+#define JITTER_INITIAL_MS 250
+
+enum PcmSampleFormat
+{
+    PCM_SAMPLE_S16LE,
+    PCM_SAMPLE_U8 // unsigned, 128 = silence
+};
+
+struct PcmStreamFormat
+{
+    uint32_t sample_rate;
+    uint8_t channels; // 1 or 2, interleaved; stereo is downmixed
+    PcmSampleFormat sample_format;
+};
+
+enum PlaybackEvent
+{
+    PLAYBACK_IDLE,      // no stream
+    PLAYBACK_BUFFERING, // waiting for the low-water mark
+    PLAYBACK_PLAYING,
+    PLAYBACK_FINISHED   // stream ended and everything has played (reported once)
+};
+
+struct PlaybackStats
+{
+    uint32_t time_to_first_audio_ms; // stream start to first slice queued
+    uint32_t underruns;              // times the ring ran dry mid-stream this turn
+    uint32_t low_water_ms;           // mark used for this turn
+    uint32_t jitter_ms;              // smoothed inter-arrival deviation
+    uint32_t samples_played;
+    uint32_t samples_dropped;        // chunk data that did not fit in the ring
+    uint32_t output_rate;            // rate handed to the speaker
+    uint32_t resampled_samples;      // output samples produced by the resampler this turn
+    uint32_t resample_cycles;        // CPU cycles spent producing them
+    uint32_t dynamics_samples;       // samples through the output dynamics this turn
+    uint32_t dynamics_cycles;        // CPU cycles spent on them
+    uint32_t stretched_samples;      // samples out of the time stretcher this turn
+    uint32_t stretch_cycles;         // CPU cycles spent producing them
+    uint32_t mix_samples;            // output samples voices were mixed into this turn
+    uint32_t mix_cycles;             // CPU cycles spent mixing them
+    SignalStats signal;              // over everything written to the stream this turn
+};
+
+// Speaker channel and clock under the consumer
+struct PlaybackSink
+{
+    void *context;
+    bool (*play)(void *context, const int16_t *samples, size_t len, uint32_t sample_rate, bool stereo); // false if full
+    size_t (*queued)(void *context);        // slices taken and not played out yet, the playing one included
+    uint8_t (*volume)(void *context);
+    void (*set_volume)(void *context, uint8_t volume);
+    void (*stop)(void *context);            // cut the channel, dropping what is queued
+    void (*wait_ms)(void *context, uint32_t ms);
+    unsigned long (*now_ms)(void *context);
+    uint32_t (*cycle_count)(void *context); // for the cycle stats
+};
+
+// Allocate the ring and start the feeder task (call once at startup)
+bool playback_begin();
+
+// Reset the core onto a ring (power of two) and a sink, without a feeder;
+// playback_begin() does this on the device
+bool playback_init(int16_t *ring_storage, size_t ring_samples, const PlaybackSink &sink);
+
+// One pass of the feeder: release played slices, queue more, play the voices
+PlaybackEvent playback_service();
+
+// True once the feeder has carried out the last abort
+bool playback_abort_settled();
+
+// Speaker's native rate; streams at other rates are resampled to it (0 = always pass through)
+void playback_set_output_rate(uint32_t sample_rate);
+
+// Playback speed of streams in percent (100 to PLAYBACK_MAX_SPEED); a stream
+// already playing follows from its next chunk
+void playback_set_speed(uint32_t percent);
+uint32_t playback_speed();
+
+// Producer side (network): one stream per response
+void playback_stream_begin(const PcmStreamFormat &format);
+void playback_stream_write(const uint8_t *data, size_t bytes); // frames in the stream format, any split
+void playback_stream_write_samples(const int16_t *samples, size_t count); // mono 16-bit (decoded ADPCM)
+void playback_stream_note_chunk(); // one network chunk arrived (feeds the jitter estimate)
+void playback_stream_end();
+void playback_stream_abort(); // stops what was started before it; returns at once
+
+// Abort, then wait (a few ms) until the feeder has let go of every buffer it was
+// playing from, so a clip buffer can be freed or replaced
+void playback_stop();
+
+// Play a complete buffer (16-bit, interleaved if stereo) without copying it; the
+// output dynamics are applied to it in place
+void playback_play_clip(int16_t *samples, size_t count, uint32_t sample_rate, bool stereo);
+
+// Overlay a mono sound on the output (see audio_mixer.h); the buffer must stay
+// valid until it has played. Returns a handle for playback_stop_voice(), 0 if it
+// could not be queued
+uint32_t playback_play_voice(const int16_t *samples, size_t count, uint32_t sample_rate, const MixerVoiceParams &params);
+void playback_stop_voice(uint32_t handle);
+
+// True once after a stream or clip has played out; clip buffers may be freed then
+bool playback_take_finished();
+bool playback_active();
+
+PlaybackStats playback_stats();
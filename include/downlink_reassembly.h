@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Puts a response's audio back together from chunks that carry their byte
+// offset
+//
+// Chunks that continue the bytes delivered so far go straight to the sink. A
+// chunk that starts further on leaves a gap: it is copied into a hold window
+// (addressed by offset modulo the window size, so it covers the window's worth
+// of bytes after the delivered ones) and handed on once the gap is filled.
+// Bytes already delivered or held are skipped, so duplicates and overlapping
+// resends are harmless, and the sink sees every byte once, in order. What is
+// still missing can be listed as byte ranges for a resend request.
+
+#define REASSEMBLY_MAX_HELD 8 // separate held runs; a chunk that would need another is dropped
+
+struct ByteRange
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+enum ReassemblyResult
+{
+    REASSEMBLY_DELIVERED, // continued the delivered bytes (and released any held run it joined)
+    REASSEMBLY_HELD,      // past a gap; kept until the gap is filled
+    REASSEMBLY_DUPLICATE, // nothing new
+    REASSEMBLY_DROPPED    // past a gap and didn't fit the window; still missing
+};
+
+struct ReassemblyStats
+{
+    uint32_t delivered;
+    uint32_t held;
+    uint32_t duplicates;
+    uint32_t dropped;
+};
+
+typedef void (*ReassemblySink)(void *context, const uint8_t *data, size_t len);
+
+class DownlinkReassembly
+{
+public:
+    DownlinkReassembly();
+
+    // Start a response of total_bytes; window may be nullptr (chunks past a gap are then dropped)
+    void begin(uint32_t total_bytes, uint8_t *window, size_t window_bytes, ReassemblySink sink, void *context);
+
+    ReassemblyResult accept(uint32_t offset, const uint8_t *data, size_t len);
+
+    uint32_t delivered() const { return delivered_; }
+    uint32_t total() const { return total_; }
+    bool complete() const { return delivered_ >= total_; }
+    bool has_gap() const { return held_count_ > 0; }
+
+    // Ranges between the delivered bytes and the end that aren't held, in order; returns how many (at most max)
+    size_t missing(ByteRange *out, size_t max) const;
+
+    const ReassemblyStats &stats() const { return stats_; }
+
+private:
+    bool hold(uint32_t offset, const uint8_t *data, size_t len);
+    void release_held();
+
+    uint8_t *window_;
+    size_t window_bytes_;
+    uint32_t total_;
+    uint32_t delivered_;
+    ByteRange held_[REASSEMBLY_MAX_HELD]; // sorted, disjoint and not touching, all past delivered_
+    size_t held_count_;
+    ReassemblySink sink_;
+    void *context_;
+    ReassemblyStats stats_;
+};
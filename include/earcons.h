@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "earcons_data.h"
+
+// Earcons and fixed prompts compiled into flash
+//
+// scripts/gen_earcons.py turns assets/earcons/*.wav into IMA-ADPCM arrays in
+// earcons_data.cpp at build time (one EarconId per file, declared in
+// earcons_data.h). The committed sources are synthesized tones; a recorded
+// prompt replaces one by dropping in a WAV of the same name. earcons_begin()
+// decodes them once into PSRAM; earcon_play() then only hands the decoded
+// buffer to the playback mixer as a voice, so it never blocks and can be used
+// from any state. Over a response that is playing it is mixed in and the
+// response is ducked until it ends.
+
+#define EARCON_PRIORITY 1
+#define EARCON_GAIN_Q12 4096 // unity
+#define EARCON_DUCK_Q12 1300 // response at about -10 dB under an earcon
+
+// Decode the bank (call once at startup); false if PSRAM ran out
+bool earcons_begin();
+
+// Start an earcon, replacing one that is still playing
+void earcon_play(EarconId id);
+
+// How long an earcon plays for
+uint32_t earcon_duration_ms(EarconId id);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <FS.h>
+#include "tts_cache.h"
+
+// TtsCacheStorage on an Arduino filesystem (SPIFFS or SD)
+class FsCacheStorage : public TtsCacheStorage
+{
+public:
+    explicit FsCacheStorage(fs::FS &fs) : fs_(fs) {}
+
+    bool write(const char *path, const uint8_t *data, size_t len) override;
+    bool append(const char *path, const uint8_t *data, size_t len) override;
+    size_t read(const char *path, size_t offset, uint8_t *dst, size_t len) override;
+    bool remove(const char *path) override;
+
+private:
+    bool write_mode(const char *path, const char *mode, const uint8_t *data, size_t len);
+
+    fs::FS &fs_;
+};
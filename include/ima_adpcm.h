@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// IMA-ADPCM codec (4 bits per sample, 4:1 against 16-bit PCM)
+//
+// Frames are self-contained: a 4-byte header carries the coder state
+// (little-endian predictor, step index, flags) followed by two samples per
+// byte, low nibble first, as in the WAV IMA-ADPCM layout. A lost frame
+// therefore never desynchronises the frames after it. A frame of an odd number
+// of samples sets IMA_ADPCM_FLAG_ODD, and the high nibble of its last byte is
+// padding, so the header and length give the exact sample count.
+
+#define IMA_ADPCM_HEADER_BYTES 4
+#define IMA_ADPCM_FLAG_ODD 0x01 // header byte 3: the last byte holds one sample
+
+struct ImaAdpcmState
+{
+    int32_t predictor;
+    int32_t step_index;
+};
+
+void ima_adpcm_reset(ImaAdpcmState *state);
+
+// Bytes needed to encode a frame of n samples (header included)
+inline size_t ima_adpcm_frame_bytes(size_t samples)
+{
+    return IMA_ADPCM_HEADER_BYTES + (samples + 1) / 2;
+}
+
+// Encode n samples into out (ima_adpcm_frame_bytes(n) bytes); the state carries over
+size_t ima_adpcm_encode_frame(ImaAdpcmState *state, const int16_t *pcm, size_t samples, uint8_t *out);
+
+// Samples in a frame produced by ima_adpcm_encode_frame
+size_t ima_adpcm_frame_samples(const uint8_t *frame, size_t frame_bytes);
+
+// Decode a frame produced by ima_adpcm_encode_frame; returns samples written
+size_t ima_adpcm_decode_frame(const uint8_t *frame, size_t frame_bytes, int16_t *pcm, size_t max_samples);
+
+// Headerless nibble stream: decode with state carried across calls, for byte streams
+// that are split at arbitrary points (two samples per byte, low nibble first)
+size_t ima_adpcm_decode_stream(ImaAdpcmState *state, const uint8_t *data, size_t bytes, int16_t *pcm);
+
+// Single-sample primitives shared by the frame and stream coders
+uint8_t ima_adpcm_encode_sample(ImaAdpcmState *state, int16_t sample);
+int16_t ima_adpcm_decode_sample(ImaAdpcmState *state, uint8_t nibble);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Quantized keyword-spotting network (stack of int8 fully connected layers)
+//
+// The model is a flat little-endian blob, normally read from SPIFFS:
+//
+//   header (16 bytes): "KWS1", u16 frames, u16 mel_bins, f32 feature_scale,
+//                      i8 feature_zero, u8 layer_count, u16 reserved
+//   per layer:         u16 inputs, u16 outputs, f32 requant, u8 relu, u8[3] pad,
+//                      i32 bias[outputs], i8 weights[outputs][inputs] padded to 4 bytes
+//
+// Features are quantized as q = round(log_mel * feature_scale) + feature_zero.
+// Hidden layers produce int8 activations (acc * requant, ReLU optional); the
+// last layer has two outputs, [other, keyword], turned into a probability.
+// The blob must stay alive while the model is used; weights are not copied.
+
+#define KWS_MAX_LAYERS 6
+#define KWS_MAX_WIDTH 256 // widest hidden layer
+
+struct KwsLayer
+{
+    uint16_t inputs;
+    uint16_t outputs;
+    float requant;
+    bool relu;
+    const int32_t *bias;
+    const int8_t *weights;
+};
+
+class KwsModel
+{
+public:
+    KwsModel() : layer_count_(0), frames_(0), mel_bins_(0), feature_scale_(1.0f), feature_zero_(0) {}
+
+    // Validate and index a model blob (must be 4-byte aligned)
+    bool load(const uint8_t *blob, size_t length);
+    bool loaded() const { return layer_count_ > 0; }
+
+    uint16_t frames() const { return frames_; }
+    uint16_t mel_bins() const { return mel_bins_; }
+    size_t input_size() const { return (size_t)frames_ * mel_bins_; }
+
+    int8_t quantize_feature(float log_mel) const;
+
+    // Run the network over frames * mel_bins quantized features (oldest frame first)
+    float keyword_probability(const int8_t *features) const;
+
+    // Multiply-accumulates per inference, for budgeting
+    uint32_t macs() const;
+
+private:
+    KwsLayer layers_[KWS_MAX_LAYERS];
+    size_t layer_count_;
+    uint16_t frames_;
+    uint16_t mel_bins_;
+    float feature_scale_;
+    int8_t feature_zero_;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Log-mel feature extraction for keyword spotting
+//
+// Each hop of new samples shifts a 512-sample Hann window, runs a real FFT
+// (as a 256-point complex FFT), folds the power spectrum into triangular mel
+// bands and returns their natural log. All tables are built by init() and
+// live in the object, so push() does no allocation.
+
+#define LOG_MEL_FFT_SIZE 512
+#define LOG_MEL_BINS 40
+#define LOG_MEL_SPECTRUM_BINS (LOG_MEL_FFT_SIZE / 2 + 1)
+
+class LogMelExtractor
+{
+public:
+    bool init(uint32_t sample_rate, size_t hop_samples, float low_hz, float high_hz);
+
+    // Add one hop of samples; writes LOG_MEL_BINS log energies
+    void push(const int16_t *hop, float *log_mel);
+
+private:
+    void fft(float *re, float *im) const;
+
+    size_t hop_;
+    float window_[LOG_MEL_FFT_SIZE];
+    float history_[LOG_MEL_FFT_SIZE];
+    float twiddle_re_[LOG_MEL_FFT_SIZE / 4];
+    float twiddle_im_[LOG_MEL_FFT_SIZE / 4];
+    uint16_t bit_reverse_[LOG_MEL_FFT_SIZE / 2];
+    float split_re_[LOG_MEL_FFT_SIZE / 2]; // twiddles that turn the half-size FFT into the real spectrum
+    float split_im_[LOG_MEL_FFT_SIZE / 2];
+
+    // Sparse filterbank: band b covers spectrum bins [band_start_[b], band_start_[b] + band_len_[b])
+    uint16_t band_start_[LOG_MEL_BINS];
+    uint16_t band_len_[LOG_MEL_BINS];
+    uint16_t band_offset_[LOG_MEL_BINS];
+    float band_weights_[LOG_MEL_SPECTRUM_BINS * 2]; // each spectrum bin feeds at most two bands
+};
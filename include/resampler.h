@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Streaming rational-ratio polyphase resampler (mono, Q15)
+//
+// The ratio out_rate / in_rate is reduced to L / M; a windowed-sinc low-pass
+// prototype of RESAMPLER_TAPS * L coefficients is split into L phases of
+// RESAMPLER_TAPS taps, each normalised to unity DC gain. Each output sample
+// costs RESAMPLER_TAPS multiply-accumulates regardless of the ratio. State
+// carries across calls, so input can be fed in arbitrary pieces.
+
+#define RESAMPLER_TAPS 16
+#define RESAMPLER_MAX_PHASES 441 // enough for 8k/16k/24k into 44.1k; 48k and 64k need far fewer
+
+class PolyphaseResampler
+{
+public:
+    PolyphaseResampler() : up_(0), down_(0) {}
+
+    // False if the reduced ratio needs more than RESAMPLER_MAX_PHASES phases
+    bool init(uint32_t in_rate, uint32_t out_rate);
+    void reset();
+    bool ready() const { return up_ != 0; }
+
+    // Convert as much of in as fits in out; *consumed reports the input samples used
+    size_t process(const int16_t *in, size_t in_count, int16_t *out, size_t out_capacity, size_t *consumed);
+
+private:
+    uint32_t up_;    // L
+    uint32_t down_;  // M
+    uint32_t phase_; // position of the next output between inputs, in 1/L steps
+    size_t next_;    // index of the next output's newest input, relative to the next block
+    int16_t history_[RESAMPLER_TAPS - 1]; // last inputs, oldest first
+    int16_t coeffs_[RESAMPLER_MAX_PHASES][RESAMPLER_TAPS];
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Growable sample buffer made of fixed-size blocks
+//
+// Blocks are allocated from PSRAM on demand and returned to a free list when
+// the buffer is cleared, so repeated utterances reuse the same memory instead
+// of fragmenting the heap. The total length is bounded only by the sample
+// budget given to init(). Samples are addressed by absolute position; callers
+// that need contiguous memory use read_span() or copy_out().
+
+class SegmentedAudioBuffer
+{
+public:
+    SegmentedAudioBuffer();
+    ~SegmentedAudioBuffer();
+
+    // block_samples is the allocation unit; budget_samples caps the total length
+    bool init(size_t block_samples, size_t budget_samples);
+
+    size_t size() const { return size_; }
+    size_t budget() const { return max_blocks_ * block_samples_; }
+    size_t block_samples() const { return block_samples_; }
+    bool full() const { return size_ >= budget(); }
+
+    // Contiguous room at the end (allocating a block if needed); publish with commit()
+    size_t write_span(int16_t **ptr);
+    void commit(size_t n) { size_ += n; }
+
+    // Append by copy; returns how many samples fit within the budget
+    size_t append(const int16_t *data, size_t n);
+
+    // Contiguous samples starting at pos (at most to the end of its block)
+    size_t read_span(size_t pos, const int16_t **ptr) const;
+
+    // Copy n samples starting at pos, crossing block boundaries as needed
+    size_t copy_out(size_t pos, int16_t *dst, size_t n) const;
+
+    // Forget the contents; blocks go back to the free list
+    void clear();
+
+    // Blocks currently allocated from the heap (in use + free list)
+    size_t blocks_allocated() const { return used_blocks_ + free_count_; }
+
+private:
+    int16_t *acquire_block();
+
+    size_t block_samples_;
+    size_t max_blocks_;
+    size_t size_;
+    int16_t **blocks_;     // chain of blocks in use, in order
+    size_t used_blocks_;
+    int16_t **free_list_;  // recycled blocks
+    size_t free_count_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Running statistics over 16-bit PCM
+//
+// Updated chunk by chunk as audio arrives, in integer math only, so the
+// numbers are ready the moment the last chunk lands and no second pass over
+// the audio is needed to validate or report it.
+
+#define SIGNAL_CLIP_LEVEL 32000  // |sample| at or above this counts as clipped
+#define SIGNAL_SILENCE_LEVEL 64  // |sample| below this counts as silent (~-54 dBFS)
+
+struct SignalStats
+{
+    uint32_t samples;
+    uint32_t peak;        // largest |sample|
+    int64_t sum;          // for the DC offset
+    uint64_t sum_squares; // for the RMS
+    uint32_t clipped;
+    uint32_t silent;
+};
+
+void signal_stats_reset(SignalStats *stats);
+void signal_stats_update(SignalStats *stats, const int16_t *samples, size_t count);
+
+uint32_t signal_stats_rms(const SignalStats *stats);
+int32_t signal_stats_dc(const SignalStats *stats);
+uint32_t signal_stats_silence_permille(const SignalStats *stats);
+
+// floor(sqrt(value))
+uint32_t isqrt64(uint64_t value);
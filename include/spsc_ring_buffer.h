@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Lock-free single-producer/single-consumer ring buffer.
+//
+// One task may call the producer side (push, write_span/commit) while another
+// calls the consumer side (pop, read_span/consume) without any locking. The
+// storage is supplied by the caller and its capacity must be a power of two.
+// Indices run freely and are masked on access, so full and empty are
+// distinguishable without wasting a slot.
+template <typename T>
+class SpscRingBuffer
+{
+public:
+    SpscRingBuffer() : storage_(nullptr), mask_(0), head_(0), tail_(0), overflow_count_(0), underflow_count_(0) {}
+
+    bool init(T *storage, size_t capacity)
+    {
+        if (storage == nullptr || capacity == 0 || (capacity & (capacity - 1)) != 0)
+            return false;
+
+        storage_ = storage;
+        mask_ = capacity - 1;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        overflow_count_.store(0, std::memory_order_relaxed);
+        underflow_count_.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Elements ready for the consumer
+    size_t available() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    // Room left for the producer
+    size_t free_space() const { return capacity() - available(); }
+
+    // Producer: copy all n elements in, or none if they do not fit (counted as an overflow)
+    bool push(const T *data, size_t n)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        if (capacity() - (head - tail) < n)
+        {
+            overflow_count_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        size_t first = contiguous(head, n);
+        memcpy(storage_ + (head & mask_), data, first * sizeof(T));
+        memcpy(storage_, data + first, (n - first) * sizeof(T));
+        head_.store(head + n, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: copy up to n elements out; a short read is counted as an underflow
+    size_t pop(T *data, size_t n)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t count = head - tail;
+        if (count < n)
+        {
+            underflow_count_.fetch_add(1, std::memory_order_relaxed);
+            n = count;
+        }
+
+        size_t first = contiguous(tail, n);
+        memcpy(data, storage_ + (tail & mask_), first * sizeof(T));
+        memcpy(data + first, storage_, (n - first) * sizeof(T));
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    // Producer: contiguous writable region; publish it with commit()
+    size_t write_span(T **ptr)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        *ptr = storage_ + (head & mask_);
+        return contiguous(head, capacity() - (head - tail));
+    }
+
+    void commit(size_t n)
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // Consumer: contiguous readable region; release it with consume()
+    size_t read_span(T **ptr)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        *ptr = storage_ + (tail & mask_);
+        return contiguous(tail, head - tail);
+    }
+
+    // Consumer: contiguous readable region starting offset elements past the read position,
+    // for consumers that hand out data before releasing it
+    size_t read_span_at(size_t offset, T **ptr)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t count = head - tail;
+        *ptr = storage_ + ((tail + offset) & mask_);
+        return count > offset ? contiguous(tail + offset, count - offset) : 0;
+    }
+
+    void consume(size_t n)
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // Consumer: drop everything currently queued
+    void discard() { consume(available()); }
+
+    // Producer: elements written so far (runs freely like the indices); a mark for discard_to()
+    size_t write_position() const { return head_.load(std::memory_order_relaxed); }
+
+    // Consumer: drop what was written before a write_position() mark, keeping anything
+    // written since; a mark the consumer is already past is ignored
+    void discard_to(size_t mark)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (mark - tail <= head_.load(std::memory_order_acquire) - tail)
+            tail_.store(mark, std::memory_order_release);
+    }
+
+    uint32_t overflow_count() const { return overflow_count_.load(std::memory_order_relaxed); }
+    uint32_t underflow_count() const { return underflow_count_.load(std::memory_order_relaxed); }
+
+private:
+    // Elements of n that fit before the end of storage starting at index
+    size_t contiguous(size_t index, size_t n) const
+    {
+        size_t to_end = capacity() - (index & mask_);
+        return n < to_end ? n : to_end;
+    }
+
+    T *storage_;
+    size_t mask_;
+    std::atomic<size_t> head_; // written by producer only
+    std::atomic<size_t> tail_; // written by consumer only
+    std::atomic<uint32_t> overflow_count_;
+    std::atomic<uint32_t> underflow_count_;
+};
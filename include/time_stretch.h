@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Streaming WSOLA time-scale modification (mono, Q15): plays speech faster
+// without raising its pitch
+//
+// Output is built from blocks of one overlap length. Each block crossfades the
+// natural continuation of the previous block with the input segment, within
+// +/- the seek range of the nominal position, that best matches it
+// (normalized cross-correlation on every second sample, coarse lag grid then
+// refined). The nominal position advances by speed x overlap per block. The
+// work per block is fixed by the overlap and seek lengths, and all buffers are
+// members, so nothing is allocated and the CPU cost per output sample is
+// bounded for a given rate.
+
+#define TSM_OVERLAP_MS 10       // block / crossfade length
+#define TSM_SEEK_MS 5           // alignment search range either side of the nominal position
+#define TSM_MAX_OVERLAP 480     // 10 ms at 48 kHz
+#define TSM_MAX_SEEK 240
+#define TSM_BUFFER_SAMPLES 4096 // input window; needs 2 * (overlap + seek) + hop
+#define TSM_MIN_SPEED 100       // percent
+#define TSM_MAX_SPEED 190       // hop must stay under two overlaps
+
+class WsolaStretcher
+{
+public:
+    WsolaStretcher() : overlap_(0), speed_(TSM_MIN_SPEED) {}
+
+    // Size blocks for the rate and start empty (the speed is kept); false if they don't fit the fixed buffers
+    bool init(uint32_t sample_rate);
+    void reset();
+    bool ready() const { return overlap_ != 0; }
+
+    // Takes effect from the next block
+    void set_speed(uint32_t percent);
+    uint32_t speed() const { return speed_; }
+
+    // Stretch as much of in as fits; *consumed reports the input samples taken
+    size_t process(const int16_t *in, size_t in_count, int16_t *out, size_t out_capacity, size_t *consumed);
+
+    // End of input: later process() calls hand out what is still buffered, unstretched
+    void finish() { finishing_ = true; }
+
+private:
+    bool step();
+    bool drain_step();
+    size_t best_offset(size_t nominal) const;
+    int32_t correlate(size_t offset, int32_t *energy) const;
+
+    size_t overlap_;   // block length, even
+    size_t seek_;      // even
+    uint32_t speed_;
+    uint32_t hop_q8_;  // nominal input advance per block, Q8
+
+    int16_t buf_[TSM_BUFFER_SAMPLES];
+    size_t len_;
+    uint32_t pos_q8_;  // nominal start of the next candidate in buf_, Q8
+    size_t next_;      // first input sample after the template (natural continuation)
+    bool started_;
+    bool finishing_;
+
+    int16_t tmpl_[TSM_MAX_OVERLAP]; // continuation of the last block, to be crossfaded out
+    size_t tmpl_len_;
+
+    int16_t out_[TSM_MAX_OVERLAP];  // finished block not yet handed out
+    size_t out_len_;
+    size_t out_pos_;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Persistent cache of TTS responses, keyed by a hash of the response text (or
+// a server-supplied cache id)
+//
+// Each entry is one file holding a small header and the audio bytes exactly as
+// they arrived on the wire, so a hit is replayed through the normal downlink
+// path. An index file keeps the keys, sizes and last-use order; inserting an
+// entry evicts least recently used ones until the total fits the byte budget.
+// All file access goes through TtsCacheStorage, so the index and eviction
+// logic doesn't depend on the filesystem behind it.
+//
+// Only the store_*() calls and flush() write. A hit just marks the index dirty,
+// so the caller decides when the filesystem may be written.
+
+#define TTS_CACHE_MAX_ENTRIES 48
+#define TTS_CACHE_DIR "/tts"
+#define TTS_CACHE_INDEX_PATH TTS_CACHE_DIR "/index.bin"
+
+// Minimal file operations the cache needs
+class TtsCacheStorage
+{
+public:
+    virtual ~TtsCacheStorage() {}
+
+    virtual bool write(const char *path, const uint8_t *data, size_t len) = 0; // create or replace
+    virtual bool append(const char *path, const uint8_t *data, size_t len) = 0;
+    virtual size_t read(const char *path, size_t offset, uint8_t *dst, size_t len) = 0;
+    virtual bool remove(const char *path) = 0;
+};
+
+// Stored ahead of the audio in every entry
+struct TtsAudioHeader
+{
+    uint8_t format;       // DownlinkFormat of the stored bytes
+    uint8_t channels;
+    uint16_t reserved;
+    uint32_t sample_rate;
+    uint32_t data_bytes;
+};
+
+class TtsCache
+{
+public:
+    TtsCache() : storage_(nullptr), budget_(0), count_(0), clock_(0), index_dirty_(false), storing_(false) {}
+
+    // Load the index; false if there is no storage
+    bool begin(TtsCacheStorage *storage, uint32_t budget_bytes);
+
+    static uint64_t key_for(const char *text); // 64-bit FNV-1a
+
+    // Hit: fills header and marks the entry most recently used (in memory until flush())
+    bool lookup(uint64_t key, TtsAudioHeader *header);
+    size_t read_audio(uint64_t key, size_t offset, uint8_t *dst, size_t len);
+
+    // Store an entry in pieces: begin (evicts to make room), append, then commit
+    bool store_begin(uint64_t key, const TtsAudioHeader &header);
+    bool store_append(const uint8_t *data, size_t len);
+    bool store_commit();
+    void store_abort();
+    bool storing() const { return storing_; }
+
+    // Write the index if hits or dropped entries changed it since the last write
+    bool flush();
+    bool dirty() const { return index_dirty_; }
+
+    size_t entries() const { return count_; }
+    uint32_t used_bytes() const;
+    uint32_t budget() const { return budget_; }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t bytes;     // header + audio
+        uint32_t last_used; // cache clock at the last hit or store
+    };
+
+    int find(uint64_t key) const;
+    void remove_at(size_t index);
+    bool evict_for(uint32_t bytes);
+    bool save_index();
+    static void entry_path(uint64_t key, char *path, size_t len);
+
+    TtsCacheStorage *storage_;
+    uint32_t budget_;
+    Entry entries_[TTS_CACHE_MAX_ENTRIES];
+    size_t count_;
+    uint32_t clock_;
+    bool index_dirty_;
+
+    // Entry being stored
+    bool storing_;
+    uint64_t store_key_;
+    uint32_t store_expected_;
+    uint32_t store_written_;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ima_adpcm.h"
+#include "wire_protocol.h"
+
+// Cuts a recording into uplink frames while it is still growing
+//
+// Samples are addressed by absolute position in the recording. Each pump()
+// sends every whole frame between the last one sent and the limit the caller
+// allows (with VAD, silence that might still be trimmed is held back); a
+// flushing pump() also sends the partial tail. Frames are PCM16 or IMA-ADPCM,
+// either bare, with the JSON control messages sent by the caller, or as wire
+// UTTERANCE_AUDIO frames bracketed by UTTERANCE_START and UTTERANCE_END.
+
+#define UPLINK_MAX_FRAME_SAMPLES 1600 // 100 ms at 16 kHz
+
+// Uplink codecs the device offers in its hello; the server picks one in its connection message
+enum UplinkCodec
+{
+    UPLINK_CODEC_PCM16,
+    UPLINK_CODEC_IMA_ADPCM // 4:1, self-contained frames with a 4-byte state header
+};
+
+// Samples [pos, pos + samples) of the recording: a pointer into it, or into scratch after copying them there
+typedef const int16_t *(*UplinkSource)(void *context, size_t pos, size_t samples, int16_t *scratch);
+
+// One message for the server; returns false if it could not be sent
+typedef bool (*UplinkSink)(void *context, const uint8_t *data, size_t len);
+
+class UplinkStream
+{
+public:
+    UplinkStream();
+
+    // frame_samples is at most UPLINK_MAX_FRAME_SAMPLES
+    bool init(uint32_t sample_rate, size_t frame_samples, UplinkSource source, UplinkSink sink, void *context);
+
+    // Optional cycle counter for the encoder cost
+    void set_cycle_counter(uint32_t (*counter)()) { cycle_counter_ = counter; }
+
+    // Start an utterance at position 0 (sends UTTERANCE_START when binary)
+    void begin(uint32_t utterance_id, UplinkCodec codec, bool binary);
+
+    // Leading trim: samples before pos are never sent
+    void skip_to(size_t pos);
+
+    // Send the frames that end at or before limit (and the tail when flushing); returns frames sent
+    size_t pump(size_t limit, bool flush);
+
+    // Close the utterance (sends UTTERANCE_END with the totals when binary)
+    void end();
+
+    // Another wire frame numbered in this utterance, with its payload written at frame_payload()
+    uint8_t *frame_payload() { return tx_ + WIRE_HEADER_BYTES; }
+    size_t frame_payload_capacity() const { return sizeof(tx_) - WIRE_HEADER_BYTES; }
+    bool send_frame(uint8_t type, size_t payload_len);
+
+    uint32_t utterance_id() const { return utterance_id_; }
+    size_t start_pos() const { return start_pos_; }
+    size_t sent_pos() const { return sent_pos_; }
+    size_t samples_sent() const { return sent_pos_ - start_pos_; }
+    uint32_t frames_sent() const { return frames_sent_; }
+    size_t frame_samples() const { return frame_samples_; }
+    uint64_t encode_cycles() const { return encode_cycles_; }
+
+private:
+    uint32_t sample_rate_;
+    size_t frame_samples_;
+    UplinkSource source_;
+    UplinkSink sink_;
+    void *context_;
+    uint32_t (*cycle_counter_)();
+
+    uint32_t utterance_id_;
+    UplinkCodec codec_;
+    bool binary_;
+    uint32_t seq_;
+    size_t start_pos_;
+    size_t sent_pos_;
+    uint32_t frames_sent_;
+    ImaAdpcmState adpcm_;
+    uint64_t encode_cycles_;
+
+    int16_t scratch_[UPLINK_MAX_FRAME_SAMPLES];
+    uint8_t tx_[WIRE_HEADER_BYTES + UPLINK_MAX_FRAME_SAMPLES * sizeof(int16_t)]; // payload is built in place after the header
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Frame-based voice activity detector
+//
+// Each frame is classified as speech when its mean energy rises far enough
+// above an adaptive noise floor, or moderately above it with a zero-crossing
+// rate typical of unvoiced consonants. Short gaps are bridged by a hangover,
+// and the utterance is declared finished after a configurable run of trailing
+// silence. All arithmetic is integer so it is cheap to run per capture frame.
+
+struct VadConfig
+{
+    uint32_t sample_rate;
+    uint16_t frame_samples;
+    uint16_t min_speech_ms;       // consecutive speech needed to declare onset
+    uint16_t hangover_ms;         // speech label held across short gaps
+    uint16_t noise_seed_ms;       // the quietest frame in this opening stretch seeds the noise floor
+    uint16_t trailing_silence_ms; // silence after speech that ends the utterance
+    uint16_t lead_in_ms;          // audio kept before the detected onset when trimming
+    uint16_t tail_ms;             // audio kept after the last speech frame when trimming
+    uint16_t energy_ratio_q4;     // speech if energy > noise floor * ratio / 16
+    uint16_t fricative_ratio_q4;  // weaker energy ratio accepted for high-ZCR frames
+    uint16_t zcr_min_q8;          // fricative zero-crossing band, crossings per sample * 256
+    uint16_t zcr_max_q8;
+    uint32_t min_energy;          // absolute floor so digital silence never counts as speech
+};
+
+enum VadEvent
+{
+    VAD_EVENT_NONE,
+    VAD_EVENT_SPEECH_START,
+    VAD_EVENT_SPEECH_END
+};
+
+// Defaults tuned for 16kHz, 20 ms frames on the Core2 microphone
+VadConfig vad_default_config(uint32_t sample_rate, uint16_t frame_samples);
+
+class VoiceActivityDetector
+{
+public:
+    VoiceActivityDetector();
+
+    void init(const VadConfig &config);
+    void reset();
+
+    // Classify one frame of config.frame_samples samples
+    VadEvent process_frame(const int16_t *frame);
+
+    bool speech_detected() const { return speech_started_; }
+    bool in_speech() const { return speech_started_ && !speech_ended_ && hangover_left_ > 0; }
+    bool ended() const { return speech_ended_; }
+
+    // Sample offsets (from reset) bounding the speech plus configured padding
+    size_t trim_start() const;
+    size_t trim_end(size_t total_samples) const;
+
+    // Samples that are known not to be trimmed away yet (safe to stream)
+    size_t confirmed_end(size_t total_samples) const;
+
+    size_t samples_processed() const { return samples_processed_; }
+    size_t speech_start_sample() const { return speech_start_sample_; }
+    size_t speech_end_sample() const { return speech_end_sample_; }
+    uint32_t noise_floor() const { return noise_floor_; }
+    uint32_t last_energy() const { return last_energy_; }
+
+private:
+    uint32_t ms_to_frames(uint16_t ms) const;
+    size_t ms_to_samples(uint16_t ms) const;
+
+    VadConfig config_;
+    uint32_t noise_floor_;
+    uint32_t last_energy_;
+    uint32_t onset_frames_;   // consecutive raw speech frames
+    uint32_t hangover_left_;  // frames the speech label is still held
+    bool speech_started_;
+    bool speech_ended_;
+    size_t samples_processed_;
+    size_t speech_start_sample_;
+    size_t speech_end_sample_; // end of the last raw speech frame
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "kws_model.h"
+#include "log_mel.h"
+
+// Hands-free wake word detection
+//
+// The capture hook feeds every frame in with wake_word_feed(); a low-priority
+// task on the Wi-Fi core hands each 20 ms hop to a WakeWordDetector, which
+// turns it into log-mel features and runs the quantized KwsModel over the
+// last second of them. Feature extraction runs on every hop; inference is
+// spaced out (stride) so the measured cost stays inside the configured share
+// of one core. The detector itself has no platform dependencies.
+
+#define WAKE_WORD_HOP_SAMPLES 320   // one capture frame
+#define WAKE_WORD_RING_SAMPLES 4096 // ~250 ms of slack for the task, power of two
+#define WAKE_WORD_TASK_PRIORITY 1
+#define WAKE_WORD_TASK_CORE 0
+#define WAKE_WORD_TASK_STACK 8192
+#define WAKE_WORD_MAX_STRIDE 8      // never infer less often than every 160 ms
+#define WAKE_WORD_SMOOTHING 3       // inferences averaged before thresholding
+#define WAKE_WORD_REFRACTORY_MS 1500
+
+// Features, model and decision for one audio stream, without the task around them
+class WakeWordDetector
+{
+public:
+    WakeWordDetector();
+    ~WakeWordDetector();
+
+    // Parse the model (the blob must outlive the detector) and set up feature extraction
+    bool init(const uint8_t *model_blob, size_t model_length, uint32_t sample_rate, float threshold);
+
+    // Start from fresh context, as when listening resumes
+    void reset();
+
+    // Features for one hop of WAKE_WORD_HOP_SAMPLES; true once a whole window of them is there
+    bool push_hop(const int16_t *hop);
+
+    // Run the model over the window; true on a detection (smoothed probability over the
+    // threshold, outside the refractory period), after which the context starts over
+    bool infer();
+
+    float last_probability() const { return last_probability_; }
+    const KwsModel &model() const { return model_; }
+
+private:
+    KwsModel model_;
+    LogMelExtractor features_;
+    int8_t *history_;      // frames x mel_bins, oldest first
+    size_t history_frames_; // frames filled since the context started
+    float threshold_;
+    float recent_[WAKE_WORD_SMOOTHING];
+    size_t recent_index_;
+    float last_probability_;
+    uint32_t hops_;
+    uint32_t refractory_hops_;
+    uint32_t last_detection_hop_;
+    bool detected_before_;
+};
+
+struct WakeWordStats
+{
+    uint32_t hops;              // feature frames computed
+    uint32_t inferences;
+    uint32_t detections;
+    uint32_t dropped_samples;   // ring overflow while the task was behind
+    uint32_t stride;            // hops between inferences (adapts to the budget)
+    uint32_t feature_cycles;    // average per hop
+    uint32_t inference_cycles;  // average per inference
+    uint32_t load_permille;     // share of one core used, relative to real time
+    float last_probability;
+};
+
+// Parse the model and start the task; model_blob must outlive the detector
+bool wake_word_begin(const uint8_t *model_blob, size_t model_length, uint32_t sample_rate, float threshold,
+                     uint8_t cpu_budget_percent);
+bool wake_word_running();
+
+// Producer side (capture task): ignored unless listening
+void wake_word_feed(const int16_t *samples, size_t n);
+
+// Only listen while it makes sense (STATE_READY); re-enabling starts from fresh context
+void wake_word_set_listening(bool listening);
+
+// Returns true once per detection
+bool wake_word_take_detection();
+
+WakeWordStats wake_word_stats();
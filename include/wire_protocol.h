@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary framing for the server link (control and audio)
+//
+// Every WebSocket binary message is one frame: a fixed 20-byte little-endian
+// header followed by the payload. The CRC-32 (IEEE) covers the first 16 header
+// bytes and the payload, so a damaged or truncated frame is rejected before
+// anything acts on it. Sequence numbers count frames per turn and direction
+// from 0; the turn is the utterance id going up and the server's response id
+// coming down.
+//
+// Control payloads are packed fields in a fixed order (see the WireType
+// comments); strings are a u16 length, which counts a terminating NUL, then the
+// bytes, so a parsed string can be used in place. Readers ignore trailing
+// fields they don't know, so a later minor version can append fields.
+//
+// Audio chunks carry the byte offset of their audio within the response, so a
+// gap or a duplicate shows up on the chunk that causes it. The device asks for
+// what it is missing with AUDIO_RESEND (at audio_complete, and after a
+// reconnect in place of dropping the response); the server answers with those
+// ranges as ordinary chunks of the same turn, then a fresh audio_complete.
+//
+// JSON text messages remain the default. The device offers this framing in its
+// JSON hello ("framing": "binary", "framingVersion": WIRE_VERSION) and switches,
+// in both directions, only when the server's JSON connection message carries
+// the same two fields back.
+
+#define WIRE_MAGIC 0xA7
+#define WIRE_VERSION 2 // 2: audio chunks carry their offset, AUDIO_RESEND
+#define WIRE_HEADER_BYTES 20
+#define WIRE_MAX_STRING 1024 // longest string a reader accepts
+
+enum WireType
+{
+    WIRE_CONNECTION = 1,  // down: uplink codec u8, message str
+    WIRE_TRANSCRIPTION,   // down: text str, response str, cache id str (empty = none)
+    WIRE_ERROR,           // down: message str
+    WIRE_AUDIO_START,     // down: format u8, channels u8, sample rate u32, total bytes u32, chunks u32, chunk bytes u32
+    WIRE_AUDIO_CHUNK,     // down: offset u32 (bytes into the response), then audio bytes in the declared format
+    WIRE_AUDIO_COMPLETE,  // down: no payload
+    WIRE_UTTERANCE_START, // up: sample rate u32, codec u8, frame ms u16
+    WIRE_UTTERANCE_AUDIO, // up: one uplink frame (PCM16, or an IMA-ADPCM frame)
+    WIRE_UTTERANCE_END,   // up: frames u32, samples u32
+    WIRE_AUDIO_CACHED,    // up: cache key u64
+    WIRE_AUDIO_RESEND     // up, in the response's turn: count u8, then offset u32, length u32 per missing range
+};
+
+enum WireStatus
+{
+    WIRE_OK,
+    WIRE_BAD_LENGTH,  // message shorter than a header, or not exactly header + its length
+    WIRE_BAD_MAGIC,
+    WIRE_BAD_VERSION, // version we don't speak
+    WIRE_BAD_CRC
+};
+
+struct WireHeader
+{
+    uint8_t type;
+    uint8_t flags; // none defined yet; sent as 0
+    uint32_t turn;
+    uint32_t seq;
+    uint32_t length; // payload bytes
+};
+
+// Check a received frame; on WIRE_OK *payload points just past the header
+WireStatus wire_parse(const uint8_t *frame, size_t len, WireHeader *header, const uint8_t **payload);
+
+// Fill in the header of a frame whose payload is already at frame + WIRE_HEADER_BYTES;
+// returns the total frame length
+size_t wire_finish(uint8_t *frame, uint8_t type, uint32_t turn, uint32_t seq, size_t payload_len);
+
+const char *wire_status_name(WireStatus status);
+
+// The server's JSON connection message agreed to this framing (framing "binary" at our
+// WIRE_VERSION); anything else, including a missing field, keeps the link on JSON
+bool wire_framing_accepted(const char *framing, int version);
+
+// CRC-32 (IEEE 802.3, reflected), continued from crc (0 to start)
+uint32_t wire_crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+// Appends little-endian fields to a payload; ok goes false (and stays) once one doesn't fit
+struct WireWriter
+{
+    uint8_t *data;
+    size_t capacity;
+    size_t len;
+    bool ok;
+};
+
+void wire_writer_init(WireWriter *w, uint8_t *data, size_t capacity);
+void wire_put_u8(WireWriter *w, uint8_t v);
+void wire_put_u16(WireWriter *w, uint16_t v);
+void wire_put_u32(WireWriter *w, uint32_t v);
+void wire_put_u64(WireWriter *w, uint64_t v);
+void wire_put_str(WireWriter *w, const char *s); // nullptr is sent as ""
+
+// Reads fields back; ok goes false once one runs past the payload, and later reads return 0 / ""
+struct WireReader
+{
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    bool ok;
+};
+
+void wire_reader_init(WireReader *r, const uint8_t *data, size_t len);
+uint8_t wire_get_u8(WireReader *r);
+uint16_t wire_get_u16(WireReader *r);
+uint32_t wire_get_u32(WireReader *r);
+uint64_t wire_get_u64(WireReader *r);
+const char *wire_get_str(WireReader *r); // points into the payload (NUL-terminated on the wire)
@@ -0,0 +1,203 @@
+"""Build the earcon bank: assets/earcons/*.wav -> include/earcons_data.h, src/earcons_data.cpp
+
+Each WAV (16-bit PCM, mono or stereo, any rate) is folded to mono and encoded
+as one IMA-ADPCM frame in the layout of ima_adpcm_encode_frame(), so the
+firmware decodes it with ima_adpcm_decode_frame(). The earcon id is the file
+name in upper case (listening.wav -> EARCON_LISTENING).
+
+The header holds the EarconId enum and an extern declaration of the bank; the
+arrays themselves are defined once, in the .cpp. Runs as a PlatformIO pre:
+script (see platformio.ini) and only rewrites a file whose content changed; it
+can also be run by hand:
+
+    python scripts/gen_earcons.py [project_dir]
+"""
+
+import os
+import sys
+import wave
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767]
+
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+SOURCE_DIR = os.path.join("assets", "earcons")
+HEADER_OUTPUT = os.path.join("include", "earcons_data.h")
+SOURCE_OUTPUT = os.path.join("src", "earcons_data.cpp")
+
+
+class AdpcmState:
+    def __init__(self):
+        self.predictor = 0
+        self.step_index = 0
+
+
+# Bit-for-bit the same as ima_adpcm_decode_sample()
+def decode_sample(state, nibble):
+    step = STEP_TABLE[state.step_index]
+    diff = step >> 3
+    if nibble & 4:
+        diff += step
+    if nibble & 2:
+        diff += step >> 1
+    if nibble & 1:
+        diff += step >> 2
+
+    predictor = state.predictor - diff if nibble & 8 else state.predictor + diff
+    state.predictor = max(-32768, min(32767, predictor))
+    state.step_index = max(0, min(88, state.step_index + INDEX_TABLE[nibble & 15]))
+    return state.predictor
+
+
+# Bit-for-bit the same as ima_adpcm_encode_sample()
+def encode_sample(state, sample):
+    step = STEP_TABLE[state.step_index]
+    diff = sample - state.predictor
+    nibble = 0
+
+    if diff < 0:
+        nibble = 8
+        diff = -diff
+    if diff >= step:
+        nibble |= 4
+        diff -= step
+    step >>= 1
+    if diff >= step:
+        nibble |= 2
+        diff -= step
+    step >>= 1
+    if diff >= step:
+        nibble |= 1
+
+    decode_sample(state, nibble)
+    return nibble
+
+
+def encode_frame(pcm):
+    state = AdpcmState()
+    out = bytearray([0, 0, 0, len(pcm) & 1])  # predictor and step index start at zero; odd-length flag
+    for i in range(0, len(pcm), 2):
+        lo = encode_sample(state, pcm[i])
+        hi = encode_sample(state, pcm[i + 1]) if i + 1 < len(pcm) else 0
+        out.append(lo | (hi << 4))
+    return bytes(out)
+
+
+def decode_frame(frame, samples):
+    state = AdpcmState()
+    state.predictor = int.from_bytes(frame[0:2], "little", signed=True)
+    state.step_index = frame[2]
+    pcm = []
+    for byte in frame[4:]:
+        pcm.append(decode_sample(state, byte & 15))
+        pcm.append(decode_sample(state, byte >> 4))
+    return pcm[:samples]
+
+
+def read_wav(path):
+    with wave.open(path, "rb") as wav:
+        if wav.getsampwidth() != 2 or wav.getnchannels() not in (1, 2):
+            raise ValueError("%s: need 16-bit mono or stereo PCM" % path)
+        channels = wav.getnchannels()
+        rate = wav.getframerate()
+        raw = wav.readframes(wav.getnframes())
+
+    values = [int.from_bytes(raw[i:i + 2], "little", signed=True) for i in range(0, len(raw), 2)]
+    if channels == 2:
+        values = [(values[i] + values[i + 1]) >> 1 for i in range(0, len(values) - 1, 2)]
+    return rate, values
+
+
+def render(project_dir):
+    """Return the (header, source) text for the WAVs currently in assets/earcons"""
+    source_dir = os.path.join(project_dir, SOURCE_DIR)
+    sources = sorted(f for f in os.listdir(source_dir) if f.lower().endswith(".wav"))
+    if not sources:
+        raise ValueError("no earcon sources in %s" % source_dir)
+
+    banner = "// Generated by scripts/gen_earcons.py from assets/earcons/*.wav; do not edit"
+    data = [banner, '#include "earcons_data.h"', ""]
+    entries = []
+    for source in sources:
+        name = os.path.splitext(source)[0].upper().replace("-", "_").replace(" ", "_")
+        rate, pcm = read_wav(os.path.join(source_dir, source))
+        frame = encode_frame(pcm)
+        entries.append((name, source, rate, len(pcm)))
+
+        data.append("static const uint8_t earcon_%s_adpcm[%d] = {" % (name.lower(), len(frame)))
+        for i in range(0, len(frame), 16):
+            data.append("    " + ", ".join("0x%02x" % b for b in frame[i:i + 16]) + ",")
+        data.append("};")
+        data.append("")
+
+    data.append("const EarconSource earcon_sources[EARCON_COUNT] = {")
+    for name, source, rate, samples in entries:
+        data.append('    {"%s", earcon_%s_adpcm, sizeof(earcon_%s_adpcm), %d, %d},'
+                    % (source, name.lower(), name.lower(), samples, rate))
+    data.append("};")
+    data.append("")
+
+    header = [
+        banner,
+        "#pragma once",
+        "",
+        "#include <cstddef>",
+        "#include <cstdint>",
+        "",
+        "enum EarconId",
+        "{",
+    ]
+    header += ["    EARCON_%s," % entry[0] for entry in entries]
+    header += [
+        "    EARCON_COUNT",
+        "};",
+        "",
+        "struct EarconSource",
+        "{",
+        "    const char *file;     // source in assets/earcons",
+        "    const uint8_t *adpcm; // one ima_adpcm_encode_frame() frame",
+        "    size_t adpcm_bytes;",
+        "    size_t samples;",
+        "    uint32_t sample_rate;",
+        "};",
+        "",
+        "extern const EarconSource earcon_sources[EARCON_COUNT]; // in earcons_data.cpp",
+        "",
+    ]
+    return "\n".join(header), "\n".join(data)
+
+
+def write_if_changed(path, text):
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == text:
+                return False
+    with open(path, "w") as f:
+        f.write(text)
+    return True
+
+
+# Always renders, so edits to this script and removed WAVs are picked up too, but only
+# rewrites outputs whose content changed so an unchanged bank doesn't trigger a rebuild
+def generate(project_dir):
+    header, data = render(project_dir)
+    written = []
+    for path, text in ((HEADER_OUTPUT, header), (SOURCE_OUTPUT, data)):
+        if write_if_changed(os.path.join(project_dir, path), text):
+            written.append(path)
+    return written
+
+
+if __name__ == "__main__":
+    generate(sys.argv[1] if len(sys.argv) > 1 else os.getcwd())
+elif "Import" in globals():
+    # Loaded by PlatformIO's SCons as an extra script
+    Import("env")  # noqa: F821
+    for path in generate(env.subst("$PROJECT_DIR")):  # noqa: F821
+        print("gen_earcons: wrote %s" % path)
@@ -0,0 +1,163 @@
+"""Write the VAD benchmark fixtures: test/test_vad/fixtures/*.wav + labels.csv
+
+Each fixture is 16 kHz mono 16-bit speech-like audio (voiced syllables built
+from a falling harmonic series with formant peaks, plus fricative noise
+bursts) over background noise, with the true start and end of the speech
+recorded in labels.csv. The output is deterministic, so the committed files
+can be regenerated exactly:
+
+    python scripts/make_vad_fixtures.py [project_dir]
+
+Recordings can be added to the same directory with a line in labels.csv
+(start and end in ms, or -1 -1 for a clip with no speech).
+"""
+
+import math
+import os
+import random
+import struct
+import sys
+import wave
+
+RATE = 16000
+FIXTURE_DIR = os.path.join("test", "test_vad", "fixtures")
+FORMANTS = [(500, 120), (1500, 200), (2500, 300)]
+
+
+class Track:
+    def __init__(self, seconds):
+        self.samples = [0.0] * int(seconds * RATE)
+
+    def add(self, start_s, values):
+        start = int(start_s * RATE)
+        for i, v in enumerate(values):
+            if start + i < len(self.samples):
+                self.samples[start + i] += v
+
+
+def envelope(n, attack, release):
+    out = []
+    for i in range(n):
+        gain = 1.0
+        if i < attack:
+            gain = 0.5 - 0.5 * math.cos(math.pi * i / attack)
+        elif i >= n - release:
+            gain = 0.5 - 0.5 * math.cos(math.pi * (n - i) / release)
+        out.append(gain)
+    return out
+
+
+def vowel(seconds, f0_start, f0_end, rms):
+    n = int(seconds * RATE)
+    env = envelope(n, int(0.03 * RATE), int(0.06 * RATE))
+    harmonics = []
+    for k in range(1, 25):
+        f = k * (f0_start + f0_end) / 2
+        if f > 3800:
+            break
+        boost = sum(math.exp(-((f - fc) / bw) ** 2) for fc, bw in FORMANTS)
+        harmonics.append((k, (0.15 + boost) / k))
+    norm = math.sqrt(sum(a * a for _, a in harmonics) / 2)
+
+    out = []
+    phase = 0.0
+    for i in range(n):
+        f0 = f0_start + (f0_end - f0_start) * i / n
+        phase += 2 * math.pi * f0 / RATE
+        s = sum(a * math.sin(k * phase) for k, a in harmonics)
+        out.append(rms * env[i] * s / norm)
+    return out
+
+
+def fricative(rng, seconds, rms):
+    n = int(seconds * RATE)
+    env = envelope(n, int(0.02 * RATE), int(0.03 * RATE))
+    out = []
+    prev = 0.0
+    for i in range(n):
+        white = rng.gauss(0, 1)
+        out.append(rms * env[i] * (white - prev) / math.sqrt(2))  # first difference leaves the hiss
+        prev = white
+    return out
+
+
+def noise(rng, track, rms, hum=0.0):
+    # Low-passed room noise with a little white noise on top
+    lp = 0.0
+    raw = []
+    for i in range(len(track.samples)):
+        lp = 0.9 * lp + 0.1 * rng.gauss(0, 1)
+        raw.append(lp * 4.0 + 0.3 * rng.gauss(0, 1) + hum * math.sin(2 * math.pi * 50 * i / RATE))
+    level = math.sqrt(sum(v * v for v in raw) / len(raw))
+    track.add(0, [v * rms / level for v in raw])
+
+
+def speak(rng, track, start, words, rms):
+    """Lay down words (lists of syllables 'v' or 's') from start; returns the end of the last sound"""
+    t = start
+    end = start
+    for spoken in words:
+        for syllable in spoken["syllables"]:
+            if syllable == "s":
+                length = rng.uniform(0.10, 0.16)
+                track.add(t, fricative(rng, length, rms * spoken["fricative"]))
+            else:
+                length = rng.uniform(0.14, 0.26)
+                f0 = rng.uniform(110, 190)
+                track.add(t, vowel(length, f0, f0 * 0.85, rms * rng.uniform(0.7, 1.0)))
+            end = t + length
+            t = end + rng.uniform(0.02, 0.06)
+        t = end + spoken["pause"]
+    return end
+
+
+def word(syllables, pause=0.12, fricative=0.25):
+    return {"syllables": syllables, "pause": pause, "fricative": fricative}
+
+
+def fixtures():
+    # name, seconds, noise rms, speech start, speech rms, words (None = no speech)
+    return [
+        ("quiet_room", 3.0, 40, 0.50, 6000,
+         [word("vv"), word("vsv"), word("vv")]),
+        ("noisy_room", 3.0, 700, 0.40, 6000,
+         [word("vv"), word("vvv"), word("sv")]),
+        ("long_pauses", 4.0, 150, 0.30, 6000,
+         [word("vv", pause=0.45), word("vsv", pause=0.55), word("vv")]),
+        ("fricative_end", 3.0, 120, 0.40, 6000,
+         [word("vv"), word("vvs", fricative=0.2)]),
+        ("speech_from_start", 3.0, 120, 0.00, 6000,
+         [word("svv"), word("vv"), word("vsv")]),
+        ("hum_no_speech", 3.0, 300, None, 0, None),
+    ]
+
+
+def write_wav(path, samples):
+    with wave.open(path, "wb") as wav:
+        wav.setnchannels(1)
+        wav.setsampwidth(2)
+        wav.setframerate(RATE)
+        wav.writeframes(b"".join(struct.pack("<h", max(-32768, min(32767, int(round(v))))) for v in samples))
+
+
+def generate(project_dir):
+    out_dir = os.path.join(project_dir, FIXTURE_DIR)
+    os.makedirs(out_dir, exist_ok=True)
+    labels = ["# file,speech_start_ms,speech_end_ms (-1 -1: no speech)"]
+    for index, (name, seconds, noise_rms, start, rms, words) in enumerate(fixtures()):
+        rng = random.Random(1000 + index)
+        track = Track(seconds)
+        noise(rng, track, noise_rms, hum=0.0 if words else 3.0)
+        if words:
+            end = speak(rng, track, start, words, rms)
+            labels.append("%s.wav,%d,%d" % (name, round(start * 1000), round(end * 1000)))
+        else:
+            labels.append("%s.wav,-1,-1" % name)
+        write_wav(os.path.join(out_dir, name + ".wav"), track.samples)
+
+    with open(os.path.join(out_dir, "labels.csv"), "w") as f:
+        f.write("\n".join(labels) + "\n")
+
+
+if __name__ == "__main__":
+    generate(sys.argv[1] if len(sys.argv) > 1 else os.getcwd())
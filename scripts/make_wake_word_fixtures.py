@@ -0,0 +1,323 @@
+"""Write the wake word fixtures and test model: test/test_wake_word/fixtures/
+
+The keyword is synthetic, three sounds built like the VAD fixtures' speech:
+an open vowel with rising pitch, a short fricative, then a close front vowel
+with falling pitch. The fixtures are 16 kHz mono 16-bit clips of that keyword
+among other speech-like words over background noise, and clips without it;
+labels.csv gives where each keyword was spoken. The words around the keyword
+use the same vowels, so the model has to learn the sequence and the pitch
+contour, not the sounds.
+
+kws_test_model.bin is a KWS1 blob (see include/kws_model.h) with one layer: a
+logistic classifier over the quantized log-mel window, trained here on other
+renderings of the keyword (different seeds from the fixtures). The features
+mirror src/log_mel.cpp. It exists to exercise the detector on the host; it
+is not a model for real speech. The output is deterministic:
+
+    python scripts/make_wake_word_fixtures.py [project_dir]
+
+Recordings can be added to the fixture directory with their lines in
+labels.csv (one line per keyword, start and end in ms, or -1 -1 for a clip
+without it).
+"""
+
+import cmath
+import math
+import operator
+import os
+import random
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from make_vad_fixtures import RATE, Track, envelope, fricative, noise, write_wav  # noqa: E402
+
+FIXTURE_DIR = os.path.join("test", "test_wake_word", "fixtures")
+
+HOP = 320  # WAKE_WORD_HOP_SAMPLES
+FFT_SIZE = 512  # LOG_MEL_FFT_SIZE
+MEL_BINS = 40  # LOG_MEL_BINS
+MODEL_FRAMES = 40  # 0.8 s window
+
+# Vowels as (F1, F2); the keyword is "a" (rising), a fricative, then "i" (falling)
+VOWELS = {"a": (800, 1250), "i": (320, 2400), "o": (550, 900), "u": (300, 800), "e": (500, 1800)}
+F3 = (2500, 300)
+
+
+def vowel(seconds, f0_start, f0_end, rms, formants):
+    n = int(seconds * RATE)
+    env = envelope(n, int(0.03 * RATE), int(0.05 * RATE))
+    peaks = [(formants[0], 120), (formants[1], 200), F3]
+    f0_mid = (f0_start + f0_end) / 2
+    harmonics = []
+    for k in range(1, 25):
+        f = k * f0_mid
+        if f > 3800:
+            break
+        boost = sum(math.exp(-((f - fc) / bw) ** 2) for fc, bw in peaks)
+        harmonics.append((k, (0.1 + boost) / k))
+    norm = math.sqrt(sum(a * a for _, a in harmonics) / 2)
+
+    out = []
+    phase = 0.0
+    for i in range(n):
+        f0 = f0_start + (f0_end - f0_start) * i / n
+        phase += 2 * math.pi * f0 / RATE
+        s = sum(a * math.sin(k * phase) for k, a in harmonics)
+        out.append(rms * env[i] * s / norm)
+    return out
+
+
+def say_keyword(rng, track, start, rms):
+    """Returns where the keyword ends"""
+    pace = rng.uniform(0.9, 1.1)
+    pitch = rng.uniform(0.85, 1.2)
+    t = start
+    a = 0.16 * pace
+    track.add(t, vowel(a, 140 * pitch, 200 * pitch, rms, VOWELS["a"]))
+    t += a + 0.03 * pace
+    s = 0.09 * pace
+    track.add(t, fricative(rng, s, rms * 0.3))
+    t += s + 0.03 * pace
+    i = 0.20 * pace
+    track.add(t, vowel(i, 210 * pitch, 130 * pitch, rms, VOWELS["i"]))
+    return t + i
+
+
+def say_word(rng, track, start, rms):
+    """A word of two or three syllables that is never the keyword; returns where it ends"""
+    t = start
+    previous = None
+    for _ in range(rng.choice((2, 3))):
+        if rng.random() < 0.25 and previous != "s":
+            length = rng.uniform(0.08, 0.14)
+            track.add(t, fricative(rng, length, rms * 0.3))
+            previous = "s"
+        else:
+            name = rng.choice(sorted(VOWELS))
+            if previous == "s" and name == "i":
+                name = "e"  # no "a s i"-like runs
+            length = rng.uniform(0.14, 0.26)
+            f0 = rng.uniform(110, 200)
+            track.add(t, vowel(length, f0, f0 * rng.uniform(0.8, 0.9), rms * rng.uniform(0.7, 1.0), VOWELS[name]))
+            previous = name
+        t += length + rng.uniform(0.02, 0.06)
+    return t
+
+
+def render(rng, seconds, noise_rms, speech_rms, keywords):
+    """Words over noise with `keywords` renderings of the keyword among them; returns (track, [(start, end)])"""
+    track = Track(seconds)
+    noise(rng, track, noise_rms, hum=0.0 if speech_rms else 3.0)
+    spoken = []
+    if speech_rms:
+        keywords_left = keywords
+        t = 0.3
+        first = True
+        last_keyword = -10.0
+        while t < seconds - 1.0:
+            rms = speech_rms * rng.uniform(0.8, 1.2)
+            slots_left = max(1, int((seconds - 1.0 - t) / 1.5))  # at the slowest pace
+            # Nobody says it twice within the detector's refractory period (1.5 s)
+            allowed = not first and t - last_keyword >= 1.6
+            if allowed and keywords_left > 0 and rng.random() < keywords_left / float(slots_left):
+                end = say_keyword(rng, track, t, rms)
+                spoken.append((t, end))
+                keywords_left -= 1
+                last_keyword = end
+            else:
+                end = say_word(rng, track, t, rms)
+            t = end + rng.uniform(0.25, 0.6)
+            first = False
+    return track, spoken
+
+
+# Log-mel features as src/log_mel.cpp computes them (in double precision)
+def hz_to_mel(hz):
+    return 2595.0 * math.log10(1.0 + hz / 700.0)
+
+
+def mel_to_hz(mel):
+    return 700.0 * (10.0 ** (mel / 2595.0) - 1.0)
+
+
+def mel_filters(low_hz=20.0, high_hz=RATE / 2.0):
+    mel_low = hz_to_mel(low_hz)
+    mel_high = hz_to_mel(high_hz)
+    bin_hz = RATE / FFT_SIZE
+    bands = []
+    for b in range(MEL_BINS):
+        left = mel_to_hz(mel_low + (mel_high - mel_low) * b / (MEL_BINS + 1)) / bin_hz
+        center = mel_to_hz(mel_low + (mel_high - mel_low) * (b + 1) / (MEL_BINS + 1)) / bin_hz
+        right = mel_to_hz(mel_low + (mel_high - mel_low) * (b + 2) / (MEL_BINS + 1)) / bin_hz
+        first = int(math.ceil(left))
+        last = min(int(math.floor(right)), FFT_SIZE // 2)
+        last = max(last, first)
+        weights = []
+        for k in range(first, last + 1):
+            w = (k - left) / (center - left) if k <= center else (right - k) / (right - center)
+            weights.append((k, max(w, 0.0)))
+        bands.append(weights)
+    return bands
+
+
+BIT_REVERSE = [int(format(i, "09b")[::-1], 2) for i in range(FFT_SIZE)]
+TWIDDLES = [cmath.exp(-2j * math.pi * k / FFT_SIZE) for k in range(FFT_SIZE // 2)]
+
+
+def fft(values):
+    n = len(values)
+    out = [values[BIT_REVERSE[i]] for i in range(n)]
+    size = 2
+    while size <= n:
+        half = size // 2
+        step = TWIDDLES[::n // size]
+        for start in range(0, n, size):
+            for k in range(half):
+                a = start + k
+                t = out[a + half] * step[k]
+                out[a + half] = out[a] - t
+                out[a] += t
+        size *= 2
+    return out
+
+
+def log_mel_frames(samples):
+    window = [0.5 - 0.5 * math.cos(2 * math.pi * i / FFT_SIZE) for i in range(FFT_SIZE)]
+    bands = mel_filters()
+    history = [0.0] * FFT_SIZE
+    frames = []
+    for h in range(len(samples) // HOP):
+        history = history[HOP:] + [max(-32768, min(32767, int(round(v)))) / 32768.0
+                                   for v in samples[h * HOP:(h + 1) * HOP]]
+        spectrum = fft([history[i] * window[i] for i in range(FFT_SIZE)])
+        power = [abs(spectrum[k]) ** 2 for k in range(FFT_SIZE // 2 + 1)]
+        frames.append([math.log(sum(w * power[k] for k, w in band) + 1e-6) for band in bands])
+    return frames
+
+
+def quantize(value, scale, zero):
+    return max(-128, min(127, int(round(value * scale)) + zero))
+
+
+def window_at(quantized, last_hop):
+    """Model input for the window ending at hop last_hop, oldest frame first"""
+    out = []
+    for h in range(last_hop - MODEL_FRAMES + 1, last_hop + 1):
+        out.extend(quantized[h])
+    return out
+
+
+def frame_span(start_s, end_s):
+    """First and last hop whose analysis window overlaps [start_s, end_s)"""
+    first = int(start_s * RATE) // HOP
+    last = int((end_s * RATE + FFT_SIZE) // HOP) - 1
+    return first, last
+
+
+def training_windows(rng, scale, zero):
+    positives = []
+    negatives = []
+    for index in range(10):
+        track, spoken = render(rng, 14.0, rng.choice((40, 150, 400, 800)), rng.uniform(3000, 12000), 5)
+        quantized = [[quantize(v, scale, zero) for v in frame] for frame in log_mel_frames(track.samples)]
+        spans = [frame_span(start, end) for start, end in spoken]
+        for last_hop in range(MODEL_FRAMES - 1, len(quantized)):
+            first_hop = last_hop - MODEL_FRAMES + 1
+            inside = any(first_hop <= first and last <= last_hop + 2 for first, last in spans)
+            # Windows holding all but the last few frames of a keyword are neither
+            nearly = any(min(last, last_hop) - max(first, first_hop) >= last - first - 8 for first, last in spans)
+            if inside:
+                positives.append(window_at(quantized, last_hop))
+            elif not nearly:
+                negatives.append(window_at(quantized, last_hop))
+    track, _ = render(rng, 10.0, 300, 0, 0)
+    quantized = [[quantize(v, scale, zero) for v in frame] for frame in log_mel_frames(track.samples)]
+    for last_hop in range(MODEL_FRAMES - 1, len(quantized), 3):
+        negatives.append(window_at(quantized, last_hop))
+    return positives, negatives
+
+
+def train(positives, negatives, rng, epochs=12):
+    """Logistic regression by SGD on standardized inputs; returns weights and bias in the quantized input domain"""
+    examples = [(x, 1.0) for x in positives] + [(x, 0.0) for x in negatives]
+    size = len(examples[0][0])
+    mean = [sum(x[i] for x, _ in examples) / len(examples) for i in range(size)]
+    std = [max(1.0, math.sqrt(sum((x[i] - mean[i]) ** 2 for x, _ in examples) / len(examples))) for i in range(size)]
+    inv_std = [1.0 / s for s in std]
+    standard = [([(v - m) * r for v, m, r in zip(x, mean, inv_std)], y) for x, y in examples]
+
+    # Balance the classes
+    positive_weight = len(negatives) / float(len(positives))
+    w = [0.0] * size
+    b = 0.0
+    rate = 0.01
+    decay = 1e-4
+    for epoch in range(epochs):
+        rng.shuffle(standard)
+        for x, y in standard:
+            z = sum(map(operator.mul, w, x)) + b
+            p = 1.0 / (1.0 + math.exp(-max(-30.0, min(30.0, z))))
+            g = (p - y) * (positive_weight if y else 1.0) * rate
+            shrink = 1.0 - rate * decay
+            w = [wi * shrink - g * xi for wi, xi in zip(w, x)]
+            b -= g
+        rate *= 0.7
+
+    weights = [wi * r for wi, r in zip(w, inv_std)]
+    bias = b - sum(wi * m for wi, m in zip(weights, mean))
+    return weights, bias
+
+
+def model_blob(weights, bias, scale, zero):
+    # One layer, outputs [other, keyword] = -/+ the logistic logit, halved so the softmax is its sigmoid
+    step = max(abs(v) for v in weights) / 127.0
+    q = [max(-127, min(127, int(round(v / step)))) for v in weights]
+    q_bias = int(round(bias / step))
+    blob = b"KWS1" + struct.pack("<HHfbBH", MODEL_FRAMES, MEL_BINS, scale, zero, 1, 0)
+    blob += struct.pack("<HHfB3x", len(q), 2, step / 2, 0)
+    blob += struct.pack("<ii", -q_bias, q_bias)
+    blob += struct.pack("<%db" % len(q), *[-v for v in q]) + struct.pack("<%db" % len(q), *q)
+    blob += b"\0" * (-len(blob) % 4)
+    return blob
+
+
+def fixtures():
+    # name, seconds, noise rms, speech rms, keywords (speech rms 0 = noise only)
+    return [
+        ("keyword_quiet", 8.0, 40, 6000, 3),
+        ("keyword_noisy", 8.0, 600, 6000, 3),
+        ("keyword_loud", 6.0, 150, 12000, 2),
+        ("other_speech", 14.0, 150, 6000, 0),
+        ("hum_no_speech", 4.0, 300, 0, 0),
+    ]
+
+
+def generate(project_dir):
+    out_dir = os.path.join(project_dir, FIXTURE_DIR)
+    os.makedirs(out_dir, exist_ok=True)
+
+    # log-mel of silence is log(1e-6) = -13.8; loud speech stays under +8
+    scale = 9.0
+    zero = -128 - int(round(-14.0 * scale))
+
+    positives, negatives = training_windows(random.Random(7), scale, zero)
+    weights, bias = train(positives, negatives, random.Random(8))
+    with open(os.path.join(out_dir, "kws_test_model.bin"), "wb") as f:
+        f.write(model_blob(weights, bias, scale, zero))
+
+    labels = ["# file,keyword_start_ms,keyword_end_ms (one line per keyword; -1 -1: none)"]
+    for index, (name, seconds, noise_rms, speech_rms, keywords) in enumerate(fixtures()):
+        track, spoken = render(random.Random(2000 + index), seconds, noise_rms, speech_rms, keywords)
+        for start, end in spoken:
+            labels.append("%s.wav,%d,%d" % (name, round(start * 1000), round(end * 1000)))
+        if not spoken:
+            labels.append("%s.wav,-1,-1" % name)
+        write_wav(os.path.join(out_dir, name + ".wav"), track.samples)
+
+    with open(os.path.join(out_dir, "labels.csv"), "w") as f:
+        f.write("\n".join(labels) + "\n")
+
+
+if __name__ == "__main__":
+    generate(sys.argv[1] if len(sys.argv) > 1 else os.getcwd())
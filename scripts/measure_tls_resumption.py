@@ -0,0 +1,165 @@
+"""Time full TLS handshakes against resumed ones on a local stand-in server
+
+The device does a full handshake on every connect to the server (see
+init_websocket()). This script measures how much session resumption would save
+on the handshake. openssl s_server stands in for the server, using a throwaway
+self-signed certificate of each key type. Each connect is timed in two parts,
+TCP connect and TLS handshake. Connects first go out without a session, then
+offer the session the first connect got, and the server must accept it.
+
+    python scripts/measure_tls_resumption.py [--connects N] [--tls 1.2|1.3]
+        [--server HOST:PORT] [--openssl PATH]
+
+With --server the real server is measured instead, without verifying its
+certificate.
+
+The numbers come from this host over loopback. On the device a full handshake
+costs the ECDHE and certificate signature work in mbedtls, plus one more round
+trip. A resumed handshake skips both. Neither cost scales from these
+figures. What carries over is whether the server resumes, and the ratio of
+full to resumed time when the link's round trip is small.
+"""
+
+import argparse
+import os
+import shutil
+import socket
+import ssl
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+KEY_TYPES = [("ECDSA P-256", ["-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:P-256"]),
+             ("RSA 2048", ["-newkey", "rsa:2048"])]
+
+
+def make_certificate(openssl, directory, key_args):
+    cert = os.path.join(directory, "cert.pem")
+    key = os.path.join(directory, "key.pem")
+    subprocess.run([openssl, "req", "-x509", "-nodes", "-days", "1", "-subj", "/CN=localhost",
+                    "-keyout", key, "-out", cert] + key_args,
+                   check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return cert, key
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def start_server(openssl, cert, key, port):
+    server = subprocess.Popen([openssl, "s_server", "-accept", str(port), "-cert", cert, "-key", key,
+                               "-www", "-quiet"],
+                              stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    deadline = time.monotonic() + 5
+    while time.monotonic() < deadline:
+        try:
+            socket.create_connection(("127.0.0.1", port), timeout=0.2).close()
+            return server
+        except OSError:
+            time.sleep(0.05)
+    server.kill()
+    raise RuntimeError("openssl s_server did not start")
+
+
+def client_context(tls):
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+    context.check_hostname = False
+    context.verify_mode = ssl.CERT_NONE
+    version = ssl.TLSVersion.TLSv1_3 if tls == "1.3" else ssl.TLSVersion.TLSv1_2
+    context.minimum_version = version
+    context.maximum_version = version
+    return context
+
+
+def connect(context, host, port, session):
+    """One connect: (tcp_ms, handshake_ms, resumed, session for the next)"""
+    start = time.perf_counter()
+    raw = socket.create_connection((host, port), timeout=10)
+    connected = time.perf_counter()
+    tls = context.wrap_socket(raw, server_hostname=host, session=session, do_handshake_on_connect=False)
+    tls.do_handshake()
+    done = time.perf_counter()
+
+    # TLS 1.3 tickets arrive after the handshake, so exchange something before keeping the session
+    tls.sendall(b"GET / HTTP/1.0\r\n\r\n")
+    while tls.recv(4096):
+        pass
+    resumed = tls.session_reused
+    next_session = tls.session
+    tls.close()
+    return (connected - start) * 1000, (done - connected) * 1000, resumed, next_session
+
+
+def measure(context, host, port, connects):
+    full_tcp, full_tls, resumed_tcp, resumed_tls = [], [], [], []
+    session = None
+    for _ in range(connects):
+        tcp_ms, tls_ms, resumed, session = connect(context, host, port, None)
+        full_tcp.append(tcp_ms)
+        full_tls.append(tls_ms)
+    refused = 0
+    for _ in range(connects):
+        tcp_ms, tls_ms, resumed, next_session = connect(context, host, port, session)
+        if not resumed:
+            refused += 1
+        session = next_session
+        resumed_tcp.append(tcp_ms)
+        resumed_tls.append(tls_ms)
+    return {
+        "full_tcp": statistics.median(full_tcp),
+        "full_tls": statistics.median(full_tls),
+        "resumed_tcp": statistics.median(resumed_tcp),
+        "resumed_tls": statistics.median(resumed_tls),
+        "refused": refused,
+    }
+
+
+def report(name, result, connects):
+    print("%-12s full: TCP %6.2f ms, handshake %6.2f ms | resumed: TCP %6.2f ms, handshake %6.2f ms"
+          " (%.1fx faster, %d of %d not resumed)"
+          % (name, result["full_tcp"], result["full_tls"], result["resumed_tcp"], result["resumed_tls"],
+             result["full_tls"] / result["resumed_tls"], result["refused"], connects))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--connects", type=int, default=50, help="connects of each kind (medians are reported)")
+    parser.add_argument("--tls", choices=["1.2", "1.3"], default="1.2", help="protocol version (default 1.2)")
+    parser.add_argument("--server", help="HOST:PORT to measure instead of a local stand-in")
+    parser.add_argument("--openssl", default=shutil.which("openssl"), help="openssl binary for the stand-in")
+    args = parser.parse_args()
+
+    context = client_context(args.tls)
+    print("TLS %s, %d connects of each kind, medians" % (args.tls, args.connects))
+
+    if args.server:
+        host, port = args.server.rsplit(":", 1)
+        result = measure(context, host, int(port), args.connects)
+        report(args.server, result, args.connects)
+        return 1 if result["refused"] == args.connects else 0
+
+    if args.openssl is None:
+        sys.exit("openssl not found; pass --openssl")
+
+    failed = False
+    for name, key_args in KEY_TYPES:
+        with tempfile.TemporaryDirectory() as directory:
+            cert, key = make_certificate(args.openssl, directory, key_args)
+            port = free_port()
+            server = start_server(args.openssl, cert, key, port)
+            try:
+                result = measure(context, "127.0.0.1", port, args.connects)
+            finally:
+                server.kill()
+                server.wait()
+        report(name, result, args.connects)
+        failed |= result["refused"] > 0
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,137 @@
+#include "audio_capture.h"
+
+#include <Arduino.h>
+#include <M5Unified.h>
+#include "spsc_ring_buffer.h"
+
+// M5Unified keeps at most two record() requests in flight; a third slot lets us
+// copy a finished frame out while the next two are being filled.
+#define CAPTURE_SLOTS 3
+#define CAPTURE_MAX_IN_FLIGHT 2
+
+static SpscRingBuffer<int16_t> capture_ring;
+static int16_t *capture_ring_storage = nullptr;
+static int16_t capture_slots[CAPTURE_SLOTS][CAPTURE_FRAME_SAMPLES];
+
+static TaskHandle_t capture_task_handle = nullptr;
+static uint32_t capture_sample_rate = 16000;
+static volatile bool capture_active = false;
+static CaptureFrameHook capture_frame_hook = nullptr;
+
+static volatile uint32_t frames_captured = 0;
+static volatile size_t ring_high_water = 0;
+
+static void capture_task(void *arg)
+{
+    size_t oldest_slot = 0; // slot of the oldest outstanding record() request
+    size_t queued = 0;      // outstanding requests we have issued
+
+    for (;;)
+    {
+        if (!M5.Mic.isEnabled())
+        {
+            queued = 0;
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+
+        // Keep the mic's request queue full so there are no gaps between frames
+        while (queued < CAPTURE_MAX_IN_FLIGHT)
+        {
+            size_t slot = (oldest_slot + queued) % CAPTURE_SLOTS;
+            if (!M5.Mic.record(capture_slots[slot], CAPTURE_FRAME_SAMPLES, capture_sample_rate))
+                break;
+            queued++;
+        }
+
+        // Requests complete in order, so everything beyond the mic's in-flight count is done
+        size_t in_flight = M5.Mic.isRecording();
+        while (queued > in_flight)
+        {
+            frames_captured++;
+
+            // Run the hook on every frame, not just active ones, so filter state stays settled
+            if (capture_frame_hook != nullptr)
+            {
+                capture_frame_hook(capture_slots[oldest_slot], CAPTURE_FRAME_SAMPLES);
+            }
+
+            if (capture_active)
+            {
+                // A full ring drops this frame; SpscRingBuffer counts it as an overflow
+                capture_ring.push(capture_slots[oldest_slot], CAPTURE_FRAME_SAMPLES);
+
+                size_t level = capture_ring.available();
+                if (level > ring_high_water)
+                    ring_high_water = level;
+            }
+            oldest_slot = (oldest_slot + 1) % CAPTURE_SLOTS;
+            queued--;
+        }
+
+        vTaskDelay(1);
+    }
+}
+
+bool audio_capture_begin(uint32_t sample_rate)
+{
+    if (capture_task_handle != nullptr)
+        return true;
+
+    capture_sample_rate = sample_rate;
+    capture_ring_storage = new int16_t[CAPTURE_RING_SAMPLES];
+    if (!capture_ring.init(capture_ring_storage, CAPTURE_RING_SAMPLES))
+        return false;
+
+    return xTaskCreatePinnedToCore(capture_task, "mic_capture", CAPTURE_TASK_STACK, nullptr,
+                                   CAPTURE_TASK_PRIORITY, &capture_task_handle, CAPTURE_TASK_CORE) == pdPASS;
+}
+
+void audio_capture_set_frame_hook(CaptureFrameHook hook)
+{
+    capture_frame_hook = hook;
+}
+
+void audio_capture_set_active(bool active)
+{
+    capture_active = active;
+}
+
+bool audio_capture_is_active()
+{
+    return capture_active;
+}
+
+size_t audio_capture_available()
+{
+    return capture_ring.available();
+}
+
+size_t audio_capture_read(int16_t *dst, size_t max_samples)
+{
+    return capture_ring.pop(dst, max_samples);
+}
+
+void audio_capture_discard()
+{
+    capture_ring.discard();
+}
+
+void audio_capture_retain(size_t max_samples)
+{
+    size_t queued = capture_ring.available();
+    if (queued > max_samples)
+    {
+        capture_ring.consume(queued - max_samples);
+    }
+}
+
+CaptureStats audio_capture_stats()
+{
+    CaptureStats stats;
+    stats.frames_captured = frames_captured;
+    stats.frames_dropped = capture_ring.overflow_count();
+    stats.short_reads = capture_ring.underflow_count();
+    stats.ring_high_water = ring_high_water;
+    return stats;
+}
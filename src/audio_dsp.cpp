@@ -0,0 +1,370 @@
+#include "audio_dsp.h"
+
+#include <cmath>
+#include <cstring>
+#include "signal_stats.h"
+
+bool DspChain::add(DspProcessFn process, void *state)
+{
+    if (count_ >= DSP_MAX_STAGES || process == nullptr)
+        return false;
+
+    stages_[count_].process = process;
+    stages_[count_].state = state;
+    count_++;
+    return true;
+}
+
+void DspChain::process(int16_t *samples, size_t n) const
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        stages_[i].process(stages_[i].state, samples, n);
+    }
+}
+
+// Per-sample smoothing coefficient for a time constant, in Q15 (init time only)
+static int32_t time_constant_q15(uint32_t sample_rate, uint32_t ms)
+{
+    if (ms == 0)
+        return 32767;
+    double alpha = 1.0 - exp(-1000.0 / ((double)ms * sample_rate));
+    return (int32_t)(alpha * 32768.0 + 0.5);
+}
+
+void dc_blocker_init(DcBlocker *dc, uint32_t sample_rate, uint32_t cutoff_hz)
+{
+    // R = 1 - 2*pi*fc/fs is close enough for the few-Hz corners used here
+    double r = 1.0 - 2.0 * M_PI * cutoff_hz / sample_rate;
+    dc->r_q15 = (int32_t)(r * 32768.0 + 0.5);
+    dc->x1 = 0;
+    dc->y1_q8 = 0;
+}
+
+void dc_blocker_process(void *state, int16_t *samples, size_t n)
+{
+    DcBlocker *dc = (DcBlocker *)state;
+    int32_t x1 = dc->x1;
+    int32_t y1 = dc->y1_q8;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t x = samples[i];
+        // Keep 8 extra fractional bits in the feedback term so the pole does not drift
+        y1 = (x - x1) * 256 + (int32_t)(((int64_t)y1 * dc->r_q15 + (1 << 14)) >> 15);
+        x1 = x;
+        samples[i] = dsp_saturate((y1 + 128) >> 8);
+    }
+
+    dc->x1 = x1;
+    dc->y1_q8 = y1;
+}
+
+void biquad_init_highpass(Biquad *bq, uint32_t sample_rate, uint32_t cutoff_hz, float q)
+{
+    // RBJ audio EQ cookbook high-pass, normalised by a0 and scaled to Q14
+    double w0 = 2.0 * M_PI * cutoff_hz / sample_rate;
+    double alpha = sin(w0) / (2.0 * q);
+    double cosw = cos(w0);
+    double a0 = 1.0 + alpha;
+
+    bq->b0 = (int32_t)lround(16384.0 * ((1.0 + cosw) / 2.0) / a0);
+    bq->b1 = (int32_t)lround(16384.0 * -(1.0 + cosw) / a0);
+    bq->b2 = bq->b0;
+    bq->a1 = (int32_t)lround(16384.0 * (-2.0 * cosw) / a0);
+    bq->a2 = (int32_t)lround(16384.0 * (1.0 - alpha) / a0);
+    bq->x1 = bq->x2 = bq->y1 = bq->y2 = 0;
+}
+
+void biquad_process(void *state, int16_t *samples, size_t n)
+{
+    Biquad *bq = (Biquad *)state;
+    int32_t x1 = bq->x1, x2 = bq->x2, y1 = bq->y1, y2 = bq->y2;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t x = samples[i];
+        // Outputs are kept with 8 extra fractional bits: with a pole this close to z=1,
+        // truncating the feedback to whole LSBs shows up as a DC offset of hundreds of LSB.
+        // The Q14 x Q8 products need a 64-bit accumulator.
+        int64_t acc = ((int64_t)bq->b0 * x + (int64_t)bq->b1 * x1 + (int64_t)bq->b2 * x2) * 256 -
+                      (int64_t)bq->a1 * y1 - (int64_t)bq->a2 * y2;
+        int32_t y = (int32_t)((acc + (1 << 13)) >> 14);
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        samples[i] = dsp_saturate((y + 128) >> 8);
+    }
+
+    bq->x1 = x1;
+    bq->x2 = x2;
+    bq->y1 = y1;
+    bq->y2 = y2;
+}
+
+void agc_init(Agc *agc, uint32_t sample_rate, int32_t target, int32_t gate, uint32_t attack_ms, uint32_t release_ms,
+              int32_t max_gain_q12)
+{
+    agc->target = target;
+    agc->gate = gate;
+    agc->max_gain_q12 = max_gain_q12;
+    agc->min_gain_q12 = 4096 / 4; // never attenuate by more than 12 dB
+    agc->attack_q15 = time_constant_q15(sample_rate, attack_ms);
+    agc->release_q15 = time_constant_q15(sample_rate, release_ms);
+    agc->envelope = 0;
+    agc->gain_q12 = 4096;
+}
+
+void agc_process(void *state, int16_t *samples, size_t n)
+{
+    Agc *agc = (Agc *)state;
+    int32_t env = agc->envelope;
+    int32_t gain = agc->gain_q12;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t x = samples[i];
+        int32_t mag = x < 0 ? -x : x;
+        int32_t coeff = mag > env ? agc->attack_q15 : agc->release_q15;
+        env += ((mag - env) * coeff) >> 15;
+
+        samples[i] = dsp_saturate((int32_t)(((int64_t)x * gain) >> 12));
+    }
+
+    // Ease toward the gain that brings the envelope to target (one divide per block)
+    if (env > agc->gate)
+    {
+        int32_t wanted = (int32_t)(((int64_t)agc->target << 12) / env);
+        if (wanted > agc->max_gain_q12)
+            wanted = agc->max_gain_q12;
+        if (wanted < agc->min_gain_q12)
+            wanted = agc->min_gain_q12;
+
+        // Drop quickly to avoid clipping, rise slowly to avoid pumping
+        gain += wanted < gain ? (wanted - gain) / 2 : (wanted - gain) / 16;
+    }
+
+    agc->envelope = env;
+    agc->gain_q12 = gain;
+}
+
+void soft_limiter_init(SoftLimiter *lim, int32_t threshold)
+{
+    lim->threshold = threshold;
+}
+
+void soft_limiter_process(void *state, int16_t *samples, size_t n)
+{
+    SoftLimiter *lim = (SoftLimiter *)state;
+    const int32_t t = lim->threshold;
+    const int32_t headroom = 32767 - t;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t x = samples[i];
+        int32_t mag = x < 0 ? -x : x;
+        if (mag <= t)
+            continue;
+
+        // y = t + d * h / (h + d): slope 1 at the knee, asymptote at full scale
+        int32_t d = mag - t;
+        int32_t y = t + (int32_t)(((int64_t)d * headroom) / (headroom + d));
+        samples[i] = (int16_t)(x < 0 ? -y : y);
+    }
+}
+
+void lookahead_limiter_init(LookaheadLimiter *lim, uint32_t sample_rate, int32_t threshold, uint32_t lookahead_us,
+                            uint32_t release_ms)
+{
+    uint32_t lookahead = (uint32_t)((uint64_t)sample_rate * lookahead_us / 1000000) & ~1u;
+    if (lookahead < 2)
+        lookahead = 2;
+    if (lookahead > LIMITER_MAX_LOOKAHEAD)
+        lookahead = LIMITER_MAX_LOOKAHEAD;
+
+    lim->threshold = threshold;
+    lim->lookahead = lookahead;
+    lim->attack_q15 = (int32_t)((1.0 - exp(-4.6 / lookahead)) * 32768.0 + 0.5);
+    lim->release_q15 = time_constant_q15(sample_rate, release_ms);
+    lookahead_limiter_reset(lim);
+}
+
+void lookahead_limiter_reset(LookaheadLimiter *lim)
+{
+    lim->gain_q24 = 1 << 24;
+    lim->hold_q24 = 1 << 24;
+    lim->hold_count = 0;
+    lim->pos = 0;
+    memset(lim->delay, 0, sizeof(lim->delay));
+}
+
+void lookahead_limiter_process(void *state, int16_t *samples, size_t n)
+{
+    LookaheadLimiter *lim = (LookaheadLimiter *)state;
+    const int32_t unity = 1 << 24;
+    int32_t gain = lim->gain_q24;
+    int32_t hold = lim->hold_q24;
+    uint32_t hold_count = lim->hold_count;
+    uint32_t pos = lim->pos;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t x = samples[i];
+        int32_t mag = x < 0 ? -x : x;
+
+        // Gain this sample will need when it leaves the delay line
+        int32_t need = unity;
+        if (mag > lim->threshold)
+            need = (int32_t)(((int64_t)lim->threshold << 24) / mag);
+
+        // Hold the lowest requirement until its sample has been output; the release is
+        // much slower than the look-ahead, so letting go then is safe
+        if (need <= hold)
+        {
+            hold = need;
+            hold_count = lim->lookahead;
+        }
+        else if (hold_count > 0)
+        {
+            hold_count--;
+        }
+        else
+        {
+            hold = need;
+        }
+
+        int32_t coeff = hold < gain ? lim->attack_q15 : lim->release_q15;
+        gain += (int32_t)(((int64_t)(hold - gain) * coeff) >> 15);
+
+        int32_t delayed = lim->delay[pos];
+        lim->delay[pos] = (int16_t)x;
+        pos = pos + 1 == lim->lookahead ? 0 : pos + 1;
+
+        samples[i] = dsp_saturate((int32_t)(((int64_t)delayed * gain) >> 24));
+    }
+
+    lim->gain_q24 = gain;
+    lim->hold_q24 = hold;
+    lim->hold_count = hold_count;
+    lim->pos = pos;
+}
+
+void loudness_normalizer_init(LoudnessNormalizer *ln, uint32_t sample_rate, int32_t target_rms, int32_t gate_rms,
+                              uint32_t window_ms, int32_t min_gain_q12, int32_t max_gain_q12)
+{
+    ln->target_rms = target_rms;
+    ln->gate_rms = gate_rms;
+    ln->min_gain_q12 = min_gain_q12;
+    ln->max_gain_q12 = max_gain_q12;
+    ln->window_samples = sample_rate / 1000 * window_ms;
+    ln->mean_square = 0;
+    ln->primed = false;
+    ln->gain_q12 = 4096;
+}
+
+void loudness_normalizer_process(void *state, int16_t *samples, size_t n)
+{
+    LoudnessNormalizer *ln = (LoudnessNormalizer *)state;
+    if (n == 0)
+        return;
+
+    uint64_t sum_squares = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t x = samples[i];
+        sum_squares += (uint32_t)(x * x);
+    }
+    uint32_t block_ms = (uint32_t)(sum_squares / n);
+
+    int32_t start_gain = ln->gain_q12;
+    if (block_ms > (uint32_t)(ln->gate_rms * ln->gate_rms))
+    {
+        if (!ln->primed)
+        {
+            ln->mean_square = block_ms;
+            ln->primed = true;
+        }
+        else
+        {
+            // Weight the block by its share of the averaging window
+            uint32_t weight = n < ln->window_samples ? n : ln->window_samples;
+            ln->mean_square += (int32_t)(((int64_t)block_ms - ln->mean_square) * weight / ln->window_samples);
+        }
+
+        int32_t rms = (int32_t)isqrt64(ln->mean_square);
+        int32_t wanted = rms > 0 ? (int32_t)(((int64_t)ln->target_rms << 12) / rms) : ln->max_gain_q12;
+        if (wanted > ln->max_gain_q12)
+            wanted = ln->max_gain_q12;
+        if (wanted < ln->min_gain_q12)
+            wanted = ln->min_gain_q12;
+        ln->gain_q12 = wanted;
+    }
+
+    // Ramp from the previous block's gain so changes don't zipper
+    int32_t gain_q20 = start_gain << 8;
+    int32_t step_q20 = (ln->gain_q12 - start_gain) * 256 / (int32_t)n;
+    for (size_t i = 0; i < n; i++)
+    {
+        gain_q20 += step_q20;
+        samples[i] = dsp_saturate((int32_t)(((int64_t)samples[i] * gain_q20) >> 20));
+    }
+}
+
+void gain_envelope_init(GainEnvelope *env, bool open)
+{
+    env->gain_q24 = open ? 1 << 24 : 0;
+    env->target_q24 = env->gain_q24;
+    env->step_q24 = 0;
+}
+
+void gain_envelope_ramp(GainEnvelope *env, bool open, size_t samples)
+{
+    env->target_q24 = open ? 1 << 24 : 0;
+    if (samples == 0)
+    {
+        env->gain_q24 = env->target_q24;
+        env->step_q24 = 0;
+        return;
+    }
+
+    // Round away from zero so the target is always reached within the ramp
+    int32_t distance = env->target_q24 - env->gain_q24;
+    int32_t step = distance / (int32_t)samples;
+    env->step_q24 = step + (distance > 0 ? 1 : (distance < 0 ? -1 : 0));
+}
+
+bool gain_envelope_settled(const GainEnvelope *env)
+{
+    return env->gain_q24 == env->target_q24;
+}
+
+void gain_envelope_process(void *state, int16_t *samples, size_t n)
+{
+    GainEnvelope *env = (GainEnvelope *)state;
+    size_t i = 0;
+
+    for (; i < n && env->gain_q24 != env->target_q24; i++)
+    {
+        int32_t next = env->gain_q24 + env->step_q24;
+        if ((env->step_q24 > 0 && next > env->target_q24) || (env->step_q24 < 0 && next < env->target_q24))
+            next = env->target_q24;
+        env->gain_q24 = next;
+        samples[i] = (int16_t)(((int64_t)samples[i] * env->gain_q24) >> 24);
+    }
+
+    // Settled: unity leaves the rest alone, silence clears it
+    if (env->gain_q24 == 0)
+    {
+        memset(samples + i, 0, (n - i) * sizeof(int16_t));
+    }
+}
+
+void crossfade_linear(const int16_t *a, const int16_t *b, int16_t *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t w = (int32_t)(((i + 1) << 15) / (n + 1)); // Q15 weight of b, never quite 0 or 1
+        out[i] = (int16_t)((a[i] * (32768 - w) + b[i] * w) >> 15);
+    }
+}
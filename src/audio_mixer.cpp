@@ -0,0 +1,261 @@
+#include "audio_mixer.h"
+
+#include <cstring>
+#include "audio_dsp.h"
+
+#define MIXER_UNITY_Q15 32768
+#define MIXER_WAIT -2 // slot being freed; retry on the next mix()
+#define MIXER_NONE -1
+
+AudioMixer::AudioMixer() : next_handle_(0), next_order_(0), bed_gain_q15_(MIXER_UNITY_Q15)
+{
+    requests_.init(request_storage_, MIXER_QUEUE_DEPTH);
+    memset(voices_, 0, sizeof(voices_));
+}
+
+bool AudioMixer::send(const Request &request)
+{
+    return requests_.push(&request, 1);
+}
+
+uint32_t AudioMixer::play(const int16_t *samples, size_t count, uint32_t sample_rate, const MixerVoiceParams &params)
+{
+    if (samples == nullptr || count == 0 || sample_rate == 0)
+        return 0;
+
+    if (++next_handle_ == 0)
+        next_handle_ = 1;
+    Request request = {samples, count, sample_rate, params, next_handle_};
+    return send(request) ? next_handle_ : 0;
+}
+
+void AudioMixer::stop(uint32_t handle)
+{
+    if (handle == 0)
+        return;
+
+    Request request = {nullptr, 0, 0, {0, 0, 0}, handle};
+    send(request);
+}
+
+void AudioMixer::stop_all()
+{
+    Request request = {nullptr, 0, 0, {0, 0, 0}, 0};
+    send(request);
+}
+
+bool AudioMixer::active()
+{
+    if (requests_.available() > 0)
+        return true;
+    for (size_t i = 0; i < MIXER_MAX_VOICES; i++)
+    {
+        if (voices_[i].active)
+            return true;
+    }
+    return false;
+}
+
+void AudioMixer::reset_bed()
+{
+    bed_gain_q15_ = MIXER_UNITY_Q15;
+}
+
+void AudioMixer::release(Voice &voice)
+{
+    if (voice.active)
+        voice.releasing = true;
+}
+
+// Free slot, or the one to take over (released first); MIXER_NONE if all outrank priority
+int AudioMixer::slot_for(uint8_t priority)
+{
+    for (size_t i = 0; i < MIXER_MAX_VOICES; i++)
+    {
+        if (!voices_[i].active)
+            return (int)i;
+    }
+
+    int victim = MIXER_NONE;
+    for (size_t i = 0; i < MIXER_MAX_VOICES; i++)
+    {
+        const Voice &voice = voices_[i];
+        if (voice.releasing)
+            return MIXER_WAIT;
+        if (voice.params.priority > priority)
+            continue;
+        if (victim == MIXER_NONE || voice.params.priority < voices_[victim].params.priority ||
+            (voice.params.priority == voices_[victim].params.priority && voice.order < voices_[victim].order))
+        {
+            victim = (int)i;
+        }
+    }
+
+    if (victim == MIXER_NONE)
+        return MIXER_NONE;
+    release(voices_[victim]);
+    return MIXER_WAIT;
+}
+
+void AudioMixer::take_requests()
+{
+    Request *request;
+    while (requests_.read_span(&request) > 0)
+    {
+        if (request->samples == nullptr)
+        {
+            for (size_t i = 0; i < MIXER_MAX_VOICES; i++)
+            {
+                if (request->handle == 0 || voices_[i].handle == request->handle)
+                    release(voices_[i]);
+            }
+        }
+        else
+        {
+            int slot = slot_for(request->params.priority);
+            if (slot == MIXER_WAIT)
+                break; // a voice is fading out to make room
+
+            if (slot != MIXER_NONE)
+            {
+                Voice &voice = voices_[slot];
+                voice.samples = request->samples;
+                voice.count = request->count;
+                voice.index = 0;
+                voice.frac_q16 = 0;
+                voice.sample_rate = request->sample_rate;
+                voice.params = request->params;
+                voice.handle = request->handle;
+                voice.order = next_order_++;
+                voice.level_q12 = MIXER_UNITY_Q12;
+                voice.active = true;
+                voice.releasing = false;
+            }
+        }
+        requests_.consume(1);
+    }
+}
+
+// Accumulate frames of one voice at the output rate
+void AudioMixer::render(Voice &voice, int32_t *acc, size_t frames, uint32_t step_q16, int32_t release_step)
+{
+    const int32_t gain = voice.params.gain_q12;
+
+    if (step_q16 == 0x10000 && !voice.releasing)
+    {
+        // Native rate: straight multiply-accumulate
+        size_t n = voice.count - voice.index;
+        if (n > frames)
+            n = frames;
+        const int16_t *src = voice.samples + voice.index;
+        for (size_t i = 0; i < n; i++)
+        {
+            acc[i] += (src[i] * gain) >> 12;
+        }
+        voice.index += n;
+    }
+    else
+    {
+        for (size_t i = 0; i < frames && voice.index < voice.count; i++)
+        {
+            int32_t sample = voice.samples[voice.index];
+            if (voice.frac_q16 != 0)
+            {
+                int32_t next = voice.index + 1 < voice.count ? voice.samples[voice.index + 1] : 0;
+                sample += ((next - sample) * (int32_t)(voice.frac_q16 >> 1)) >> 15;
+            }
+
+            int32_t g = gain;
+            if (voice.releasing)
+            {
+                voice.level_q12 -= release_step;
+                if (voice.level_q12 <= 0)
+                {
+                    voice.index = voice.count;
+                    break;
+                }
+                g = (gain * voice.level_q12) >> 12;
+            }
+            acc[i] += (sample * g) >> 12;
+
+            voice.frac_q16 += step_q16;
+            voice.index += voice.frac_q16 >> 16;
+            voice.frac_q16 &= 0xffff;
+        }
+    }
+
+    if (voice.index >= voice.count)
+        voice.active = false;
+}
+
+void AudioMixer::mix(int16_t *out, size_t frames, uint8_t channels, uint32_t output_rate)
+{
+    take_requests();
+    if (output_rate == 0)
+        return;
+
+    size_t release_samples = (size_t)MIXER_RELEASE_MS * output_rate / 1000;
+    int32_t release_step = MIXER_UNITY_Q12 / (int32_t)(release_samples > 0 ? release_samples : 1);
+    int32_t attack_step = MIXER_UNITY_Q15 * 1000 / (int32_t)(MIXER_DUCK_ATTACK_MS * output_rate) + 1;
+    int32_t recover_step = MIXER_UNITY_Q15 * 1000 / (int32_t)(MIXER_DUCK_RELEASE_MS * output_rate) + 1;
+
+    int32_t acc[MIXER_BLOCK_FRAMES];
+    for (size_t done = 0; done < frames;)
+    {
+        size_t n = frames - done < MIXER_BLOCK_FRAMES ? frames - done : MIXER_BLOCK_FRAMES;
+        memset(acc, 0, n * sizeof(int32_t));
+
+        int32_t duck_q15 = MIXER_UNITY_Q15;
+        bool any = false;
+        for (size_t v = 0; v < MIXER_MAX_VOICES; v++)
+        {
+            Voice &voice = voices_[v];
+            if (!voice.active)
+                continue;
+
+            any = true;
+            if (!voice.releasing && ((int32_t)voice.params.duck_q12 << 3) < duck_q15)
+                duck_q15 = (int32_t)voice.params.duck_q12 << 3;
+            uint32_t step = (uint32_t)(((uint64_t)voice.sample_rate << 16) / output_rate);
+            render(voice, acc, n, step, release_step);
+        }
+
+        int16_t *dst = out + done * channels;
+        if (bed_gain_q15_ == MIXER_UNITY_Q15 && duck_q15 == MIXER_UNITY_Q15)
+        {
+            if (any)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    for (uint8_t c = 0; c < channels; c++)
+                    {
+                        dst[i * channels + c] = dsp_saturate(dst[i * channels + c] + acc[i]);
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Duck or recover the bed one step per frame
+            int32_t gain = bed_gain_q15_;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (gain > duck_q15)
+                    gain = gain - attack_step > duck_q15 ? gain - attack_step : duck_q15;
+                else if (gain < duck_q15)
+                    gain = gain + recover_step < duck_q15 ? gain + recover_step : duck_q15;
+
+                for (uint8_t c = 0; c < channels; c++)
+                {
+                    int32_t bed = (dst[i * channels + c] * gain) >> 15;
+                    dst[i * channels + c] = dsp_saturate(bed + acc[i]);
+                }
+            }
+            bed_gain_q15_ = gain;
+        }
+        done += n;
+    }
+
+    // Requests waiting on a voice that finished fading in this call
+    take_requests();
+}
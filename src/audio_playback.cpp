@@ -0,0 +1,1019 @@
+#include "audio_playback.h"
+
+#include <atomic>
+#include <cstring>
+#include "spsc_ring_buffer.h"
+#include "resampler.h"
+#include "audio_dsp.h"
+#include "time_stretch.h"
+#include "audio_mixer.h"
+
+#define PLAYBACK_MIN_SLICE_SAMPLES 256 // don't queue crumbs while more data is on its way
+#define PLAYBACK_STRETCH_SCRATCH 256   // frames folded per pass on their way into the stretcher
+
+enum ConsumerState
+{
+    CONSUMER_IDLE,
+    CONSUMER_BUFFERING,
+    CONSUMER_PLAYING,
+    CONSUMER_CLIP
+};
+
+static SpscRingBuffer<int16_t> playback_ring;
+static PlaybackSink sink;
+
+// Producer state
+static std::atomic<uint32_t> stream_generation(0); // bumped by playback_stream_begin() and playback_play_clip()
+static std::atomic<uint32_t> abort_generation(0);  // generation the last abort applies to
+static std::atomic<size_t> abort_mark(0);          // ring write position at that abort
+static volatile bool stream_ended = false;
+static volatile uint32_t stream_sample_rate = 24000;
+static volatile unsigned long stream_start_ms = 0;
+static PcmStreamFormat stream_format = {24000, 1, PCM_SAMPLE_S16LE};
+static uint8_t carry[4]; // partial frame left at the end of a chunk
+static size_t carry_len = 0;
+static unsigned long last_arrival_ms = 0;
+static float arrival_mean_ms = 0.0f;
+static float arrival_jitter_ms = 0.0f;
+static bool arrival_seeded = false;
+
+// Time stretch, run on the producer side so the ring holds audio in playback time
+static WsolaStretcher stretcher;
+static volatile uint32_t speed_percent = 100; // set from the UI
+static bool stretching = false;                // this stream goes through the stretcher
+static int16_t stretch_scratch[PLAYBACK_STRETCH_SCRATCH];
+
+struct ClipSource
+{
+    int16_t *samples;
+    size_t count;
+    bool stereo;
+    uint32_t sample_rate;
+};
+
+// What a generation starts. The producer fills the slot of the next generation and
+// then publishes it, so the slot the consumer latches from is not rewritten until
+// another generation has been published (see latch_request())
+struct StreamRequest
+{
+    bool is_clip;
+    ClipSource clip;
+    size_t ring_start; // ring write position when it began; anything before is stale
+};
+
+static StreamRequest requests[2];
+
+// Consumer state
+static volatile bool finished_pending = false;
+static ConsumerState consumer_state = CONSUMER_IDLE;
+static uint32_t consumer_generation = 0;
+static uint32_t abort_handled = 0;                  // abort_generation last carried out
+static std::atomic<uint32_t> abort_acknowledged(0); // published copy for playback_abort_settled()
+struct InFlightSlice
+{
+    int16_t *data;
+    size_t ring_samples; // released from the ring once played (0 for resampled slices)
+    size_t samples;      // at the output rate
+    bool voice_only;     // mixer output between responses, not part of one
+};
+
+static InFlightSlice in_flight_slices[PLAYBACK_MAX_IN_FLIGHT];
+static size_t in_flight = 0;
+static size_t submitted = 0; // samples past the ring read position already queued on the speaker
+static unsigned long head_started_ms = 0; // no later than the moment the oldest queued slice began playing
+static unsigned long last_service_ms = 0;
+static bool first_audio_sent = false;
+static ClipSource clip = {nullptr, 0, false, 24000}; // clip being played
+static size_t clip_submitted = 0;
+static uint32_t underrun_margin_ms = 0; // grows on underruns, decays on clean turns
+
+// Rate conversion
+static uint32_t output_rate = 0;
+static bool resampling = false;
+static PolyphaseResampler resampler;
+static uint32_t resampler_in_rate = 0;
+static uint32_t resampler_out_rate = 0;
+static int16_t resample_slots[PLAYBACK_MAX_IN_FLIGHT][PLAYBACK_RESAMPLE_SLICE_SAMPLES];
+static size_t next_slot = 0;
+
+// Output dynamics, run in place on each slice before it is queued
+static DspChain output_dsp;
+static LoudnessNormalizer output_loudness;
+static LookaheadLimiter output_limiter;
+static uint32_t output_dsp_rate = 0;
+
+// A slice is converted and processed once, then kept until the speaker accepts it
+struct PreparedSlice
+{
+    int16_t *samples; // nullptr = none
+    size_t len;
+    size_t ring_samples;
+};
+
+static PreparedSlice prepared = {nullptr, 0, 0};
+
+// Envelope over everything queued: ramps at every start, end, underrun and resume
+static GainEnvelope envelope;
+static int16_t crossfade_slots[PLAYBACK_MAX_IN_FLIGHT][PLAYBACK_CROSSFADE_MAX_SAMPLES];
+static size_t next_crossfade_slot = 0;
+
+// Voices overlaid on the output; between responses they are played on their own
+static AudioMixer mixer;
+static int16_t voice_slots[PLAYBACK_MAX_IN_FLIGHT][PLAYBACK_VOICE_SLICE_SAMPLES];
+static size_t next_voice_slot = 0;
+
+static PlaybackStats stats;
+
+static size_t ms_to_samples(uint32_t ms, uint32_t sample_rate)
+{
+    return (size_t)ms * sample_rate / 1000;
+}
+
+static uint32_t current_low_water_ms()
+{
+    uint32_t mark = JITTER_INITIAL_MS;
+    if (arrival_seeded)
+    {
+        // Cover a few deviations of inter-arrival jitter, like an RTO estimate
+        mark = JITTER_MIN_MS + (uint32_t)(4.0f * arrival_jitter_ms);
+    }
+    mark += underrun_margin_ms;
+    return mark < JITTER_MIN_MS ? JITTER_MIN_MS : (mark > JITTER_MAX_MS ? JITTER_MAX_MS : mark);
+}
+
+// Ramp length at the current output rate, in samples (interleaved for stereo)
+static size_t fade_samples(uint32_t ms, bool stereo)
+{
+    size_t n = ms_to_samples(ms, stats.output_rate);
+    return stereo ? n * 2 : n;
+}
+
+static unsigned long now_ms()
+{
+    return sink.now_ms(sink.context);
+}
+
+static uint32_t cycle_count()
+{
+    return sink.cycle_count(sink.context);
+}
+
+// Producer: slot for the generation about to be published. The fence keeps these
+// writes from being seen ahead of the previous publish.
+static StreamRequest &next_request()
+{
+    std::atomic_thread_fence(std::memory_order_release);
+    return requests[(stream_generation.load(std::memory_order_relaxed) + 1) & 1];
+}
+
+static void publish_request()
+{
+    stream_generation.store(stream_generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Consumer: copy out the request of *generation. If the producer published again
+// meanwhile, the copy may be torn, so take the newer generation instead.
+static StreamRequest latch_request(uint32_t *generation)
+{
+    for (;;)
+    {
+        StreamRequest request = requests[*generation & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t now = stream_generation.load(std::memory_order_acquire);
+        if (now == *generation)
+            return request;
+        *generation = now;
+    }
+}
+
+// Nothing may be running the consumer meanwhile
+bool playback_init(int16_t *ring_storage, size_t ring_samples, const PlaybackSink &playback_sink)
+{
+    if (!playback_ring.init(ring_storage, ring_samples))
+        return false;
+
+    sink = playback_sink;
+    stream_generation.store(0, std::memory_order_relaxed);
+    abort_generation.store(0, std::memory_order_relaxed);
+    abort_acknowledged.store(0, std::memory_order_relaxed);
+    abort_handled = 0;
+    consumer_generation = 0;
+    consumer_state = CONSUMER_IDLE;
+    finished_pending = false;
+    in_flight = 0;
+    submitted = 0;
+    prepared.samples = nullptr;
+    arrival_seeded = false;
+    last_arrival_ms = 0;
+    underrun_margin_ms = 0;
+    resampler_in_rate = 0;
+    output_dsp_rate = 0;
+    memset(&stats, 0, sizeof(stats));
+    return true;
+}
+
+void playback_set_output_rate(uint32_t sample_rate)
+{
+    output_rate = sample_rate;
+}
+
+void playback_set_speed(uint32_t percent)
+{
+    speed_percent = percent < 100 ? 100 : (percent > PLAYBACK_MAX_SPEED ? PLAYBACK_MAX_SPEED : percent);
+}
+
+uint32_t playback_speed()
+{
+    return speed_percent;
+}
+
+void playback_stream_begin(const PcmStreamFormat &format)
+{
+    stream_format = format;
+    if (stream_format.channels != 2)
+        stream_format.channels = 1;
+    stream_sample_rate = format.sample_rate;
+    stream_start_ms = now_ms();
+    stream_ended = false;
+    carry_len = 0;
+    last_arrival_ms = 0;
+    stats.samples_dropped = 0;
+    stats.stretched_samples = 0;
+    stats.stretch_cycles = 0;
+    signal_stats_reset(&stats.signal);
+    stretching = stretcher.init(format.sample_rate) && speed_percent != 100;
+    stretcher.set_speed(speed_percent);
+    StreamRequest &request = next_request();
+    request.is_clip = false;
+    request.ring_start = playback_ring.write_position();
+    publish_request();
+}
+
+// Follow a speed change; a stream that started at normal speed joins the stretcher here
+static void update_stretch()
+{
+    uint32_t speed = speed_percent;
+    if (speed == stretcher.speed() || !stretcher.ready())
+        return;
+
+    if (!stretching)
+    {
+        stretcher.reset();
+        stretching = true;
+    }
+    stretcher.set_speed(speed);
+}
+
+// Stretch samples into the ring until either runs out; *consumed is what the stretcher took
+static void drain_stretcher(const int16_t *samples, size_t count, size_t *consumed)
+{
+    uint32_t start = cycle_count();
+    size_t used = 0;
+    for (;;)
+    {
+        int16_t *dst;
+        size_t span = playback_ring.write_span(&dst);
+        size_t taken;
+        size_t made = stretcher.process(samples + used, count - used, dst, span, &taken);
+        playback_ring.commit(made);
+        stats.stretched_samples += made;
+        used += taken;
+        if (made < span || playback_ring.free_space() == 0)
+            break; // stretcher needs more input, or the ring is full
+    }
+    stats.stretch_cycles += cycle_count() - start;
+    *consumed = used;
+}
+
+void playback_stream_write_samples(const int16_t *samples, size_t count)
+{
+    update_stretch();
+    if (stretching)
+    {
+        signal_stats_update(&stats.signal, samples, count);
+        size_t used;
+        drain_stretcher(samples, count, &used);
+        stats.samples_dropped += count - used;
+        return;
+    }
+
+    if (!playback_ring.push(samples, count))
+    {
+        stats.samples_dropped += count;
+        return;
+    }
+    signal_stats_update(&stats.signal, samples, count);
+}
+
+static size_t frame_bytes()
+{
+    return stream_format.channels * (stream_format.sample_format == PCM_SAMPLE_U8 ? 1 : 2);
+}
+
+// Fold frames of the stream format into mono 16-bit; src need not be aligned
+static void convert_frames(const uint8_t *src, size_t frames, int16_t *dst)
+{
+    const bool stereo = stream_format.channels == 2;
+
+    if (stream_format.sample_format == PCM_SAMPLE_U8)
+    {
+        for (size_t i = 0; i < frames; i++)
+        {
+            int32_t sample = (src[0] - 128) * 256;
+            if (stereo)
+                sample = (sample + (src[1] - 128) * 256) >> 1;
+            dst[i] = (int16_t)sample;
+            src += stream_format.channels;
+        }
+    }
+    else if (!stereo)
+    {
+        memcpy(dst, src, frames * sizeof(int16_t));
+    }
+    else
+    {
+        for (size_t i = 0; i < frames; i++)
+        {
+            int32_t left = (int16_t)(src[0] | (src[1] << 8));
+            int32_t right = (int16_t)(src[2] | (src[3] << 8));
+            dst[i] = (int16_t)((left + right) >> 1);
+            src += 4;
+        }
+    }
+}
+
+void playback_stream_write(const uint8_t *data, size_t bytes)
+{
+    const size_t frame = frame_bytes();
+
+    // A chunk boundary may split a frame; finish it with the start of this chunk
+    if (carry_len > 0)
+    {
+        while (carry_len < frame && bytes > 0)
+        {
+            carry[carry_len++] = *data++;
+            bytes--;
+        }
+        if (carry_len < frame)
+            return;
+
+        int16_t sample;
+        convert_frames(carry, 1, &sample);
+        playback_stream_write_samples(&sample, 1);
+        carry_len = 0;
+    }
+
+    size_t count = bytes / frame;
+    update_stretch();
+    if (stretching)
+    {
+        // Fold into scratch on the way to the stretcher
+        for (size_t done = 0; done < count;)
+        {
+            size_t n = count - done < PLAYBACK_STRETCH_SCRATCH ? count - done : PLAYBACK_STRETCH_SCRATCH;
+            convert_frames(data + done * frame, n, stretch_scratch);
+            playback_stream_write_samples(stretch_scratch, n);
+            done += n;
+        }
+    }
+    else if (playback_ring.free_space() < count)
+    {
+        stats.samples_dropped += count;
+    }
+    else
+    {
+        // Convert straight into the ring
+        size_t done = 0;
+        while (done < count)
+        {
+            int16_t *dst;
+            size_t span = playback_ring.write_span(&dst);
+            size_t n = count - done < span ? count - done : span;
+            convert_frames(data + done * frame, n, dst);
+            signal_stats_update(&stats.signal, dst, n);
+            playback_ring.commit(n);
+            done += n;
+        }
+    }
+
+    carry_len = bytes - count * frame;
+    memcpy(carry, data + count * frame, carry_len);
+}
+
+void playback_stream_note_chunk()
+{
+    unsigned long now = now_ms();
+    if (last_arrival_ms != 0)
+    {
+        float dt = (float)(now - last_arrival_ms);
+        if (!arrival_seeded)
+        {
+            arrival_mean_ms = dt;
+            arrival_jitter_ms = dt / 2;
+            arrival_seeded = true;
+        }
+        else
+        {
+            float deviation = dt > arrival_mean_ms ? dt - arrival_mean_ms : arrival_mean_ms - dt;
+            arrival_mean_ms += (dt - arrival_mean_ms) / 8;
+            arrival_jitter_ms += (deviation - arrival_jitter_ms) / 4;
+        }
+    }
+    last_arrival_ms = now;
+}
+
+void playback_stream_end()
+{
+    if (stretching)
+    {
+        // The stretcher holds up to a block plus its search window; hand it over unstretched
+        stretcher.finish();
+        size_t used;
+        drain_stretcher(nullptr, 0, &used);
+    }
+    stream_ended = true;
+}
+
+// Tagged with the current generation and the ring position, so the consumer stops
+// exactly what was started before it: a stream or clip begun after the abort still
+// plays, and what it has already written stays in the ring
+void playback_stream_abort()
+{
+    abort_mark.store(playback_ring.write_position(), std::memory_order_relaxed);
+    abort_generation.store(stream_generation.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+bool playback_abort_settled()
+{
+    return abort_acknowledged.load(std::memory_order_acquire) == abort_generation.load(std::memory_order_relaxed);
+}
+
+void playback_play_clip(int16_t *samples, size_t count, uint32_t sample_rate, bool stereo)
+{
+    StreamRequest &request = next_request();
+    request.is_clip = true;
+    request.clip.samples = samples;
+    request.clip.count = stereo ? count & ~(size_t)1 : count;
+    request.clip.stereo = stereo;
+    request.clip.sample_rate = sample_rate;
+    request.ring_start = playback_ring.write_position();
+    stream_start_ms = now_ms();
+    publish_request();
+}
+
+bool playback_take_finished()
+{
+    if (!finished_pending)
+        return false;
+
+    finished_pending = false;
+    return true;
+}
+
+// Release slices the speaker has finished with
+static void release_completed()
+{
+    size_t playing = sink.queued(sink.context);
+    if (in_flight > playing)
+        head_started_ms = last_service_ms; // the next one started after the previous pass
+    while (in_flight > playing)
+    {
+        playback_ring.consume(in_flight_slices[0].ring_samples);
+        submitted -= in_flight_slices[0].ring_samples;
+        if (!in_flight_slices[0].voice_only)
+            stats.samples_played += in_flight_slices[0].samples;
+
+        for (size_t i = 1; i < in_flight; i++)
+        {
+            in_flight_slices[i - 1] = in_flight_slices[i];
+        }
+        in_flight--;
+    }
+}
+
+// Set up conversion for a new stream; the filter is only redesigned when the rates change
+static void select_output_rate()
+{
+    resampling = false;
+    if (output_rate != 0 && stream_sample_rate != output_rate)
+    {
+        if (resampler_in_rate != stream_sample_rate || resampler_out_rate != output_rate)
+        {
+            resampler_in_rate = stream_sample_rate;
+            resampler_out_rate = output_rate;
+            if (!resampler.init(stream_sample_rate, output_rate))
+                resampler_in_rate = 0; // ratio too awkward; let the speaker convert
+        }
+        else
+        {
+            resampler.reset();
+        }
+        resampling = resampler_in_rate != 0;
+    }
+
+    stats.output_rate = resampling ? output_rate : stream_sample_rate;
+    stats.resampled_samples = 0;
+    stats.resample_cycles = 0;
+}
+
+// Fill one output slice from the ring through the resampler, consuming its input
+static size_t resample_slice(int16_t *out)
+{
+    uint32_t start = cycle_count();
+    size_t produced = 0;
+
+    while (produced < PLAYBACK_RESAMPLE_SLICE_SAMPLES)
+    {
+        int16_t *in;
+        size_t available = playback_ring.read_span(&in);
+        if (available == 0)
+            break;
+
+        size_t used;
+        produced += resampler.process(in, available, out + produced, PLAYBACK_RESAMPLE_SLICE_SAMPLES - produced, &used);
+        playback_ring.consume(used);
+        if (used == 0)
+            break;
+    }
+
+    stats.resample_cycles += cycle_count() - start;
+    stats.resampled_samples += produced;
+    return produced;
+}
+
+// Dynamics state follows the output rate; the loudness estimate carries over between turns
+static void configure_output_dsp(uint32_t sample_rate)
+{
+#if PLAYBACK_DYNAMICS
+    if (sample_rate != output_dsp_rate)
+    {
+        loudness_normalizer_init(&output_loudness, sample_rate, PLAYBACK_LOUDNESS_TARGET_RMS, PLAYBACK_LOUDNESS_GATE_RMS,
+                                 PLAYBACK_LOUDNESS_WINDOW_MS, PLAYBACK_LOUDNESS_MIN_GAIN_Q12, PLAYBACK_LOUDNESS_MAX_GAIN_Q12);
+        lookahead_limiter_init(&output_limiter, sample_rate, PLAYBACK_LIMITER_THRESHOLD, PLAYBACK_LIMITER_LOOKAHEAD_US,
+                               PLAYBACK_LIMITER_RELEASE_MS);
+        if (output_dsp.size() == 0)
+        {
+            output_dsp.add(loudness_normalizer_process, &output_loudness);
+            output_dsp.add(lookahead_limiter_process, &output_limiter);
+        }
+        output_dsp_rate = sample_rate;
+    }
+#endif
+    stats.dynamics_samples = 0;
+    stats.dynamics_cycles = 0;
+}
+
+static void process_output(int16_t *slice, size_t len)
+{
+    uint32_t start = cycle_count();
+    output_dsp.process(slice, len);
+    stats.dynamics_cycles += cycle_count() - start;
+    stats.dynamics_samples += len;
+}
+
+// Overlay the voices on a slice about to be queued
+static void mix_voices(int16_t *slice, size_t len, bool stereo)
+{
+    if (!mixer.active() && !mixer.bed_ducked())
+        return;
+
+    uint32_t start = cycle_count();
+    mixer.mix(slice, stereo ? len / 2 : len, stereo ? 2 : 1, stats.output_rate);
+    stats.mix_cycles += cycle_count() - start;
+    stats.mix_samples += len;
+}
+
+// Dynamics, then the envelope, over a slice about to be queued. A closed envelope
+// reopens with a fade-in; reopening restarts the limiter and keeps the envelope
+// shut while its delay line flushes, so the fade isn't spent on the zeros it
+// emits. fade_tail closes the envelope again by the end of the slice.
+static void shape_output(int16_t *slice, size_t len, bool fade_tail, bool stereo)
+{
+    size_t fade = fade_samples(PLAYBACK_FADE_MS, stereo);
+    bool reopening = envelope.target_q24 == 0;
+    size_t hold = 0;
+#if PLAYBACK_DYNAMICS
+    if (reopening)
+    {
+        lookahead_limiter_reset(&output_limiter);
+        hold = output_limiter.lookahead < len ? output_limiter.lookahead : len;
+    }
+#endif
+    process_output(slice, len);
+
+    if (reopening)
+    {
+        gain_envelope_process(&envelope, slice, hold);
+        gain_envelope_ramp(&envelope, true, fade);
+    }
+
+    size_t tail = !fade_tail ? 0 : (fade < len - hold ? fade : len - hold);
+    gain_envelope_process(&envelope, slice + hold, len - hold - tail);
+    if (fade_tail)
+    {
+        gain_envelope_ramp(&envelope, false, tail);
+        gain_envelope_process(&envelope, slice + len - tail, tail);
+    }
+    mix_voices(slice, len, stereo);
+}
+
+// Start the envelope closed so the first slice fades in
+static void start_envelope()
+{
+    gain_envelope_init(&envelope, false);
+}
+
+// Time left on the slice playing now (mono streams), erring low
+static uint32_t head_remaining_ms()
+{
+    uint32_t slice_ms = (uint32_t)(in_flight_slices[0].samples * 1000 / stats.output_rate);
+    uint32_t elapsed = now_ms() - head_started_ms;
+    return elapsed < slice_ms ? slice_ms - elapsed : 0;
+}
+
+// Nothing is left to queue behind the last slice: fade its tail in place while
+// the speaker is still short of it, so running dry ends in silence. Too late if
+// that slice is already playing and nearly done.
+static void fade_queued_tail()
+{
+    InFlightSlice &last = in_flight_slices[in_flight - 1];
+    size_t fade = fade_samples(PLAYBACK_FADE_MS, false);
+    if (fade > last.samples)
+        fade = last.samples;
+
+    if (in_flight == 1 && head_remaining_ms() < PLAYBACK_FADE_MS + PLAYBACK_TAIL_MARGIN_MS)
+        return;
+
+    GainEnvelope tail;
+    gain_envelope_init(&tail, true);
+    gain_envelope_ramp(&tail, false, fade);
+    gain_envelope_process(&tail, last.data + last.samples - fade, fade);
+    gain_envelope_init(&envelope, false);
+}
+
+static bool submit_prepared(bool stereo)
+{
+    if (!sink.play(sink.context, prepared.samples, prepared.len, stats.output_rate, stereo))
+        return false;
+
+    if (!first_audio_sent)
+    {
+        stats.time_to_first_audio_ms = now_ms() - stream_start_ms;
+        first_audio_sent = true;
+    }
+    if (in_flight == 0)
+        head_started_ms = now_ms();
+
+    in_flight_slices[in_flight].data = prepared.samples;
+    in_flight_slices[in_flight].ring_samples = prepared.ring_samples;
+    in_flight_slices[in_flight].samples = prepared.len;
+    in_flight_slices[in_flight].voice_only = false;
+    in_flight++;
+    prepared.samples = nullptr;
+    return true;
+}
+
+// Output rate, dynamics and envelope for a clip starting from silence
+static void start_clip(const ClipSource &source)
+{
+    clip = source;
+    clip_submitted = 0;
+    stats.output_rate = clip.sample_rate; // clips are played natively
+    stats.resampled_samples = 0;
+    configure_output_dsp(stats.output_rate);
+    start_envelope();
+}
+
+// A new clip was started while one is playing. With the same format the rest of
+// the old clip is crossfaded into the start of the new one; otherwise the old
+// clip fades out and the new one starts from silence.
+static void switch_clip(const ClipSource &next, uint32_t generation)
+{
+    consumer_generation = generation;
+
+    bool compatible = next.sample_rate == clip.sample_rate && next.stereo == clip.stereo;
+    size_t n = fade_samples(compatible ? PLAYBACK_CROSSFADE_MS : PLAYBACK_FADE_MS, clip.stereo);
+    if (n > PLAYBACK_CROSSFADE_MAX_SAMPLES)
+        n = PLAYBACK_CROSSFADE_MAX_SAMPLES;
+    if (n > clip.count - clip_submitted)
+        n = clip.count - clip_submitted;
+    if (compatible && n > next.count)
+        n = next.count;
+
+    if (n > 0)
+    {
+        // Slots rotate like the resampler's, so the one written is never still queued
+        int16_t *crossfade_slot = crossfade_slots[next_crossfade_slot];
+        next_crossfade_slot = (next_crossfade_slot + 1) % PLAYBACK_MAX_IN_FLIGHT;
+
+        if (compatible)
+        {
+            crossfade_linear(clip.samples + clip_submitted, next.samples, crossfade_slot, n);
+        }
+        else
+        {
+            memcpy(crossfade_slot, clip.samples + clip_submitted, n * sizeof(int16_t));
+        }
+        shape_output(crossfade_slot, n, !compatible, clip.stereo);
+
+        prepared.samples = crossfade_slot;
+        prepared.len = n;
+        prepared.ring_samples = 0;
+        if (!submit_prepared(clip.stereo))
+            prepared.samples = nullptr; // no room after all; cut instead
+    }
+
+    if (compatible)
+    {
+        clip = next;
+        clip_submitted = n;
+    }
+    else
+    {
+        start_clip(next);
+    }
+}
+
+// Queue a clip straight from the caller's buffer; a stream requested meanwhile
+// waits for the clip to finish
+static PlaybackEvent service_clip(uint32_t generation)
+{
+    if (consumer_generation != generation && prepared.samples == nullptr && in_flight < PLAYBACK_MAX_IN_FLIGHT)
+    {
+        StreamRequest request = latch_request(&generation);
+        if (request.is_clip)
+            switch_clip(request.clip, generation);
+    }
+
+    while (in_flight < PLAYBACK_MAX_IN_FLIGHT)
+    {
+        if (prepared.samples == nullptr)
+        {
+            if (clip_submitted >= clip.count)
+                break;
+
+            size_t len = clip.count - clip_submitted;
+            if (len > PLAYBACK_SLICE_SAMPLES)
+                len = PLAYBACK_SLICE_SAMPLES; // even, so stereo frames stay whole
+
+            prepared.samples = clip.samples + clip_submitted;
+            prepared.len = len;
+            prepared.ring_samples = 0;
+            clip_submitted += len;
+            shape_output(prepared.samples, len, clip_submitted >= clip.count, clip.stereo);
+        }
+
+        if (!submit_prepared(clip.stereo))
+            break;
+    }
+
+    // Slices reference the clip until the channel has played them
+    if (in_flight == 0 && prepared.samples == nullptr && clip_submitted >= clip.count)
+    {
+        consumer_state = CONSUMER_IDLE;
+        return PLAYBACK_FINISHED;
+    }
+    return PLAYBACK_PLAYING;
+}
+
+// Take the next slice from the ring (or through the resampler), then process and ramp it
+static bool prepare_stream_slice(size_t unsubmitted)
+{
+    // Read before the ring: once the stream has ended, everything it wrote is already there
+    bool ended = stream_ended;
+
+    if (unsubmitted == 0)
+        return false;
+    // Hold back crumbs while more data may still arrive in time
+    if (!ended && in_flight > 0 && unsubmitted < PLAYBACK_MIN_SLICE_SAMPLES &&
+        head_remaining_ms() > PLAYBACK_FADE_MS + PLAYBACK_TAIL_MARGIN_MS + PLAYBACK_SERVICE_MS)
+        return false;
+
+    int16_t *slice;
+    size_t len;
+    size_t ring_samples;
+    bool last_buffered;
+    if (resampling)
+    {
+        slice = resample_slots[next_slot];
+        len = resample_slice(slice);
+        ring_samples = 0;
+        last_buffered = playback_ring.available() == 0;
+        if (len == 0)
+            return false;
+        next_slot = (next_slot + 1) % PLAYBACK_MAX_IN_FLIGHT;
+    }
+    else
+    {
+        len = playback_ring.read_span_at(submitted, &slice);
+        if (len > PLAYBACK_STREAM_SLICE_SAMPLES)
+            len = PLAYBACK_STREAM_SLICE_SAMPLES;
+        ring_samples = len;
+        last_buffered = len == unsubmitted;
+    }
+
+    // Last of the stream, or nothing else queued: fade the tail so what follows
+    // starts from silence, not a click
+    shape_output(slice, len, last_buffered && (ended || in_flight == 0), false);
+
+    prepared.samples = slice;
+    prepared.len = len;
+    prepared.ring_samples = ring_samples;
+    submitted += ring_samples;
+    return true;
+}
+
+// Bring the channel down over a few milliseconds before cutting it, rather than
+// stopping mid-waveform; the slices still queued are what fades
+static void fade_out_channel()
+{
+    if (in_flight > 0)
+    {
+        uint8_t volume = sink.volume(sink.context);
+        for (int step = PLAYBACK_STOP_FADE_MS - 1; step >= 0; step--)
+        {
+            sink.set_volume(sink.context, (uint8_t)(volume * step / PLAYBACK_STOP_FADE_MS));
+            sink.wait_ms(sink.context, 1);
+        }
+        sink.stop(sink.context);
+        sink.set_volume(sink.context, volume);
+    }
+    else
+    {
+        sink.stop(sink.context);
+    }
+}
+
+static PlaybackEvent service_output()
+{
+    release_completed();
+    last_service_ms = now_ms();
+
+    // The generation is read first: an abort is published before any generation
+    // that follows it, so one started after an abort is never taken without it
+    uint32_t generation = stream_generation.load(std::memory_order_acquire);
+    uint32_t aborted = abort_generation.load(std::memory_order_acquire);
+    if (aborted != abort_handled)
+    {
+        fade_out_channel();
+        in_flight = 0;
+        submitted = 0;
+        prepared.samples = nullptr;
+        playback_ring.discard_to(abort_mark.load(std::memory_order_relaxed));
+        consumer_state = CONSUMER_IDLE;
+        if ((int32_t)(aborted - consumer_generation) > 0)
+            consumer_generation = aborted; // aborted before it started
+        abort_handled = aborted;
+        abort_acknowledged.store(aborted, std::memory_order_release);
+        return PLAYBACK_IDLE;
+    }
+
+    if (consumer_state == CONSUMER_IDLE)
+    {
+        if (consumer_generation == generation)
+            return PLAYBACK_IDLE;
+
+        StreamRequest request = latch_request(&generation);
+        bool clip = request.is_clip;
+        playback_ring.discard_to(request.ring_start);
+        consumer_generation = generation;
+        consumer_state = clip ? CONSUMER_CLIP : CONSUMER_BUFFERING;
+        prepared.samples = nullptr;
+        first_audio_sent = false;
+        stats.underruns = 0;
+        stats.samples_played = 0;
+        stats.mix_samples = 0;
+        stats.mix_cycles = 0;
+        stats.time_to_first_audio_ms = 0;
+        if (clip)
+        {
+            start_clip(request.clip);
+        }
+        else
+        {
+            select_output_rate();
+            configure_output_dsp(stats.output_rate);
+            start_envelope();
+        }
+    }
+
+    if (consumer_state == CONSUMER_CLIP)
+        return service_clip(generation);
+
+    size_t unsubmitted = playback_ring.available() - submitted;
+
+    if (consumer_state == CONSUMER_BUFFERING)
+    {
+        stats.low_water_ms = current_low_water_ms();
+        stats.jitter_ms = (uint32_t)arrival_jitter_ms;
+        if (unsubmitted < ms_to_samples(stats.low_water_ms, stream_sample_rate) && !stream_ended)
+            return PLAYBACK_BUFFERING;
+
+        consumer_state = CONSUMER_PLAYING;
+    }
+
+    // Keep the speaker's queue full, taking slices straight from the ring or from the resampler
+    while (in_flight < PLAYBACK_MAX_IN_FLIGHT)
+    {
+        if (prepared.samples == nullptr && !prepare_stream_slice(unsubmitted))
+            break;
+        if (!submit_prepared(false))
+            break;
+        unsubmitted = playback_ring.available() - submitted;
+    }
+    unsubmitted = playback_ring.available() - submitted;
+
+    if (unsubmitted == 0 && prepared.samples == nullptr && in_flight > 0 && envelope.target_q24 != 0)
+    {
+        fade_queued_tail();
+    }
+
+    if (in_flight == 0 && unsubmitted == 0 && prepared.samples == nullptr)
+    {
+        if (stream_ended)
+        {
+            consumer_state = CONSUMER_IDLE;
+            if (stats.underruns == 0)
+                underrun_margin_ms = underrun_margin_ms * 3 / 4;
+            return PLAYBACK_FINISHED;
+        }
+
+        // Ran dry: rebuffer to the (now higher) mark and fade back in
+        gain_envelope_init(&envelope, false);
+        stats.underruns++;
+        underrun_margin_ms += 100;
+        consumer_state = CONSUMER_BUFFERING;
+        return PLAYBACK_BUFFERING;
+    }
+
+    return PLAYBACK_PLAYING;
+}
+
+// With no response queued or on its way, the voices get slices of their own
+static void service_voices()
+{
+    if (consumer_state == CONSUMER_PLAYING || consumer_state == CONSUMER_CLIP || prepared.samples != nullptr)
+        return;
+    if (!mixer.active())
+    {
+        if (in_flight == 0 && consumer_state == CONSUMER_IDLE)
+            mixer.reset_bed();
+        return;
+    }
+
+    // Same rate as the response about to start (or the last one), so the queue stays uniform
+    uint32_t rate = stats.output_rate != 0 ? stats.output_rate : (output_rate != 0 ? output_rate : stream_sample_rate);
+    stats.output_rate = rate;
+    while (in_flight < PLAYBACK_MAX_IN_FLIGHT && mixer.active())
+    {
+        int16_t *slot = voice_slots[next_voice_slot];
+        memset(slot, 0, sizeof(voice_slots[0]));
+        uint32_t start = cycle_count();
+        mixer.mix(slot, PLAYBACK_VOICE_SLICE_SAMPLES, 1, rate);
+        stats.mix_cycles += cycle_count() - start;
+        stats.mix_samples += PLAYBACK_VOICE_SLICE_SAMPLES;
+
+        if (!sink.play(sink.context, slot, PLAYBACK_VOICE_SLICE_SAMPLES, rate, false))
+            break; // mixed audio is lost; only happens if someone else uses the channel
+        next_voice_slot = (next_voice_slot + 1) % PLAYBACK_MAX_IN_FLIGHT;
+        if (in_flight == 0)
+            head_started_ms = now_ms();
+        in_flight_slices[in_flight].data = slot;
+        in_flight_slices[in_flight].ring_samples = 0;
+        in_flight_slices[in_flight].samples = PLAYBACK_VOICE_SLICE_SAMPLES;
+        in_flight_slices[in_flight].voice_only = true;
+        in_flight++;
+    }
+}
+
+PlaybackEvent playback_service()
+{
+    PlaybackEvent event = service_output();
+    if (event == PLAYBACK_FINISHED)
+    {
+        finished_pending = true;
+    }
+    service_voices();
+    return event;
+}
+
+uint32_t playback_play_voice(const int16_t *samples, size_t count, uint32_t sample_rate, const MixerVoiceParams &params)
+{
+    return mixer.play(samples, count, sample_rate, params);
+}
+
+void playback_stop_voice(uint32_t handle)
+{
+    mixer.stop(handle);
+}
+
+bool playback_active()
+{
+    return consumer_state != CONSUMER_IDLE || consumer_generation != stream_generation.load(std::memory_order_acquire) ||
+           abort_acknowledged.load(std::memory_order_acquire) != abort_generation.load(std::memory_order_relaxed);
+}
+
+PlaybackStats playback_stats()
+{
+    return stats;
+}
@@ -0,0 +1,86 @@
+#include "audio_playback.h"
+
+#include <Arduino.h>
+#include <M5Unified.h>
+#include <esp_heap_caps.h>
+
+static TaskHandle_t playback_task_handle = nullptr;
+
+static bool speaker_play(void *context, const int16_t *samples, size_t len, uint32_t sample_rate, bool stereo)
+{
+    return M5.Speaker.playRaw(samples, len, sample_rate, stereo, 1, PLAYBACK_CHANNEL, false);
+}
+
+static size_t speaker_queued(void *context)
+{
+    return M5.Speaker.isPlaying(PLAYBACK_CHANNEL);
+}
+
+static uint8_t speaker_volume(void *context)
+{
+    return M5.Speaker.getChannelVolume(PLAYBACK_CHANNEL);
+}
+
+static void speaker_set_volume(void *context, uint8_t volume)
+{
+    M5.Speaker.setChannelVolume(PLAYBACK_CHANNEL, volume);
+}
+
+static void speaker_stop(void *context)
+{
+    M5.Speaker.stop(PLAYBACK_CHANNEL);
+}
+
+static void task_wait_ms(void *context, uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+static unsigned long clock_ms(void *context)
+{
+    return millis();
+}
+
+static uint32_t clock_cycles(void *context)
+{
+    return ESP.getCycleCount();
+}
+
+// The feeder's channel on the M5 speaker
+static const PlaybackSink speaker_sink = {
+    nullptr, speaker_play, speaker_queued, speaker_volume, speaker_set_volume, speaker_stop, task_wait_ms, clock_ms, clock_cycles,
+};
+
+static void playback_task(void *arg)
+{
+    for (;;)
+    {
+        playback_service();
+        vTaskDelay(pdMS_TO_TICKS(PLAYBACK_SERVICE_MS));
+    }
+}
+
+bool playback_begin()
+{
+    if (playback_task_handle != nullptr)
+        return true;
+
+    int16_t *storage = (int16_t *)heap_caps_malloc(PLAYBACK_RING_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (storage == nullptr || !playback_init(storage, PLAYBACK_RING_SAMPLES, speaker_sink))
+        return false;
+
+    return xTaskCreatePinnedToCore(playback_task, "spk_feeder", PLAYBACK_TASK_STACK, nullptr,
+                                   PLAYBACK_TASK_PRIORITY, &playback_task_handle, PLAYBACK_TASK_CORE) == pdPASS;
+}
+
+void playback_stop()
+{
+    playback_stream_abort();
+    if (playback_task_handle == nullptr)
+        return;
+
+    while (!playback_abort_settled())
+    {
+        vTaskDelay(1);
+    }
+}
@@ -0,0 +1,148 @@
+#include "downlink_reassembly.h"
+
+#include <cstring>
+
+DownlinkReassembly::DownlinkReassembly()
+    : window_(nullptr), window_bytes_(0), total_(0), delivered_(0), held_count_(0), sink_(nullptr), context_(nullptr)
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void DownlinkReassembly::begin(uint32_t total_bytes, uint8_t *window, size_t window_bytes, ReassemblySink sink,
+                               void *context)
+{
+    window_ = window;
+    window_bytes_ = window != nullptr ? window_bytes : 0;
+    total_ = total_bytes;
+    delivered_ = 0;
+    held_count_ = 0;
+    sink_ = sink;
+    context_ = context;
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+ReassemblyResult DownlinkReassembly::accept(uint32_t offset, const uint8_t *data, size_t len)
+{
+    // Nothing past the declared end is audio
+    if (offset >= total_)
+        len = 0;
+    else if (len > total_ - offset)
+        len = total_ - offset;
+
+    uint32_t end = offset + (uint32_t)len;
+    if (len == 0 || end <= delivered_)
+    {
+        stats_.duplicates++;
+        return REASSEMBLY_DUPLICATE;
+    }
+
+    if (offset <= delivered_)
+    {
+        size_t skip = delivered_ - offset;
+        sink_(context_, data + skip, len - skip);
+        delivered_ = end;
+        release_held();
+        stats_.delivered++;
+        return REASSEMBLY_DELIVERED;
+    }
+
+    if (!hold(offset, data, len))
+    {
+        stats_.dropped++;
+        return REASSEMBLY_DROPPED;
+    }
+    stats_.held++;
+    return REASSEMBLY_HELD;
+}
+
+// Copy a chunk past the gap into the window and merge it into the held runs
+bool DownlinkReassembly::hold(uint32_t offset, const uint8_t *data, size_t len)
+{
+    // The window covers window_bytes_ from the first missing byte; keep the front of what fits
+    uint32_t limit = delivered_ + (uint32_t)(window_bytes_ < total_ - delivered_ ? window_bytes_ : total_ - delivered_);
+    if (offset >= limit)
+        return false;
+    if (len > limit - offset)
+        len = limit - offset;
+    uint32_t end = offset + (uint32_t)len;
+
+    // Work out the merged runs first; nothing is copied if they don't fit
+    ByteRange merged[REASSEMBLY_MAX_HELD + 1];
+    size_t count = 0;
+    size_t i = 0;
+    while (i < held_count_ && held_[i].offset + held_[i].length < offset)
+    {
+        merged[count++] = held_[i++];
+    }
+
+    // Absorb every held run that overlaps or touches the chunk
+    uint32_t lo = offset;
+    uint32_t hi = end;
+    while (i < held_count_ && held_[i].offset <= hi)
+    {
+        if (held_[i].offset < lo)
+            lo = held_[i].offset;
+        if (held_[i].offset + held_[i].length > hi)
+            hi = held_[i].offset + held_[i].length;
+        i++;
+    }
+    merged[count].offset = lo;
+    merged[count].length = hi - lo;
+    count++;
+
+    while (i < held_count_)
+    {
+        merged[count++] = held_[i++];
+    }
+    if (count > REASSEMBLY_MAX_HELD)
+        return false;
+
+    size_t pos = offset % window_bytes_;
+    size_t first = len < window_bytes_ - pos ? len : window_bytes_ - pos;
+    memcpy(window_ + pos, data, first);
+    memcpy(window_, data + first, len - first);
+
+    memcpy(held_, merged, count * sizeof(ByteRange));
+    held_count_ = count;
+    return true;
+}
+
+// Hand on held runs that the delivered bytes have reached
+void DownlinkReassembly::release_held()
+{
+    while (held_count_ > 0 && held_[0].offset <= delivered_)
+    {
+        uint32_t end = held_[0].offset + held_[0].length;
+        while (delivered_ < end)
+        {
+            size_t pos = delivered_ % window_bytes_;
+            size_t n = end - delivered_;
+            if (n > window_bytes_ - pos)
+                n = window_bytes_ - pos;
+            sink_(context_, window_ + pos, n);
+            delivered_ += (uint32_t)n;
+        }
+
+        held_count_--;
+        memmove(held_, held_ + 1, held_count_ * sizeof(ByteRange));
+    }
+}
+
+size_t DownlinkReassembly::missing(ByteRange *out, size_t max) const
+{
+    size_t count = 0;
+    uint32_t pos = delivered_;
+    for (size_t i = 0; i <= held_count_ && count < max; i++)
+    {
+        uint32_t next = i < held_count_ ? held_[i].offset : total_;
+        if (next > pos)
+        {
+            out[count].offset = pos;
+            out[count].length = next - pos;
+            count++;
+        }
+        if (i < held_count_)
+            pos = held_[i].offset + held_[i].length;
+    }
+    return count;
+}
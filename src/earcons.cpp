@@ -0,0 +1,50 @@
+#include "earcons.h"
+
+#include <esp_heap_caps.h>
+#include "ima_adpcm.h"
+#include "audio_playback.h"
+
+static int16_t *earcon_pcm[EARCON_COUNT];
+static uint32_t earcon_voice = 0; // mixer handle of the last earcon started
+
+bool earcons_begin()
+{
+    for (int i = 0; i < EARCON_COUNT; i++)
+    {
+        if (earcon_pcm[i] != nullptr)
+            continue;
+
+        const EarconSource &source = earcon_sources[i];
+        int16_t *pcm = (int16_t *)heap_caps_malloc(source.samples * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        if (pcm == nullptr)
+            return false;
+
+        if (ima_adpcm_decode_frame(source.adpcm, source.adpcm_bytes, pcm, source.samples) != source.samples)
+        {
+            heap_caps_free(pcm);
+            return false;
+        }
+        earcon_pcm[i] = pcm;
+    }
+    return true;
+}
+
+void earcon_play(EarconId id)
+{
+    if (id < 0 || id >= EARCON_COUNT || earcon_pcm[id] == nullptr)
+        return;
+
+    const EarconSource &source = earcon_sources[id];
+    const MixerVoiceParams params = {EARCON_PRIORITY, EARCON_GAIN_Q12, EARCON_DUCK_Q12};
+    playback_stop_voice(earcon_voice);
+    earcon_voice = playback_play_voice(earcon_pcm[id], source.samples, source.sample_rate, params);
+}
+
+uint32_t earcon_duration_ms(EarconId id)
+{
+    if (id < 0 || id >= EARCON_COUNT)
+        return 0;
+
+    const EarconSource &source = earcon_sources[id];
+    return (uint32_t)((uint64_t)source.samples * 1000 / source.sample_rate);
+}
@@ -0,0 +1,41 @@
+#include "fs_cache_storage.h"
+
+bool FsCacheStorage::write_mode(const char *path, const char *mode, const uint8_t *data, size_t len)
+{
+    File file = fs_.open(path, mode, true); // create missing directories (SD)
+    if (!file)
+        return false;
+
+    size_t written = file.write(data, len);
+    file.close();
+    return written == len;
+}
+
+bool FsCacheStorage::write(const char *path, const uint8_t *data, size_t len)
+{
+    return write_mode(path, FILE_WRITE, data, len);
+}
+
+bool FsCacheStorage::append(const char *path, const uint8_t *data, size_t len)
+{
+    return write_mode(path, FILE_APPEND, data, len);
+}
+
+size_t FsCacheStorage::read(const char *path, size_t offset, uint8_t *dst, size_t len)
+{
+    if (!fs_.exists(path))
+        return 0;
+
+    File file = fs_.open(path, FILE_READ);
+    if (!file)
+        return 0;
+
+    size_t got = file.seek(offset) ? file.read(dst, len) : 0;
+    file.close();
+    return got;
+}
+
+bool FsCacheStorage::remove(const char *path)
+{
+    return fs_.exists(path) && fs_.remove(path);
+}
@@ -0,0 +1,138 @@
+#include "ima_adpcm.h"
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8};
+
+static inline int32_t clamp_sample(int32_t v)
+{
+    return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+}
+
+static inline int32_t clamp_index(int32_t i)
+{
+    return i > 88 ? 88 : (i < 0 ? 0 : i);
+}
+
+void ima_adpcm_reset(ImaAdpcmState *state)
+{
+    state->predictor = 0;
+    state->step_index = 0;
+}
+
+int16_t ima_adpcm_decode_sample(ImaAdpcmState *state, uint8_t nibble)
+{
+    int32_t step = step_table[state->step_index];
+
+    // diff = (nibble + 0.5) * step / 4, computed with shifts as in the reference decoder
+    int32_t diff = step >> 3;
+    if (nibble & 4)
+        diff += step;
+    if (nibble & 2)
+        diff += step >> 1;
+    if (nibble & 1)
+        diff += step >> 2;
+
+    state->predictor = clamp_sample(nibble & 8 ? state->predictor - diff : state->predictor + diff);
+    state->step_index = clamp_index(state->step_index + index_table[nibble & 15]);
+    return (int16_t)state->predictor;
+}
+
+uint8_t ima_adpcm_encode_sample(ImaAdpcmState *state, int16_t sample)
+{
+    int32_t step = step_table[state->step_index];
+    int32_t diff = (int32_t)sample - state->predictor;
+    uint8_t nibble = 0;
+
+    if (diff < 0)
+    {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step)
+    {
+        nibble |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        nibble |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        nibble |= 1;
+    }
+
+    // Run the decoder so encoder and decoder predictors stay bit-identical
+    ima_adpcm_decode_sample(state, nibble);
+    return nibble;
+}
+
+size_t ima_adpcm_encode_frame(ImaAdpcmState *state, const int16_t *pcm, size_t samples, uint8_t *out)
+{
+    out[0] = (uint8_t)(state->predictor & 0xff);
+    out[1] = (uint8_t)((state->predictor >> 8) & 0xff);
+    out[2] = (uint8_t)state->step_index;
+    out[3] = (samples & 1) ? IMA_ADPCM_FLAG_ODD : 0;
+
+    uint8_t *dst = out + IMA_ADPCM_HEADER_BYTES;
+    for (size_t i = 0; i < samples; i += 2)
+    {
+        uint8_t lo = ima_adpcm_encode_sample(state, pcm[i]);
+        uint8_t hi = (i + 1 < samples) ? ima_adpcm_encode_sample(state, pcm[i + 1]) : 0;
+        *dst++ = (uint8_t)(lo | (hi << 4));
+    }
+    return dst - out;
+}
+
+size_t ima_adpcm_frame_samples(const uint8_t *frame, size_t frame_bytes)
+{
+    if (frame_bytes <= IMA_ADPCM_HEADER_BYTES)
+        return 0;
+    return (frame_bytes - IMA_ADPCM_HEADER_BYTES) * 2 - (frame[3] & IMA_ADPCM_FLAG_ODD);
+}
+
+size_t ima_adpcm_decode_frame(const uint8_t *frame, size_t frame_bytes, int16_t *pcm, size_t max_samples)
+{
+    if (frame_bytes < IMA_ADPCM_HEADER_BYTES || frame[2] > 88)
+        return 0;
+
+    ImaAdpcmState state;
+    state.predictor = (int16_t)(frame[0] | (frame[1] << 8));
+    state.step_index = frame[2];
+
+    size_t samples = ima_adpcm_frame_samples(frame, frame_bytes);
+    if (samples > max_samples)
+        samples = max_samples;
+
+    const uint8_t *data = frame + IMA_ADPCM_HEADER_BYTES;
+    ima_adpcm_decode_stream(&state, data, samples / 2, pcm);
+
+    // Odd limit: only the low nibble of the last byte is wanted
+    if (samples & 1)
+    {
+        pcm[samples - 1] = ima_adpcm_decode_sample(&state, data[samples / 2] & 15);
+    }
+    return samples;
+}
+
+size_t ima_adpcm_decode_stream(ImaAdpcmState *state, const uint8_t *data, size_t bytes, int16_t *pcm)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        pcm[2 * i] = ima_adpcm_decode_sample(state, data[i] & 15);
+        pcm[2 * i + 1] = ima_adpcm_decode_sample(state, data[i] >> 4);
+    }
+    return bytes * 2;
+}
@@ -0,0 +1,120 @@
+#include "kws_model.h"
+
+#include <cmath>
+#include <cstring>
+
+static uint16_t read_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static float read_f32(const uint8_t *p)
+{
+    uint32_t bits = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool KwsModel::load(const uint8_t *blob, size_t length)
+{
+    layer_count_ = 0;
+    if (blob == nullptr || length < 16 || ((uintptr_t)blob & 3) != 0 || memcmp(blob, "KWS1", 4) != 0)
+        return false;
+
+    frames_ = read_u16(blob + 4);
+    mel_bins_ = read_u16(blob + 6);
+    feature_scale_ = read_f32(blob + 8);
+    feature_zero_ = (int8_t)blob[12];
+    size_t count = blob[13];
+    if (count == 0 || count > KWS_MAX_LAYERS)
+        return false;
+
+    size_t offset = 16;
+    size_t expected_inputs = input_size();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (offset + 12 > length)
+            return false;
+
+        KwsLayer &layer = layers_[i];
+        layer.inputs = read_u16(blob + offset);
+        layer.outputs = read_u16(blob + offset + 2);
+        layer.requant = read_f32(blob + offset + 4);
+        layer.relu = blob[offset + 8] != 0;
+        offset += 12;
+
+        bool last = i == count - 1;
+        if (layer.inputs != expected_inputs || (last ? layer.outputs != 2 : layer.outputs > KWS_MAX_WIDTH))
+            return false;
+
+        size_t weight_bytes = ((size_t)layer.outputs * layer.inputs + 3) & ~(size_t)3;
+        if (offset + layer.outputs * sizeof(int32_t) + weight_bytes > length)
+            return false;
+
+        layer.bias = (const int32_t *)(blob + offset);
+        offset += layer.outputs * sizeof(int32_t);
+        layer.weights = (const int8_t *)(blob + offset);
+        offset += weight_bytes;
+        expected_inputs = layer.outputs;
+    }
+
+    layer_count_ = count;
+    return true;
+}
+
+int8_t KwsModel::quantize_feature(float log_mel) const
+{
+    int32_t q = (int32_t)lroundf(log_mel * feature_scale_) + feature_zero_;
+    return (int8_t)(q > 127 ? 127 : (q < -128 ? -128 : q));
+}
+
+float KwsModel::keyword_probability(const int8_t *features) const
+{
+    int8_t scratch[2][KWS_MAX_WIDTH];
+    const int8_t *input = features;
+    float logits[2] = {0.0f, 0.0f};
+
+    for (size_t l = 0; l < layer_count_; l++)
+    {
+        const KwsLayer &layer = layers_[l];
+        bool last = l == layer_count_ - 1;
+        int8_t *output = scratch[l & 1];
+
+        for (size_t o = 0; o < layer.outputs; o++)
+        {
+            const int8_t *w = layer.weights + (size_t)o * layer.inputs;
+            int32_t acc = layer.bias[o];
+            for (size_t i = 0; i < layer.inputs; i++)
+            {
+                acc += (int32_t)w[i] * input[i];
+            }
+
+            float value = acc * layer.requant;
+            if (last)
+            {
+                logits[o] = value;
+                continue;
+            }
+
+            if (layer.relu && value < 0.0f)
+                value = 0.0f;
+            int32_t q = (int32_t)lroundf(value);
+            output[o] = (int8_t)(q > 127 ? 127 : (q < -128 ? -128 : q));
+        }
+        input = output;
+    }
+
+    // Two-class softmax
+    return 1.0f / (1.0f + expf(logits[0] - logits[1]));
+}
+
+uint32_t KwsModel::macs() const
+{
+    uint32_t total = 0;
+    for (size_t l = 0; l < layer_count_; l++)
+    {
+        total += (uint32_t)layers_[l].inputs * layers_[l].outputs;
+    }
+    return total;
+}
@@ -0,0 +1,182 @@
+#include "log_mel.h"
+
+#include <cmath>
+#include <cstring>
+
+static float hz_to_mel(float hz)
+{
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float mel_to_hz(float mel)
+{
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+bool LogMelExtractor::init(uint32_t sample_rate, size_t hop_samples, float low_hz, float high_hz)
+{
+    if (hop_samples == 0 || hop_samples > LOG_MEL_FFT_SIZE || high_hz <= low_hz)
+        return false;
+
+    hop_ = hop_samples;
+    memset(history_, 0, sizeof(history_));
+
+    for (size_t i = 0; i < LOG_MEL_FFT_SIZE; i++)
+    {
+        window_[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / LOG_MEL_FFT_SIZE);
+    }
+
+    // Tables for the N/2-point complex FFT
+    const size_t n = LOG_MEL_FFT_SIZE / 2;
+    for (size_t i = 0; i < n / 2; i++)
+    {
+        twiddle_re_[i] = cosf(2.0f * (float)M_PI * i / n);
+        twiddle_im_[i] = -sinf(2.0f * (float)M_PI * i / n);
+    }
+    for (size_t k = 0; k < n; k++)
+    {
+        split_re_[k] = cosf(-2.0f * (float)M_PI * k / LOG_MEL_FFT_SIZE);
+        split_im_[k] = sinf(-2.0f * (float)M_PI * k / LOG_MEL_FFT_SIZE);
+    }
+
+    size_t bits = 0;
+    while ((1u << bits) < n)
+        bits++;
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t r = 0;
+        for (size_t b = 0; b < bits; b++)
+        {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse_[i] = (uint16_t)r;
+    }
+
+    // Triangular mel filters, edges evenly spaced on the mel scale
+    float mel_low = hz_to_mel(low_hz);
+    float mel_high = hz_to_mel(high_hz);
+    float bin_hz = (float)sample_rate / LOG_MEL_FFT_SIZE;
+    size_t offset = 0;
+
+    for (size_t b = 0; b < LOG_MEL_BINS; b++)
+    {
+        float left = mel_to_hz(mel_low + (mel_high - mel_low) * b / (LOG_MEL_BINS + 1)) / bin_hz;
+        float center = mel_to_hz(mel_low + (mel_high - mel_low) * (b + 1) / (LOG_MEL_BINS + 1)) / bin_hz;
+        float right = mel_to_hz(mel_low + (mel_high - mel_low) * (b + 2) / (LOG_MEL_BINS + 1)) / bin_hz;
+
+        size_t first = (size_t)ceilf(left);
+        size_t last = (size_t)floorf(right);
+        if (last >= LOG_MEL_SPECTRUM_BINS)
+            last = LOG_MEL_SPECTRUM_BINS - 1;
+        if (last < first)
+            last = first; // very narrow low bands still get one bin
+
+        if (offset + (last - first + 1) > sizeof(band_weights_) / sizeof(band_weights_[0]))
+            return false;
+
+        band_start_[b] = (uint16_t)first;
+        band_len_[b] = (uint16_t)(last - first + 1);
+        band_offset_[b] = (uint16_t)offset;
+
+        for (size_t k = first; k <= last; k++)
+        {
+            float w = k <= center ? (k - left) / (center - left) : (right - k) / (right - center);
+            band_weights_[offset++] = w > 0.0f ? w : 0.0f;
+        }
+    }
+
+    return true;
+}
+
+void LogMelExtractor::fft(float *re, float *im) const
+{
+    const size_t n = LOG_MEL_FFT_SIZE / 2;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t j = bit_reverse_[i];
+        if (j > i)
+        {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1)
+    {
+        size_t half = len >> 1;
+        size_t step = n / len;
+        for (size_t start = 0; start < n; start += len)
+        {
+            for (size_t k = 0; k < half; k++)
+            {
+                float wr = twiddle_re_[k * step];
+                float wi = twiddle_im_[k * step];
+                size_t a = start + k;
+                size_t b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void LogMelExtractor::push(const int16_t *hop, float *log_mel)
+{
+    const size_t n = LOG_MEL_FFT_SIZE / 2;
+
+    memmove(history_, history_ + hop_, (LOG_MEL_FFT_SIZE - hop_) * sizeof(float));
+    for (size_t i = 0; i < hop_; i++)
+    {
+        history_[LOG_MEL_FFT_SIZE - hop_ + i] = hop[i] * (1.0f / 32768.0f);
+    }
+
+    // Pack the real windowed frame into a half-size complex sequence (even -> re, odd -> im)
+    float re[LOG_MEL_FFT_SIZE / 2];
+    float im[LOG_MEL_FFT_SIZE / 2];
+    for (size_t i = 0; i < n; i++)
+    {
+        re[i] = history_[2 * i] * window_[2 * i];
+        im[i] = history_[2 * i + 1] * window_[2 * i + 1];
+    }
+    fft(re, im);
+
+    // Split into the spectrum of the real frame and take the power
+    float power[LOG_MEL_SPECTRUM_BINS];
+    power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    power[n] = (re[0] - im[0]) * (re[0] - im[0]);
+    for (size_t k = 1; k < n; k++)
+    {
+        float er = 0.5f * (re[k] + re[n - k]);
+        float ei = 0.5f * (im[k] - im[n - k]);
+        float or_ = 0.5f * (im[k] + im[n - k]);
+        float oi = -0.5f * (re[k] - re[n - k]);
+
+        // Twiddle e^{-j*2*pi*k/N} for the full-size transform
+        float wr = split_re_[k];
+        float wi = split_im_[k];
+        float xr = er + or_ * wr - oi * wi;
+        float xi = ei + or_ * wi + oi * wr;
+        power[k] = xr * xr + xi * xi;
+    }
+
+    for (size_t b = 0; b < LOG_MEL_BINS; b++)
+    {
+        const float *w = band_weights_ + band_offset_[b];
+        const float *p = power + band_start_[b];
+        float energy = 0.0f;
+        for (size_t k = 0; k < band_len_[b]; k++)
+        {
+            energy += w[k] * p[k];
+        }
+        log_mel[b] = logf(energy + 1e-6f);
+    }
+}
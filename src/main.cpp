@@ -1,16 +1,42 @@
 #include <Arduino.h>
 #include <WiFi.h>
+#include <Preferences.h>
 #include <WebSocketsClient.h>
 #include <ArduinoJson.h>
 #include <M5Unified.h>
+#include <SPIFFS.h>
+#include <SD.h>
 #include <esp_heap_caps.h>
+#include <atomic>
 #include <cstring>
 #include <memory>
 #include <cmath>
+#include "audio_capture.h"
+#include "vad.h"
+#include "segmented_buffer.h"
+#include "ima_adpcm.h"
+#include "audio_dsp.h"
+#include "wake_word.h"
+#include "audio_playback.h"
+#include "signal_stats.h"
+#include "tts_cache.h"
+#include "fs_cache_storage.h"
+#include "earcons.h"
+#include "wire_protocol.h"
+#include "downlink_reassembly.h"
+#include "uplink_stream.h"
 
 #define WIFI_SSID "WIFI_SSID"
 #define WIFI_PASS "PASSWORD"
 #define WIFI_MAXIMUM_RETRY 5
+#define WIFI_CONNECT_TIMEOUT_MS 10000 // report a failure; association keeps retrying in the background
+
+// Fast reconnect: try the last access point (and lease) that worked before scanning
+#define WIFI_FAST_CONNECT 1
+#define WIFI_REUSE_LEASE 0                // 1 skips DHCP with the cached address: only where the router reserves it
+                                          // for this device, since the lease is never renewed or checked for expiry
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000 // then fall back to a full scan and DHCP
+#define WIFI_PREFS_NAMESPACE "wifi"       // NVS namespace of the cached profile
 
 // WebSocket server configuration
 #define WS_HOST "DNS_OR_IP_ADDRESS" // Replace with your server address
@@ -19,6 +45,19 @@
 #define WS_PATH "/ws" // WebSocket endpoint
 // Test settings: #define WS_PORT 5174 and #define WS_PATH "/"
 
+// Server link upkeep: reconnects back off exponentially with jitter, and the idle link is pinged
+#define WS_RECONNECT_MIN_MS 250         // first retry after a drop
+#define WS_RECONNECT_MAX_MS 30000
+#define WS_HEARTBEAT_WHILE_READY 1      // a dead link is found and replaced before the next tap
+#define WS_HEARTBEAT_INTERVAL_MS 15000
+#define WS_HEARTBEAT_TIMEOUT_MS 3000
+#define WS_HEARTBEAT_MISSES 2
+
+// Audio bring-up runs in its own task at boot, so loop() can open the server link meanwhile
+#define PERIPHERALS_TASK_STACK 8192 // the wake word model loads in it
+#define PERIPHERALS_TASK_PRIORITY 1 // same as loopTask: they share the core while the handshake computes
+#define PERIPHERALS_TASK_CORE 1     // where the audio drivers (and their interrupts) have always been set up
+
 // Device states for MVP
 enum DeviceState
 {
@@ -40,13 +79,144 @@ bool websocket_connected = false;
 const char *ssid = WIFI_SSID;
 const char *password = WIFI_PASS;
 
+// Boot runs as a pipeline: Wi-Fi comes up in its own task, the audio peripherals
+// initialize in another, and loop() opens the server link (DNS, TCP, TLS and the
+// WebSocket upgrade) as soon as there is an address, without waiting for them
+enum BootPhase
+{
+    BOOT_WIFI_START,
+    BOOT_PERIPHERALS,      // display, mic, speaker, caches
+    BOOT_WIFI_ASSOCIATED,
+    BOOT_WIFI_GOT_IP,
+    BOOT_DNS,
+    BOOT_SERVER_CONNECTED, // TLS and WebSocket handshake done
+    BOOT_READY,            // server link and peripherals both up: the device is usable
+    BOOT_PHASE_COUNT
+};
+volatile uint32_t boot_phase_ms[BOOT_PHASE_COUNT]; // millis() when each phase finished, 0 = not yet
+volatile bool wifi_has_ip = false;                  // set by the Wi-Fi event task, acted on in loop()
+std::atomic<bool> peripherals_ready(false);         // set by the bring-up task once init_audio() is done
+bool peripherals_started = false;                   // loop() has finished what needs the main task (cache mount)
+bool wifi_failure_reported = false;
+
+// Last access point and lease that worked, kept in NVS
+struct WifiProfile
+{
+    char ssid[33]; // the profile only applies to this network
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+enum WifiAttempt
+{
+    WIFI_ATTEMPT_FAST, // directed at the cached BSSID and channel
+    WIFI_ATTEMPT_SCAN  // full scan and DHCP
+};
+
+WifiProfile wifi_profile;
+bool wifi_profile_valid = false;
+WifiProfile wifi_profile_unsaved; // differs from the stored one; written once the mic is idle
+bool wifi_profile_dirty = false;
+WifiAttempt wifi_attempt = WIFI_ATTEMPT_SCAN;
+unsigned long wifi_attempt_ms = 0;         // current attempt started
+unsigned long wifi_outage_ms = 0;          // without an address since
+volatile uint32_t wifi_associated_ms = 0;  // event task: current attempt associated, 0 = not yet
+volatile uint32_t wifi_got_ip_ms = 0;
+volatile bool wifi_attempt_failed = false; // event task: disconnected during the attempt
+bool websocket_initialized = false;
+
+// Server link reconnects
+uint32_t ws_backoff_ms = WS_RECONNECT_MIN_MS;  // ceiling of the next retry interval
+uint32_t ws_retry_interval_ms = WS_RECONNECT_MIN_MS;
+unsigned long ws_retry_window_ms = 0;         // current retry interval started
+unsigned long ws_link_down_ms = 0;            // without a server link since
+bool ws_heartbeat_on = false;
+
 // Audio configuration for MVP
 #define SAMPLE_RATE 16000
 #define BUFFER_SIZE 1024
 // Note: I2S configuration handled by M5Unified microphone API
 
-// WebSocket and audio buffer configuration
-#define AUDIO_CHUNK_SIZE 48000 // 3 seconds at 16kHz (was 4096 = 0.256s)
+// Recording buffer configuration: PSRAM blocks, length limited only by the budget
+#define RECORDING_BLOCK_SAMPLES 3200 // 200 ms per block, a whole number of capture and uplink frames
+#define RECORDING_BUDGET_MS 30000    // longest utterance we keep (960 KB of PSRAM)
+#define RECORDING_BUDGET_SAMPLES (SAMPLE_RATE / 1000 * RECORDING_BUDGET_MS)
+
+// Streaming uplink: send fixed-size frames while recording instead of one blob at stop
+#define UPLINK_STREAMING 1                                        // 0 = legacy single-blob upload
+#define UPLINK_FRAME_MS 40                                        // 20-100 ms per frame
+#define UPLINK_FRAME_SAMPLES (SAMPLE_RATE * UPLINK_FRAME_MS / 1000) // 640 samples at 16kHz
+
+// Downlink formats the device can decode; the server declares one in audio_start
+enum DownlinkFormat
+{
+    DOWNLINK_FORMAT_PCM16,
+    DOWNLINK_FORMAT_PCM8,     // unsigned 8-bit
+    DOWNLINK_FORMAT_IMA_ADPCM // headerless nibble stream, decoder state carried across chunks, mono only
+};
+
+// Pre-roll: keep listening in STATE_READY so speech started just before the tap is kept
+#define PREROLL_ENABLED 1
+#define PREROLL_MS 300 // must stay well below the capture ring (CAPTURE_RING_SAMPLES)
+#define PREROLL_SAMPLES (SAMPLE_RATE / 1000 * PREROLL_MS)
+
+// Front-end DSP run on every capture frame: DC removal, high-pass, AGC, soft limiter
+#define FRONTEND_DSP_ENABLED 1
+#define FRONTEND_HPF_HZ 100
+#define FRONTEND_AGC_TARGET 8000   // ~-12 dBFS envelope peak
+#define FRONTEND_AGC_GATE 150      // don't chase gain on background noise
+#define FRONTEND_AGC_MAX_GAIN 16   // on top of MIC_MAGNIFICATION
+#define FRONTEND_LIMITER_THRESHOLD 26000
+#if FRONTEND_DSP_ENABLED
+#define MIC_MAGNIFICATION 4 // leave headroom; AGC makes up the level
+#else
+#define MIC_MAGNIFICATION 16
+#endif
+
+// Wake word: hands-free start in STATE_READY; needs a model uploaded to SPIFFS (pio run -t uploadfs).
+// Off until a trained model ships; the one in test/test_wake_word only knows a synthetic keyword
+#define WAKE_WORD_ENABLED 0
+#define WAKE_WORD_MODEL_PATH "/kws_model.bin"
+#define WAKE_WORD_THRESHOLD 0.85f
+#define WAKE_WORD_CPU_BUDGET 25 // percent of one core
+
+// Streaming playback: start on the first chunks instead of waiting for audio_complete
+#define PLAYBACK_STREAMING 1
+#define PLAYBACK_DEFAULT_RATE 24000 // when audio_start doesn't say
+#define PLAYBACK_RESAMPLE 1         // convert streams to the speaker's native rate instead of letting it interpolate
+
+// Resumable downlink (binary framing only): gaps are asked for again instead of dropping the response
+#define DOWNLINK_HOLD_BYTES (64 * 1024)  // chunks that arrive past a gap wait here, in PSRAM
+#define DOWNLINK_RESUME_TIMEOUT_MS 10000 // how long a cut-off response waits for the link to come back
+#define DOWNLINK_RESEND_TIMEOUT_MS 3000  // ...and for a resend to make progress
+#define DOWNLINK_RESEND_ATTEMPTS 3
+#define DOWNLINK_RESEND_MAX_RANGES 16    // per request; any others are asked for next time
+
+// Playback speed: tapping the top-right corner steps through these (time-stretched, pitch kept)
+#define SPEED_ZONE_WIDTH 80
+#define SPEED_ZONE_HEIGHT 40
+
+// TTS cache: replay repeated responses from flash instead of downloading them again
+#define TTS_CACHE_ENABLED 1
+#define TTS_CACHE_USE_SD 1                     // 1 = SD card, 0 = SPIFFS partition (stores only while the mic is idle)
+#define TTS_CACHE_SPIFFS_BUDGET (320 * 1024)   // SPIFFS is 448 KB, shared with the wake word model
+#define TTS_CACHE_SD_BUDGET (16 * 1024 * 1024)
+#define TTS_CACHE_MAX_ENTRY_BYTES (192 * 1024) // longer responses aren't kept
+#define TTS_CACHE_IO_BYTES 4096                // flash I/O per loop() pass
+#define TTS_CACHE_SD_CS_PIN 4
+
+// Earcons (assets/earcons/*.wav, compiled in by scripts/gen_earcons.py)
+#define EARCON_LISTENING_CUE 1   // chime when recording starts; the capture it overlaps is dropped
+#define LISTENING_CUE_GUARD_MS 60 // speaker queue and DMA before the chime is heard, plus the room's decay
+
+// Voice activity detection: end the utterance automatically and trim silence
+#define VAD_ENABLED 1
+#define VAD_TRAILING_SILENCE_MS 800   // silence after speech that ends the utterance
+#define VAD_NO_SPEECH_TIMEOUT_MS 4000 // give up if no speech starts within this time
 
 // WebSocket client instance
 WebSocketsClient webSocket;
@@ -65,23 +235,109 @@ static const char *LCD_TAG = "lcd";
 void update_display(const char *message);
 void update_display_with_transcription(const char *status, const char *transcription);
 void handle_touch();
+void draw_speed_badge();
 void webSocketEvent(WStype_t type, uint8_t *payload, size_t length);
+void wifi_event(WiFiEvent_t event, WiFiEventInfo_t info);
+void service_wifi();
+void start_wifi_connect(bool fast);
+bool load_wifi_profile();
+void update_wifi_profile();
+void save_wifi_profile();
+bool mic_idle();
+void boot_mark(BootPhase phase);
+void log_boot_timeline();
 void handle_transcription_message(const char *json_string);
+void handle_wire_frame(const uint8_t *frame, size_t length);
+void on_transcription(const char *text, const char *response, const char *cache_id);
+void on_server_error(const char *message);
+void on_audio_start(size_t total_size, int chunks, int chunk_size, DownlinkFormat format, uint32_t sample_rate,
+                    uint8_t channels);
+void on_audio_chunk(const uint8_t *payload, size_t length);
+void on_audio_complete();
+void on_connection(const char *message, UplinkCodec codec, bool binary_framing);
+void begin_downlink_reassembly(uint32_t turn);
+void deliver_reassembled_audio(void *context, const uint8_t *data, size_t length);
+void on_sequenced_chunk(uint32_t turn, uint32_t offset, const uint8_t *data, size_t length);
+void on_sequenced_complete();
+void finish_sequenced_downlink();
+bool suspend_downlink();
+void abandon_downlink();
+void request_missing_audio();
+void service_downlink_resume();
 void init_websocket();
+void service_websocket_link();
+void schedule_websocket_retry();
 void send_audio_chunk(uint8_t *data, size_t length);
+void send_hello();
+void send_utterance_start();
+void send_utterance_end();
+void stream_pending_frames(bool flush);
+const int16_t *read_utterance_frame(void *context, size_t pos, size_t samples, int16_t *scratch);
+bool send_uplink_message(void *context, const uint8_t *data, size_t len);
+uint32_t read_cycle_count();
+void drain_captured_audio();
+void run_vad();
+void process_capture_frame(int16_t *frame, size_t samples);
+void init_wake_word();
+size_t utterance_send_limit(bool final);
 void start_recording();
 void stop_recording();
+void discard_recording();
 void init_audio();
+void bring_up_peripherals();
+void peripherals_task(void *param);
+bool start_peripherals();
 void set_state(DeviceState new_state);
 void play_audio_response(uint8_t *data, size_t length);
+void release_response_audio();
+void service_playback();
+void stop_streaming_playback();
+void begin_downlink_stream();
+void feed_stream_audio(const uint8_t *data, size_t length);
+void init_tts_cache();
+bool play_cached_response();
+void stage_for_cache(const uint8_t *data, size_t length);
+bool cache_writes_allowed();
+void service_tts_cache();
 void check_processing_timeout();
 void check_recording_timeout();
+void show_error(const char *status, const char *message, unsigned long duration_ms);
+void service_error_display();
 // void test_speaker_hardware();
 
 // Global variables for recording state
 bool is_recording = false;
-std::unique_ptr<int16_t[]> audio_buffer;
-size_t audio_buffer_pos = 0;
+SegmentedAudioBuffer audio_buffer;
+bool recording_buffer_exhausted = false;
+
+// Variables for streaming uplink
+bool uplink_streaming = UPLINK_STREAMING;
+UplinkStream uplink;       // frames of audio_buffer sent so far, by absolute position
+uint32_t utterance_id = 0; // incremented per utterance
+
+// Variables for uplink compression (negotiated per connection)
+UplinkCodec uplink_codec = UPLINK_CODEC_PCM16;
+
+// Binary framing (negotiated per connection; JSON text otherwise)
+bool wire_binary = false;
+uint8_t wire_tx[WIRE_HEADER_BYTES + 1 + DOWNLINK_RESEND_MAX_RANGES * 8]; // resend requests; utterance frames go through uplink
+uint32_t wire_rx_turn = 0;
+uint32_t wire_rx_seq = 0;    // next frame expected in wire_rx_turn
+bool wire_rx_synced = false; // a frame has arrived on this connection
+
+// Variables for pre-roll and tap latency instrumentation
+bool preroll_enabled = PREROLL_ENABLED;
+unsigned long tap_time_us = 0;     // when the tap that started this utterance was seen
+bool first_sample_logged = false;
+
+// Front-end DSP stages (state owned here, run in the capture task)
+DcBlocker frontend_dc;
+Biquad frontend_hpf;
+Agc frontend_agc;
+SoftLimiter frontend_limiter;
+DspChain frontend_dsp;
+volatile uint32_t frontend_dsp_cycles = 0; // accumulated since the utterance started
+volatile uint32_t frontend_dsp_frames = 0;
 
 // Variables for transcription and timeout handling
 String last_transcription = "";
@@ -89,17 +345,77 @@ String last_response = "";
 unsigned long processing_start_time = 0;
 const unsigned long PROCESSING_TIMEOUT = 30000; // 30 seconds timeout
 
+// A failed turn's error stays on screen until a deadline rather than blocking loop()
+bool error_display_pending = false;
+unsigned long error_display_start = 0;
+unsigned long error_display_ms = 0;
+
 // Variables for recording timeout
 unsigned long recording_start_time = 0;
-const unsigned long RECORDING_TIMEOUT = 5000; // 5 seconds max recording
+
+// Capture the listening cue can reach is dropped as it is drained, so neither the VAD
+// nor the server hears the chime: at this utterance position, this many samples
+size_t listening_cue_at = 0;
+size_t listening_cue_skip = 0;
+
+// Variables for voice activity detection
+bool vad_enabled = VAD_ENABLED;
+VoiceActivityDetector vad;
+size_t vad_pos = 0;               // samples of audio_buffer already classified
+bool vad_endpoint_reached = false; // set by the VAD, acted on in loop()
 
 // Variables for chunked audio reception
 bool receiving_chunked_audio = false;
 std::unique_ptr<uint8_t[]> chunked_audio_buffer;
-size_t expected_audio_size = 0;
-size_t received_audio_size = 0;
+size_t expected_audio_size = 0;  // bytes on the wire (encoded)
+size_t received_audio_size = 0;  // bytes on the wire (encoded)
+size_t decoded_audio_size = 0;   // PCM bytes in chunked_audio_buffer
+DownlinkFormat downlink_format = DOWNLINK_FORMAT_PCM16;
+uint32_t downlink_sample_rate = PLAYBACK_DEFAULT_RATE;
+uint8_t downlink_channels = 1;
+ImaAdpcmState downlink_adpcm_state;
+uint64_t downlink_decode_cycles = 0;
 int expected_chunks = 0;
 int received_chunks = 0;
+DownlinkReassembly downlink_reassembly;
+uint8_t *downlink_hold = nullptr;         // PSRAM, set aside on the first sequenced response
+bool downlink_sequenced = false;          // current response's chunks carry offsets
+uint32_t downlink_turn = 0;               // its response id, for resend requests
+bool downlink_interrupted = false;        // link lost mid-response; resume once it is back
+unsigned long downlink_interrupted_ms = 0;
+bool downlink_resend_pending = false;     // asked for missing ranges, waiting for audio_complete
+unsigned long downlink_resend_ms = 0;     // request sent, or last progress since
+uint32_t downlink_resend_attempts = 0;
+bool playback_streaming = PLAYBACK_STREAMING;
+bool streaming_response = false; // current response goes through the jitter buffer
+std::unique_ptr<uint8_t[]> response_audio; // buffered response the feeder task is playing from
+SignalStats response_signal;                // accumulated over the buffered response as chunks arrive
+const uint32_t playback_speeds[] = {100, 125, 150};
+size_t playback_speed_index = 0;
+uint32_t response_signal_cycles = 0;
+
+// TTS cache (keyed per response; misses are staged in PSRAM and written while ready)
+TtsCache tts_cache;
+bool tts_cache_ready = false;
+uint64_t response_cache_key = 0;
+bool response_cache_key_valid = false;
+bool response_from_cache = false;   // this turn plays from the cache
+bool skip_downlink_audio = false;   // ...so any audio the server still sends is dropped
+TtsAudioHeader cache_replay_header;
+size_t cache_replay_pos = 0;
+uint8_t *cache_staging = nullptr;   // wire bytes of the current response
+size_t cache_staged = 0;
+bool cache_staging_active = false;
+TtsAudioHeader cache_store_header;
+uint64_t cache_store_key = 0;
+size_t cache_store_pos = 0;
+bool cache_store_pending = false;
+
+// Loop latency while speaking (playback must not hold up the network)
+unsigned long speaking_loop_last_us = 0;
+unsigned long speaking_loop_max_us = 0;
+uint64_t speaking_loop_total_us = 0;
+uint32_t speaking_loop_count = 0;
 
 // MVP Implementation - Core Functions
 
@@ -107,6 +423,7 @@ int received_chunks = 0;
 void set_state(DeviceState new_state)
 {
     current_state = new_state;
+    error_display_pending = false; // any other state change ends a timed error
 
     switch (new_state)
     {
@@ -158,6 +475,8 @@ void update_display(const char *message)
 
     M5.Display.setCursor(x, y);
     M5.Display.print(message);
+
+    draw_speed_badge();
 }
 
 // Enhanced display function with transcription text
@@ -215,316 +534,1340 @@ void update_display_with_transcription(const char *status, const char *transcrip
     M5.Display.setTextSize(1);
     M5.Display.setCursor(10, M5.Display.height() - 30);
     M5.Display.print("Tap to speak");
+
+    draw_speed_badge();
 }
 
-// Handle JSON transcription messages from server
-void handle_transcription_message(const char *json_string)
+// Current playback speed in the top-right corner, which is also its touch zone
+void draw_speed_badge()
 {
-    LOG_INFO(WS_TAG, "Parsing JSON: %s", json_string);
+    uint32_t speed = playback_speeds[playback_speed_index];
+    char label[8];
+    snprintf(label, sizeof(label), "%u.%02ux", (unsigned)(speed / 100), (unsigned)(speed % 100));
 
-    // Parse JSON using ArduinoJson
-    StaticJsonDocument<1024> doc;
-    DeserializationError error = deserializeJson(doc, json_string);
+    M5.Display.fillRect(M5.Display.width() - SPEED_ZONE_WIDTH, 0, SPEED_ZONE_WIDTH, SPEED_ZONE_HEIGHT, TFT_BLACK);
+    M5.Display.setTextColor(speed == 100 ? TFT_DARKGREY : TFT_YELLOW);
+    M5.Display.setTextSize(2);
+    M5.Display.setCursor(M5.Display.width() - SPEED_ZONE_WIDTH + 8, 12);
+    M5.Display.print(label);
+}
 
-    if (error)
+// Transcription (and response text) for the current turn; may start a cached replay
+void on_transcription(const char *text, const char *response, const char *cache_id)
+{
+    if (text != nullptr)
     {
-        LOG_ERROR(WS_TAG, "JSON parsing failed: %s", error.c_str());
-        return;
+        last_transcription = String(text);
+        LOG_INFO(WS_TAG, "Transcription received: %s", text);
     }
 
-    // Check message type
-    const char *type = doc["type"];
-    if (type == nullptr)
+    if (response != nullptr)
     {
-        LOG_ERROR(WS_TAG, "No message type found in JSON");
-        return;
+        last_response = String(response);
+        LOG_INFO(WS_TAG, "Response text: %s", response);
     }
 
-    if (strcmp(type, "transcription") == 0)
+    // Cache key: the server's id for the audio if it gives one, else the response text
+    response_cache_key_valid = cache_id != nullptr || response != nullptr;
+    if (response_cache_key_valid)
     {
-        // Handle transcription message
-        const char *text = doc["text"];
-        const char *response = doc["response"];
+        response_cache_key = TtsCache::key_for(cache_id != nullptr ? cache_id : response);
+        if (play_cached_response())
+            return;
+    }
 
-        if (text != nullptr)
-        {
-            last_transcription = String(text);
-            LOG_INFO(WS_TAG, "Transcription received: %s", text);
-        }
+    // Update display with transcription
+    set_state(STATE_TRANSCRIBING);
+    update_display_with_transcription("Transcribed", last_transcription.c_str());
+}
 
-        if (response != nullptr)
-        {
-            last_response = String(response);
-            LOG_INFO(WS_TAG, "Response text: %s", response);
-        }
+void on_server_error(const char *message)
+{
+    LOG_ERROR(WS_TAG, "Server error: %s", message);
+    earcon_play(EARCON_ERROR);
+    show_error("Error", message, 3000);
+}
 
-        // Update display with transcription
-        set_state(STATE_TRANSCRIBING);
-        update_display_with_transcription("Transcribed", last_transcription.c_str());
-    }
-    else if (strcmp(type, "error") == 0)
+const char *downlink_format_name(DownlinkFormat format)
+{
+    switch (format)
     {
-        // Handle error message
-        const char *message = doc["message"];
-        if (message != nullptr)
-        {
-            LOG_ERROR(WS_TAG, "Server error: %s", message);
-            update_display_with_transcription("Error", message);
-            delay(3000); // Show error for 3 seconds
-            set_state(STATE_READY);
-        }
+    case DOWNLINK_FORMAT_PCM8:
+        return "pcm8";
+    case DOWNLINK_FORMAT_IMA_ADPCM:
+        return "ima_adpcm";
+    default:
+        return "pcm16";
     }
-    else if (strcmp(type, "audio_start") == 0)
-    {
-        // Handle chunked audio start
-        expected_audio_size = doc["totalSize"];
-        expected_chunks = doc["chunks"];
-        int chunk_size = doc["chunkSize"];
+}
 
-        LOG_INFO(WS_TAG, "Starting chunked audio reception: %u bytes, %d chunks, %d bytes/chunk",
-                 expected_audio_size, expected_chunks, chunk_size);
+// The server is about to send a response's audio in chunks
+void on_audio_start(size_t total_size, int chunks, int chunk_size, DownlinkFormat format, uint32_t sample_rate,
+                    uint8_t channels)
+{
+    expected_audio_size = total_size;
+    expected_chunks = chunks;
 
-        // Allocate buffer for full audio
-        chunked_audio_buffer.reset(new uint8_t[expected_audio_size]);
+    if (skip_downlink_audio)
+    {
+        // Already playing this response from the cache; let the server's copy go by
+        LOG_INFO(WS_TAG, "Ignoring %u bytes of server audio, playing from cache", expected_audio_size);
         received_audio_size = 0;
         received_chunks = 0;
         receiving_chunked_audio = true;
+        return;
+    }
 
-        update_display_with_transcription("Receiving Audio", "Downloading chunks...");
+    downlink_format = format;
+    downlink_sample_rate = sample_rate;
+    if (downlink_sample_rate < 8000 || downlink_sample_rate > 48000)
+    {
+        LOG_ERROR(WS_TAG, "Unsupported sample rate %u, assuming %d", downlink_sample_rate, PLAYBACK_DEFAULT_RATE);
+        downlink_sample_rate = PLAYBACK_DEFAULT_RATE;
     }
-    else if (strcmp(type, "audio_complete") == 0)
+    downlink_channels = channels;
+    if (downlink_channels != 2 || downlink_format == DOWNLINK_FORMAT_IMA_ADPCM)
+        downlink_channels = 1;
+
+    LOG_INFO(WS_TAG, "Starting chunked audio reception: %u bytes, %d chunks, %d bytes/chunk, format %s, %u Hz, %u ch",
+             expected_audio_size, expected_chunks, chunk_size, downlink_format_name(downlink_format),
+             downlink_sample_rate, downlink_channels);
+
+    ima_adpcm_reset(&downlink_adpcm_state);
+
+    // Keep the wire bytes so the response can be cached once it is complete
+    cache_staging_active = tts_cache_ready && response_cache_key_valid && !cache_store_pending &&
+                           expected_audio_size <= TTS_CACHE_MAX_ENTRY_BYTES;
+    cache_staged = 0;
+    if (cache_staging_active)
     {
-        // Handle chunked audio completion
-        LOG_INFO(WS_TAG, "Chunked audio reception complete: %u bytes, %d chunks",
-                 received_audio_size, received_chunks);
+        cache_store_header.format = downlink_format;
+        cache_store_header.channels = downlink_channels;
+        cache_store_header.reserved = 0;
+        cache_store_header.sample_rate = downlink_sample_rate;
+    }
 
-        if (receiving_chunked_audio && received_audio_size == expected_audio_size)
-        {
-            // Debug: Check first few bytes of reassembled audio
-            LOG_INFO(WS_TAG, "First 8 bytes of reassembled audio: %02x %02x %02x %02x %02x %02x %02x %02x",
-                     chunked_audio_buffer[0], chunked_audio_buffer[1], chunked_audio_buffer[2], chunked_audio_buffer[3],
-                     chunked_audio_buffer[4], chunked_audio_buffer[5], chunked_audio_buffer[6], chunked_audio_buffer[7]);
+    // Short responses are error beeps; they keep the buffered path and its checks.
+    // That path holds 16-bit PCM, so ADPCM expands 4:1 and 8-bit 2:1.
+    size_t pcm_size = expected_audio_size;
+    if (downlink_format == DOWNLINK_FORMAT_IMA_ADPCM)
+        pcm_size = expected_audio_size * 4;
+    else if (downlink_format == DOWNLINK_FORMAT_PCM8)
+        pcm_size = expected_audio_size * 2;
+    streaming_response = playback_streaming && pcm_size >= 1000;
+    if (streaming_response)
+    {
+        begin_downlink_stream();
+        set_state(STATE_SPEAKING);
+        update_display_with_transcription("Speaking", last_response.c_str());
+    }
+    else
+    {
+        // Allocate buffer for the full decoded audio
+        chunked_audio_buffer.reset(new uint8_t[pcm_size]);
+    }
+    downlink_decode_cycles = 0;
+    decoded_audio_size = 0;
+    received_audio_size = 0;
+    signal_stats_reset(&response_signal);
+    response_signal_cycles = 0;
+    received_chunks = 0;
+    receiving_chunked_audio = true;
+
+    if (!streaming_response)
+    {
+        update_display_with_transcription("Receiving Audio", "Downloading chunks...");
+    }
+}
 
-            // Comprehensive debugging
-            LOG_INFO(WS_TAG, "CHUNK DEBUG: Expected %u bytes, received %u bytes, chunks %d/%d",
-                     expected_audio_size, received_audio_size, received_chunks, expected_chunks);
+// The server has sent all of the response's audio
+void on_audio_complete()
+{
+    LOG_INFO(WS_TAG, "Chunked audio reception complete: %u bytes, %d chunks",
+             received_audio_size, received_chunks);
 
-            // Play the reassembled audio
-            LOG_INFO(WS_TAG, "Playing reassembled audio: %u bytes", received_audio_size);
-            set_state(STATE_SPEAKING);
-            play_audio_response(chunked_audio_buffer.get(), received_audio_size);
-        }
-        else
+    if (skip_downlink_audio)
+    {
+        receiving_chunked_audio = false;
+        skip_downlink_audio = false;
+        return;
+    }
+
+    // Complete responses are written to the cache a piece at a time once we're idle
+    if (cache_staging_active && received_audio_size == expected_audio_size && cache_staged == expected_audio_size)
+    {
+        cache_store_header.data_bytes = cache_staged;
+        cache_store_key = response_cache_key;
+        cache_store_pos = 0;
+        cache_store_pending = true;
+    }
+    cache_staging_active = false;
+
+    if (receiving_chunked_audio && streaming_response)
+    {
+        // Already playing; let the jitter buffer drain what is left
+        if (received_audio_size != expected_audio_size)
         {
             LOG_ERROR(WS_TAG, "Audio chunk mismatch: received %u bytes, expected %u bytes",
                       received_audio_size, expected_audio_size);
-            update_display_with_transcription("Audio Error", "Incomplete audio received");
-            delay(2000);
-            set_state(STATE_READY);
         }
-
-        // Reset chunked audio state
-        receiving_chunked_audio = false;
-        chunked_audio_buffer.reset();
+        playback_stream_end();
     }
-    else if (strcmp(type, "connection") == 0)
+    else if (receiving_chunked_audio && received_audio_size == expected_audio_size)
     {
-        // Handle connection confirmation
-        const char *message = doc["message"];
-        if (message != nullptr)
+        if (downlink_format == DOWNLINK_FORMAT_IMA_ADPCM && decoded_audio_size > 0)
         {
-            LOG_INFO(WS_TAG, "Connection message: %s", message);
+            LOG_INFO(WS_TAG, "IMA-ADPCM decode: %u bytes -> %u PCM bytes, %u cycles/sample",
+                     received_audio_size, decoded_audio_size,
+                     (unsigned)(downlink_decode_cycles / (decoded_audio_size / sizeof(int16_t))));
         }
+
+        // Play the reassembled audio
+        LOG_INFO(WS_TAG, "Playing reassembled audio: %u bytes", decoded_audio_size);
+        set_state(STATE_SPEAKING);
+        release_response_audio();
+        response_audio = std::move(chunked_audio_buffer);
+        play_audio_response(response_audio.get(), decoded_audio_size);
     }
     else
     {
-        LOG_INFO(WS_TAG, "Unknown message type: %s", type);
+        LOG_ERROR(WS_TAG, "Audio chunk mismatch: received %u bytes, expected %u bytes",
+                  received_audio_size, expected_audio_size);
+        show_error("Audio Error", "Incomplete audio received", 2000);
     }
+
+    // Reset chunked audio state
+    receiving_chunked_audio = false;
+    chunked_audio_buffer.reset();
 }
 
-// Touch detection
-void handle_touch()
+// Connection confirmation; servers that understand our hello answer with the
+// uplink codec and, if they speak it, binary framing
+void on_connection(const char *message, UplinkCodec codec, bool binary_framing)
 {
-    M5.update();
-
-    if (M5.Touch.getCount() > 0)
+    if (message != nullptr)
     {
-        auto touchDetail = M5.Touch.getDetail();
-        LOG_INFO(TAG, "Touch detected at (%d, %d)", touchDetail.x, touchDetail.y);
+        LOG_INFO(WS_TAG, "Connection message: %s", message);
+    }
 
-        // Visual feedback for touch
-        M5.Display.fillCircle(touchDetail.x, touchDetail.y, 10, TFT_RED);
-        delay(100); // Brief visual feedback
+    uplink_codec = codec;
+    wire_binary = binary_framing;
+    LOG_INFO(WS_TAG, "Uplink codec: %s, framing: %s", uplink_codec == UPLINK_CODEC_IMA_ADPCM ? "ima_adpcm" : "pcm16",
+             wire_binary ? "binary" : "json");
 
-        if (current_state == STATE_READY)
-        {
-            LOG_INFO(TAG, "Starting recording from touch");
-            start_recording();
-        }
-        else if (current_state == STATE_LISTENING)
-        {
-            LOG_INFO(TAG, "Stopping recording from touch");
-            stop_recording();
-        }
-        else if (current_state == STATE_ERROR)
-        {
-            LOG_INFO(TAG, "Retrying connection from touch");
-            // Retry connection
-            if (!websocket_connected)
-            {
-                init_websocket();
-            }
-            else
-            {
-                set_state(STATE_READY);
-            }
-        }
-        else if (current_state == STATE_TRANSCRIBING)
-        {
-            LOG_INFO(TAG, "Currently transcribing, ignoring touch");
-            update_display_with_transcription("Transcribing...", "Please wait");
-        }
-        else if (current_state == STATE_SPEAKING)
-        {
-            LOG_INFO(TAG, "Currently playing audio, ignoring touch");
-            update_display_with_transcription("Playing Audio", "Please wait for completion");
-        }
-        else if (current_state == STATE_PROCESSING)
+    // Pick up a response the lost link cut off
+    if (downlink_interrupted)
+    {
+        downlink_interrupted = false;
+        if (wire_binary)
         {
-            LOG_INFO(TAG, "Currently processing, ignoring touch");
-            update_display("Processing... Please wait");
+            downlink_resend_attempts = 0;
+            request_missing_audio();
+            if (streaming_response)
+                update_display_with_transcription("Speaking", last_response.c_str());
         }
-
-        // Wait for touch release to avoid multiple triggers
-        while (M5.Touch.getCount() > 0)
+        else
         {
-            M5.update();
-            delay(50);
+            LOG_ERROR(WS_TAG, "Server no longer offers binary framing, can't resume response %u", downlink_turn);
+            abandon_downlink();
+            set_state(STATE_READY);
         }
-        delay(100); // Additional debounce
     }
 }
 
-// WebSocket event handler
-void webSocketEvent(WStype_t type, uint8_t *payload, size_t length)
+// One chunk of the response audio announced by audio_start
+void on_audio_chunk(const uint8_t *payload, size_t length)
 {
-    switch (type)
+    if (!receiving_chunked_audio)
     {
-    case WStype_DISCONNECTED:
-        LOG_ERROR(WS_TAG, "WebSocket Disconnected - length: %u, heap free: %u bytes", length, ESP.getFreeHeap());
-        websocket_connected = false;
-        set_state(STATE_ERROR);
-        break;
-    case WStype_ERROR:
-        LOG_ERROR(WS_TAG, "WebSocket Error (length: %u): %s, heap free: %u bytes", length, payload, ESP.getFreeHeap());
-        websocket_connected = false;
-        set_state(STATE_ERROR);
-        break;
-    case WStype_CONNECTED:
-        LOG_INFO(WS_TAG, "WebSocket Connected to: %s", payload);
-        websocket_connected = true;
-        set_state(STATE_READY);
-        break;
-    case WStype_TEXT:
-        LOG_INFO(WS_TAG, "Received text: %s", payload);
-        // Handle JSON messages (transcription, errors, etc.)
-        handle_transcription_message((const char *)payload);
-        break;
-    case WStype_BIN:
-        LOG_INFO(WS_TAG, "Received binary data: %u bytes, heap before: %u bytes", length, ESP.getFreeHeap());
+        LOG_ERROR(WS_TAG, "Audio chunk outside a response: %u bytes", length);
+        return;
+    }
 
-        if (receiving_chunked_audio)
+    if (skip_downlink_audio)
+    {
+        received_audio_size += length;
+        received_chunks++;
+        return;
+    }
+
+    if (received_audio_size + length <= expected_audio_size)
+    {
+        stage_for_cache(payload, length);
+    }
+
+    if (received_audio_size + length <= expected_audio_size && streaming_response)
+    {
+        // Straight into the jitter buffer; playback starts at the low-water mark
+        playback_stream_note_chunk();
+        feed_stream_audio(payload, length);
+        received_audio_size += length;
+        received_chunks++;
+    }
+    else if (received_audio_size + length <= expected_audio_size)
+    {
+        if (downlink_format == DOWNLINK_FORMAT_IMA_ADPCM)
         {
-            // This is a chunk of the audio stream
-            if (received_audio_size + length <= expected_audio_size)
-            {
-                memcpy(chunked_audio_buffer.get() + received_audio_size, payload, length);
-                received_audio_size += length;
-                received_chunks++;
-
-                LOG_INFO(WS_TAG, "Received chunk %d/%d: %u bytes (total: %u/%u bytes)",
-                         received_chunks, expected_chunks, length, received_audio_size, expected_audio_size);
-
-                // Update progress display
-                int progress = (received_audio_size * 100) / expected_audio_size;
-                char progress_text[50];
-                snprintf(progress_text, sizeof(progress_text), "Progress: %d%% (%d/%d chunks)",
-                         progress, received_chunks, expected_chunks);
-                update_display_with_transcription("Receiving Audio", progress_text);
-            }
-            else
+            // Decode as it arrives so nothing is left to do at audio_complete
+            uint32_t cycles_start = ESP.getCycleCount();
+            size_t samples = ima_adpcm_decode_stream(&downlink_adpcm_state, payload, length,
+                                                     (int16_t *)(chunked_audio_buffer.get() + decoded_audio_size));
+            downlink_decode_cycles += ESP.getCycleCount() - cycles_start;
+            decoded_audio_size += samples * sizeof(int16_t);
+        }
+        else if (downlink_format == DOWNLINK_FORMAT_PCM8)
+        {
+            // Widen to 16-bit as it arrives; the speaker gets one sample format
+            int16_t *dst = (int16_t *)(chunked_audio_buffer.get() + decoded_audio_size);
+            for (size_t i = 0; i < length; i++)
             {
-                LOG_ERROR(WS_TAG, "Audio chunk overflow: would exceed expected size");
+                dst[i] = (int16_t)((payload[i] - 128) * 256);
             }
+            decoded_audio_size += length * sizeof(int16_t);
         }
         else
         {
-            // Legacy: single large audio message (fallback)
-            LOG_INFO(WS_TAG, "Received complete audio: %u bytes", length);
-            set_state(STATE_SPEAKING);
-            play_audio_response(payload, length);
+            memcpy(chunked_audio_buffer.get() + received_audio_size, payload, length);
+            decoded_audio_size += length;
         }
 
-        LOG_INFO(WS_TAG, "Binary data processed, heap after: %u bytes", ESP.getFreeHeap());
-        break;
-    default:
-        break;
+        // Account for the whole samples that just landed (a chunk may end mid-sample)
+        uint32_t stats_start = ESP.getCycleCount();
+        size_t whole_samples = decoded_audio_size / sizeof(int16_t);
+        signal_stats_update(&response_signal, (const int16_t *)chunked_audio_buffer.get() + response_signal.samples,
+                            whole_samples - response_signal.samples);
+        response_signal_cycles += ESP.getCycleCount() - stats_start;
+        received_audio_size += length;
+        received_chunks++;
+
+        LOG_INFO(WS_TAG, "Received chunk %d/%d: %u bytes (total: %u/%u bytes)",
+                 received_chunks, expected_chunks, length, received_audio_size, expected_audio_size);
+
+        // Update progress display
+        int progress = (received_audio_size * 100) / expected_audio_size;
+        char progress_text[50];
+        snprintf(progress_text, sizeof(progress_text), "Progress: %d%% (%d/%d chunks)",
+                 progress, received_chunks, expected_chunks);
+        update_display_with_transcription("Receiving Audio", progress_text);
     }
-}
-
-// Initialize WebSocket connection
-void init_websocket()
-{
-    LOG_INFO(WS_TAG, "Initializing WebSocket connection...");
-    LOG_INFO(WS_TAG, "Connecting to: wss://%s:%d%s", WS_HOST, WS_PORT, WS_PATH);
-    set_state(STATE_CONNECTING_SERVER);
-
-    // webSocket.begin(WS_HOST, WS_PORT, WS_PATH);
-    webSocket.beginSSL(WS_HOST, WS_PORT, WS_PATH);
-    webSocket.onEvent(webSocketEvent);
-    webSocket.setReconnectInterval(5000);
-    // Disable heartbeat for now
-    // webSocket.enableHeartbeat(15000, 3000, 2);
-}
-
-// Send audio chunk via WebSocket
-void send_audio_chunk(uint8_t *data, size_t length)
-{
-    if (websocket_connected)
+    else
     {
-        webSocket.sendBIN(data, length);
-        LOG_INFO(WS_TAG, "Sent audio chunk: %d bytes", length);
+        LOG_ERROR(WS_TAG, "Audio chunk overflow: would exceed expected size");
     }
 }
 
-// Initialize audio system
-void init_audio()
+// Handle JSON control messages from the server
+void handle_transcription_message(const char *json_string)
 {
-    LOG_INFO(AUDIO_TAG, "Initializing audio system...");
-
-    // Try to use M5Unified microphone first
-    auto mic_cfg = M5.Mic.config();
-    mic_cfg.sample_rate = SAMPLE_RATE;
-    mic_cfg.over_sampling = 1;
-    mic_cfg.magnification = 16;
-    mic_cfg.use_adc = false;
+    LOG_INFO(WS_TAG, "Parsing JSON: %s", json_string);
 
-    M5.Mic.config(mic_cfg);
-    LOG_INFO(AUDIO_TAG, "M5Unified microphone configured");
+    // Parse JSON using ArduinoJson
+    StaticJsonDocument<1024> doc;
+    DeserializationError error = deserializeJson(doc, json_string);
 
-    if (M5.Mic.begin())
+    if (error)
     {
-        LOG_INFO(AUDIO_TAG, "M5 Microphone started successfully");
+        LOG_ERROR(WS_TAG, "JSON parsing failed: %s", error.c_str());
+        return;
     }
-    else
+
+    // Check message type
+    const char *type = doc["type"];
+    if (type == nullptr)
     {
-        LOG_ERROR(AUDIO_TAG, "Failed to start M5 microphone");
+        LOG_ERROR(WS_TAG, "No message type found in JSON");
+        return;
     }
 
-    // Allocate audio buffer
-    audio_buffer.reset(new int16_t[AUDIO_CHUNK_SIZE]);
-
-    LOG_INFO(AUDIO_TAG, "Audio system initialized");
+    if (strcmp(type, "transcription") == 0)
+    {
+        on_transcription(doc["text"], doc["response"], doc["cacheId"]);
+    }
+    else if (strcmp(type, "error") == 0)
+    {
+        const char *message = doc["message"];
+        if (message != nullptr)
+            on_server_error(message);
+    }
+    else if (strcmp(type, "audio_start") == 0)
+    {
+        const char *format = doc["format"] | "pcm16";
+        DownlinkFormat downlink = DOWNLINK_FORMAT_PCM16;
+        if (strcmp(format, "ima_adpcm") == 0)
+            downlink = DOWNLINK_FORMAT_IMA_ADPCM;
+        else if (strcmp(format, "pcm8") == 0)
+            downlink = DOWNLINK_FORMAT_PCM8;
+
+        on_audio_start(doc["totalSize"], doc["chunks"], doc["chunkSize"], downlink,
+                       doc["sampleRate"] | PLAYBACK_DEFAULT_RATE, doc["channels"] | 1);
+    }
+    else if (strcmp(type, "audio_complete") == 0)
+    {
+        on_audio_complete();
+    }
+    else if (strcmp(type, "connection") == 0)
+    {
+        const char *codec = doc["uplinkCodec"];
+        const char *framing = doc["framing"];
+        on_connection(doc["message"], codec != nullptr && strcmp(codec, "ima_adpcm") == 0 ? UPLINK_CODEC_IMA_ADPCM : UPLINK_CODEC_PCM16,
+                      wire_framing_accepted(framing, doc["framingVersion"] | 0));
+    }
+    else
+    {
+        LOG_INFO(WS_TAG, "Unknown message type: %s", type);
+    }
+}
+
+// Handle a binary frame from a server that accepted binary framing
+void handle_wire_frame(const uint8_t *frame, size_t length)
+{
+    WireHeader header;
+    const uint8_t *payload;
+    WireStatus status = wire_parse(frame, length, &header, &payload);
+    if (status != WIRE_OK)
+    {
+        LOG_ERROR(WS_TAG, "Dropped %u-byte frame: %s", length, wire_status_name(status));
+        return;
+    }
+
+    // Frames of a turn arrive in order over the one connection; a jump means the server skipped some
+    if (wire_rx_synced && header.turn == wire_rx_turn && header.seq != wire_rx_seq)
+    {
+        LOG_ERROR(WS_TAG, "Frame sequence jump in turn %u: expected %u, got %u", header.turn, wire_rx_seq, header.seq);
+    }
+    wire_rx_turn = header.turn;
+    wire_rx_seq = header.seq + 1;
+    wire_rx_synced = true;
+
+    WireReader r;
+    wire_reader_init(&r, payload, header.length);
+    switch (header.type)
+    {
+    case WIRE_AUDIO_CHUNK:
+    {
+        uint32_t offset = wire_get_u32(&r);
+        if (r.ok)
+            on_sequenced_chunk(header.turn, offset, payload + r.pos, header.length - r.pos);
+        break;
+    }
+    case WIRE_TRANSCRIPTION:
+    {
+        const char *text = wire_get_str(&r);
+        const char *response = wire_get_str(&r);
+        const char *cache_id = wire_get_str(&r);
+        if (r.ok)
+            on_transcription(text, response, cache_id[0] != 0 ? cache_id : nullptr);
+        break;
+    }
+    case WIRE_ERROR:
+    {
+        const char *message = wire_get_str(&r);
+        if (r.ok)
+            on_server_error(message);
+        break;
+    }
+    case WIRE_AUDIO_START:
+    {
+        uint8_t format = wire_get_u8(&r);
+        uint8_t channels = wire_get_u8(&r);
+        uint32_t sample_rate = wire_get_u32(&r);
+        uint32_t total_size = wire_get_u32(&r);
+        uint32_t chunks = wire_get_u32(&r);
+        uint32_t chunk_size = wire_get_u32(&r);
+        if (r.ok)
+        {
+            on_audio_start(total_size, chunks, chunk_size,
+                           format <= DOWNLINK_FORMAT_IMA_ADPCM ? (DownlinkFormat)format : DOWNLINK_FORMAT_PCM16,
+                           sample_rate, channels);
+            begin_downlink_reassembly(header.turn);
+        }
+        break;
+    }
+    case WIRE_AUDIO_COMPLETE:
+        on_sequenced_complete();
+        return;
+    case WIRE_CONNECTION:
+    {
+        uint8_t codec = wire_get_u8(&r);
+        const char *message = wire_get_str(&r);
+        if (r.ok)
+            on_connection(message, codec == UPLINK_CODEC_IMA_ADPCM ? UPLINK_CODEC_IMA_ADPCM : UPLINK_CODEC_PCM16, true);
+        break;
+    }
+    default:
+        LOG_INFO(WS_TAG, "Unknown frame type %u", header.type);
+        return;
+    }
+
+    if (!r.ok)
+    {
+        LOG_ERROR(WS_TAG, "Malformed payload in frame type %u (%u bytes)", header.type, header.length);
+    }
+}
+
+// Chunks of a binary-framed response say where they belong; put them back in order from here
+void begin_downlink_reassembly(uint32_t turn)
+{
+    if (downlink_hold == nullptr)
+    {
+        downlink_hold = (uint8_t *)heap_caps_malloc(DOWNLINK_HOLD_BYTES, MALLOC_CAP_SPIRAM);
+        if (downlink_hold == nullptr)
+        {
+            LOG_ERROR(WS_TAG, "No memory for the downlink hold window, chunks past a gap will be requested again");
+        }
+    }
+
+    downlink_reassembly.begin(expected_audio_size, downlink_hold, DOWNLINK_HOLD_BYTES, deliver_reassembled_audio, nullptr);
+    downlink_sequenced = true;
+    downlink_turn = turn;
+    downlink_interrupted = false;
+    downlink_resend_pending = false;
+    downlink_resend_attempts = 0;
+}
+
+// Reassembled response audio, in order and each byte once
+void deliver_reassembled_audio(void *context, const uint8_t *data, size_t length)
+{
+    on_audio_chunk(data, length);
+}
+
+// One chunk of a binary-framed response; gaps, duplicates and resent ranges are sorted out here
+void on_sequenced_chunk(uint32_t turn, uint32_t offset, const uint8_t *data, size_t length)
+{
+    if (!downlink_sequenced || turn != downlink_turn)
+    {
+        LOG_ERROR(WS_TAG, "Audio chunk outside a response: turn %u, offset %u, %u bytes", turn, offset, length);
+        return;
+    }
+
+    uint32_t before = downlink_reassembly.delivered();
+    switch (downlink_reassembly.accept(offset, data, length))
+    {
+    case REASSEMBLY_HELD:
+        LOG_ERROR(WS_TAG, "Gap in response %u: chunk at byte %u held, missing from byte %u", turn, offset, before);
+        break;
+    case REASSEMBLY_DROPPED:
+        LOG_ERROR(WS_TAG, "Gap in response %u: chunk at byte %u is past the hold window, dropped", turn, offset);
+        break;
+    case REASSEMBLY_DUPLICATE:
+        LOG_INFO(WS_TAG, "Duplicate chunk at byte %u (%u bytes) ignored", offset, length);
+        break;
+    default:
+        break;
+    }
+
+    // A resend that is still arriving hasn't timed out
+    if (downlink_resend_pending && downlink_reassembly.delivered() != before)
+        downlink_resend_ms = millis();
+}
+
+// audio_complete of a binary-framed response: finish it, or first ask for what is still missing
+void on_sequenced_complete()
+{
+    if (!downlink_sequenced)
+    {
+        LOG_ERROR(WS_TAG, "Audio complete outside a response");
+        return;
+    }
+
+    if (downlink_reassembly.complete() || skip_downlink_audio)
+    {
+        finish_sequenced_downlink();
+    }
+    else if (downlink_resend_attempts < DOWNLINK_RESEND_ATTEMPTS)
+    {
+        request_missing_audio();
+    }
+    else
+    {
+        LOG_ERROR(WS_TAG, "Response %u still incomplete after %u resend requests", downlink_turn, downlink_resend_attempts);
+        finish_sequenced_downlink();
+    }
+}
+
+// Done with a sequenced response, whole or not; the usual audio_complete handling takes it from here
+void finish_sequenced_downlink()
+{
+    const ReassemblyStats &rs = downlink_reassembly.stats();
+    LOG_INFO(WS_TAG, "Response %u reassembled: %u/%u bytes; chunks %u in order, %u held, %u duplicate, %u dropped; %u resend requests",
+             downlink_turn, downlink_reassembly.delivered(), downlink_reassembly.total(), rs.delivered, rs.held,
+             rs.duplicates, rs.dropped, downlink_resend_attempts);
+    downlink_sequenced = false;
+    downlink_interrupted = false;
+    downlink_resend_pending = false;
+    on_audio_complete();
+}
+
+// Ask the server again for the parts of the current response we don't have
+void request_missing_audio()
+{
+    ByteRange ranges[DOWNLINK_RESEND_MAX_RANGES];
+    size_t count = downlink_reassembly.missing(ranges, DOWNLINK_RESEND_MAX_RANGES);
+
+    WireWriter w;
+    wire_writer_init(&w, wire_tx + WIRE_HEADER_BYTES, sizeof(wire_tx) - WIRE_HEADER_BYTES);
+    wire_put_u8(&w, (uint8_t)count);
+    uint32_t missing_bytes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        wire_put_u32(&w, ranges[i].offset);
+        wire_put_u32(&w, ranges[i].length);
+        missing_bytes += ranges[i].length;
+    }
+
+    // Sent in the response's turn, numbered by attempt
+    size_t len = wire_finish(wire_tx, WIRE_AUDIO_RESEND, downlink_turn, downlink_resend_attempts, w.len);
+    bool sent = websocket_connected && webSocket.sendBIN(wire_tx, len);
+    LOG_INFO(WS_TAG, "Requested %u missing bytes of response %u in %u ranges, from byte %u%s", missing_bytes,
+             downlink_turn, count, count > 0 ? ranges[0].offset : 0, sent ? "" : " (send failed)");
+
+    downlink_resend_attempts++;
+    downlink_resend_pending = true;
+    downlink_resend_ms = millis();
+}
+
+// The link dropped mid-response: keep what arrived so it can be resumed; false if there is nothing to keep
+bool suspend_downlink()
+{
+    if (!downlink_sequenced || skip_downlink_audio)
+        return false;
+
+    if (!downlink_interrupted)
+    {
+        LOG_INFO(WS_TAG, "Link lost at byte %u of %u of response %u, holding it for %d ms",
+                 downlink_reassembly.delivered(), downlink_reassembly.total(), downlink_turn, DOWNLINK_RESUME_TIMEOUT_MS);
+        downlink_interrupted = true;
+        downlink_interrupted_ms = millis();
+        update_display_with_transcription("Reconnecting", "Response paused");
+    }
+    downlink_resend_pending = false; // asked again once the link is back
+    return true;
+}
+
+// A cut-off response that won't be resumed: drop it, as a lost link always did
+void abandon_downlink()
+{
+    stop_streaming_playback();
+    receiving_chunked_audio = false;
+    chunked_audio_buffer.reset();
+    cache_staging_active = false;
+    downlink_sequenced = false;
+    downlink_interrupted = false;
+    downlink_resend_pending = false;
+}
+
+// Give up on a cut-off response whose link, or whose resend, doesn't come back in time
+void service_downlink_resume()
+{
+    if (downlink_interrupted && millis() - downlink_interrupted_ms > DOWNLINK_RESUME_TIMEOUT_MS)
+    {
+        LOG_ERROR(WS_TAG, "No reconnect within %d ms, dropping response %u", DOWNLINK_RESUME_TIMEOUT_MS, downlink_turn);
+        abandon_downlink();
+        set_state(websocket_connected ? STATE_READY : STATE_ERROR);
+    }
+    else if (downlink_resend_pending && millis() - downlink_resend_ms > DOWNLINK_RESEND_TIMEOUT_MS)
+    {
+        LOG_ERROR(WS_TAG, "Resend of response %u timed out at byte %u of %u", downlink_turn,
+                  downlink_reassembly.delivered(), downlink_reassembly.total());
+        finish_sequenced_downlink();
+    }
+}
+
+// Touch detection
+void handle_touch()
+{
+    M5.update();
+
+    if (M5.Touch.getCount() > 0)
+    {
+        auto touchDetail = M5.Touch.getDetail();
+        LOG_INFO(TAG, "Touch detected at (%d, %d)", touchDetail.x, touchDetail.y);
+
+        // Visual feedback for touch
+        M5.Display.fillCircle(touchDetail.x, touchDetail.y, 10, TFT_RED);
+        delay(100); // Brief visual feedback
+
+        if (touchDetail.x >= M5.Display.width() - SPEED_ZONE_WIDTH && touchDetail.y < SPEED_ZONE_HEIGHT)
+        {
+            // Speed zone works in any state; a response already playing follows from its next chunk
+            playback_speed_index = (playback_speed_index + 1) % (sizeof(playback_speeds) / sizeof(playback_speeds[0]));
+            playback_set_speed(playback_speeds[playback_speed_index]);
+            LOG_INFO(TAG, "Playback speed %u%%", (unsigned)playback_speed());
+            draw_speed_badge();
+        }
+        else if (current_state == STATE_READY)
+        {
+            LOG_INFO(TAG, "Starting recording from touch");
+            tap_time_us = micros();
+            start_recording();
+        }
+        else if (current_state == STATE_LISTENING)
+        {
+            LOG_INFO(TAG, "Stopping recording from touch");
+            stop_recording();
+        }
+        else if (current_state == STATE_ERROR)
+        {
+            LOG_INFO(TAG, "Retrying connection from touch");
+            // Retry connection
+            if (!websocket_connected)
+            {
+                init_websocket();
+            }
+            else
+            {
+                set_state(STATE_READY);
+            }
+        }
+        else if (current_state == STATE_TRANSCRIBING)
+        {
+            LOG_INFO(TAG, "Currently transcribing, ignoring touch");
+            update_display_with_transcription("Transcribing...", "Please wait");
+        }
+        else if (current_state == STATE_SPEAKING)
+        {
+            LOG_INFO(TAG, "Currently playing audio, ignoring touch");
+            update_display_with_transcription("Playing Audio", "Please wait for completion");
+        }
+        else if (current_state == STATE_PROCESSING)
+        {
+            LOG_INFO(TAG, "Currently processing, ignoring touch");
+            update_display("Processing... Please wait");
+        }
+
+        // Wait for touch release to avoid multiple triggers
+        while (M5.Touch.getCount() > 0)
+        {
+            M5.update();
+            delay(50);
+        }
+        delay(100); // Additional debounce
+    }
+}
+
+// WebSocket event handler
+void webSocketEvent(WStype_t type, uint8_t *payload, size_t length)
+{
+    switch (type)
+    {
+    case WStype_DISCONNECTED:
+        LOG_ERROR(WS_TAG, "WebSocket Disconnected - length: %u, heap free: %u bytes", length, ESP.getFreeHeap());
+        if (websocket_connected)
+        {
+            if (peripherals_started)
+                earcon_play(EARCON_NO_CONNECTION); // once per lost connection, not per retry
+            ws_link_down_ms = millis();
+            ws_backoff_ms = WS_RECONNECT_MIN_MS; // a link that was up is retried right away
+            schedule_websocket_retry();
+        }
+        websocket_connected = false;
+        if (!suspend_downlink())
+        {
+            stop_streaming_playback();
+            set_state(STATE_ERROR);
+        }
+        break;
+    case WStype_ERROR:
+        LOG_ERROR(WS_TAG, "WebSocket Error (length: %u): %s, heap free: %u bytes", length, payload, ESP.getFreeHeap());
+        websocket_connected = false;
+        if (!suspend_downlink())
+        {
+            stop_streaming_playback();
+            set_state(STATE_ERROR);
+        }
+        break;
+    case WStype_CONNECTED:
+        LOG_INFO(WS_TAG, "WebSocket Connected to: %s", payload);
+        LOG_INFO(WS_TAG, "Server link up after %lu ms without it", millis() - ws_link_down_ms);
+        websocket_connected = true;
+        ws_backoff_ms = WS_RECONNECT_MIN_MS;
+        schedule_websocket_retry();
+        boot_mark(BOOT_SERVER_CONNECTED);
+        if (peripherals_started && boot_phase_ms[BOOT_READY] == 0)
+        {
+            boot_mark(BOOT_READY);
+            log_boot_timeline();
+        }
+        uplink_codec = UPLINK_CODEC_PCM16; // until the server picks one
+        wire_binary = false;               // likewise
+        wire_rx_synced = false;
+        send_hello();
+        // A cut-off response resumes once the server answers the hello; during boot start_peripherals() switches
+        if (!downlink_interrupted && peripherals_started)
+            set_state(STATE_READY);
+        break;
+    case WStype_TEXT:
+        LOG_INFO(WS_TAG, "Received text: %s", payload);
+        // Handle JSON messages (transcription, errors, etc.)
+        handle_transcription_message((const char *)payload);
+        break;
+    case WStype_BIN:
+        LOG_INFO(WS_TAG, "Received binary data: %u bytes, heap before: %u bytes", length, ESP.getFreeHeap());
+
+        if (wire_binary)
+        {
+            handle_wire_frame(payload, length);
+        }
+        else if (receiving_chunked_audio)
+        {
+            on_audio_chunk(payload, length);
+        }
+        else
+        {
+            // Legacy: single large audio message (fallback). The frame is gone once we
+            // return, so keep an aligned copy for the feeder to play from
+            LOG_INFO(WS_TAG, "Received complete audio: %u bytes", length);
+            release_response_audio();
+            response_audio.reset(new (std::nothrow) uint8_t[length]);
+            if (response_audio)
+            {
+                memcpy(response_audio.get(), payload, length);
+                signal_stats_reset(&response_signal);
+                uint32_t stats_start = ESP.getCycleCount();
+                signal_stats_update(&response_signal, (const int16_t *)response_audio.get(), length / sizeof(int16_t));
+                response_signal_cycles = ESP.getCycleCount() - stats_start;
+                set_state(STATE_SPEAKING);
+                play_audio_response(response_audio.get(), length);
+            }
+            else
+            {
+                LOG_ERROR(WS_TAG, "No memory to hold %u-byte response", length);
+            }
+        }
+
+        LOG_INFO(WS_TAG, "Binary data processed, heap after: %u bytes", ESP.getFreeHeap());
+        break;
+    default:
+        break;
+    }
+}
+
+// Runs in the Wi-Fi event task: only note what happened
+void wifi_event(WiFiEvent_t event, WiFiEventInfo_t info)
+{
+    switch (event)
+    {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+        boot_mark(BOOT_WIFI_ASSOCIATED);
+        wifi_associated_ms = millis();
+        break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+        boot_mark(BOOT_WIFI_GOT_IP);
+        wifi_got_ip_ms = millis();
+        wifi_has_ip = true;
+        break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+        // start_wifi_connect() disconnects before each attempt; that event arrives after the
+        // attempt has started and isn't its failure
+        if (info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE)
+            wifi_attempt_failed = true;
+        wifi_has_ip = false;
+        break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+        wifi_has_ip = false;
+        break;
+    default:
+        break;
+    }
+}
+
+// Follow Wi-Fi from loop(): open the server link as soon as there is an address, and reconnect
+void service_wifi()
+{
+    if (wifi_has_ip && !wifi_connected)
+    {
+        wifi_connected = true;
+        wifi_failure_reported = false;
+        uint32_t associated = wifi_associated_ms;
+        bool fast = wifi_attempt == WIFI_ATTEMPT_FAST;
+        LOG_INFO(TAG, "WiFi connected (%s): associated in %lu ms, address %lu ms later (%s), %lu ms without WiFi",
+                 fast ? "cached access point" : "scan", associated != 0 ? associated - wifi_attempt_ms : 0,
+                 associated != 0 ? wifi_got_ip_ms - associated : 0, fast && WIFI_REUSE_LEASE ? "cached lease" : "DHCP",
+                 wifi_got_ip_ms - wifi_outage_ms);
+        LOG_INFO(TAG, "WiFi: %s, gateway %s, DNS %s, channel %d, rssi %d", WiFi.localIP().toString().c_str(),
+                 WiFi.gatewayIP().toString().c_str(), WiFi.dnsIP().toString().c_str(), WiFi.channel(), WiFi.RSSI());
+        update_wifi_profile();
+        if (websocket_initialized)
+        {
+            // The client reconnects on its own; don't leave it waiting out a backoff grown while Wi-Fi was down
+            ws_backoff_ms = WS_RECONNECT_MIN_MS;
+            schedule_websocket_retry();
+            return;
+        }
+
+        // Resolve here so the lookup is timed on its own; the client's lookup then hits the lwIP cache
+        IPAddress server_ip;
+        if (WiFi.hostByName(WS_HOST, server_ip))
+        {
+            boot_mark(BOOT_DNS);
+            LOG_INFO(TAG, "Resolved %s to %s", WS_HOST, server_ip.toString().c_str());
+        }
+        else
+        {
+            LOG_ERROR(TAG, "DNS lookup for %s failed, the client will retry", WS_HOST);
+        }
+        init_websocket();
+        return;
+    }
+
+    if (!wifi_has_ip && wifi_connected)
+    {
+        wifi_connected = false;
+        wifi_outage_ms = millis();
+        LOG_ERROR(TAG, "WiFi connection lost, reconnecting");
+        start_wifi_connect(wifi_profile_valid);
+        return;
+    }
+
+    if (wifi_connected)
+    {
+        if (wifi_profile_dirty && mic_idle())
+            save_wifi_profile();
+        return;
+    }
+
+    // Auto-reconnect is off, so a stalled attempt is retried here
+    unsigned long elapsed = millis() - wifi_attempt_ms;
+    if (wifi_attempt == WIFI_ATTEMPT_FAST && (wifi_attempt_failed || elapsed > WIFI_FAST_CONNECT_TIMEOUT_MS))
+    {
+        LOG_ERROR(TAG, "Cached access point not reached after %lu ms, scanning", elapsed);
+        start_wifi_connect(false);
+    }
+    else if (wifi_attempt == WIFI_ATTEMPT_SCAN && elapsed > WIFI_CONNECT_TIMEOUT_MS)
+    {
+        LOG_ERROR(TAG, "WiFi scan connect timed out after %lu ms, retrying", elapsed);
+        start_wifi_connect(false);
+    }
+
+    if (!wifi_failure_reported && peripherals_started && millis() - wifi_outage_ms > WIFI_CONNECT_TIMEOUT_MS)
+    {
+        LOG_ERROR(TAG, "WiFi connection failed");
+        earcon_play(EARCON_NO_CONNECTION);
+        set_state(STATE_ERROR);
+        wifi_failure_reported = true;
+    }
+}
+
+// Directed connect to the cached access point (and lease), or a full scan with DHCP
+void start_wifi_connect(bool fast)
+{
+    WiFi.disconnect();
+    wifi_associated_ms = 0;
+    wifi_attempt_failed = false;
+    wifi_attempt_ms = millis();
+
+    if (fast)
+    {
+#if WIFI_REUSE_LEASE
+        WiFi.config(IPAddress(wifi_profile.ip), IPAddress(wifi_profile.gateway), IPAddress(wifi_profile.subnet),
+                    IPAddress(wifi_profile.dns));
+#endif
+        WiFi.begin(ssid, password, wifi_profile.channel, wifi_profile.bssid);
+        wifi_attempt = WIFI_ATTEMPT_FAST;
+    }
+    else
+    {
+        WiFi.config(IPAddress(), IPAddress(), IPAddress()); // back to DHCP
+        WiFi.begin(ssid, password);
+        wifi_attempt = WIFI_ATTEMPT_SCAN;
+    }
+}
+
+// Cached profile for this SSID, if there is one
+bool load_wifi_profile()
+{
+#if WIFI_FAST_CONNECT
+    Preferences prefs;
+    if (!prefs.begin(WIFI_PREFS_NAMESPACE, true))
+        return false;
+
+    bool valid = prefs.getBytes("profile", &wifi_profile, sizeof(wifi_profile)) == sizeof(wifi_profile) &&
+                 strncmp(wifi_profile.ssid, ssid, sizeof(wifi_profile.ssid)) == 0 && wifi_profile.channel != 0;
+    prefs.end();
+    if (valid)
+    {
+        LOG_INFO(TAG, "Cached access point %02x:%02x:%02x:%02x:%02x:%02x on channel %u",
+                 wifi_profile.bssid[0], wifi_profile.bssid[1], wifi_profile.bssid[2], wifi_profile.bssid[3],
+                 wifi_profile.bssid[4], wifi_profile.bssid[5], wifi_profile.channel);
+    }
+    return valid;
+#else
+    return false;
+#endif
+}
+
+// Remember the access point and lease just connected with; flash is only written when they
+// change, and not until save_wifi_profile() finds the mic idle
+void update_wifi_profile()
+{
+#if WIFI_FAST_CONNECT
+    WifiProfile profile;
+    memset(&profile, 0, sizeof(profile)); // padding too, for the compare
+    strncpy(profile.ssid, ssid, sizeof(profile.ssid) - 1);
+    const uint8_t *bssid = WiFi.BSSID();
+    if (bssid == nullptr)
+        return;
+    memcpy(profile.bssid, bssid, sizeof(profile.bssid));
+    profile.channel = WiFi.channel();
+    profile.ip = WiFi.localIP();
+    profile.gateway = WiFi.gatewayIP();
+    profile.subnet = WiFi.subnetMask();
+    profile.dns = WiFi.dnsIP();
+
+    wifi_profile_dirty = !wifi_profile_valid || memcmp(&profile, &wifi_profile, sizeof(profile)) != 0;
+    wifi_profile_unsaved = profile;
+#endif
+}
+
+// An NVS write stalls the flash cache on both cores like a SPIFFS one (see
+// cache_writes_allowed()), so service_wifi() only calls this with the mic idle
+void save_wifi_profile()
+{
+#if WIFI_FAST_CONNECT
+    const WifiProfile &profile = wifi_profile_unsaved;
+    Preferences prefs;
+    if (prefs.begin(WIFI_PREFS_NAMESPACE, false) && prefs.putBytes("profile", &profile, sizeof(profile)) == sizeof(profile))
+    {
+        wifi_profile = profile;
+        wifi_profile_valid = true;
+        LOG_INFO(TAG, "Saved WiFi profile: channel %u, %s", profile.channel, IPAddress(profile.ip).toString().c_str());
+    }
+    else
+    {
+        LOG_ERROR(TAG, "Failed to save WiFi profile");
+    }
+    prefs.end();
+    wifi_profile_dirty = false;
+#endif
+}
+
+// First time a boot phase finishes
+void boot_mark(BootPhase phase)
+{
+    if (boot_phase_ms[phase] == 0)
+        boot_phase_ms[phase] = millis();
+}
+
+void log_boot_timeline()
+{
+    static const char *names[BOOT_PHASE_COUNT] = {"wifi start", "peripherals", "associated", "ip", "dns", "server", "ready"};
+    char line[160];
+    size_t len = 0;
+    for (int i = 0; i < BOOT_PHASE_COUNT && len < sizeof(line); i++)
+    {
+        if (boot_phase_ms[i] != 0)
+            len += snprintf(line + len, sizeof(line) - len, "%s%s %u", i > 0 ? ", " : "", names[i], boot_phase_ms[i]);
+        else
+            len += snprintf(line + len, sizeof(line) - len, "%s%s -", i > 0 ? ", " : "", names[i]);
+    }
+    LOG_INFO(TAG, "Boot timeline (ms since power-up): %s", line);
+}
+
+// Initialize WebSocket connection
+void init_websocket()
+{
+    LOG_INFO(WS_TAG, "Initializing WebSocket connection...");
+    LOG_INFO(WS_TAG, "Connecting to: wss://%s:%d%s", WS_HOST, WS_PORT, WS_PATH);
+    set_state(STATE_CONNECTING_SERVER);
+    websocket_initialized = true;
+
+    // webSocket.begin(WS_HOST, WS_PORT, WS_PATH);
+    // Every connect is a full TLS handshake: the client makes a new WiFiClientSecure per attempt,
+    // and that has no way to keep an mbedtls session for resumption (what it would save is
+    // measured by scripts/measure_tls_resumption.py)
+    webSocket.beginSSL(WS_HOST, WS_PORT, WS_PATH);
+    webSocket.onEvent(webSocketEvent);
+    ws_backoff_ms = WS_RECONNECT_MIN_MS;
+    schedule_websocket_retry();
+    ws_link_down_ms = millis();
+    // Heartbeat is switched on and off with STATE_READY (see service_websocket_link())
+}
+
+// Keep the server link up: widen the retry interval while it stays down, and ping it while idle
+void service_websocket_link()
+{
+    if (!websocket_initialized)
+        return;
+
+#if WS_HEARTBEAT_WHILE_READY
+    // Only between turns, so pings never queue behind audio
+    bool heartbeat = websocket_connected && current_state == STATE_READY;
+    if (heartbeat != ws_heartbeat_on)
+    {
+        if (heartbeat)
+            webSocket.enableHeartbeat(WS_HEARTBEAT_INTERVAL_MS, WS_HEARTBEAT_TIMEOUT_MS, WS_HEARTBEAT_MISSES);
+        else
+            webSocket.disableHeartbeat();
+        ws_heartbeat_on = heartbeat;
+    }
+#endif
+
+    // The client retries once per interval; once one has passed, the next try waits longer
+    if (!websocket_connected && millis() - ws_retry_window_ms > ws_retry_interval_ms)
+        schedule_websocket_retry();
+}
+
+// Next retry interval: half the ceiling plus a random part of the other half, so devices that
+// lost the server together don't all come back at once; the ceiling doubles up to the maximum
+void schedule_websocket_retry()
+{
+    ws_retry_interval_ms = ws_backoff_ms / 2 + random(ws_backoff_ms / 2 + 1);
+    webSocket.setReconnectInterval(ws_retry_interval_ms);
+    ws_retry_window_ms = millis();
+    ws_backoff_ms = ws_backoff_ms < WS_RECONNECT_MAX_MS / 2 ? ws_backoff_ms * 2 : WS_RECONNECT_MAX_MS;
+}
+
+// Send audio chunk via WebSocket
+void send_audio_chunk(uint8_t *data, size_t length)
+{
+    if (websocket_connected)
+    {
+        webSocket.sendBIN(data, length);
+        LOG_INFO(WS_TAG, "Sent audio chunk: %d bytes", length);
+    }
+}
+
+// Send a JSON control message via WebSocket
+template <size_t N>
+void send_control_message(const StaticJsonDocument<N> &doc)
+{
+    if (!websocket_connected)
+        return;
+
+    char json[256];
+    size_t len = serializeJson(doc, json, sizeof(json));
+    webSocket.sendTXT(json, len);
+    LOG_INFO(WS_TAG, "Sent control: %s", json);
+}
+
+// Offer our capabilities; older servers ignore this and we stay on PCM
+void send_hello()
+{
+    StaticJsonDocument<256> doc;
+    doc["type"] = "hello";
+    JsonArray codecs = doc.createNestedArray("uplinkCodecs");
+    codecs.add("pcm16");
+    codecs.add("ima_adpcm");
+    JsonArray formats = doc.createNestedArray("downlinkFormats");
+    formats.add("pcm16");
+    formats.add("pcm8");
+    formats.add("ima_adpcm");
+    doc["outputRate"] = M5.Speaker.config().sample_rate; // servers may pick it to skip conversion
+    doc["ttsCache"] = tts_cache_ready;                   // we answer cached responses with audio_cached
+    doc["framing"] = "binary";                           // accepted with framing/framingVersion in connection
+    doc["framingVersion"] = WIRE_VERSION;
+    send_control_message(doc);
+}
+
+// Uplink stream source: frames normally sit inside one block; copy only when one straddles a boundary
+const int16_t *read_utterance_frame(void *context, size_t pos, size_t samples, int16_t *scratch)
+{
+    const int16_t *frame;
+    if (audio_buffer.read_span(pos, &frame) < samples)
+    {
+        audio_buffer.copy_out(pos, scratch, samples);
+        frame = scratch;
+    }
+    return frame;
+}
+
+// Uplink stream sink; no per-frame logging here: Serial at 115200 would cost more than the send itself
+bool send_uplink_message(void *context, const uint8_t *data, size_t len)
+{
+    return websocket_connected && webSocket.sendBIN((uint8_t *)data, len);
+}
+
+uint32_t read_cycle_count()
+{
+    return ESP.getCycleCount();
+}
+
+// Announce a streamed utterance so the server can start recognition on the first frame
+void send_utterance_start()
+{
+    uplink.begin(utterance_id, uplink_codec, wire_binary); // the binary announcement goes out here
+    if (wire_binary)
+        return;
+
+    StaticJsonDocument<256> doc;
+    doc["type"] = "utterance_start";
+    doc["id"] = utterance_id;
+    doc["sampleRate"] = SAMPLE_RATE;
+    doc["format"] = uplink_codec == UPLINK_CODEC_IMA_ADPCM ? "ima_adpcm" : "pcm16";
+    doc["frameMs"] = UPLINK_FRAME_MS;
+    send_control_message(doc);
+}
+
+// Mark the end of a streamed utterance; frame/sample totals let the server verify it got everything
+void send_utterance_end()
+{
+    if (wire_binary)
+    {
+        uplink.end();
+        return;
+    }
+
+    StaticJsonDocument<256> doc;
+    doc["type"] = "utterance_end";
+    doc["id"] = utterance_id;
+    doc["frames"] = uplink.frames_sent();
+    doc["samples"] = uplink.samples_sent();
+    send_control_message(doc);
+}
+
+// Last sample that may be sent: with VAD, silence that might still be trimmed is held back
+size_t utterance_send_limit(bool final)
+{
+    if (!vad_enabled)
+        return audio_buffer.size();
+
+    if (final)
+        return vad.trim_end(audio_buffer.size()); // whole buffer if no speech was detected
+
+    return vad.confirmed_end(audio_buffer.size());
+}
+
+// Send every complete frame recorded since the last call (and the partial tail when flushing)
+void stream_pending_frames(bool flush)
+{
+    uplink.pump(utterance_send_limit(flush), flush);
+}
+
+// Capture-task hook: run the front-end chain in place on each frame, then hand it to the wake word detector
+void process_capture_frame(int16_t *frame, size_t samples)
+{
+#if FRONTEND_DSP_ENABLED
+    uint32_t cycles_start = ESP.getCycleCount();
+    frontend_dsp.process(frame, samples);
+    frontend_dsp_cycles += ESP.getCycleCount() - cycles_start;
+    frontend_dsp_frames++;
+#endif
+    wake_word_feed(frame, samples);
+}
+
+// Load the keyword model from SPIFFS and start the detector; without a model we stay tap-to-talk
+void init_wake_word()
+{
+    if (!SPIFFS.begin(false))
+    {
+        LOG_ERROR(AUDIO_TAG, "SPIFFS mount failed, wake word disabled");
+        return;
+    }
+
+    File model_file = SPIFFS.open(WAKE_WORD_MODEL_PATH, FILE_READ);
+    if (!model_file)
+    {
+        LOG_INFO(AUDIO_TAG, "No wake word model at %s, tap to speak only", WAKE_WORD_MODEL_PATH);
+        return;
+    }
+
+    // The detector keeps pointers into the blob, so it stays allocated for the life of the program
+    size_t model_size = model_file.size();
+    uint8_t *model = (uint8_t *)heap_caps_malloc(model_size, MALLOC_CAP_SPIRAM);
+    bool read_ok = model != nullptr && model_file.read(model, model_size) == model_size;
+    model_file.close();
+
+    if (read_ok && wake_word_begin(model, model_size, SAMPLE_RATE, WAKE_WORD_THRESHOLD, WAKE_WORD_CPU_BUDGET))
+    {
+        LOG_INFO(AUDIO_TAG, "Wake word detector started (%u-byte model, %d%% CPU budget)",
+                 (unsigned)model_size, WAKE_WORD_CPU_BUDGET);
+    }
+    else
+    {
+        LOG_ERROR(AUDIO_TAG, "Invalid wake word model %s, wake word disabled", WAKE_WORD_MODEL_PATH);
+        heap_caps_free(model);
+    }
+}
+
+// Initialize audio system
+void init_audio()
+{
+    LOG_INFO(AUDIO_TAG, "Initializing audio system...");
+
+    // Try to use M5Unified microphone first
+    auto mic_cfg = M5.Mic.config();
+    mic_cfg.sample_rate = SAMPLE_RATE;
+    mic_cfg.over_sampling = 1;
+    mic_cfg.magnification = MIC_MAGNIFICATION;
+    mic_cfg.use_adc = false;
+
+    M5.Mic.config(mic_cfg);
+    LOG_INFO(AUDIO_TAG, "M5Unified microphone configured");
+
+    if (M5.Mic.begin())
+    {
+        LOG_INFO(AUDIO_TAG, "M5 Microphone started successfully");
+    }
+    else
+    {
+        LOG_ERROR(AUDIO_TAG, "Failed to start M5 microphone");
+    }
+
+    // Recording buffer grows in PSRAM blocks as the utterance does
+    if (audio_buffer.init(RECORDING_BLOCK_SAMPLES, RECORDING_BUDGET_SAMPLES))
+    {
+        LOG_INFO(AUDIO_TAG, "Recording buffer: %d-sample PSRAM blocks, budget %d ms",
+                 RECORDING_BLOCK_SAMPLES, RECORDING_BUDGET_MS);
+    }
+    else
+    {
+        LOG_ERROR(AUDIO_TAG, "Failed to set up recording buffer");
+    }
+
+    // Streamed utterances are cut into frames straight out of the recording buffer
+    uplink.init(SAMPLE_RATE, UPLINK_FRAME_SAMPLES, read_utterance_frame, send_uplink_message, nullptr);
+    uplink.set_cycle_counter(read_cycle_count);
+
+    VadConfig vad_cfg = vad_default_config(SAMPLE_RATE, CAPTURE_FRAME_SAMPLES);
+    vad_cfg.trailing_silence_ms = VAD_TRAILING_SILENCE_MS;
+    vad.init(vad_cfg);
+
+#if FRONTEND_DSP_ENABLED
+    // Condition every frame before VAD and upload
+    dc_blocker_init(&frontend_dc, SAMPLE_RATE, 10);
+    biquad_init_highpass(&frontend_hpf, SAMPLE_RATE, FRONTEND_HPF_HZ, 0.707f);
+    agc_init(&frontend_agc, SAMPLE_RATE, FRONTEND_AGC_TARGET, FRONTEND_AGC_GATE, 2, 300,
+             FRONTEND_AGC_MAX_GAIN * 4096 - 1);
+    soft_limiter_init(&frontend_limiter, FRONTEND_LIMITER_THRESHOLD);
+    frontend_dsp.add(dc_blocker_process, &frontend_dc);
+    frontend_dsp.add(biquad_process, &frontend_hpf);
+    frontend_dsp.add(agc_process, &frontend_agc);
+    frontend_dsp.add(soft_limiter_process, &frontend_limiter);
+    LOG_INFO(AUDIO_TAG, "Front-end DSP: %u stages", (unsigned)frontend_dsp.size());
+#endif
+
+#if WAKE_WORD_ENABLED
+    init_wake_word();
+#endif
+    audio_capture_set_frame_hook(process_capture_frame);
+
+    // Jitter buffer for streaming TTS playback
+    if (!playback_begin())
+    {
+        LOG_ERROR(AUDIO_TAG, "Failed to allocate playback ring, streaming playback disabled");
+        playback_streaming = false;
+    }
+    if (!earcons_begin())
+    {
+        LOG_ERROR(AUDIO_TAG, "Failed to decode earcons");
+    }
+#if PLAYBACK_RESAMPLE
+    playback_set_output_rate(M5.Speaker.config().sample_rate);
+    LOG_INFO(AUDIO_TAG, "Speaker native rate %u Hz", M5.Speaker.config().sample_rate);
+#endif
+
+    // Capture runs in its own pinned task so loop() stalls don't drop mic frames
+    if (audio_capture_begin(SAMPLE_RATE))
+    {
+        LOG_INFO(AUDIO_TAG, "Capture task started (%d-sample frames, %d-sample ring)",
+                 CAPTURE_FRAME_SAMPLES, CAPTURE_RING_SAMPLES);
+    }
+    else
+    {
+        LOG_ERROR(AUDIO_TAG, "Failed to start capture task");
+    }
+
+    LOG_INFO(AUDIO_TAG, "Audio system initialized");
 }
 
 // Start recording audio
@@ -536,14 +1879,131 @@ void start_recording()
     LOG_INFO(AUDIO_TAG, "Starting recording...");
     set_state(STATE_LISTENING);
     is_recording = true;
-    audio_buffer_pos = 0;
+    audio_buffer.clear();
+    recording_buffer_exhausted = false;
     recording_start_time = millis(); // Start recording timeout timer
 
+    vad.reset();
+    vad_pos = 0;
+    vad_endpoint_reached = false;
+
+    // Keep the last PREROLL_MS captured while ready (or nothing) as the start of the utterance
+    audio_capture_retain(preroll_enabled ? PREROLL_SAMPLES : 0);
+    audio_capture_set_active(true);
+    first_sample_logged = false;
+    frontend_dsp_cycles = 0;
+    frontend_dsp_frames = 0;
+    response_cache_key_valid = false;
+    skip_downlink_audio = false;
+    listening_cue_skip = 0;
+#if EARCON_LISTENING_CUE
+    // Everything after the retained pre-roll was captured after the tap, so the chime
+    // starts no earlier than that; the pre-roll itself is kept
+    earcon_play(EARCON_LISTENING);
+    listening_cue_at = audio_capture_available();
+    listening_cue_skip = (size_t)(earcon_duration_ms(EARCON_LISTENING) + LISTENING_CUE_GUARD_MS) * SAMPLE_RATE / 1000;
+#endif
+
+    if (uplink_streaming)
+    {
+        utterance_id++;
+        send_utterance_start();
+    }
+
     // Visual feedback for recording start
     update_display_with_transcription("RECORDING", "Speak now... Tap again to stop");
 
-    // Add a red recording indicator
-    M5.Display.fillCircle(M5.Display.width() - 20, 20, 8, TFT_RED);
+    // Add a red recording indicator
+    M5.Display.fillCircle(M5.Display.width() - 20, 20, 8, TFT_RED);
+}
+
+// Classify newly captured frames; the endpoint is acted on from loop()
+void run_vad()
+{
+    while (audio_buffer.size() - vad_pos >= CAPTURE_FRAME_SAMPLES)
+    {
+        // Blocks hold a whole number of capture frames, so a frame never straddles two
+        const int16_t *frame;
+        audio_buffer.read_span(vad_pos, &frame);
+        VadEvent event = vad.process_frame(frame);
+        vad_pos += CAPTURE_FRAME_SAMPLES;
+
+        if (event == VAD_EVENT_SPEECH_START)
+        {
+            // Leading silence is never sent
+            uplink.skip_to(vad.trim_start());
+            LOG_INFO(AUDIO_TAG, "VAD speech start at %u ms (noise floor %u)",
+                     (unsigned)(vad.speech_start_sample() * 1000 / SAMPLE_RATE), vad.noise_floor());
+        }
+        else if (event == VAD_EVENT_SPEECH_END)
+        {
+            size_t speech_samples = vad.speech_end_sample() - vad.speech_start_sample();
+            size_t latency_samples = vad.samples_processed() - vad.speech_end_sample();
+            LOG_INFO(AUDIO_TAG, "VAD endpoint: %u ms of speech, endpointing latency %u ms",
+                     (unsigned)(speech_samples * 1000 / SAMPLE_RATE),
+                     (unsigned)(latency_samples * 1000 / SAMPLE_RATE));
+            vad_endpoint_reached = true;
+        }
+    }
+}
+
+// Move captured samples from the capture ring into the utterance buffer
+void drain_captured_audio()
+{
+    size_t samples_read = 0;
+
+    // Read straight from the capture ring into the tail block of the recording
+    while (audio_capture_available() > 0)
+    {
+        int16_t *dst;
+        size_t space = audio_buffer.write_span(&dst);
+        if (space == 0)
+        {
+            recording_buffer_exhausted = true; // budget reached or PSRAM ran out; loop() stops the recording
+            break;
+        }
+
+        // Stop at the listening cue, then read through it without keeping it
+        size_t pos = audio_buffer.size();
+        size_t wanted = min(audio_capture_available(), space);
+        if (listening_cue_skip > 0 && pos < listening_cue_at)
+            wanted = min(wanted, listening_cue_at - pos);
+
+        size_t count = audio_capture_read(dst, wanted);
+        if (listening_cue_skip > 0 && pos == listening_cue_at)
+        {
+            size_t dropped = min(count, listening_cue_skip);
+            memmove(dst, dst + dropped, (count - dropped) * sizeof(int16_t));
+            listening_cue_skip -= dropped;
+            count -= dropped;
+        }
+
+        audio_buffer.commit(count);
+        samples_read += count;
+    }
+
+    if (samples_read == 0)
+        return;
+
+    if (!first_sample_logged)
+    {
+        // With pre-roll the first sample predates the tap, so this is ~0 rather than a frame or two
+        LOG_INFO(AUDIO_TAG, "Tap-to-first-sample: %lu us (%u samples, %u ms pre-roll)",
+                 micros() - tap_time_us, (unsigned)samples_read,
+                 preroll_enabled ? (unsigned)PREROLL_MS : 0);
+        first_sample_logged = true;
+    }
+
+    if (vad_enabled)
+    {
+        run_vad();
+    }
+
+    // Push completed frames out while the user is still speaking
+    if (uplink_streaming)
+    {
+        stream_pending_frames(false);
+    }
 }
 
 // Stop recording and send audio
@@ -553,16 +2013,79 @@ void stop_recording()
         return;
 
     LOG_INFO(AUDIO_TAG, "Stopping recording...");
+    unsigned long stop_ms = millis();
+
+    // Collect the frames captured since the last loop() pass before closing the utterance
+    drain_captured_audio();
+    audio_capture_set_active(false);
+
+    CaptureStats capture_stats = audio_capture_stats();
+    LOG_INFO(AUDIO_TAG, "Capture stats: %u frames, %u dropped, %u short reads, ring high water %u samples",
+             capture_stats.frames_captured, capture_stats.frames_dropped,
+             capture_stats.short_reads, (unsigned)capture_stats.ring_high_water);
+    if (frontend_dsp_frames > 0)
+    {
+        LOG_INFO(AUDIO_TAG, "Front-end DSP: %u cycles/frame, AGC gain %u/4096",
+                 (unsigned)(frontend_dsp_cycles / frontend_dsp_frames), (unsigned)frontend_agc.gain_q12);
+    }
+
     set_state(STATE_PROCESSING);
     is_recording = false;
     processing_start_time = millis(); // Start timeout timer
 
-    if (audio_buffer_pos > 0)
+    if (uplink_streaming)
+    {
+        // Most of the utterance is already on the wire; only the tail frame remains. This times
+        // handing it to the socket, not its arrival: test_uplink_stream compares arrival times
+        stream_pending_frames(true);
+        send_utterance_end();
+        LOG_INFO(AUDIO_TAG, "Streamed %u samples in %u frames, stop-to-last-send: %lu ms",
+                 (unsigned)uplink.samples_sent(), uplink.frames_sent(), millis() - stop_ms);
+        if (uplink_codec == UPLINK_CODEC_IMA_ADPCM && uplink.frames_sent() > 0)
+        {
+            LOG_INFO(AUDIO_TAG, "IMA-ADPCM encode: %u cycles/frame (%d samples)",
+                     (unsigned)(uplink.encode_cycles() / uplink.frames_sent()), UPLINK_FRAME_SAMPLES);
+        }
+
+        if (uplink.samples_sent() == 0)
+        {
+            LOG_ERROR(AUDIO_TAG, "No audio data to send");
+            set_state(STATE_READY);
+        }
+    }
+    else if (audio_buffer.size() > 0)
     {
-        // Send recorded audio to server
-        send_audio_chunk((uint8_t *)audio_buffer.get(), audio_buffer_pos * sizeof(int16_t));
-        LOG_INFO(AUDIO_TAG, "Sent %d samples (%d bytes) to server",
-                 audio_buffer_pos, audio_buffer_pos * sizeof(int16_t));
+        // Send recorded audio to server, minus leading/trailing silence
+        size_t send_start = vad_enabled ? vad.trim_start() : 0;
+        size_t send_end = utterance_send_limit(true);
+        size_t send_samples = send_end - send_start;
+
+        // The single-blob upload needs contiguous memory; stage it in PSRAM for the send,
+        // with room in front for a frame header
+        size_t blob_bytes = send_samples * sizeof(int16_t);
+        uint8_t *blob = (uint8_t *)heap_caps_malloc(WIRE_HEADER_BYTES + blob_bytes, MALLOC_CAP_SPIRAM);
+        if (blob != nullptr)
+        {
+            audio_buffer.copy_out(send_start, (int16_t *)(blob + WIRE_HEADER_BYTES), send_samples);
+            if (wire_binary)
+            {
+                size_t frame_len = wire_finish(blob, WIRE_UTTERANCE_AUDIO, utterance_id, 0, blob_bytes);
+                send_audio_chunk(blob, frame_len);
+            }
+            else
+            {
+                send_audio_chunk(blob + WIRE_HEADER_BYTES, blob_bytes);
+            }
+            heap_caps_free(blob);
+            LOG_INFO(AUDIO_TAG, "Sent %d samples (%d bytes) to server, trimmed %d leading / %d trailing, stop-to-last-send: %lu ms",
+                     send_samples, send_samples * sizeof(int16_t), send_start, audio_buffer.size() - send_end,
+                     millis() - stop_ms);
+        }
+        else
+        {
+            LOG_ERROR(AUDIO_TAG, "No memory to stage %d-sample upload", send_samples);
+            set_state(STATE_READY);
+        }
     }
     else
     {
@@ -570,108 +2093,94 @@ void stop_recording()
         set_state(STATE_READY);
     }
 
-    audio_buffer_pos = 0;
+    audio_buffer.clear();
 }
 
-// Play audio response
-void play_audio_response(uint8_t *data, size_t length)
+// Drop a recording in which no speech started: nothing is uploaded and the device goes back to ready
+void discard_recording()
 {
-    LOG_INFO(AUDIO_TAG, "Playing audio response: %u bytes", (unsigned)length);
+    if (!is_recording)
+        return;
 
-    // DEBUGGING: Dump first 100 bytes as hex to see exact data
-    LOG_INFO(AUDIO_TAG, "Raw audio data dump:");
-    for (int i = 0; i < min(100, (int)length); i += 16)
+    LOG_INFO(AUDIO_TAG, "Discarding %u ms of recording without speech",
+             (unsigned)(audio_buffer.size() * 1000 / SAMPLE_RATE));
+    audio_capture_set_active(false);
+    is_recording = false;
+
+    if (uplink_streaming)
     {
-        char hex_line[120];
-        sprintf(hex_line, "%04x: ", i);
-        for (int j = 0; j < 16 && (i + j) < length; j++)
-        {
-            sprintf(hex_line + strlen(hex_line), "%02x ", data[i + j]);
-        }
-        Serial.println(hex_line);
+        // The VAD held every frame back, so the server's utterance is closed empty
+        send_utterance_end();
     }
 
-    // Enhanced audio debugging - log first 16 bytes to analyze format
-    if (length >= 16)
+    audio_buffer.clear();
+    set_state(STATE_READY);
+}
+
+// A new response can arrive before the last buffered one has played out; the feeder
+// may still be queuing slices from it, so stop it and wait before the buffer goes
+void release_response_audio()
+{
+    if (response_audio && playback_active())
     {
-        LOG_INFO(AUDIO_TAG, "Audio format analysis - First 16 bytes (should be immediate audio data):");
-        for (int i = 0; i < 16; i += 2)
-        {
-            int16_t sample = (int16_t)(data[i] | (data[i + 1] << 8));
-            Serial.printf("  [%d-%d]: 0x%02x%02x -> %d\n", i, i + 1, data[i], data[i + 1], sample);
-        }
+        LOG_INFO(AUDIO_TAG, "Stopping the previous response before replacing it");
+        playback_stop();
     }
+    response_audio.reset();
+}
+
+// Validate a buffered response (data is response_audio) and start playing it;
+// returns at once, the feeder task plays it and service_playback() finishes the turn
+void play_audio_response(uint8_t *data, size_t length)
+{
+    LOG_INFO(AUDIO_TAG, "Playing audio response: %u bytes", (unsigned)length);
 
-    // Short-audio check (keep existing behavior)
+    // Short responses are the server's error beep; play ours from flash instead
     if (length < 1000)
     {
         LOG_INFO(AUDIO_TAG, "Short audio detected - likely error beep");
         update_display_with_transcription("Error", "Server error occurred");
+        earcon_play(EARCON_ERROR);
+        response_audio.reset();
+        set_state(STATE_READY);
+        return;
     }
-    else
-    {
-        update_display_with_transcription("Speaking", last_response.c_str());
-    }
+    update_display_with_transcription("Speaking", last_response.c_str());
 
     // Set volume and configure speaker for better quality
     M5.Speaker.setVolume(120);           // Balanced volume for clarity
     M5.Speaker.setChannelVolume(0, 120); // Ensure consistent channel volume
 
-    // ---------------------------
-    // New validation: peak + RMS
-    // ---------------------------
+    // Validate from the statistics gathered while the chunks arrived
     bool validAudio = false;
+    uint32_t rms = signal_stats_rms(&response_signal);
+
+    LOG_INFO(AUDIO_TAG, "Response signal: %u samples, peak %u, rms %u, dc %d, %u clipped, %u.%u%% silent (%u cycles/sample)",
+             response_signal.samples, response_signal.peak, rms, signal_stats_dc(&response_signal),
+             response_signal.clipped, signal_stats_silence_permille(&response_signal) / 10,
+             signal_stats_silence_permille(&response_signal) % 10,
+             response_signal.samples > 0 ? response_signal_cycles / response_signal.samples : 0);
 
-    if (length >= 2)
+    if (response_signal.samples == 0)
     {
-        size_t totalSamples = length / 2;
-        size_t samplesToCheck = min(totalSamples, (size_t)1024);
+        LOG_ERROR(AUDIO_TAG, "No samples available to validate");
+    }
+    else
+    {
+        // Tunable thresholds (adjust after testing)
+        const uint32_t PEAK_THRESHOLD = 300; // brief transient threshold
+        const uint32_t RMS_THRESHOLD = 40;   // sustained energy threshold
 
-        LOG_INFO(AUDIO_TAG, "Validating %u samples for peak/RMS", (unsigned)samplesToCheck);
+        // Accept if either measure indicates audio energy
+        validAudio = response_signal.peak >= PEAK_THRESHOLD || rms >= RMS_THRESHOLD;
 
-        if (samplesToCheck == 0)
-        {
-            LOG_ERROR(AUDIO_TAG, "No samples available to validate");
-            validAudio = false;
-        }
-        else
+        // Fallback: accept very-low-energy signals to avoid false negatives
+        if (!validAudio && response_signal.peak > 0 && response_signal.sum_squares > response_signal.samples)
         {
-            uint64_t sumSquares = 0;
-            int16_t peakSample = 0;
-
-            for (size_t i = 0; i < samplesToCheck; ++i)
-            {
-                size_t byteIndex = i * 2;
-                int16_t sample = (int16_t)(data[byteIndex] | (data[byteIndex + 1] << 8));
-                int16_t absS = (sample < 0) ? -sample : sample;
-                sumSquares += (uint64_t)absS * (uint64_t)absS;
-                if (absS > peakSample)
-                    peakSample = absS;
-            }
-
-            double rms = sqrt((double)sumSquares / (double)samplesToCheck);
-
-            LOG_INFO(AUDIO_TAG, "Validation metrics: peak=%d, rms=%.1f", peakSample, rms);
-
-            // Tunable thresholds (adjust after testing)
-            const int PEAK_THRESHOLD = 300;    // brief transient threshold
-            const double RMS_THRESHOLD = 40.0; // sustained energy threshold
-
-            // Accept if either measure indicates audio energy
-            validAudio = (peakSample >= PEAK_THRESHOLD) || (rms >= RMS_THRESHOLD);
-
-            // Fallback: accept very-low-energy signals to avoid false negatives
-            if (!validAudio && peakSample > 0 && rms > 1.0)
-            {
-                LOG_INFO(AUDIO_TAG, "Low-energy audio detected; accepting as fallback (peak=%d, rms=%.1f)", peakSample, rms);
-                validAudio = true;
-            }
+            LOG_INFO(AUDIO_TAG, "Low-energy audio detected; accepting as fallback (peak=%u, rms=%u)", response_signal.peak, rms);
+            validAudio = true;
         }
     }
-    else
-    {
-        validAudio = false;
-    }
 
     LOG_INFO(AUDIO_TAG, "Audio validation result: %s", validAudio ? "ACCEPTED" : "REJECTED");
 
@@ -692,71 +2201,324 @@ void play_audio_response(uint8_t *data, size_t length)
         LOG_INFO(AUDIO_TAG, "STEP 2: Playing server audio: %u bytes", (unsigned)length);
         update_display_with_transcription("Playing Server Audio", "Listen for noise/distortion...");
 
-        // Fallback: use 24kHz playback rate. If you have a global audioFileSampleRate,
-        // replace the hardcoded 24000 below with that variable (ensure it's declared above).
-        uint32_t playback_rate = 24000;
+        // Play at the rate and channel count the server declared; the speaker converts natively
+        uint32_t playback_rate = downlink_sample_rate;
+        bool stereo = downlink_channels == 2;
 
-        LOG_INFO(AUDIO_TAG, "Playing audio at %u Hz", playback_rate);
+        LOG_INFO(AUDIO_TAG, "Playing audio at %u Hz, %s", playback_rate, stereo ? "stereo" : "mono");
 
-        // Configure speaker for optimal playback before playing
-        M5.Speaker.stop();                   // Ensure clean start
+        // No M5.Speaker.stop() first: it would click, and the feeder task owns channel 0
         M5.Speaker.setAllChannelVolume(120); // Set all channels consistently
 
-        // STREAMING PLAYBACK: Use triple-buffering like SD card code for smooth playback
-        static constexpr const size_t buf_num = 3;
-        static constexpr const size_t buf_size = 1024;
-        static uint8_t play_buffers[buf_num][buf_size];
+        // The feeder queues slices straight from response_audio after we return
+        playback_play_clip((int16_t *)data, length / sizeof(int16_t), playback_rate, stereo);
+    }
+    else
+    {
+        LOG_ERROR(AUDIO_TAG, "Invalid audio data received");
+        earcon_play(EARCON_ERROR);
+        response_audio.reset();
+        set_state(STATE_READY);
+        if (last_transcription.length() > 0)
+        {
+            update_display_with_transcription("Ready", last_transcription.c_str());
+        }
+    }
+}
 
-        LOG_INFO(AUDIO_TAG, "Streaming audio with triple-buffering");
+// Return to ready once the feeder task has played the response out
+void service_playback()
+{
+    // Track how long loop() iterations take while audio plays
+    if (current_state == STATE_SPEAKING)
+    {
+        unsigned long now = micros();
+        if (speaking_loop_last_us != 0)
+        {
+            unsigned long gap = now - speaking_loop_last_us;
+            if (gap > speaking_loop_max_us)
+                speaking_loop_max_us = gap;
+            speaking_loop_total_us += gap;
+            speaking_loop_count++;
+        }
+        speaking_loop_last_us = now;
+    }
+    else
+    {
+        speaking_loop_last_us = 0;
+    }
 
-        size_t data_remaining = length;
-        size_t data_pos = 0;
-        size_t buf_idx = 0;
+    if (!playback_take_finished())
+        return;
 
-        // Stream audio using rotating buffers - no waiting between chunks
-        while (data_remaining > 0)
-        {
-            size_t chunk_len = (data_remaining < buf_size) ? data_remaining : buf_size;
+    PlaybackStats pb = playback_stats();
+    if (speaking_loop_count > 0)
+    {
+        LOG_INFO(AUDIO_TAG, "Loop latency while speaking: avg %u us, max %lu us over %u iterations",
+                 (unsigned)(speaking_loop_total_us / speaking_loop_count), speaking_loop_max_us, speaking_loop_count);
+    }
+    speaking_loop_max_us = 0;
+    speaking_loop_total_us = 0;
+    speaking_loop_count = 0;
+    response_from_cache = false;
 
-            // Copy chunk to buffer
-            memcpy(play_buffers[buf_idx], data + data_pos, chunk_len);
+    if (pb.dynamics_samples > 0)
+    {
+        LOG_INFO(AUDIO_TAG, "Output dynamics: %u cycles/sample", (unsigned)(pb.dynamics_cycles / pb.dynamics_samples));
+    }
+
+    if (pb.mix_samples > 0)
+    {
+        LOG_INFO(AUDIO_TAG, "Voice mixing: %u cycles/sample", (unsigned)(pb.mix_cycles / pb.mix_samples));
+    }
 
-            // Queue chunk for playback (non-blocking with wait=0)
-            // For 16-bit audio: cast to int16_t* and pass sample count (bytes >> 1)
-            M5.Speaker.playRaw((const int16_t *)play_buffers[buf_idx], chunk_len >> 1, playback_rate, false, 1, 0);
+    if (pb.stretched_samples > 0)
+    {
+        LOG_INFO(AUDIO_TAG, "Time stretch at %u%%: %u cycles/sample", (unsigned)playback_speed(),
+                 (unsigned)(pb.stretch_cycles / pb.stretched_samples));
+    }
 
-            data_remaining -= chunk_len;
-            data_pos += chunk_len;
-            buf_idx = (buf_idx < (buf_num - 1)) ? buf_idx + 1 : 0;
+    if (!streaming_response)
+    {
+        LOG_INFO(AUDIO_TAG, "Audio playback completed: %u samples", pb.samples_played);
+        response_audio.reset();
+    }
+    else
+    {
+        LOG_INFO(AUDIO_TAG, "Streaming playback complete: %u samples, time-to-first-audio %u ms, %u underruns, low-water %u ms, jitter %u ms, %u dropped",
+                 pb.samples_played, pb.time_to_first_audio_ms, pb.underruns, pb.low_water_ms, pb.jitter_ms, pb.samples_dropped);
+        if (pb.resampled_samples > 0)
+        {
+            LOG_INFO(AUDIO_TAG, "Resampled %u Hz -> %u Hz: %u cycles/output sample",
+                     downlink_sample_rate, pb.output_rate, (unsigned)(pb.resample_cycles / pb.resampled_samples));
         }
+        LOG_INFO(AUDIO_TAG, "Response signal: %u samples, peak %u, rms %u, dc %d, %u clipped, %u.%u%% silent",
+                 pb.signal.samples, pb.signal.peak, signal_stats_rms(&pb.signal), signal_stats_dc(&pb.signal),
+                 pb.signal.clipped, signal_stats_silence_permille(&pb.signal) / 10, signal_stats_silence_permille(&pb.signal) % 10);
+    }
+
+    streaming_response = false;
+    set_state(STATE_READY);
+    if (last_transcription.length() > 0)
+    {
+        update_display_with_transcription("Ready", last_transcription.c_str());
+    }
+}
 
-        // Wait for final playback to complete
-        while (M5.Speaker.isPlaying())
+// Start a jitter-buffer stream in the current downlink format
+void begin_downlink_stream()
+{
+    PcmStreamFormat stream_format;
+    stream_format.sample_rate = downlink_sample_rate;
+    stream_format.channels = downlink_channels;
+    stream_format.sample_format = downlink_format == DOWNLINK_FORMAT_PCM8 ? PCM_SAMPLE_U8 : PCM_SAMPLE_S16LE;
+    playback_stream_begin(stream_format);
+}
+
+// Feed downlink audio bytes (from the network or the cache) into the jitter buffer
+void feed_stream_audio(const uint8_t *data, size_t length)
+{
+    if (downlink_format == DOWNLINK_FORMAT_IMA_ADPCM)
+    {
+        static int16_t decoded[2048];
+        for (size_t offset = 0; offset < length; offset += sizeof(decoded) / 4)
         {
-            delay(50);
+            size_t part = min(length - offset, sizeof(decoded) / 4);
+            size_t samples = ima_adpcm_decode_stream(&downlink_adpcm_state, data + offset, part, decoded);
+            playback_stream_write_samples(decoded, samples);
         }
     }
     else
     {
-        LOG_ERROR(AUDIO_TAG, "Invalid audio data received");
-        // Play a simple beep as fallback
-        M5.Speaker.tone(800, 500); // 800Hz for 500ms
-        delay(500);
+        playback_stream_write(data, length);
     }
+}
 
-    LOG_INFO(AUDIO_TAG, "Audio playback completed");
+// Mount the cache filesystem, load the index and set aside the staging buffer
+void init_tts_cache()
+{
+#if TTS_CACHE_ENABLED
+    if (!playback_streaming)
+        return; // hits replay through the jitter buffer
 
-    // Return to ready state after playing audio
-    delay(500); // Small delay before showing ready state
-    set_state(STATE_READY);
+#if TTS_CACHE_USE_SD
+    if (!SD.begin(TTS_CACHE_SD_CS_PIN, SPI, 25000000))
+    {
+        LOG_ERROR(AUDIO_TAG, "SD card mount failed, TTS cache disabled");
+        return;
+    }
+    static FsCacheStorage storage(SD);
+    uint32_t budget = TTS_CACHE_SD_BUDGET;
+#else
+    if (!SPIFFS.begin(true)) // formats the partition only if it has never been used
+    {
+        LOG_ERROR(AUDIO_TAG, "SPIFFS mount failed, TTS cache disabled");
+        return;
+    }
+    static FsCacheStorage storage(SPIFFS);
+    uint32_t budget = TTS_CACHE_SPIFFS_BUDGET;
+#endif
 
-    // Show the transcription result for a few seconds
-    if (last_transcription.length() > 0)
+    cache_staging = (uint8_t *)heap_caps_malloc(TTS_CACHE_MAX_ENTRY_BYTES, MALLOC_CAP_SPIRAM);
+    if (cache_staging == nullptr || !tts_cache.begin(&storage, budget))
     {
-        update_display_with_transcription("Ready", last_transcription.c_str());
+        LOG_ERROR(AUDIO_TAG, "Failed to set up TTS cache");
+        return;
+    }
+
+    tts_cache_ready = true;
+    LOG_INFO(AUDIO_TAG, "TTS cache: %u entries, %u/%u bytes", (unsigned)tts_cache.entries(),
+             tts_cache.used_bytes(), tts_cache.budget());
+#endif
+}
+
+// Cache hit for the current response: tell the server to skip the audio and replay ours
+bool play_cached_response()
+{
+    if (!tts_cache_ready || !tts_cache.lookup(response_cache_key, &cache_replay_header))
+        return false;
+
+    char key_hex[17];
+    snprintf(key_hex, sizeof(key_hex), "%08lx%08lx", (unsigned long)(response_cache_key >> 32),
+             (unsigned long)(response_cache_key & 0xffffffff));
+
+    if (wire_binary)
+    {
+        WireWriter w;
+        wire_writer_init(&w, uplink.frame_payload(), uplink.frame_payload_capacity());
+        wire_put_u64(&w, response_cache_key);
+        uplink.send_frame(WIRE_AUDIO_CACHED, w.len);
+    }
+    else
+    {
+        StaticJsonDocument<128> doc;
+        doc["type"] = "audio_cached";
+        doc["cacheKey"] = key_hex;
+        send_control_message(doc);
+    }
+
+    downlink_format = (DownlinkFormat)cache_replay_header.format;
+    downlink_sample_rate = cache_replay_header.sample_rate;
+    downlink_channels = cache_replay_header.channels;
+    ima_adpcm_reset(&downlink_adpcm_state);
+    begin_downlink_stream();
+
+    cache_replay_pos = 0;
+    response_from_cache = true;
+    skip_downlink_audio = true;
+    streaming_response = true;
+
+    LOG_INFO(AUDIO_TAG, "TTS cache hit %s: %u bytes", key_hex, cache_replay_header.data_bytes);
+    set_state(STATE_SPEAKING);
+    update_display_with_transcription("Speaking", last_response.c_str());
+    return true;
+}
+
+// Keep a copy of the response's wire bytes until it is known to be complete
+void stage_for_cache(const uint8_t *data, size_t length)
+{
+    if (!cache_staging_active)
+        return;
+
+    if (cache_staged + length > TTS_CACHE_MAX_ENTRY_BYTES)
+    {
+        cache_staging_active = false;
+        return;
+    }
+    memcpy(cache_staging + cache_staged, data, length);
+    cache_staged += length;
+}
+
+// One bounded piece of cache I/O per loop() pass: replay a hit, or write a staged miss while ready
+// Cache writes wait for a ready device with nothing playing. A SPIFFS write also
+// disables the flash cache on both cores for the length of a sector erase, which
+// stalls the mic task and the wake word, so on SPIFFS they also wait for the mic
+// to be idle (no pre-roll and no wake word). SD writes go over SPI and don't.
+bool cache_writes_allowed()
+{
+    if (current_state != STATE_READY || is_recording || playback_active())
+        return false;
+#if TTS_CACHE_USE_SD
+    return true;
+#else
+    return mic_idle();
+#endif
+}
+
+// Nothing is capturing: no recording or pre-roll, and no wake word
+bool mic_idle()
+{
+    return !audio_capture_is_active() && !wake_word_running();
+}
+
+void service_tts_cache()
+{
+    if (response_from_cache && cache_replay_pos < cache_replay_header.data_bytes)
+    {
+        static uint8_t piece[TTS_CACHE_IO_BYTES];
+        size_t want = min((size_t)TTS_CACHE_IO_BYTES, cache_replay_header.data_bytes - cache_replay_pos);
+        size_t got = tts_cache.read_audio(response_cache_key, cache_replay_pos, piece, want);
+        feed_stream_audio(piece, got);
+        cache_replay_pos += got;
+
+        if (got < want)
+        {
+            LOG_ERROR(AUDIO_TAG, "TTS cache entry truncated at %u bytes", (unsigned)cache_replay_pos);
+            cache_replay_pos = cache_replay_header.data_bytes;
+        }
+        if (cache_replay_pos >= cache_replay_header.data_bytes)
+        {
+            playback_stream_end();
+        }
+        return;
+    }
+
+    if (!cache_writes_allowed())
+        return;
+    if (!cache_store_pending)
+    {
+        tts_cache.flush(); // last-use order from hits
+        return;
+    }
+
+    if (cache_store_pos == 0 && !tts_cache.store_begin(cache_store_key, cache_store_header))
+    {
+        LOG_ERROR(AUDIO_TAG, "TTS cache has no room for %u bytes", cache_store_header.data_bytes);
+        cache_store_pending = false;
+        return;
+    }
+
+    size_t n = min((size_t)TTS_CACHE_IO_BYTES, cache_store_header.data_bytes - cache_store_pos);
+    if (!tts_cache.store_append(cache_staging + cache_store_pos, n))
+    {
+        LOG_ERROR(AUDIO_TAG, "TTS cache write failed");
+        cache_store_pending = false;
+        return;
+    }
+    cache_store_pos += n;
+
+    if (cache_store_pos == cache_store_header.data_bytes)
+    {
+        cache_store_pending = false;
+        if (tts_cache.store_commit())
+        {
+            LOG_INFO(AUDIO_TAG, "TTS cache stored %u bytes: %u entries, %u/%u bytes", cache_store_header.data_bytes,
+                     (unsigned)tts_cache.entries(), tts_cache.used_bytes(), tts_cache.budget());
+        }
     }
 }
 
+// The rest of a streamed response will never arrive; stop and drop what is buffered
+void stop_streaming_playback()
+{
+    if (!streaming_response || response_from_cache)
+        return;
+
+    playback_stream_abort(); // carried out by the feeder task
+    streaming_response = false;
+    receiving_chunked_audio = false;
+}
+
 // Check for processing timeout
 void check_processing_timeout()
 {
@@ -765,22 +2527,40 @@ void check_processing_timeout()
         if (millis() - processing_start_time > PROCESSING_TIMEOUT)
         {
             LOG_ERROR(TAG, "Processing timeout reached");
-            update_display_with_transcription("Timeout", "No response from server");
-            delay(3000);
-            set_state(STATE_READY);
+            earcon_play(EARCON_TIMEOUT);
+            show_error("Timeout", "No response from server", 3000);
         }
     }
 }
 
+// Show an error for a while, then go back to ready (see service_error_display()).
+// A tap dismisses it sooner, as for any error.
+void show_error(const char *status, const char *message, unsigned long duration_ms)
+{
+    set_state(STATE_ERROR);
+    update_display_with_transcription(status, message);
+    error_display_pending = true;
+    error_display_start = millis();
+    error_display_ms = duration_ms;
+}
+
+void service_error_display()
+{
+    if (error_display_pending && millis() - error_display_start >= error_display_ms)
+    {
+        set_state(STATE_READY);
+    }
+}
+
 // Check for recording timeout
 void check_recording_timeout()
 {
     if (is_recording)
     {
-        if (millis() - recording_start_time > RECORDING_TIMEOUT)
+        if (vad_enabled && !vad.speech_detected() && millis() - recording_start_time > VAD_NO_SPEECH_TIMEOUT_MS)
         {
-            LOG_INFO(AUDIO_TAG, "Recording timeout reached (5 seconds)");
-            stop_recording();
+            LOG_INFO(AUDIO_TAG, "No speech detected within %d ms", VAD_NO_SPEECH_TIMEOUT_MS);
+            discard_recording();
         }
     }
 }
@@ -788,7 +2568,6 @@ void check_recording_timeout()
 void setup()
 {
     Serial.begin(115200);
-    delay(1000);
 
     LOG_INFO(TAG, "=== M5Stack Core2 Voice Assistant MVP ===");
     LOG_INFO(TAG, "Initial heap: %u bytes", ESP.getFreeHeap());
@@ -796,54 +2575,67 @@ void setup()
     // Initialize state
     set_state(STATE_BOOT);
 
+    // Start Wi-Fi first; association and DHCP run in the background while the rest comes up
+    WiFi.persistent(false);       // our own profile replaces the SDK's copy in NVS
+    WiFi.setAutoReconnect(false); // service_wifi() reconnects, cached access point first
+    WiFi.onEvent(wifi_event);
+    wifi_profile_valid = load_wifi_profile();
+    wifi_outage_ms = millis();
+    start_wifi_connect(wifi_profile_valid);
+    boot_mark(BOOT_WIFI_START);
+
     // Initialize M5Stack
     M5.begin();
     LOG_INFO(TAG, "M5Stack initialized, heap: %u bytes", ESP.getFreeHeap());
 
-    // Initialize audio
-    init_audio();
-    LOG_INFO(TAG, "Audio initialized, heap: %u bytes", ESP.getFreeHeap());
-
-    // Connect to WiFi
-    set_state(STATE_CONNECTING_WIFI);
-    WiFi.begin(ssid, password);
-
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20)
+    // Audio comes up in the background; loop() opens the server link meanwhile (see service_wifi())
+    if (xTaskCreatePinnedToCore(peripherals_task, "peripherals", PERIPHERALS_TASK_STACK, nullptr,
+                                PERIPHERALS_TASK_PRIORITY, nullptr, PERIPHERALS_TASK_CORE) != pdPASS)
     {
-        delay(500);
-        attempts++;
-        LOG_INFO(TAG, "WiFi connection attempt %d/20", attempts);
+        LOG_ERROR(TAG, "Failed to start the peripherals task, initializing in line");
+        bring_up_peripherals();
     }
 
-    if (WiFi.status() == WL_CONNECTED)
-    {
-        wifi_connected = true;
-        LOG_INFO(TAG, "WiFi connected: %s", WiFi.localIP().toString().c_str());
-        LOG_INFO(TAG, "Gateway: %s", WiFi.gatewayIP().toString().c_str());
-        LOG_INFO(TAG, "DNS: %s", WiFi.dnsIP().toString().c_str());
+    if (!wifi_has_ip)
+        set_state(STATE_CONNECTING_WIFI);
+}
 
-        // Test basic connectivity first
-        WiFiClient testClient;
-        LOG_INFO(TAG, "Testing HTTP connection to %s:%d", WS_HOST, WS_PORT);
-        if (testClient.connect(WS_HOST, WS_PORT))
-        {
-            LOG_INFO(TAG, "HTTP connection successful!");
-            testClient.stop();
-        }
-        else
-        {
-            LOG_ERROR(TAG, "HTTP connection failed!");
-        }
+// Mic, speaker, wake word and earcons. This touches neither the display nor the WebSocket,
+// which belong to loop(); loop() only uses audio once peripherals_ready is set
+void bring_up_peripherals()
+{
+    init_audio();
+    boot_mark(BOOT_PERIPHERALS);
+    LOG_INFO(TAG, "Audio initialized at %u ms, heap: %u bytes", boot_phase_ms[BOOT_PERIPHERALS], ESP.getFreeHeap());
+    peripherals_ready.store(true, std::memory_order_release);
+}
 
-        // Initialize WebSocket
-        init_websocket();
-    }
-    else
+void peripherals_task(void *param)
+{
+    bring_up_peripherals();
+    vTaskDelete(nullptr);
+}
+
+// From loop() once the bring-up task is done: the rest of boot that has to run on the main task.
+// The cache's SD card shares the SPI bus with the display, so it is mounted here rather than
+// in the task. Returns false until then
+bool start_peripherals()
+{
+    if (peripherals_started)
+        return true;
+    if (!peripherals_ready.load(std::memory_order_acquire))
+        return false;
+
+    init_tts_cache();
+    peripherals_started = true;
+    if (websocket_connected)
     {
-        LOG_ERROR(TAG, "WiFi connection failed");
-        set_state(STATE_ERROR);
+        // The server link beat the audio
+        set_state(STATE_READY);
+        boot_mark(BOOT_READY);
+        log_boot_timeline();
     }
+    return true;
 }
 
 // Test speaker hardware with pure tone
@@ -884,45 +2676,75 @@ void setup()
 
 void loop()
 {
-    // Handle WebSocket events (skip during critical audio playback)
-    if (current_state != STATE_SPEAKING)
+    // Handle WebSocket events; playback runs in its own task, so this never pauses
+    webSocket.loop();
+
+    // Open the server link once Wi-Fi has an address
+    service_wifi();
+
+    // Back off between reconnects; heartbeat while ready
+    service_websocket_link();
+
+    // Until the audio is up only the server link is serviced
+    if (!start_peripherals())
     {
-        webSocket.loop();
+        delay(10);
+        return;
     }
 
+    // Give up on a cut-off response that can't be resumed in time
+    service_downlink_resume();
+
+    // Finish the turn once the response has played out
+    service_playback();
+
+    // Replay a cached response, or save the last one, a piece at a time
+    service_tts_cache();
+
     // Handle touch input
     handle_touch();
 
     // Check for processing timeouts
     check_processing_timeout();
 
+    // Back to ready once an error has been on screen long enough
+    service_error_display();
+
     // Check for recording timeouts
     check_recording_timeout();
 
+    // While idle and ready, keep capturing but only hold the pre-roll window
+    if (!is_recording)
+    {
+        bool preroll = preroll_enabled && current_state == STATE_READY;
+        audio_capture_set_active(preroll);
+        audio_capture_retain(preroll ? PREROLL_SAMPLES : 0);
+    }
+
+    // Wake word only listens while ready; a detection starts recording like a tap would
+    wake_word_set_listening(!is_recording && current_state == STATE_READY);
+    if (wake_word_take_detection() && current_state == STATE_READY)
+    {
+        WakeWordStats kws = wake_word_stats();
+        LOG_INFO(AUDIO_TAG, "Wake word detected (p=%.2f): features %u cycles/hop, inference %u cycles, stride %u, load %u.%u%%, %u dropped",
+                 kws.last_probability, kws.feature_cycles, kws.inference_cycles, kws.stride,
+                 kws.load_permille / 10, kws.load_permille % 10, kws.dropped_samples);
+        tap_time_us = micros();
+        start_recording();
+    }
+
     // Read audio data when recording
     if (is_recording)
     {
-        // Use M5Unified microphone API (NOT direct i2s_read)
-        if (M5.Mic.isEnabled())
-        {
-            // Record directly into our buffer
-            size_t samples_to_read = min((size_t)BUFFER_SIZE, AUDIO_CHUNK_SIZE - audio_buffer_pos);
-
-            if (samples_to_read > 0 && M5.Mic.record(audio_buffer.get() + audio_buffer_pos, samples_to_read, SAMPLE_RATE))
-            {
-                // Debug: Print first few samples to verify real audio
-                if (audio_buffer_pos < 100) // Only log first few chunks
-                {
-                    Serial.printf("Audio samples: %d, %d, %d, %d (total: %zu)\n",
-                                  audio_buffer[audio_buffer_pos],
-                                  audio_buffer[audio_buffer_pos + 1],
-                                  audio_buffer[audio_buffer_pos + 2],
-                                  audio_buffer[audio_buffer_pos + 3],
-                                  samples_to_read);
-                }
+        // Frames are captured by the mic task; move whatever is ready into the utterance
+        drain_captured_audio();
 
-                audio_buffer_pos += samples_to_read;
-            }
+        // VAD saw enough trailing silence: end the utterance without waiting for a tap
+        if (vad_endpoint_reached)
+        {
+            LOG_INFO(AUDIO_TAG, "End of speech detected, stopping recording");
+            stop_recording();
+            return;
         }
 
         // Visual feedback - pulse recording indicator
@@ -936,10 +2758,10 @@ void loop()
             lastPulse = millis();
         }
 
-        // Safety check - stop if buffer is nearly full (keep some margin)
-        if (audio_buffer_pos >= AUDIO_CHUNK_SIZE - 1000)
+        // Stop once the recording budget is used up (or PSRAM ran out)
+        if (recording_buffer_exhausted)
         {
-            LOG_INFO(AUDIO_TAG, "Buffer nearly full, stopping recording for safety");
+            LOG_INFO(AUDIO_TAG, "Recording budget reached (%u samples), stopping recording", (unsigned)audio_buffer.size());
             stop_recording();
         }
     }
@@ -0,0 +1,120 @@
+#include "resampler.h"
+
+#include <cmath>
+#include <cstring>
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+bool PolyphaseResampler::init(uint32_t in_rate, uint32_t out_rate)
+{
+    up_ = 0;
+    if (in_rate == 0 || out_rate == 0)
+        return false;
+
+    uint32_t g = gcd(in_rate, out_rate);
+    uint32_t up = out_rate / g;
+    uint32_t down = in_rate / g;
+    if (up > RESAMPLER_MAX_PHASES)
+        return false;
+
+    // Prototype runs at in_rate * L; cut off at the lower of the two Nyquist limits
+    const size_t length = (size_t)RESAMPLER_TAPS * up;
+    const double cutoff = 0.5 / (up > down ? up : down) * 0.9; // cycles per upsampled sample, 10% guard band
+    const double center = (length - 1) / 2.0;
+
+    for (uint32_t p = 0; p < up; p++)
+    {
+        double taps[RESAMPLER_TAPS];
+        double sum = 0.0;
+        for (size_t k = 0; k < RESAMPLER_TAPS; k++)
+        {
+            // Tap k of phase p multiplies the input k samples back from the newest
+            size_t n = p + k * up;
+            double t = n - center;
+            double sinc = t == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+            double blackman = 0.42 - 0.5 * cos(2.0 * M_PI * n / (length - 1)) + 0.08 * cos(4.0 * M_PI * n / (length - 1));
+            taps[k] = sinc * blackman;
+            sum += taps[k];
+        }
+        for (size_t k = 0; k < RESAMPLER_TAPS; k++)
+        {
+            coeffs_[p][k] = (int16_t)lround(taps[k] / sum * 32767.0);
+        }
+    }
+
+    up_ = up;
+    down_ = down;
+    reset();
+    return true;
+}
+
+void PolyphaseResampler::reset()
+{
+    phase_ = 0;
+    next_ = 0;
+    memset(history_, 0, sizeof(history_));
+}
+
+size_t PolyphaseResampler::process(const int16_t *in, size_t in_count, int16_t *out, size_t out_capacity, size_t *consumed)
+{
+    const size_t hist = RESAMPLER_TAPS - 1;
+    size_t produced = 0;
+    size_t i = next_;
+
+    while (i < in_count && produced < out_capacity)
+    {
+        const int16_t *c = coeffs_[phase_];
+        int32_t acc = 0;
+
+        if (i >= hist)
+        {
+            // Fast path: the whole window lies inside this block
+            const int16_t *x = in + i;
+            for (size_t k = 0; k < RESAMPLER_TAPS; k++)
+            {
+                acc += (int32_t)c[k] * x[-(int32_t)k];
+            }
+        }
+        else
+        {
+            for (size_t k = 0; k < RESAMPLER_TAPS; k++)
+            {
+                int32_t j = (int32_t)i - (int32_t)k;
+                int16_t x = j >= 0 ? in[j] : history_[hist + j];
+                acc += (int32_t)c[k] * x;
+            }
+        }
+
+        acc = (acc + (1 << 14)) >> 15;
+        out[produced++] = (int16_t)(acc > 32767 ? 32767 : (acc < -32768 ? -32768 : acc));
+
+        phase_ += down_;
+        i += phase_ / up_;
+        phase_ %= up_;
+    }
+
+    // Inputs before i are done with except as history for later outputs
+    size_t used = i < in_count ? i : in_count;
+    if (used >= hist)
+    {
+        memcpy(history_, in + used - hist, hist * sizeof(int16_t));
+    }
+    else
+    {
+        memmove(history_, history_ + used, (hist - used) * sizeof(int16_t));
+        memcpy(history_ + hist - used, in, used * sizeof(int16_t));
+    }
+
+    next_ = i - used;
+    *consumed = used;
+    return produced;
+}
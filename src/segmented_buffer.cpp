@@ -0,0 +1,124 @@
+#include "segmented_buffer.h"
+
+#include <cstring>
+#include <esp_heap_caps.h>
+
+SegmentedAudioBuffer::SegmentedAudioBuffer()
+    : block_samples_(0), max_blocks_(0), size_(0), blocks_(nullptr), used_blocks_(0),
+      free_list_(nullptr), free_count_(0)
+{
+}
+
+SegmentedAudioBuffer::~SegmentedAudioBuffer()
+{
+    clear();
+    for (size_t i = 0; i < free_count_; i++)
+    {
+        heap_caps_free(free_list_[i]);
+    }
+    delete[] blocks_;
+    delete[] free_list_;
+}
+
+bool SegmentedAudioBuffer::init(size_t block_samples, size_t budget_samples)
+{
+    if (blocks_ != nullptr || block_samples == 0 || budget_samples < block_samples)
+        return false;
+
+    block_samples_ = block_samples;
+    max_blocks_ = budget_samples / block_samples;
+    blocks_ = new int16_t *[max_blocks_];
+    free_list_ = new int16_t *[max_blocks_];
+    return true;
+}
+
+int16_t *SegmentedAudioBuffer::acquire_block()
+{
+    if (free_count_ > 0)
+    {
+        return free_list_[--free_count_];
+    }
+    return (int16_t *)heap_caps_malloc(block_samples_ * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+}
+
+size_t SegmentedAudioBuffer::write_span(int16_t **ptr)
+{
+    size_t offset = size_ % block_samples_;
+    size_t block = size_ / block_samples_;
+
+    if (offset == 0)
+    {
+        // Current block is full (or there is none yet)
+        if (block >= max_blocks_)
+            return 0;
+        if (block == used_blocks_)
+        {
+            int16_t *fresh = acquire_block();
+            if (fresh == nullptr)
+                return 0;
+            blocks_[used_blocks_++] = fresh;
+        }
+    }
+
+    *ptr = blocks_[block] + offset;
+    return block_samples_ - offset;
+}
+
+size_t SegmentedAudioBuffer::append(const int16_t *data, size_t n)
+{
+    size_t written = 0;
+    while (written < n)
+    {
+        int16_t *dst;
+        size_t room = write_span(&dst);
+        if (room == 0)
+            break;
+
+        size_t count = n - written < room ? n - written : room;
+        memcpy(dst, data + written, count * sizeof(int16_t));
+        commit(count);
+        written += count;
+    }
+    return written;
+}
+
+size_t SegmentedAudioBuffer::read_span(size_t pos, const int16_t **ptr) const
+{
+    if (pos >= size_)
+        return 0;
+
+    size_t offset = pos % block_samples_;
+    size_t count = block_samples_ - offset;
+    if (count > size_ - pos)
+        count = size_ - pos;
+
+    *ptr = blocks_[pos / block_samples_] + offset;
+    return count;
+}
+
+size_t SegmentedAudioBuffer::copy_out(size_t pos, int16_t *dst, size_t n) const
+{
+    size_t copied = 0;
+    while (copied < n)
+    {
+        const int16_t *src;
+        size_t count = read_span(pos + copied, &src);
+        if (count == 0)
+            break;
+        if (count > n - copied)
+            count = n - copied;
+
+        memcpy(dst + copied, src, count * sizeof(int16_t));
+        copied += count;
+    }
+    return copied;
+}
+
+void SegmentedAudioBuffer::clear()
+{
+    while (used_blocks_ > 0)
+    {
+        free_list_[free_count_++] = blocks_[--used_blocks_];
+    }
+    size_ = 0;
+}
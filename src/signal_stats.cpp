@@ -0,0 +1,87 @@
+#include "signal_stats.h"
+
+#define SIGNAL_BLOCK_SAMPLES 32768 // keeps the per-block sum inside int32
+
+void signal_stats_reset(SignalStats *stats)
+{
+    stats->samples = 0;
+    stats->peak = 0;
+    stats->sum = 0;
+    stats->sum_squares = 0;
+    stats->clipped = 0;
+    stats->silent = 0;
+}
+
+void signal_stats_update(SignalStats *stats, const int16_t *samples, size_t count)
+{
+    while (count > 0)
+    {
+        size_t n = count < SIGNAL_BLOCK_SAMPLES ? count : SIGNAL_BLOCK_SAMPLES;
+        int32_t sum = 0;
+        uint64_t sum_squares = 0;
+        uint32_t peak = stats->peak;
+        uint32_t clipped = 0;
+        uint32_t silent = 0;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            int32_t s = samples[i];
+            uint32_t mag = s < 0 ? -s : s;
+            sum += s;
+            sum_squares += (uint32_t)(s * s);
+            if (mag > peak)
+                peak = mag;
+            clipped += mag >= SIGNAL_CLIP_LEVEL;
+            silent += mag < SIGNAL_SILENCE_LEVEL;
+        }
+
+        stats->samples += n;
+        stats->peak = peak;
+        stats->sum += sum;
+        stats->sum_squares += sum_squares;
+        stats->clipped += clipped;
+        stats->silent += silent;
+
+        samples += n;
+        count -= n;
+    }
+}
+
+uint32_t signal_stats_rms(const SignalStats *stats)
+{
+    return stats->samples == 0 ? 0 : isqrt64(stats->sum_squares / stats->samples);
+}
+
+int32_t signal_stats_dc(const SignalStats *stats)
+{
+    return stats->samples == 0 ? 0 : (int32_t)(stats->sum / (int64_t)stats->samples);
+}
+
+uint32_t signal_stats_silence_permille(const SignalStats *stats)
+{
+    return stats->samples == 0 ? 0 : (uint32_t)((uint64_t)stats->silent * 1000 / stats->samples);
+}
+
+uint32_t isqrt64(uint64_t value)
+{
+    // Bit-by-bit: one candidate bit per iteration, no division
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > value)
+        bit >>= 2;
+
+    while (bit != 0)
+    {
+        if (value >= result + bit)
+        {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else
+        {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)result;
+}
@@ -0,0 +1,223 @@
+#include "time_stretch.h"
+
+#include <cstring>
+#include "audio_dsp.h"
+
+#define TSM_CORR_SHIFT 8        // products scaled so 240 of them fit an int32
+#define TSM_SILENCE_ENERGY 4096 // template energy (scaled) below which alignment is skipped
+
+bool WsolaStretcher::init(uint32_t sample_rate)
+{
+    overlap_ = 0;
+    size_t overlap = (size_t)sample_rate * TSM_OVERLAP_MS / 1000 & ~(size_t)1;
+    size_t seek = (size_t)sample_rate * TSM_SEEK_MS / 1000 & ~(size_t)1;
+    if (overlap == 0 || overlap > TSM_MAX_OVERLAP || seek > TSM_MAX_SEEK)
+        return false;
+
+    overlap_ = overlap;
+    seek_ = seek;
+    set_speed(speed_);
+    reset();
+    return true;
+}
+
+void WsolaStretcher::reset()
+{
+    len_ = 0;
+    pos_q8_ = 0;
+    next_ = 0;
+    started_ = false;
+    finishing_ = false;
+    tmpl_len_ = 0;
+    out_len_ = 0;
+    out_pos_ = 0;
+}
+
+void WsolaStretcher::set_speed(uint32_t percent)
+{
+    if (percent < TSM_MIN_SPEED)
+        percent = TSM_MIN_SPEED;
+    if (percent > TSM_MAX_SPEED)
+        percent = TSM_MAX_SPEED;
+
+    speed_ = percent;
+    hop_q8_ = (uint32_t)(overlap_ * percent * 256 / 100);
+}
+
+size_t WsolaStretcher::process(const int16_t *in, size_t in_count, int16_t *out, size_t out_capacity, size_t *consumed)
+{
+    size_t used = 0;
+    size_t produced = 0;
+
+    for (;;)
+    {
+        // Hand out the finished block first
+        size_t n = out_len_ - out_pos_;
+        if (n > out_capacity - produced)
+            n = out_capacity - produced;
+        memcpy(out + produced, out_ + out_pos_, n * sizeof(int16_t));
+        out_pos_ += n;
+        produced += n;
+        if (out_pos_ < out_len_ || produced == out_capacity)
+            break;
+
+        // Top up the input window
+        n = TSM_BUFFER_SAMPLES - len_;
+        if (n > in_count - used)
+            n = in_count - used;
+        if (n > 0)
+        {
+            memcpy(buf_ + len_, in + used, n * sizeof(int16_t));
+            len_ += n;
+            used += n;
+        }
+
+        if (!(finishing_ ? drain_step() : step()))
+            break;
+    }
+
+    *consumed = used;
+    return produced;
+}
+
+// Build the next output block; false until enough input is buffered
+bool WsolaStretcher::step()
+{
+    if (!started_)
+    {
+        // First block goes out as is; its continuation becomes the template
+        if (len_ < 2 * overlap_)
+            return false;
+
+        memcpy(out_, buf_, overlap_ * sizeof(int16_t));
+        memcpy(tmpl_, buf_ + overlap_, overlap_ * sizeof(int16_t));
+        tmpl_len_ = overlap_;
+        next_ = 2 * overlap_;
+        pos_q8_ = hop_q8_;
+        started_ = true;
+    }
+    else
+    {
+        size_t nominal = pos_q8_ >> 8;
+        if (len_ < nominal + seek_ + 2 * overlap_)
+            return false;
+
+        size_t best = best_offset(nominal);
+        crossfade_linear(tmpl_, buf_ + best, out_, overlap_);
+        memcpy(tmpl_, buf_ + best + overlap_, overlap_ * sizeof(int16_t));
+        next_ = best + 2 * overlap_;
+        pos_q8_ += hop_q8_;
+    }
+    out_len_ = overlap_;
+    out_pos_ = 0;
+
+    // Drop input no later candidate (or the flush) can reach
+    size_t nominal = pos_q8_ >> 8;
+    size_t drop = nominal > seek_ ? nominal - seek_ : 0;
+    if (drop > next_)
+        drop = next_;
+    if (drop > len_)
+        drop = len_;
+    if (drop > 0)
+    {
+        memmove(buf_, buf_ + drop, (len_ - drop) * sizeof(int16_t));
+        len_ -= drop;
+        next_ -= drop;
+        pos_q8_ -= (uint32_t)drop << 8;
+    }
+    return true;
+}
+
+// After finish(): the template, then the rest of the input in order
+bool WsolaStretcher::drain_step()
+{
+    if (tmpl_len_ > 0)
+    {
+        memcpy(out_, tmpl_, tmpl_len_ * sizeof(int16_t));
+        out_len_ = tmpl_len_;
+        tmpl_len_ = 0;
+    }
+    else
+    {
+        if (next_ >= len_)
+            return false;
+
+        out_len_ = len_ - next_ < TSM_MAX_OVERLAP ? len_ - next_ : TSM_MAX_OVERLAP;
+        memcpy(out_, buf_ + next_, out_len_ * sizeof(int16_t));
+        next_ += out_len_;
+    }
+    out_pos_ = 0;
+    return true;
+}
+
+// Decimated dot product of the template with the candidate at offset, plus the candidate's energy
+int32_t WsolaStretcher::correlate(size_t offset, int32_t *energy) const
+{
+    const int16_t *c = buf_ + offset;
+    int32_t dot = 0;
+    int32_t e = 0;
+    for (size_t i = 0; i < overlap_; i += 2)
+    {
+        dot += ((int32_t)tmpl_[i] * c[i]) >> TSM_CORR_SHIFT;
+        e += ((int32_t)c[i] * c[i]) >> TSM_CORR_SHIFT;
+    }
+    *energy = e;
+    return dot;
+}
+
+size_t WsolaStretcher::best_offset(size_t nominal) const
+{
+    int32_t tmpl_energy = 0;
+    for (size_t i = 0; i < overlap_; i += 2)
+    {
+        tmpl_energy += ((int32_t)tmpl_[i] * tmpl_[i]) >> TSM_CORR_SHIFT;
+    }
+    if (tmpl_energy < TSM_SILENCE_ENERGY)
+        return nominal; // nothing to line up with
+
+    size_t lo = nominal > seek_ ? nominal - seek_ : 0;
+    size_t hi = nominal + seek_;
+
+    // Coarse pass over every second lag; the candidate energy slides along with it
+    int32_t energy;
+    int32_t dot = correlate(lo, &energy);
+    size_t best = lo;
+    float best_score = -1e30f;
+    for (size_t k = lo;; k += 2)
+    {
+        float score = (float)dot * (dot < 0 ? -(float)dot : (float)dot) / (float)(energy + 1);
+        if (score > best_score)
+        {
+            best_score = score;
+            best = k;
+        }
+        if (k + 2 > hi)
+            break;
+
+        energy += (((int32_t)buf_[k + overlap_] * buf_[k + overlap_]) >> TSM_CORR_SHIFT) -
+                  (((int32_t)buf_[k] * buf_[k]) >> TSM_CORR_SHIFT);
+        dot = 0;
+        for (size_t i = 0; i < overlap_; i += 2)
+        {
+            dot += ((int32_t)tmpl_[i] * buf_[k + 2 + i]) >> TSM_CORR_SHIFT;
+        }
+    }
+
+    // Refine between the coarse lags
+    size_t coarse = best;
+    for (int d = -1; d <= 1; d += 2)
+    {
+        size_t k = d < 0 ? coarse - 1 : coarse + 1;
+        if ((d < 0 && coarse <= lo) || k > hi)
+            continue;
+
+        dot = correlate(k, &energy);
+        float score = (float)dot * (dot < 0 ? -(float)dot : (float)dot) / (float)(energy + 1);
+        if (score > best_score)
+        {
+            best_score = score;
+            best = k;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,242 @@
+#include "tts_cache.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const uint32_t INDEX_MAGIC = 0x31435454; // "TTC1"
+
+// Index file: magic, count, clock, then count entries (little-endian, as stored in memory)
+struct IndexHeader
+{
+    uint32_t magic;
+    uint32_t count;
+    uint32_t clock;
+};
+
+bool TtsCache::begin(TtsCacheStorage *storage, uint32_t budget_bytes)
+{
+    storage_ = storage;
+    budget_ = budget_bytes;
+    count_ = 0;
+    clock_ = 0;
+    index_dirty_ = false;
+    storing_ = false;
+    if (storage_ == nullptr)
+        return false;
+
+    IndexHeader header;
+    if (storage_->read(TTS_CACHE_INDEX_PATH, 0, (uint8_t *)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != INDEX_MAGIC || header.count > TTS_CACHE_MAX_ENTRIES)
+    {
+        return true; // empty (or unreadable) index: start over
+    }
+
+    size_t bytes = header.count * sizeof(Entry);
+    if (storage_->read(TTS_CACHE_INDEX_PATH, sizeof(header), (uint8_t *)entries_, bytes) != bytes)
+        return true;
+
+    count_ = header.count;
+    clock_ = header.clock;
+
+    // A smaller budget than last boot: trim now rather than on the next store
+    evict_for(0);
+    return true;
+}
+
+uint64_t TtsCache::key_for(const char *text)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const uint8_t *p = (const uint8_t *)text; *p != 0; p++)
+    {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool TtsCache::lookup(uint64_t key, TtsAudioHeader *header)
+{
+    int index = find(key);
+    if (index < 0)
+        return false;
+
+    char path[32];
+    entry_path(key, path, sizeof(path));
+    if (storage_->read(path, 0, (uint8_t *)header, sizeof(*header)) != sizeof(*header) ||
+        header->data_bytes + sizeof(*header) != entries_[index].bytes)
+    {
+        // File lost or damaged behind our back: miss, and evict it first on the next store,
+        // which also removes the file
+        entries_[index].last_used = 0;
+        index_dirty_ = true;
+        return false;
+    }
+
+    entries_[index].last_used = ++clock_;
+    index_dirty_ = true;
+    return true;
+}
+
+size_t TtsCache::read_audio(uint64_t key, size_t offset, uint8_t *dst, size_t len)
+{
+    char path[32];
+    entry_path(key, path, sizeof(path));
+    return storage_->read(path, sizeof(TtsAudioHeader) + offset, dst, len);
+}
+
+bool TtsCache::store_begin(uint64_t key, const TtsAudioHeader &header)
+{
+    if (storage_ == nullptr)
+        return false;
+    if (storing_)
+        store_abort();
+
+    uint32_t bytes = sizeof(header) + header.data_bytes;
+    if (bytes > budget_)
+        return false;
+
+    // Replacing an entry: drop the old one first so it doesn't count against the budget
+    int existing = find(key);
+    if (existing >= 0)
+        remove_at(existing);
+
+    if (!evict_for(bytes))
+        return false;
+
+    char path[32];
+    entry_path(key, path, sizeof(path));
+    if (!storage_->write(path, (const uint8_t *)&header, sizeof(header)))
+    {
+        save_index();
+        return false;
+    }
+
+    storing_ = true;
+    store_key_ = key;
+    store_expected_ = header.data_bytes;
+    store_written_ = 0;
+    return true;
+}
+
+bool TtsCache::store_append(const uint8_t *data, size_t len)
+{
+    if (!storing_)
+        return false;
+
+    char path[32];
+    entry_path(store_key_, path, sizeof(path));
+    if (store_written_ + len > store_expected_ || !storage_->append(path, data, len))
+    {
+        store_abort();
+        return false;
+    }
+    store_written_ += len;
+    return true;
+}
+
+bool TtsCache::store_commit()
+{
+    if (!storing_)
+        return false;
+    if (store_written_ != store_expected_)
+    {
+        store_abort();
+        return false;
+    }
+
+    // Room was made in store_begin()
+    Entry &entry = entries_[count_++];
+    entry.key = store_key_;
+    entry.bytes = sizeof(TtsAudioHeader) + store_expected_;
+    entry.last_used = ++clock_;
+    storing_ = false;
+    return save_index();
+}
+
+void TtsCache::store_abort()
+{
+    if (!storing_)
+        return;
+
+    char path[32];
+    entry_path(store_key_, path, sizeof(path));
+    storage_->remove(path);
+    storing_ = false;
+    save_index(); // store_begin() may have evicted entries
+}
+
+uint32_t TtsCache::used_bytes() const
+{
+    uint32_t total = 0;
+    for (size_t i = 0; i < count_; i++)
+    {
+        total += entries_[i].bytes;
+    }
+    return total;
+}
+
+int TtsCache::find(uint64_t key) const
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        if (entries_[i].key == key)
+            return (int)i;
+    }
+    return -1;
+}
+
+void TtsCache::remove_at(size_t index)
+{
+    entries_[index] = entries_[count_ - 1];
+    count_--;
+}
+
+// Evict least recently used entries until bytes more fit in the budget and a slot is free
+bool TtsCache::evict_for(uint32_t bytes)
+{
+    if (bytes > budget_)
+        return false;
+
+    bool evicted = false;
+    while (count_ > 0 && (used_bytes() + bytes > budget_ || count_ >= TTS_CACHE_MAX_ENTRIES))
+    {
+        size_t oldest = 0;
+        for (size_t i = 1; i < count_; i++)
+        {
+            if (entries_[i].last_used < entries_[oldest].last_used)
+                oldest = i;
+        }
+
+        char path[32];
+        entry_path(entries_[oldest].key, path, sizeof(path));
+        storage_->remove(path);
+        remove_at(oldest);
+        evicted = true;
+    }
+
+    if (evicted)
+        save_index();
+    return true;
+}
+
+bool TtsCache::flush()
+{
+    if (storage_ == nullptr || storing_)
+        return false;
+    return !index_dirty_ || save_index();
+}
+
+bool TtsCache::save_index()
+{
+    uint8_t buffer[sizeof(IndexHeader) + sizeof(entries_)];
+    IndexHeader header = {INDEX_MAGIC, (uint32_t)count_, clock_};
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), entries_, count_ * sizeof(Entry));
+    index_dirty_ = !storage_->write(TTS_CACHE_INDEX_PATH, buffer, sizeof(header) + count_ * sizeof(Entry));
+    return !index_dirty_;
+}
+
+void TtsCache::entry_path(uint64_t key, char *path, size_t len)
+{
+    snprintf(path, len, TTS_CACHE_DIR "/%08lx%08lx.bin", (unsigned long)(key >> 32), (unsigned long)(key & 0xffffffff));
+}
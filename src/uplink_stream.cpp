@@ -0,0 +1,117 @@
+#include "uplink_stream.h"
+
+#include <cstring>
+
+UplinkStream::UplinkStream()
+    : sample_rate_(0), frame_samples_(0), source_(nullptr), sink_(nullptr), context_(nullptr),
+      cycle_counter_(nullptr), utterance_id_(0), codec_(UPLINK_CODEC_PCM16), binary_(false), seq_(0),
+      start_pos_(0), sent_pos_(0), frames_sent_(0), encode_cycles_(0)
+{
+    ima_adpcm_reset(&adpcm_);
+}
+
+bool UplinkStream::init(uint32_t sample_rate, size_t frame_samples, UplinkSource source, UplinkSink sink,
+                        void *context)
+{
+    if (frame_samples == 0 || frame_samples > UPLINK_MAX_FRAME_SAMPLES || source == nullptr || sink == nullptr)
+        return false;
+
+    sample_rate_ = sample_rate;
+    frame_samples_ = frame_samples;
+    source_ = source;
+    sink_ = sink;
+    context_ = context;
+    return true;
+}
+
+bool UplinkStream::send_frame(uint8_t type, size_t payload_len)
+{
+    size_t len = wire_finish(tx_, type, utterance_id_, seq_++, payload_len);
+    return sink_(context_, tx_, len);
+}
+
+void UplinkStream::begin(uint32_t utterance_id, UplinkCodec codec, bool binary)
+{
+    utterance_id_ = utterance_id;
+    codec_ = codec;
+    binary_ = binary;
+    seq_ = 0;
+    start_pos_ = 0;
+    sent_pos_ = 0;
+    frames_sent_ = 0;
+    ima_adpcm_reset(&adpcm_);
+    encode_cycles_ = 0;
+
+    if (binary_)
+    {
+        WireWriter w;
+        wire_writer_init(&w, frame_payload(), frame_payload_capacity());
+        wire_put_u32(&w, sample_rate_);
+        wire_put_u8(&w, codec_);
+        wire_put_u16(&w, (uint16_t)(frame_samples_ * 1000 / sample_rate_));
+        send_frame(WIRE_UTTERANCE_START, w.len);
+    }
+}
+
+void UplinkStream::skip_to(size_t pos)
+{
+    start_pos_ = pos;
+    if (sent_pos_ < pos)
+        sent_pos_ = pos;
+}
+
+size_t UplinkStream::pump(size_t limit, bool flush)
+{
+    size_t sent = 0;
+    while (limit > sent_pos_)
+    {
+        size_t pending = limit - sent_pos_;
+        if (pending < frame_samples_ && !flush)
+            break;
+
+        size_t samples = pending < frame_samples_ ? pending : frame_samples_;
+        const int16_t *frame = source_(context_, sent_pos_, samples, scratch_);
+
+        // Build the frame payload behind the header, where a wire frame needs it
+        uint8_t *out = tx_ + WIRE_HEADER_BYTES;
+        const uint8_t *payload = out;
+        size_t out_len = samples * sizeof(int16_t);
+        if (codec_ == UPLINK_CODEC_IMA_ADPCM)
+        {
+            uint32_t cycles_start = cycle_counter_ != nullptr ? cycle_counter_() : 0;
+            out_len = ima_adpcm_encode_frame(&adpcm_, frame, samples, out);
+            if (cycle_counter_ != nullptr)
+                encode_cycles_ += cycle_counter_() - cycles_start;
+        }
+        else if (binary_)
+        {
+            memcpy(out, frame, out_len);
+        }
+        else
+        {
+            payload = (const uint8_t *)frame; // bare PCM goes out as it is
+        }
+
+        if (binary_)
+            send_frame(WIRE_UTTERANCE_AUDIO, out_len);
+        else
+            sink_(context_, payload, out_len);
+
+        sent_pos_ += samples;
+        frames_sent_++;
+        sent++;
+    }
+    return sent;
+}
+
+void UplinkStream::end()
+{
+    if (!binary_)
+        return;
+
+    WireWriter w;
+    wire_writer_init(&w, frame_payload(), frame_payload_capacity());
+    wire_put_u32(&w, frames_sent_);
+    wire_put_u32(&w, (uint32_t)samples_sent());
+    send_frame(WIRE_UTTERANCE_END, w.len);
+}
@@ -0,0 +1,157 @@
+#include "vad.h"
+
+VadConfig vad_default_config(uint32_t sample_rate, uint16_t frame_samples)
+{
+    VadConfig config;
+    config.sample_rate = sample_rate;
+    config.frame_samples = frame_samples;
+    config.min_speech_ms = 60;
+    config.hangover_ms = 200;
+    config.noise_seed_ms = 100;
+    config.trailing_silence_ms = 800;
+    config.lead_in_ms = 200;
+    config.tail_ms = 150;
+    config.energy_ratio_q4 = 64;     // 4x (+6 dB) over the noise floor
+    config.fricative_ratio_q4 = 32;  // 2x (+3 dB) when the ZCR looks like a fricative
+    config.zcr_min_q8 = 77;          // 0.3 crossings/sample
+    config.zcr_max_q8 = 192;         // 0.75 crossings/sample, above that it is hiss
+    config.min_energy = 2500;        // mean square of ~50 LSB RMS
+    return config;
+}
+
+VoiceActivityDetector::VoiceActivityDetector()
+{
+    init(vad_default_config(16000, 320));
+}
+
+void VoiceActivityDetector::init(const VadConfig &config)
+{
+    config_ = config;
+    reset();
+}
+
+void VoiceActivityDetector::reset()
+{
+    noise_floor_ = 0;
+    last_energy_ = 0;
+    onset_frames_ = 0;
+    hangover_left_ = 0;
+    speech_started_ = false;
+    speech_ended_ = false;
+    samples_processed_ = 0;
+    speech_start_sample_ = 0;
+    speech_end_sample_ = 0;
+}
+
+uint32_t VoiceActivityDetector::ms_to_frames(uint16_t ms) const
+{
+    uint32_t frame_ms_x1000 = (uint32_t)config_.frame_samples * 1000;
+    return ((uint32_t)ms * config_.sample_rate + frame_ms_x1000 - 1) / frame_ms_x1000;
+}
+
+size_t VoiceActivityDetector::ms_to_samples(uint16_t ms) const
+{
+    return (size_t)ms * config_.sample_rate / 1000;
+}
+
+VadEvent VoiceActivityDetector::process_frame(const int16_t *frame)
+{
+    const uint32_t n = config_.frame_samples;
+    size_t frame_start = samples_processed_;
+    samples_processed_ += n;
+
+    if (speech_ended_)
+        return VAD_EVENT_NONE;
+
+    // Mean energy and zero crossings in one pass
+    uint64_t sum_squares = 0;
+    uint32_t crossings = 0;
+    int16_t prev = frame[0];
+    for (uint32_t i = 0; i < n; i++)
+    {
+        int32_t s = frame[i];
+        sum_squares += (uint32_t)(s * s);
+        crossings += (uint32_t)((s ^ prev) < 0);
+        prev = frame[i];
+    }
+    uint32_t energy = (uint32_t)(sum_squares / n);
+    uint32_t zcr_q8 = (crossings << 8) / n;
+    last_energy_ = energy;
+
+    // The quietest of the opening frames seeds the noise floor, so speech that is already
+    // under way when the recording starts doesn't set it
+    bool seeding = frame_start < ms_to_samples(config_.noise_seed_ms);
+    if (frame_start == 0 || (seeding && energy < noise_floor_))
+        noise_floor_ = energy;
+
+    uint64_t floor = noise_floor_ > config_.min_energy ? noise_floor_ : config_.min_energy;
+    bool loud = (uint64_t)energy * 16 > floor * config_.energy_ratio_q4;
+    bool fricative = (uint64_t)energy * 16 > floor * config_.fricative_ratio_q4 &&
+                     zcr_q8 >= config_.zcr_min_q8 && zcr_q8 <= config_.zcr_max_q8;
+    bool is_speech = loud || fricative;
+
+    VadEvent event = VAD_EVENT_NONE;
+
+    if (is_speech)
+    {
+        onset_frames_++;
+        hangover_left_ = ms_to_frames(config_.hangover_ms);
+        speech_end_sample_ = samples_processed_;
+
+        if (!speech_started_ && onset_frames_ >= ms_to_frames(config_.min_speech_ms))
+        {
+            speech_started_ = true;
+            speech_start_sample_ = samples_processed_ - onset_frames_ * n;
+            event = VAD_EVENT_SPEECH_START;
+        }
+    }
+    else
+    {
+        onset_frames_ = 0;
+        if (hangover_left_ > 0)
+            hangover_left_--;
+
+        // Track the noise floor only outside speech: fall quickly, rise slowly
+        if (hangover_left_ == 0 && !seeding)
+        {
+            int32_t diff = (int32_t)energy - (int32_t)noise_floor_;
+            noise_floor_ += diff < 0 ? diff / 4 : diff / 64;
+        }
+
+        if (speech_started_ && samples_processed_ - speech_end_sample_ >= ms_to_samples(config_.trailing_silence_ms))
+        {
+            speech_ended_ = true;
+            event = VAD_EVENT_SPEECH_END;
+        }
+    }
+
+    return event;
+}
+
+size_t VoiceActivityDetector::trim_start() const
+{
+    if (!speech_started_)
+        return 0;
+
+    size_t lead_in = ms_to_samples(config_.lead_in_ms);
+    return speech_start_sample_ > lead_in ? speech_start_sample_ - lead_in : 0;
+}
+
+size_t VoiceActivityDetector::trim_end(size_t total_samples) const
+{
+    if (!speech_started_)
+        return total_samples;
+
+    size_t end = speech_end_sample_ + ms_to_samples(config_.tail_ms);
+    return end < total_samples ? end : total_samples;
+}
+
+size_t VoiceActivityDetector::confirmed_end(size_t total_samples) const
+{
+    // Before onset nothing is confirmed; afterwards everything up to the last
+    // speech frame (plus tail) is, while trailing silence is held back in case
+    // the utterance ends and it gets trimmed.
+    if (!speech_started_)
+        return 0;
+    return trim_end(total_samples);
+}
@@ -0,0 +1,87 @@
+#include "wake_word.h"
+
+#include <cstring>
+
+WakeWordDetector::WakeWordDetector()
+    : history_(nullptr), history_frames_(0), threshold_(0.8f), recent_index_(0), last_probability_(0.0f), hops_(0),
+      refractory_hops_(0), last_detection_hop_(0), detected_before_(false)
+{
+    memset(recent_, 0, sizeof(recent_));
+}
+
+WakeWordDetector::~WakeWordDetector()
+{
+    delete[] history_;
+}
+
+bool WakeWordDetector::init(const uint8_t *model_blob, size_t model_length, uint32_t sample_rate, float threshold)
+{
+    if (!model_.load(model_blob, model_length) || model_.mel_bins() != LOG_MEL_BINS || model_.frames() < 2)
+        return false;
+
+    if (!features_.init(sample_rate, WAKE_WORD_HOP_SAMPLES, 20.0f, sample_rate / 2.0f))
+        return false;
+
+    delete[] history_;
+    history_ = new int8_t[model_.input_size()];
+    memset(history_, 0, model_.input_size());
+
+    threshold_ = threshold;
+    refractory_hops_ = (uint32_t)((uint64_t)WAKE_WORD_REFRACTORY_MS * sample_rate / 1000 / WAKE_WORD_HOP_SAMPLES);
+    hops_ = 0;
+    detected_before_ = false;
+    reset();
+    return true;
+}
+
+void WakeWordDetector::reset()
+{
+    history_frames_ = 0;
+    memset(recent_, 0, sizeof(recent_));
+    recent_index_ = 0;
+}
+
+bool WakeWordDetector::push_hop(const int16_t *hop)
+{
+    const size_t bins = model_.mel_bins();
+    const size_t frames = model_.frames();
+
+    float log_mel[LOG_MEL_BINS];
+    features_.push(hop, log_mel);
+    memmove(history_, history_ + bins, (frames - 1) * bins);
+    int8_t *newest = history_ + (frames - 1) * bins;
+    for (size_t b = 0; b < bins; b++)
+    {
+        newest[b] = model_.quantize_feature(log_mel[b]);
+    }
+
+    hops_++;
+    if (history_frames_ < frames)
+        history_frames_++;
+    return history_frames_ >= frames;
+}
+
+bool WakeWordDetector::infer()
+{
+    float probability = model_.keyword_probability(history_);
+    last_probability_ = probability;
+
+    recent_[recent_index_] = probability;
+    recent_index_ = (recent_index_ + 1) % WAKE_WORD_SMOOTHING;
+    float smoothed = 0.0f;
+    for (size_t i = 0; i < WAKE_WORD_SMOOTHING; i++)
+    {
+        smoothed += recent_[i];
+    }
+    smoothed /= WAKE_WORD_SMOOTHING;
+
+    if (smoothed < threshold_ || (detected_before_ && hops_ - last_detection_hop_ <= refractory_hops_))
+        return false;
+
+    last_detection_hop_ = hops_;
+    detected_before_ = true;
+
+    // Start over so the same utterance cannot trigger twice
+    reset();
+    return true;
+}
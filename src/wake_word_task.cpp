@@ -0,0 +1,150 @@
+#include "wake_word.h"
+
+#include <Arduino.h>
+#include <cstring>
+#include "spsc_ring_buffer.h"
+
+static WakeWordDetector detector;
+
+static SpscRingBuffer<int16_t> kws_ring;
+static int16_t kws_ring_storage[WAKE_WORD_RING_SAMPLES];
+
+static TaskHandle_t kws_task_handle = nullptr;
+static uint32_t kws_sample_rate = 16000;
+static uint32_t kws_budget_percent = 20;
+
+static volatile bool kws_listening = false;
+static volatile bool kws_restart = false; // set when listening resumes; task clears context
+static volatile bool kws_detected = false;
+
+static WakeWordStats stats;
+static uint64_t total_feature_cycles = 0;
+static uint64_t total_inference_cycles = 0;
+
+static void update_stride(uint32_t hop_cycles)
+{
+    // Cycles available per hop under the budget, after features (which always run)
+    uint32_t budget = hop_cycles / 100 * kws_budget_percent;
+    uint32_t feature = stats.feature_cycles;
+    uint32_t spare = budget > feature ? budget - feature : 1;
+    uint32_t stride = (stats.inference_cycles + spare - 1) / spare;
+    if (stride < 1)
+        stride = 1;
+    if (stride > WAKE_WORD_MAX_STRIDE)
+        stride = WAKE_WORD_MAX_STRIDE;
+    stats.stride = stride;
+}
+
+static void kws_task(void *arg)
+{
+    int16_t hop[WAKE_WORD_HOP_SAMPLES];
+    uint32_t hops_since_inference = 0;
+
+    const uint32_t hop_cycles = (uint32_t)((uint64_t)ESP.getCpuFreqMHz() * 1000000 * WAKE_WORD_HOP_SAMPLES / kws_sample_rate);
+
+    for (;;)
+    {
+        if (kws_restart)
+        {
+            kws_ring.discard();
+            detector.reset();
+            kws_restart = false;
+        }
+
+        if (kws_ring.available() < WAKE_WORD_HOP_SAMPLES)
+        {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        kws_ring.pop(hop, WAKE_WORD_HOP_SAMPLES);
+
+        // Features for every hop
+        uint32_t start = ESP.getCycleCount();
+        bool window_full = detector.push_hop(hop);
+        total_feature_cycles += ESP.getCycleCount() - start;
+        stats.hops++;
+        stats.feature_cycles = (uint32_t)(total_feature_cycles / stats.hops);
+
+        // Inference only once the window is full and the stride allows
+        if (!window_full || ++hops_since_inference < stats.stride)
+            continue;
+        hops_since_inference = 0;
+
+        start = ESP.getCycleCount();
+        bool detected = detector.infer();
+        total_inference_cycles += ESP.getCycleCount() - start;
+        stats.inferences++;
+        stats.inference_cycles = (uint32_t)(total_inference_cycles / stats.inferences);
+        stats.last_probability = detector.last_probability();
+
+        uint64_t used = total_feature_cycles + total_inference_cycles;
+        stats.load_permille = (uint32_t)(used * 1000 / ((uint64_t)hop_cycles * stats.hops));
+        update_stride(hop_cycles);
+
+        if (detected)
+        {
+            stats.detections++;
+            kws_detected = true;
+        }
+    }
+}
+
+bool wake_word_begin(const uint8_t *model_blob, size_t model_length, uint32_t sample_rate, float threshold,
+                     uint8_t cpu_budget_percent)
+{
+    if (kws_task_handle != nullptr)
+        return true;
+
+    if (!detector.init(model_blob, model_length, sample_rate, threshold))
+        return false;
+
+    kws_ring.init(kws_ring_storage, WAKE_WORD_RING_SAMPLES);
+
+    kws_sample_rate = sample_rate;
+    kws_budget_percent = cpu_budget_percent;
+    memset(&stats, 0, sizeof(stats));
+    stats.stride = 1;
+
+    return xTaskCreatePinnedToCore(kws_task, "wake_word", WAKE_WORD_TASK_STACK, nullptr, WAKE_WORD_TASK_PRIORITY,
+                                   &kws_task_handle, WAKE_WORD_TASK_CORE) == pdPASS;
+}
+
+bool wake_word_running()
+{
+    return kws_task_handle != nullptr;
+}
+
+void wake_word_feed(const int16_t *samples, size_t n)
+{
+    if (kws_task_handle == nullptr || !kws_listening)
+        return;
+
+    if (!kws_ring.push(samples, n))
+    {
+        stats.dropped_samples += n;
+    }
+}
+
+void wake_word_set_listening(bool listening)
+{
+    if (listening && !kws_listening)
+    {
+        kws_restart = true;
+        kws_detected = false;
+    }
+    kws_listening = listening;
+}
+
+bool wake_word_take_detection()
+{
+    if (!kws_detected)
+        return false;
+
+    kws_detected = false;
+    return true;
+}
+
+WakeWordStats wake_word_stats()
+{
+    return stats;
+}
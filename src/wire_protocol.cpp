@@ -0,0 +1,265 @@
+#include "wire_protocol.h"
+
+#include <cstring>
+
+#define WIRE_CRC_OFFSET 16
+
+static uint32_t crc_table[256];
+static bool crc_table_ready = false;
+
+static void build_crc_table()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+    crc_table_ready = true;
+}
+
+uint32_t wire_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    if (!crc_table_ready)
+        build_crc_table();
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint16_t load_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t load_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void store_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Header layout: magic u8, version u8, type u8, flags u8, turn u32, seq u32, length u32, crc u32
+WireStatus wire_parse(const uint8_t *frame, size_t len, WireHeader *header, const uint8_t **payload)
+{
+    if (len < WIRE_HEADER_BYTES)
+        return WIRE_BAD_LENGTH;
+    if (frame[0] != WIRE_MAGIC)
+        return WIRE_BAD_MAGIC;
+    if (frame[1] != WIRE_VERSION)
+        return WIRE_BAD_VERSION;
+
+    header->type = frame[2];
+    header->flags = frame[3];
+    header->turn = load_u32(frame + 4);
+    header->seq = load_u32(frame + 8);
+    header->length = load_u32(frame + 12);
+    if (header->length != len - WIRE_HEADER_BYTES)
+        return WIRE_BAD_LENGTH;
+
+    uint32_t crc = wire_crc32(0, frame, WIRE_CRC_OFFSET);
+    crc = wire_crc32(crc, frame + WIRE_HEADER_BYTES, header->length);
+    if (crc != load_u32(frame + WIRE_CRC_OFFSET))
+        return WIRE_BAD_CRC;
+
+    *payload = frame + WIRE_HEADER_BYTES;
+    return WIRE_OK;
+}
+
+size_t wire_finish(uint8_t *frame, uint8_t type, uint32_t turn, uint32_t seq, size_t payload_len)
+{
+    frame[0] = WIRE_MAGIC;
+    frame[1] = WIRE_VERSION;
+    frame[2] = type;
+    frame[3] = 0;
+    store_u32(frame + 4, turn);
+    store_u32(frame + 8, seq);
+    store_u32(frame + 12, (uint32_t)payload_len);
+
+    uint32_t crc = wire_crc32(0, frame, WIRE_CRC_OFFSET);
+    crc = wire_crc32(crc, frame + WIRE_HEADER_BYTES, payload_len);
+    store_u32(frame + WIRE_CRC_OFFSET, crc);
+    return WIRE_HEADER_BYTES + payload_len;
+}
+
+const char *wire_status_name(WireStatus status)
+{
+    switch (status)
+    {
+    case WIRE_OK:
+        return "ok";
+    case WIRE_BAD_LENGTH:
+        return "length mismatch";
+    case WIRE_BAD_MAGIC:
+        return "bad magic";
+    case WIRE_BAD_VERSION:
+        return "unsupported version";
+    case WIRE_BAD_CRC:
+        return "crc mismatch";
+    }
+    return "unknown";
+}
+
+bool wire_framing_accepted(const char *framing, int version)
+{
+    return framing != nullptr && strcmp(framing, "binary") == 0 && version == WIRE_VERSION;
+}
+
+void wire_writer_init(WireWriter *w, uint8_t *data, size_t capacity)
+{
+    w->data = data;
+    w->capacity = capacity;
+    w->len = 0;
+    w->ok = true;
+}
+
+// Room for n more bytes, or mark the writer failed
+static uint8_t *reserve(WireWriter *w, size_t n)
+{
+    if (!w->ok || w->capacity - w->len < n)
+    {
+        w->ok = false;
+        return nullptr;
+    }
+    uint8_t *p = w->data + w->len;
+    w->len += n;
+    return p;
+}
+
+void wire_put_u8(WireWriter *w, uint8_t v)
+{
+    uint8_t *p = reserve(w, 1);
+    if (p != nullptr)
+        p[0] = v;
+}
+
+void wire_put_u16(WireWriter *w, uint16_t v)
+{
+    uint8_t *p = reserve(w, 2);
+    if (p != nullptr)
+        store_u16(p, v);
+}
+
+void wire_put_u32(WireWriter *w, uint32_t v)
+{
+    uint8_t *p = reserve(w, 4);
+    if (p != nullptr)
+        store_u32(p, v);
+}
+
+void wire_put_u64(WireWriter *w, uint64_t v)
+{
+    uint8_t *p = reserve(w, 8);
+    if (p != nullptr)
+    {
+        store_u32(p, (uint32_t)v);
+        store_u32(p + 4, (uint32_t)(v >> 32));
+    }
+}
+
+void wire_put_str(WireWriter *w, const char *s)
+{
+    size_t n = 0;
+    if (s != nullptr)
+    {
+        while (s[n] != 0)
+            n++;
+    }
+    if (n + 1 > WIRE_MAX_STRING)
+    {
+        w->ok = false;
+        return;
+    }
+
+    wire_put_u16(w, (uint16_t)(n + 1));
+    uint8_t *p = reserve(w, n + 1);
+    if (p == nullptr)
+        return;
+    for (size_t i = 0; i < n; i++)
+    {
+        p[i] = (uint8_t)s[i];
+    }
+    p[n] = 0;
+}
+
+void wire_reader_init(WireReader *r, const uint8_t *data, size_t len)
+{
+    r->data = data;
+    r->len = len;
+    r->pos = 0;
+    r->ok = true;
+}
+
+// Next n bytes of the payload, or nullptr (and the reader failed) if it is shorter
+static const uint8_t *take(WireReader *r, size_t n)
+{
+    if (!r->ok || r->len - r->pos < n)
+    {
+        r->ok = false;
+        return nullptr;
+    }
+    const uint8_t *p = r->data + r->pos;
+    r->pos += n;
+    return p;
+}
+
+uint8_t wire_get_u8(WireReader *r)
+{
+    const uint8_t *p = take(r, 1);
+    return p != nullptr ? p[0] : 0;
+}
+
+uint16_t wire_get_u16(WireReader *r)
+{
+    const uint8_t *p = take(r, 2);
+    return p != nullptr ? load_u16(p) : 0;
+}
+
+uint32_t wire_get_u32(WireReader *r)
+{
+    const uint8_t *p = take(r, 4);
+    return p != nullptr ? load_u32(p) : 0;
+}
+
+uint64_t wire_get_u64(WireReader *r)
+{
+    const uint8_t *p = take(r, 8);
+    return p != nullptr ? (uint64_t)load_u32(p) | ((uint64_t)load_u32(p + 4) << 32) : 0;
+}
+
+const char *wire_get_str(WireReader *r)
+{
+    uint16_t n = wire_get_u16(r);
+    if (n == 0 || n > WIRE_MAX_STRING)
+    {
+        r->ok = false;
+        return "";
+    }
+
+    const uint8_t *p = take(r, n);
+    if (p == nullptr || p[n - 1] != 0)
+    {
+        r->ok = false;
+        return "";
+    }
+    return (const char *)p;
+}
@@ -0,0 +1,497 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "audio_dsp.h"
+
+#define RATE 16000
+#define BLOCK 320
+
+void setUp() {}
+void tearDown() {}
+
+// Sine of the given amplitude and frequency plus a DC offset, continuing from *t. Tests use
+// frequencies with a whole number of cycles per block, so a block's mean is its DC.
+static void fill(int16_t *buf, size_t n, double *t, double amplitude, double hz, double dc)
+{
+    for (size_t i = 0; i < n; i++, *t += 1)
+        buf[i] = (int16_t)lround(dc + amplitude * std::sin(2 * M_PI * hz * *t / RATE));
+}
+
+static int32_t peak(const int16_t *buf, size_t n)
+{
+    int32_t p = 0;
+    for (size_t i = 0; i < n; i++)
+        p = abs(buf[i]) > p ? abs(buf[i]) : p;
+    return p;
+}
+
+static int32_t mean(const int16_t *buf, size_t n)
+{
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += buf[i];
+    return (int32_t)(sum / (int64_t)n);
+}
+
+static void test_chain_holds_at_most_max_stages()
+{
+    DspChain chain;
+    SoftLimiter lim;
+    soft_limiter_init(&lim, 20000);
+    for (int i = 0; i < DSP_MAX_STAGES; i++)
+        TEST_ASSERT_TRUE(chain.add(soft_limiter_process, &lim));
+    TEST_ASSERT_FALSE(chain.add(soft_limiter_process, &lim));
+    TEST_ASSERT_EQUAL_size_t(DSP_MAX_STAGES, chain.size());
+
+    DspChain empty;
+    TEST_ASSERT_FALSE(empty.add(nullptr, &lim));
+}
+
+// The extra fractional bits in the feedback keep the settled DC offset to an LSB or two
+static void test_dc_blocker_and_highpass_remove_offset()
+{
+    DcBlocker dc;
+    Biquad hp;
+    dc_blocker_init(&dc, RATE, 10);
+    biquad_init_highpass(&hp, RATE, 100, 0.707f);
+
+    int16_t a[BLOCK];
+    int16_t b[BLOCK];
+    double ta = 0;
+    double tb = 0;
+    for (int f = 0; f < 100; f++)
+    {
+        fill(a, BLOCK, &ta, 500, 400, 3000);
+        fill(b, BLOCK, &tb, 500, 400, 3000);
+        dc_blocker_process(&dc, a, BLOCK);
+        biquad_process(&hp, b, BLOCK);
+    }
+    TEST_ASSERT_INT_WITHIN(2, 0, mean(a, BLOCK));
+    TEST_ASSERT_INT_WITHIN(2, 0, mean(b, BLOCK));
+    TEST_ASSERT_INT_WITHIN(25, 500, peak(a, BLOCK));
+    TEST_ASSERT_INT_WITHIN(25, 500, peak(b, BLOCK));
+}
+
+static int32_t highpass_gain_permille(double hz)
+{
+    Biquad hp;
+    biquad_init_highpass(&hp, RATE, 100, 0.707f);
+    int16_t buf[BLOCK];
+    double t = 0;
+    for (int f = 0; f < 50; f++)
+    {
+        fill(buf, BLOCK, &t, 10000, hz, 0);
+        biquad_process(&hp, buf, BLOCK);
+    }
+    return peak(buf, BLOCK) / 10;
+}
+
+static void test_highpass_response()
+{
+    TEST_ASSERT_LESS_THAN(80, highpass_gain_permille(25));   // 2 octaves below: about -24 dB
+    TEST_ASSERT_INT_WITHIN(40, 707, highpass_gain_permille(100)); // -3 dB at the corner
+    TEST_ASSERT_INT_WITHIN(20, 1000, highpass_gain_permille(1000));
+}
+
+static void test_agc_brings_quiet_speech_to_target()
+{
+    Agc agc;
+    agc_init(&agc, RATE, 8000, 150, 2, 300, 16 * 4096 - 1);
+    int16_t buf[BLOCK];
+    double t = 0;
+    for (int f = 0; f < 200; f++)
+    {
+        fill(buf, BLOCK, &t, 1000, 300, 0);
+        agc_process(&agc, buf, BLOCK);
+    }
+    // The envelope follower's release sits a little under a sine's peak, so the output
+    // settles slightly above the target
+    TEST_ASSERT_GREATER_OR_EQUAL(8000, peak(buf, BLOCK));
+    TEST_ASSERT_LESS_OR_EQUAL(9600, peak(buf, BLOCK));
+}
+
+static void test_agc_gain_is_bounded()
+{
+    Agc agc;
+    agc_init(&agc, RATE, 8000, 150, 2, 300, 4 * 4096);
+    int16_t buf[BLOCK];
+    double t = 0;
+    for (int f = 0; f < 200; f++)
+    {
+        fill(buf, BLOCK, &t, 500, 300, 0);
+        agc_process(&agc, buf, BLOCK);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(4 * 4096, agc.gain_q12);
+
+    // Loud input never drops the gain below -12 dB
+    for (int f = 0; f < 200; f++)
+    {
+        fill(buf, BLOCK, &t, 32000, 300, 0);
+        agc_process(&agc, buf, BLOCK);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(4096 / 4, agc.gain_q12);
+}
+
+// Below the gate (background noise) the gain is left where speech put it
+static void test_agc_holds_gain_below_gate()
+{
+    Agc agc;
+    agc_init(&agc, RATE, 8000, 150, 2, 300, 16 * 4096 - 1);
+    int16_t buf[BLOCK];
+    double t = 0;
+    for (int f = 0; f < 200; f++)
+    {
+        fill(buf, BLOCK, &t, 4000, 300, 0);
+        agc_process(&agc, buf, BLOCK);
+    }
+    // Let the envelope release below the gate, then the gain must stay put
+    for (int f = 0; f < 100; f++)
+    {
+        fill(buf, BLOCK, &t, 60, 300, 0);
+        agc_process(&agc, buf, BLOCK);
+    }
+    TEST_ASSERT_LESS_THAN(150, agc.envelope);
+    int32_t held_gain = agc.gain_q12;
+    for (int f = 0; f < 200; f++)
+    {
+        fill(buf, BLOCK, &t, 60, 300, 0);
+        agc_process(&agc, buf, BLOCK);
+    }
+    TEST_ASSERT_EQUAL_INT32(held_gain, agc.gain_q12);
+    TEST_ASSERT_LESS_THAN(16 * 4096 - 1, agc.gain_q12);
+}
+
+static void test_soft_limiter_knee()
+{
+    SoftLimiter lim;
+    soft_limiter_init(&lim, 26000);
+    int16_t buf[6] = {1000, -26000, 26001, 30000, -32768, 32767};
+    soft_limiter_process(&lim, buf, 6);
+    TEST_ASSERT_EQUAL_INT16(1000, buf[0]);
+    TEST_ASSERT_EQUAL_INT16(-26000, buf[1]);
+    TEST_ASSERT_EQUAL_INT16(26000, buf[2]); // slope 1 at the knee, rounded down
+    TEST_ASSERT_TRUE(buf[3] > 26000 && buf[3] < 30000);
+    TEST_ASSERT_TRUE(buf[4] < -26000 && buf[4] > -32767);
+    TEST_ASSERT_TRUE(buf[5] > buf[3] && buf[5] < 32767);
+}
+
+// The capture chain as main.cpp builds it: an offset, mains hum and quiet speech in,
+// centred speech at the AGC target out
+static void test_frontend_chain()
+{
+    DcBlocker dc;
+    Biquad hp;
+    Agc agc;
+    SoftLimiter lim;
+    dc_blocker_init(&dc, RATE, 10);
+    biquad_init_highpass(&hp, RATE, 100, 0.707f);
+    agc_init(&agc, RATE, 8000, 150, 2, 300, 16 * 4096 - 1);
+    soft_limiter_init(&lim, 26000);
+    DspChain chain;
+    chain.add(dc_blocker_process, &dc);
+    chain.add(biquad_process, &hp);
+    chain.add(agc_process, &agc);
+    chain.add(soft_limiter_process, &lim);
+
+    int16_t buf[BLOCK];
+    double t = 0;
+    for (int f = 0; f < 200; f++)
+    {
+        for (size_t i = 0; i < BLOCK; i++, t++)
+            buf[i] = (int16_t)(3000 + 500 * std::sin(2 * M_PI * 400 * t / RATE) + 400 * std::sin(2 * M_PI * 50 * t / RATE));
+        chain.process(buf, BLOCK);
+    }
+    TEST_ASSERT_INT_WITHIN(50, 0, mean(buf, BLOCK));
+    TEST_ASSERT_GREATER_OR_EQUAL(8000, peak(buf, BLOCK));
+    TEST_ASSERT_LESS_OR_EQUAL(9600, peak(buf, BLOCK));
+}
+
+// Output dynamics, with the playback settings from audio_playback.h
+#define OUT_RATE 24000
+
+static LookaheadLimiter limiter;
+static LoudnessNormalizer loudness;
+
+static void init_output_stages()
+{
+    lookahead_limiter_init(&limiter, OUT_RATE, 24000, 2000, 80);
+    loudness_normalizer_init(&loudness, OUT_RATE, 3000, 300, 3000, 1024, 16384);
+}
+
+// Static curve of the limiter: settled output peak for a 1 kHz tone at each input level
+static void test_limiter_gain_curve()
+{
+    init_output_stages();
+    TEST_ASSERT_EQUAL_UINT32(48, limiter.lookahead); // 2 ms at 24 kHz
+
+    const int levels[] = {8000, 16000, 24000, 28000, 32000};
+    for (size_t l = 0; l < 5; l++)
+    {
+        lookahead_limiter_reset(&limiter);
+        std::vector<int16_t> buf(OUT_RATE / 2);
+        double t = 0;
+        for (size_t i = 0; i < buf.size(); i++, t++)
+            buf[i] = (int16_t)lround(levels[l] * std::sin(2 * M_PI * 1000 * t / OUT_RATE));
+        for (size_t o = 0; o < buf.size(); o += 1024)
+            lookahead_limiter_process(&limiter, &buf[o], buf.size() - o < 1024 ? buf.size() - o : 1024);
+        int32_t out = peak(&buf[buf.size() / 2], buf.size() / 2);
+
+        char report[64];
+        snprintf(report, sizeof(report), "limiter: in %5d -> out %5d", levels[l], (int)out);
+        TEST_MESSAGE(report);
+        if (levels[l] <= 24000)
+            TEST_ASSERT_INT_WITHIN(2, levels[l], out); // transparent below the threshold
+        else
+            TEST_ASSERT_INT_WITHIN(100, 24000, out);
+    }
+}
+
+// A step from silence to near full scale is caught inside the look-ahead
+static void test_limiter_catches_a_cold_step()
+{
+    init_output_stages();
+    std::vector<int16_t> buf(4800, 0);
+    double t = 0;
+    for (size_t i = 2400; i < buf.size(); i++, t++)
+        buf[i] = (int16_t)lround(32000 * std::sin(2 * M_PI * 1000 * t / OUT_RATE));
+    lookahead_limiter_process(&limiter, buf.data(), buf.size());
+    TEST_ASSERT_LESS_OR_EQUAL(24000 + 240, peak(buf.data(), buf.size()));
+
+    // The output is the input delayed by the look-ahead
+    TEST_ASSERT_EQUAL_INT16(0, buf[2400 + 47]);
+}
+
+// Settled output RMS of the normalizer for a range of input levels (target 3000, +-12 dB)
+static void test_normalizer_gain_curve()
+{
+    const int amplitudes[] = {500, 1500, 4000, 12000};
+    const int expected_rms[] = {1412, 3000, 3000, 3000}; // 354 RMS in is held at the +12 dB cap
+    for (size_t l = 0; l < 4; l++)
+    {
+        init_output_stages();
+        double squares = 0;
+        size_t count = 0;
+        const size_t blocks = OUT_RATE * 6 / 1024;
+        for (size_t b = 0; b < blocks; b++)
+        {
+            int16_t buf[1024];
+            for (size_t i = 0; i < 1024; i++)
+                buf[i] = (int16_t)lround(amplitudes[l] * std::sin(2 * M_PI * 300 * (b * 1024 + i) / OUT_RATE));
+            loudness_normalizer_process(&loudness, buf, 1024);
+            if (b > OUT_RATE * 5 / 1024)
+            {
+                for (size_t i = 0; i < 1024; i++)
+                    squares += (double)buf[i] * buf[i];
+                count += 1024;
+            }
+        }
+        int rms = (int)std::sqrt(squares / count);
+
+        char report[80];
+        snprintf(report, sizeof(report), "normalizer: in rms %5d -> out rms %5d, gain %.2f",
+                 (int)(amplitudes[l] / std::sqrt(2.0)), rms, loudness.gain_q12 / 4096.0);
+        TEST_MESSAGE(report);
+        TEST_ASSERT_INT_WITHIN(expected_rms[l] / 20, expected_rms[l], rms);
+    }
+}
+
+// Pauses below the gate leave the level estimate and the gain alone
+static void test_normalizer_ignores_pauses()
+{
+    init_output_stages();
+    int16_t buf[1024];
+    double t = 0;
+    for (int b = 0; b < 100; b++)
+    {
+        fill(buf, 1024, &t, 1500, 300, 0);
+        loudness_normalizer_process(&loudness, buf, 1024);
+    }
+    int32_t gain = loudness.gain_q12;
+    uint32_t level = loudness.mean_square;
+    for (int b = 0; b < 100; b++)
+    {
+        fill(buf, 1024, &t, 100, 300, 0);
+        loudness_normalizer_process(&loudness, buf, 1024);
+    }
+    TEST_ASSERT_EQUAL_INT32(gain, loudness.gain_q12);
+    TEST_ASSERT_EQUAL_UINT32(level, loudness.mean_square);
+}
+
+// Largest sample-to-sample step, the click the envelope is there to avoid
+static int32_t max_jump(const int16_t *buf, size_t n)
+{
+    int32_t jump = 0;
+    for (size_t i = 1; i < n; i++)
+        jump = abs(buf[i] - buf[i - 1]) > jump ? abs(buf[i] - buf[i - 1]) : jump;
+    return jump;
+}
+
+static void test_envelope_fades_in_within_the_ramp()
+{
+    GainEnvelope env;
+    gain_envelope_init(&env, false);
+    gain_envelope_ramp(&env, true, 120);
+
+    std::vector<int16_t> buf(200, 10000);
+    gain_envelope_process(&env, buf.data(), buf.size());
+    TEST_ASSERT_LESS_OR_EQUAL(10000 / 120 + 1, buf[0]);
+    for (size_t i = 1; i < buf.size(); i++)
+        TEST_ASSERT_GREATER_OR_EQUAL(buf[i - 1], buf[i]);
+    TEST_ASSERT_EQUAL_INT16(10000, buf[119]);
+    TEST_ASSERT_TRUE(gain_envelope_settled(&env));
+
+    // Open and settled: later blocks pass untouched
+    int16_t block[4] = {-32768, 32767, 5, -5};
+    gain_envelope_process(&env, block, 4);
+    TEST_ASSERT_EQUAL_INT16(-32768, block[0]);
+    TEST_ASSERT_EQUAL_INT16(32767, block[1]);
+}
+
+// Reversing halfway carries on from the current gain, and a closed envelope clears the rest
+static void test_envelope_reverses_without_a_step()
+{
+    GainEnvelope env;
+    gain_envelope_init(&env, false);
+    gain_envelope_ramp(&env, true, 100);
+
+    std::vector<int16_t> buf(300, 10000);
+    gain_envelope_process(&env, buf.data(), 50);
+    gain_envelope_ramp(&env, false, 100);
+    gain_envelope_process(&env, &buf[50], 250);
+
+    TEST_ASSERT_LESS_OR_EQUAL(10000 / 100 + 2, max_jump(buf.data(), buf.size()));
+    TEST_ASSERT_INT_WITHIN(200, 5000, buf[49]);
+    TEST_ASSERT_EQUAL_INT16(0, buf[149]);
+    for (size_t i = 150; i < buf.size(); i++)
+        TEST_ASSERT_EQUAL_INT16(0, buf[i]);
+}
+
+static void test_envelope_zero_length_ramp_jumps()
+{
+    GainEnvelope env;
+    gain_envelope_init(&env, true);
+    gain_envelope_ramp(&env, false, 0);
+    TEST_ASSERT_TRUE(gain_envelope_settled(&env));
+
+    int16_t block[3] = {1000, -1000, 7};
+    gain_envelope_process(&env, block, 3);
+    TEST_ASSERT_EQUAL_INT16(0, block[0]);
+    TEST_ASSERT_EQUAL_INT16(0, block[2]);
+}
+
+// Fading out the end of a tone instead of cutting it leaves no step bigger than the tone's own
+static void test_envelope_fade_out_removes_the_click()
+{
+    std::vector<int16_t> buf(OUT_RATE / 100 + 15); // ends near a peak
+    double t = 0;
+    fill(buf.data(), buf.size(), &t, 16000, 400, 0);
+    buf.push_back(0); // what follows: silence
+    int32_t tone_jump = max_jump(buf.data(), buf.size() - 1);
+    TEST_ASSERT_GREATER_THAN(tone_jump, abs(buf[buf.size() - 2])); // cut: a click
+
+    size_t fade = OUT_RATE * 5 / 1000;
+    GainEnvelope env;
+    gain_envelope_init(&env, true);
+    gain_envelope_ramp(&env, false, fade);
+    gain_envelope_process(&env, &buf[buf.size() - 1 - fade], fade);
+    TEST_ASSERT_LESS_OR_EQUAL(tone_jump, max_jump(buf.data(), buf.size()));
+    TEST_ASSERT_EQUAL_INT16(0, buf[buf.size() - 2]);
+}
+
+static void test_crossfade_runs_from_a_to_b()
+{
+    const size_t n = 480;
+    std::vector<int16_t> a(n, 8000);
+    std::vector<int16_t> b(n, -8000);
+    std::vector<int16_t> out(n);
+    crossfade_linear(a.data(), b.data(), out.data(), n);
+
+    TEST_ASSERT_INT_WITHIN(16000 / n + 1, 8000, out[0]);
+    TEST_ASSERT_INT_WITHIN(16000 / n + 1, -8000, out[n - 1]);
+    TEST_ASSERT_INT_WITHIN(16000 / n + 1, 0, out[n / 2]);
+    for (size_t i = 1; i < n; i++)
+        TEST_ASSERT_LESS_OR_EQUAL(out[i - 1], out[i]);
+
+    // The same block on both sides comes through unchanged (to rounding)
+    std::vector<int16_t> tone(n);
+    double t = 0;
+    fill(tone.data(), n, &t, 20000, 400, 0);
+    crossfade_linear(tone.data(), tone.data(), out.data(), n);
+    for (size_t i = 0; i < n; i++)
+        TEST_ASSERT_INT_WITHIN(1, tone[i], out[i]);
+}
+
+// Switching between opposite-phase tones: a cut steps by twice the level, a crossfade
+// stays within the tone's own slope plus one ramp step
+static void test_crossfade_joins_opposite_phases()
+{
+    const size_t n = OUT_RATE * 20 / 1000;
+    std::vector<int16_t> a(n);
+    std::vector<int16_t> b(n);
+    double t = 0;
+    fill(a.data(), n, &t, 12000, 400, 0);
+    for (size_t i = 0; i < n; i++)
+        b[i] = (int16_t)-a[i];
+
+    std::vector<int16_t> joined(a.begin(), a.begin() + n / 2);
+    std::vector<int16_t> out(n);
+    crossfade_linear(a.data() + n / 2, b.data(), out.data(), n / 2);
+    joined.insert(joined.end(), out.begin(), out.begin() + n / 2);
+    joined.insert(joined.end(), b.begin() + n / 2, b.end());
+
+    int32_t slope = max_jump(a.data(), n);
+    TEST_ASSERT_LESS_OR_EQUAL(slope + 24000 / (n / 2) + 2, max_jump(joined.data(), joined.size()));
+}
+
+// Host cost of both output stages per sample (reported, not asserted)
+static void test_output_dynamics_benchmark()
+{
+    init_output_stages();
+    std::vector<int16_t> buf(OUT_RATE * 10);
+    for (size_t i = 0; i < buf.size(); i++)
+        buf[i] = (int16_t)(20000 * std::sin(i * 0.1));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t o = 0; o < buf.size(); o += 1024)
+    {
+        size_t n = buf.size() - o < 1024 ? buf.size() - o : 1024;
+        loudness_normalizer_process(&loudness, &buf[o], n);
+        lookahead_limiter_process(&limiter, &buf[o], n);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    char report[80];
+    snprintf(report, sizeof(report), "normalizer + limiter: %.2f ns per sample", ns / buf.size());
+    TEST_MESSAGE(report);
+    TEST_ASSERT_LESS_OR_EQUAL(24000 + 240, peak(buf.data(), buf.size()));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_chain_holds_at_most_max_stages);
+    RUN_TEST(test_dc_blocker_and_highpass_remove_offset);
+    RUN_TEST(test_highpass_response);
+    RUN_TEST(test_agc_brings_quiet_speech_to_target);
+    RUN_TEST(test_agc_gain_is_bounded);
+    RUN_TEST(test_agc_holds_gain_below_gate);
+    RUN_TEST(test_soft_limiter_knee);
+    RUN_TEST(test_frontend_chain);
+    RUN_TEST(test_limiter_gain_curve);
+    RUN_TEST(test_limiter_catches_a_cold_step);
+    RUN_TEST(test_normalizer_gain_curve);
+    RUN_TEST(test_normalizer_ignores_pauses);
+    RUN_TEST(test_envelope_fades_in_within_the_ramp);
+    RUN_TEST(test_envelope_reverses_without_a_step);
+    RUN_TEST(test_envelope_zero_length_ramp_jumps);
+    RUN_TEST(test_envelope_fade_out_removes_the_click);
+    RUN_TEST(test_crossfade_runs_from_a_to_b);
+    RUN_TEST(test_crossfade_joins_opposite_phases);
+    RUN_TEST(test_output_dynamics_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,216 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "audio_mixer.h"
+
+#define RATE 24000
+
+static const MixerVoiceParams plain = {1, MIXER_UNITY_Q12, MIXER_UNITY_Q12};
+
+void setUp() {}
+void tearDown() {}
+
+static int32_t max_step(const std::vector<int16_t> &x)
+{
+    int32_t step = 0;
+    for (size_t i = 1; i < x.size(); i++)
+        step = abs(x[i] - x[i - 1]) > step ? abs(x[i] - x[i - 1]) : step;
+    return step;
+}
+
+static void test_no_voices_leaves_bed_untouched()
+{
+    AudioMixer mixer;
+    std::vector<int16_t> out(1000, 123);
+    mixer.mix(out.data(), out.size(), 1, RATE);
+    for (size_t i = 0; i < out.size(); i++)
+        TEST_ASSERT_EQUAL_INT16(123, out[i]);
+    TEST_ASSERT_FALSE(mixer.active());
+}
+
+// A voice at the output rate and unity gain adds sample for sample, then ends
+static void test_voice_adds_exactly_and_ends()
+{
+    AudioMixer mixer;
+    std::vector<int16_t> voice(500);
+    for (size_t i = 0; i < voice.size(); i++)
+        voice[i] = (int16_t)(i * 37 - 9000);
+    TEST_ASSERT_NOT_EQUAL(0, mixer.play(voice.data(), voice.size(), RATE, plain));
+    TEST_ASSERT_TRUE(mixer.active());
+
+    std::vector<int16_t> out(1000, 0);
+    mixer.mix(out.data(), out.size(), 1, RATE);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(voice.data(), out.data(), voice.size());
+    for (size_t i = voice.size(); i < out.size(); i++)
+        TEST_ASSERT_EQUAL_INT16(0, out[i]);
+    TEST_ASSERT_FALSE(mixer.active());
+}
+
+static void test_sum_saturates()
+{
+    const int16_t levels[] = {20000, -20000};
+    const int16_t limits[] = {32767, -32768};
+    for (int s = 0; s < 2; s++)
+    {
+        AudioMixer mixer;
+        std::vector<int16_t> voice(100, levels[s]);
+        mixer.play(voice.data(), voice.size(), RATE, plain);
+        std::vector<int16_t> out(100, levels[s]);
+        mixer.mix(out.data(), out.size(), 1, RATE);
+        for (size_t i = 0; i < out.size(); i++)
+            TEST_ASSERT_EQUAL_INT16(limits[s], out[i]);
+    }
+}
+
+static void test_stereo_gets_voice_on_both_channels()
+{
+    AudioMixer mixer;
+    std::vector<int16_t> voice(100, 1000);
+    mixer.play(voice.data(), voice.size(), RATE, plain);
+    std::vector<int16_t> out(200, 0);
+    mixer.mix(out.data(), 100, 2, RATE);
+    for (size_t i = 0; i < out.size(); i++)
+        TEST_ASSERT_EQUAL_INT16(1000, out[i]);
+}
+
+// The bed reaches the duck gain within the attack and comes back once the voice is over
+static void test_ducking_attack_and_release()
+{
+    AudioMixer mixer;
+    std::vector<int16_t> silence(RATE, 0);
+    MixerVoiceParams ducking = {1, MIXER_UNITY_Q12, MIXER_UNITY_Q12 / 2};
+    mixer.play(silence.data(), silence.size(), RATE, ducking);
+
+    std::vector<int16_t> bed(RATE / 2, 10000);
+    mixer.mix(bed.data(), bed.size(), 1, RATE);
+    TEST_ASSERT_EQUAL_INT16(5000, bed[RATE * (MIXER_DUCK_ATTACK_MS + 10) / 1000]);
+    TEST_ASSERT_EQUAL_INT16(5000, bed.back());
+    TEST_ASSERT_LESS_OR_EQUAL(200, max_step(bed));
+    TEST_ASSERT_TRUE(mixer.bed_ducked());
+
+    std::vector<int16_t> rest(RATE / 2 + RATE, 10000);
+    mixer.mix(rest.data(), rest.size(), 1, RATE);
+    TEST_ASSERT_LESS_THAN(10000, rest[RATE / 2 + 10]); // releasing slowly, not jumping back
+    TEST_ASSERT_LESS_OR_EQUAL(200, max_step(rest));
+    TEST_ASSERT_EQUAL_INT16(10000, rest.back());
+    TEST_ASSERT_FALSE(mixer.bed_ducked());
+}
+
+// A 16 kHz voice keeps its duration and waveform at 24 kHz
+static void test_rate_conversion()
+{
+    AudioMixer mixer;
+    std::vector<int16_t> voice(1600);
+    for (size_t i = 0; i < voice.size(); i++)
+        voice[i] = (int16_t)(8000 * std::sin(2 * M_PI * 440 * i / 16000.0));
+    mixer.play(voice.data(), voice.size(), 16000, plain);
+
+    std::vector<int16_t> out(4000, 0);
+    mixer.mix(out.data(), out.size(), 1, RATE);
+    size_t length = 0;
+    double error = 0;
+    for (size_t i = 0; i < out.size(); i++)
+    {
+        if (out[i] != 0)
+            length = i + 1;
+        if (i < 2300)
+            error = std::fmax(error, std::fabs(out[i] - 8000 * std::sin(2 * M_PI * 440 * i / RATE)));
+    }
+
+    char report[64];
+    snprintf(report, sizeof(report), "16 -> 24 kHz: %u samples, max error %.0f", (unsigned)length, error);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_UINT_WITHIN(2, 2400, length);
+    TEST_ASSERT_LESS_THAN_MESSAGE(200, (int)error, report);
+}
+
+// With every slot busy a voice takes the slot of one at or below its priority once that
+// has faded; a lower priority is dropped
+static void test_stealing()
+{
+    AudioMixer mixer;
+    std::vector<int16_t> busy(RATE * 2, 100);
+    std::vector<int16_t> cue(RATE / 5, 1000);
+    MixerVoiceParams low = {0, MIXER_UNITY_Q12, MIXER_UNITY_Q12};
+    MixerVoiceParams high = {2, MIXER_UNITY_Q12, MIXER_UNITY_Q12};
+    for (int i = 0; i < MIXER_MAX_VOICES; i++)
+        mixer.play(busy.data(), busy.size(), RATE, plain);
+
+    std::vector<int16_t> out(240, 0);
+    mixer.mix(out.data(), out.size(), 1, RATE);
+    TEST_ASSERT_EQUAL_INT16(100 * MIXER_MAX_VOICES, out[10]);
+
+    mixer.play(cue.data(), cue.size(), RATE, low);
+    std::vector<int16_t> dropped(480, 0);
+    mixer.mix(dropped.data(), dropped.size(), 1, RATE);
+    TEST_ASSERT_EQUAL_INT16(100 * MIXER_MAX_VOICES, dropped[400]);
+
+    mixer.play(cue.data(), cue.size(), RATE, high);
+    std::vector<int16_t> fading(480, 0);
+    mixer.mix(fading.data(), fading.size(), 1, RATE);
+    TEST_ASSERT_LESS_OR_EQUAL(20, max_step(fading));
+    std::vector<int16_t> after(480, 0);
+    mixer.mix(after.data(), after.size(), 1, RATE);
+    TEST_ASSERT_EQUAL_INT16(100 * (MIXER_MAX_VOICES - 1) + 1000, after[400]);
+}
+
+static void test_stop_fades_out()
+{
+    AudioMixer mixer;
+    std::vector<int16_t> voice(RATE * 2, 500);
+    uint32_t handle = mixer.play(voice.data(), voice.size(), RATE, plain);
+    std::vector<int16_t> out(480, 0);
+    mixer.mix(out.data(), out.size(), 1, RATE);
+    TEST_ASSERT_EQUAL_INT16(500, out.back());
+    mixer.stop(handle);
+    std::vector<int16_t> stopped(480, 0);
+    mixer.mix(stopped.data(), stopped.size(), 1, RATE);
+    TEST_ASSERT_LESS_OR_EQUAL(20, max_step(stopped));
+    TEST_ASSERT_EQUAL_INT16(0, stopped.back());
+    TEST_ASSERT_FALSE(mixer.active());
+}
+
+// Host cost per output sample by number of voices, half of them resampled (reported, not asserted)
+static void test_benchmark()
+{
+    std::vector<int16_t> voice(1 << 22, 1000);
+    for (int voices = 0; voices <= MIXER_MAX_VOICES; voices++)
+    {
+        AudioMixer mixer;
+        for (int k = 0; k < voices; k++)
+            mixer.play(voice.data(), voice.size(), k & 1 ? 16000 : RATE, plain);
+
+        std::vector<int16_t> out(1024, 0);
+        mixer.mix(out.data(), out.size(), 1, RATE);
+        const int iterations = 2000;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            mixer.mix(out.data(), out.size(), 1, RATE);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                    (iterations * (double)out.size());
+
+        char report[64];
+        snprintf(report, sizeof(report), "%d voices: %.2f ns per output sample", voices, ns);
+        TEST_MESSAGE(report);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_voices_leaves_bed_untouched);
+    RUN_TEST(test_voice_adds_exactly_and_ends);
+    RUN_TEST(test_sum_saturates);
+    RUN_TEST(test_stereo_gets_voice_on_both_channels);
+    RUN_TEST(test_ducking_attack_and_release);
+    RUN_TEST(test_rate_conversion);
+    RUN_TEST(test_stealing);
+    RUN_TEST(test_stop_fades_out);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
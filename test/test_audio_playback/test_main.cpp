@@ -0,0 +1,446 @@
+#include <unity.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "audio_playback.h"
+#include "audio_dsp.h"
+
+#define RATE 24000
+#define RING_SAMPLES (1 << 17)
+
+void setUp() {}
+void tearDown() {}
+
+// Stand-in for one M5.Speaker channel on a virtual clock: one slice playing and one
+// waiting. A slice is copied out when it starts to play, as the DMA would read it;
+// stop() takes back what the playing slice had not got to.
+struct QueuedSlice
+{
+    const int16_t *data;
+    size_t len;
+    uint32_t rate;
+};
+
+struct FakeSpeaker
+{
+    uint64_t now_us;
+    uint64_t head_started_us;
+    std::vector<QueuedSlice> queue;
+    std::vector<int16_t> delivered;
+    std::vector<size_t> gaps; // delivered.size() each time the channel ran out
+    size_t delivered_at_stop; // how much had played when the channel was last cut
+    uint32_t stops;
+    uint8_t volume;
+    uint8_t lowest_volume;
+    bool wrong_rate;
+};
+
+static FakeSpeaker speaker;
+static int16_t ring_storage[RING_SAMPLES];
+
+static uint64_t slice_us(const QueuedSlice &slice)
+{
+    return (uint64_t)slice.len * 1000000 / slice.rate;
+}
+
+static void start_head()
+{
+    const QueuedSlice &head = speaker.queue[0];
+    speaker.delivered.insert(speaker.delivered.end(), head.data, head.data + head.len);
+}
+
+// Retire whatever has finished by now; the next slice starts where the last one ended
+static void advance()
+{
+    while (!speaker.queue.empty() && speaker.head_started_us + slice_us(speaker.queue[0]) <= speaker.now_us)
+    {
+        speaker.head_started_us += slice_us(speaker.queue[0]);
+        speaker.queue.erase(speaker.queue.begin());
+        if (!speaker.queue.empty())
+            start_head();
+        else
+            speaker.gaps.push_back(speaker.delivered.size());
+    }
+}
+
+static bool fake_play(void *context, const int16_t *samples, size_t len, uint32_t sample_rate, bool stereo)
+{
+    advance();
+    if (speaker.queue.size() >= PLAYBACK_MAX_IN_FLIGHT)
+        return false;
+
+    QueuedSlice slice = {samples, len, sample_rate};
+    speaker.wrong_rate |= sample_rate != RATE || stereo;
+    speaker.queue.push_back(slice);
+    if (speaker.queue.size() == 1)
+    {
+        speaker.head_started_us = speaker.now_us;
+        start_head();
+    }
+    return true;
+}
+
+static size_t fake_queued(void *context)
+{
+    advance();
+    return speaker.queue.size();
+}
+
+static uint8_t fake_volume(void *context)
+{
+    return speaker.volume;
+}
+
+static void fake_set_volume(void *context, uint8_t volume)
+{
+    speaker.volume = volume;
+    if (volume < speaker.lowest_volume)
+        speaker.lowest_volume = volume;
+}
+
+static void fake_stop(void *context)
+{
+    advance();
+    if (!speaker.queue.empty())
+    {
+        const QueuedSlice &head = speaker.queue[0];
+        size_t played = (size_t)((speaker.now_us - speaker.head_started_us) * head.rate / 1000000);
+        speaker.delivered.resize(speaker.delivered.size() - (head.len - played));
+    }
+    speaker.queue.clear();
+    speaker.delivered_at_stop = speaker.delivered.size();
+    speaker.stops++;
+}
+
+static void fake_wait_ms(void *context, uint32_t ms)
+{
+    speaker.now_us += (uint64_t)ms * 1000;
+}
+
+static unsigned long fake_now_ms(void *context)
+{
+    return (unsigned long)(speaker.now_us / 1000);
+}
+
+static uint32_t fake_cycle_count(void *context)
+{
+    return 0;
+}
+
+static const PlaybackSink fake_sink = {
+    nullptr, fake_play, fake_queued, fake_volume, fake_set_volume, fake_stop, fake_wait_ms, fake_now_ms, fake_cycle_count,
+};
+
+static void start_playback()
+{
+    speaker.now_us = 1000000; // millis() is well past zero by the time anything plays
+    speaker.head_started_us = 0;
+    speaker.queue.clear();
+    speaker.delivered.clear();
+    speaker.gaps.clear();
+    speaker.delivered_at_stop = 0;
+    speaker.stops = 0;
+    speaker.volume = 200;
+    speaker.lowest_volume = 200;
+    speaker.wrong_rate = false;
+    TEST_ASSERT_TRUE(playback_init(ring_storage, RING_SAMPLES, fake_sink));
+    playback_set_output_rate(RATE);
+    playback_set_speed(100);
+}
+
+// One feeder period of virtual time, then one pass
+static void tick()
+{
+    speaker.now_us += PLAYBACK_SERVICE_MS * 1000;
+    playback_service();
+}
+
+static bool run_until_finished(uint32_t limit_ms)
+{
+    for (uint32_t t = 0; t < limit_ms; t += PLAYBACK_SERVICE_MS)
+    {
+        tick();
+        if (playback_take_finished())
+            return true;
+    }
+    return false;
+}
+
+// Within +-250, so every block stays under the loudness gate and the limiter threshold;
+// different steps make different, never-repeating-nearby sequences
+static std::vector<int16_t> quiet_signal(size_t n, uint32_t step)
+{
+    std::vector<int16_t> samples(n);
+    for (size_t i = 0; i < n; i++)
+        samples[i] = (int16_t)((i * step) % 501) - 250;
+    return samples;
+}
+
+// What the speaker must get for input played from silence to its end. At this level the
+// loudness normalizer holds unity gain and the limiter only delays by its look-ahead, so
+// the last look-ahead of input never leaves it; the envelope stays shut while the delay
+// line flushes, fades in, and fades out over the end.
+static std::vector<int16_t> expected_output(const std::vector<int16_t> &input)
+{
+    const size_t lookahead = (size_t)RATE * PLAYBACK_LIMITER_LOOKAHEAD_US / 1000000;
+    const size_t fade = (size_t)RATE * PLAYBACK_FADE_MS / 1000;
+
+    std::vector<int16_t> out(input.size(), 0);
+    memcpy(&out[lookahead], input.data(), (input.size() - lookahead) * sizeof(int16_t));
+
+    GainEnvelope envelope;
+    gain_envelope_init(&envelope, false);
+    gain_envelope_process(&envelope, out.data(), lookahead);
+    gain_envelope_ramp(&envelope, true, fade);
+    gain_envelope_process(&envelope, &out[lookahead], out.size() - lookahead - fade);
+    gain_envelope_ramp(&envelope, false, fade);
+    gain_envelope_process(&envelope, &out[out.size() - fade], fade);
+    return out;
+}
+
+static void assert_delivered(const std::vector<int16_t> &expected, size_t from)
+{
+    TEST_ASSERT_EQUAL_size_t(from + expected.size(), speaker.delivered.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), &speaker.delivered[from], expected.size());
+}
+
+// A clip goes out in slices straight from its buffer, faded in and out
+static void test_clip()
+{
+    start_playback();
+    std::vector<int16_t> input = quiet_signal(RATE, 37);
+    std::vector<int16_t> buffer = input; // processed in place
+
+    playback_play_clip(buffer.data(), buffer.size(), RATE, false);
+    TEST_ASSERT_TRUE(run_until_finished(2000));
+
+    assert_delivered(expected_output(input), 0);
+    TEST_ASSERT_FALSE(speaker.wrong_rate);
+    TEST_ASSERT_EQUAL_UINT32(input.size(), playback_stats().samples_played);
+    TEST_ASSERT_FALSE(playback_active());
+}
+
+// A stream written in 20 ms chunks every 10 ms, split mid-sample, plays exactly what was written
+static void test_stream()
+{
+    start_playback();
+    std::vector<int16_t> input = quiet_signal(RATE * 3 / 2, 53);
+    const uint8_t *bytes = (const uint8_t *)input.data();
+    const size_t total = input.size() * sizeof(int16_t);
+    const size_t chunks[] = {333, 627}; // 960 bytes, 20 ms, every two
+
+    PcmStreamFormat format = {RATE, 1, PCM_SAMPLE_S16LE};
+    playback_stream_begin(format);
+    size_t written = 0;
+    for (size_t n = 0; written < total; n++)
+    {
+        size_t len = chunks[n % 2] < total - written ? chunks[n % 2] : total - written;
+        playback_stream_write(bytes + written, len);
+        playback_stream_note_chunk();
+        written += len;
+        if (n % 2 == 1)
+        {
+            tick();
+            tick();
+        }
+    }
+    playback_stream_end();
+    TEST_ASSERT_TRUE(run_until_finished(3000));
+
+    assert_delivered(expected_output(input), 0);
+    TEST_ASSERT_FALSE(speaker.wrong_rate);
+    TEST_ASSERT_EQUAL_UINT32(0, playback_stats().underruns);
+    TEST_ASSERT_EQUAL_UINT32(0, playback_stats().samples_dropped);
+}
+
+// A clip started over a playing one takes over from the first slice not yet queued:
+// the rest of the old clip is crossfaded into the start of the new one
+static void test_clip_replaces_clip()
+{
+    start_playback();
+    std::vector<int16_t> first = quiet_signal(RATE, 37);
+    std::vector<int16_t> second = quiet_signal(RATE / 2, 91);
+    std::vector<int16_t> first_buffer = first;
+    std::vector<int16_t> second_buffer = second;
+
+    playback_play_clip(first_buffer.data(), first_buffer.size(), RATE, false);
+    for (int i = 0; i < 20; i++)
+        tick();
+    playback_play_clip(second_buffer.data(), second_buffer.size(), RATE, false);
+    TEST_ASSERT_TRUE(run_until_finished(2000));
+
+    // The two slices queued at the start are the first clip's; the swap comes when one is free
+    const size_t switched_at = 2 * PLAYBACK_SLICE_SAMPLES;
+    const size_t crossfade = (size_t)RATE * PLAYBACK_CROSSFADE_MS / 1000;
+    std::vector<int16_t> input(first.begin(), first.begin() + switched_at);
+    input.resize(switched_at + crossfade);
+    crossfade_linear(&first[switched_at], second.data(), &input[switched_at], crossfade);
+    input.insert(input.end(), second.begin() + crossfade, second.end());
+
+    assert_delivered(expected_output(input), 0);
+    TEST_ASSERT_EQUAL_UINT32(0, speaker.stops);
+}
+
+// An abort cuts the channel after ramping its volume down, and a stream begun right
+// after it plays from its own start with nothing of the old one left in the ring
+static void test_abort_then_begin()
+{
+    start_playback();
+    std::vector<int16_t> first = quiet_signal(RATE, 37);
+    std::vector<int16_t> second = quiet_signal(RATE / 2, 91);
+    PcmStreamFormat format = {RATE, 1, PCM_SAMPLE_S16LE};
+
+    playback_stream_begin(format);
+    playback_stream_write_samples(first.data(), first.size());
+    for (int i = 0; i < 60; i++)
+        tick();
+    TEST_ASSERT_TRUE(playback_active());
+
+    playback_stream_abort();
+    playback_stream_begin(format);
+    playback_stream_write_samples(second.data(), second.size());
+    playback_stream_end();
+    TEST_ASSERT_TRUE(run_until_finished(2000));
+
+    TEST_ASSERT_EQUAL_UINT32(1, speaker.stops);
+    TEST_ASSERT_EQUAL_UINT8(0, speaker.lowest_volume);
+    TEST_ASSERT_EQUAL_UINT8(200, speaker.volume);
+    TEST_ASSERT_TRUE(playback_abort_settled());
+
+    // Up to the cut, the first stream as it would have played; after it, only the second
+    size_t cut = speaker.delivered_at_stop;
+    TEST_ASSERT_TRUE(cut > RATE / 4 && cut < first.size());
+    std::vector<int16_t> first_expected = expected_output(first);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(first_expected.data(), speaker.delivered.data(), cut);
+    assert_delivered(expected_output(second), cut);
+}
+
+#define CHUNK_SAMPLES 960 // 40 ms per network chunk
+#define TRACE_CHUNKS 100  // 4 s responses
+#define SILENT_EDGE 64    // a concealed gap is faded to about this on both sides
+
+// Chunk arrival times in ms after the response starts; the first after 150 ms of server latency
+static std::vector<uint32_t> steady_trace()
+{
+    std::vector<uint32_t> arrivals;
+    for (uint32_t i = 0; i < TRACE_CHUNKS; i++)
+        arrivals.push_back(150 + i * 40);
+    return arrivals;
+}
+
+// Same average rate, but five chunks at a time every 200 ms
+static std::vector<uint32_t> bursty_trace()
+{
+    std::vector<uint32_t> arrivals;
+    for (uint32_t i = 0; i < TRACE_CHUNKS; i++)
+        arrivals.push_back(150 + i / 5 * 200 + i % 5 * 2);
+    return arrivals;
+}
+
+// Steady, then nothing for 700 ms after the 40th chunk; the backlog comes in at four
+// times real time until it has caught up
+static std::vector<uint32_t> stalled_trace()
+{
+    std::vector<uint32_t> arrivals;
+    for (uint32_t i = 0; i < TRACE_CHUNKS; i++)
+    {
+        uint32_t on_time = 150 + i * 40;
+        uint32_t catching_up = i < 40 ? 0 : 150 + 40 * 40 + 700 + (i - 40) * 10;
+        arrivals.push_back(catching_up > on_time ? catching_up : on_time);
+    }
+    return arrivals;
+}
+
+struct TraceResult
+{
+    PlaybackStats stats;
+    size_t gaps;      // times the channel ran out before the end
+    size_t concealed; // of those, faded to silence on both sides
+};
+
+// Feed a response through the producer API as the trace says, serviced every feeder period
+static TraceResult play_trace(const std::vector<uint32_t> &arrivals)
+{
+    start_playback();
+    std::vector<int16_t> input(arrivals.size() * CHUNK_SAMPLES);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = (int16_t)(6000 * sin(2 * M_PI * 440 * i / RATE));
+
+    const uint64_t start_us = speaker.now_us;
+    PcmStreamFormat format = {RATE, 1, PCM_SAMPLE_S16LE};
+    playback_stream_begin(format);
+
+    size_t next = 0;
+    bool finished = false;
+    for (uint32_t t = PLAYBACK_SERVICE_MS; t < 20000 && !finished; t += PLAYBACK_SERVICE_MS)
+    {
+        // Chunks that came in during this feeder period, each at its own time
+        for (; next < arrivals.size() && arrivals[next] <= t; next++)
+        {
+            speaker.now_us = start_us + (uint64_t)arrivals[next] * 1000;
+            playback_stream_write_samples(&input[next * CHUNK_SAMPLES], CHUNK_SAMPLES);
+            playback_stream_note_chunk();
+            if (next + 1 == arrivals.size())
+                playback_stream_end();
+        }
+        speaker.now_us = start_us + (uint64_t)t * 1000;
+        playback_service();
+        finished = playback_take_finished();
+    }
+    TEST_ASSERT_TRUE(finished);
+
+    TraceResult result;
+    result.stats = playback_stats();
+    result.gaps = 0;
+    result.concealed = 0;
+    for (size_t i = 0; i < speaker.gaps.size(); i++)
+    {
+        size_t at = speaker.gaps[i];
+        if (at == speaker.delivered.size())
+            continue; // the end of the response
+        result.gaps++;
+        if (abs(speaker.delivered[at - 1]) <= SILENT_EDGE && abs(speaker.delivered[at]) <= SILENT_EDGE)
+            result.concealed++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(input.size(), result.stats.samples_played);
+    TEST_ASSERT_EQUAL_UINT32(0, result.stats.samples_dropped);
+    return result;
+}
+
+// Arrival patterns through the jitter buffer: every time the channel runs out it has
+// faded out first and fades back in, and a steady link never runs it out
+static void test_arrival_traces()
+{
+    const char *names[] = {"steady", "bursty", "stalled"};
+    std::vector<uint32_t> traces[] = {steady_trace(), bursty_trace(), stalled_trace()};
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        TraceResult result = play_trace(traces[i]);
+        char report[160];
+        snprintf(report, sizeof(report), "%-7s: time to first audio %4u ms, low-water %4u ms, %u underruns, %u of %u gaps concealed",
+                 names[i], (unsigned)result.stats.time_to_first_audio_ms, (unsigned)result.stats.low_water_ms,
+                 (unsigned)result.stats.underruns, (unsigned)result.concealed, (unsigned)result.gaps);
+        TEST_MESSAGE(report);
+
+        TEST_ASSERT_EQUAL_MESSAGE(result.gaps, result.concealed, report);
+        TEST_ASSERT_EQUAL_MESSAGE(result.stats.underruns, result.gaps, report);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, play_trace(traces[0]).stats.underruns);
+    TEST_ASSERT_TRUE(play_trace(traces[2]).stats.underruns > 0);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_clip);
+    RUN_TEST(test_stream);
+    RUN_TEST(test_clip_replaces_clip);
+    RUN_TEST(test_abort_then_begin);
+    RUN_TEST(test_arrival_traces);
+    return UNITY_END();
+}
@@ -0,0 +1,334 @@
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "downlink_reassembly.h"
+#include "wire_protocol.h"
+
+static std::vector<uint8_t> sink_bytes;
+static uint8_t response[100];
+
+static void sink(void *context, const uint8_t *data, size_t len)
+{
+    std::vector<uint8_t> *out = (std::vector<uint8_t> *)context;
+    out->insert(out->end(), data, data + len);
+}
+
+void setUp()
+{
+    sink_bytes.clear();
+    for (int i = 0; i < 100; i++)
+        response[i] = (uint8_t)(i * 7 + 1);
+}
+
+void tearDown() {}
+
+static void assert_prefix(const DownlinkReassembly &reassembly)
+{
+    TEST_ASSERT_EQUAL_size_t(reassembly.delivered(), sink_bytes.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(response, sink_bytes.data(), sink_bytes.size());
+}
+
+static void test_in_order_goes_straight_through()
+{
+    DownlinkReassembly reassembly;
+    reassembly.begin(100, nullptr, 0, sink, &sink_bytes);
+    for (int offset = 0; offset < 100; offset += 30)
+        TEST_ASSERT_EQUAL(REASSEMBLY_DELIVERED, reassembly.accept(offset, response + offset, offset + 30 > 100 ? 10 : 30));
+    TEST_ASSERT_TRUE(reassembly.complete());
+    TEST_ASSERT_FALSE(reassembly.has_gap());
+    TEST_ASSERT_EQUAL_UINT32(4, reassembly.stats().delivered);
+    assert_prefix(reassembly);
+}
+
+// Duplicates, overlaps and bytes past the declared end never reach the sink twice
+static void test_duplicates_and_overlaps_are_skipped()
+{
+    DownlinkReassembly reassembly;
+    reassembly.begin(100, nullptr, 0, sink, &sink_bytes);
+    reassembly.accept(0, response, 40);
+    TEST_ASSERT_EQUAL(REASSEMBLY_DUPLICATE, reassembly.accept(0, response, 40));
+    TEST_ASSERT_EQUAL(REASSEMBLY_DUPLICATE, reassembly.accept(10, response + 10, 20));
+    TEST_ASSERT_EQUAL(REASSEMBLY_DELIVERED, reassembly.accept(30, response + 30, 30));
+    TEST_ASSERT_EQUAL_UINT32(60, reassembly.delivered());
+
+    uint8_t past_end[50];
+    memcpy(past_end, response + 60, 40);
+    memset(past_end + 40, 0xEE, 10);
+    TEST_ASSERT_EQUAL(REASSEMBLY_DELIVERED, reassembly.accept(60, past_end, sizeof(past_end)));
+    TEST_ASSERT_EQUAL(REASSEMBLY_DUPLICATE, reassembly.accept(100, past_end, 10));
+    TEST_ASSERT_TRUE(reassembly.complete());
+    TEST_ASSERT_EQUAL_UINT32(3, reassembly.stats().duplicates);
+    assert_prefix(reassembly);
+}
+
+// A chunk past a gap waits in the window and goes out once the gap is filled
+static void test_gap_is_held_then_released()
+{
+    uint8_t window[64];
+    DownlinkReassembly reassembly;
+    reassembly.begin(100, window, sizeof(window), sink, &sink_bytes);
+    reassembly.accept(0, response, 20);
+    TEST_ASSERT_EQUAL(REASSEMBLY_HELD, reassembly.accept(40, response + 40, 20));
+    TEST_ASSERT_TRUE(reassembly.has_gap());
+    TEST_ASSERT_EQUAL_UINT32(20, reassembly.delivered());
+
+    ByteRange missing[4];
+    TEST_ASSERT_EQUAL_size_t(2, reassembly.missing(missing, 4));
+    TEST_ASSERT_EQUAL_UINT32(20, missing[0].offset);
+    TEST_ASSERT_EQUAL_UINT32(20, missing[0].length);
+    TEST_ASSERT_EQUAL_UINT32(60, missing[1].offset);
+    TEST_ASSERT_EQUAL_UINT32(40, missing[1].length);
+
+    TEST_ASSERT_EQUAL(REASSEMBLY_DELIVERED, reassembly.accept(20, response + 20, 20));
+    TEST_ASSERT_FALSE(reassembly.has_gap());
+    TEST_ASSERT_EQUAL_UINT32(60, reassembly.delivered());
+    assert_prefix(reassembly);
+}
+
+// Without a window, or beyond it, a chunk past a gap stays missing; the window wraps
+static void test_window_limits()
+{
+    DownlinkReassembly reassembly;
+    reassembly.begin(100, nullptr, 0, sink, &sink_bytes);
+    TEST_ASSERT_EQUAL(REASSEMBLY_DROPPED, reassembly.accept(50, response + 50, 10));
+    TEST_ASSERT_EQUAL_UINT32(1, reassembly.stats().dropped);
+
+    uint8_t window[16];
+    sink_bytes.clear();
+    reassembly.begin(100, window, sizeof(window), sink, &sink_bytes);
+    for (int offset = 90; offset >= 20; offset -= 10)
+        TEST_ASSERT_EQUAL(REASSEMBLY_DROPPED, reassembly.accept(offset, response + offset, 10));
+    TEST_ASSERT_EQUAL(REASSEMBLY_HELD, reassembly.accept(10, response + 10, 10)); // only 10..16 fits
+    TEST_ASSERT_EQUAL(REASSEMBLY_DELIVERED, reassembly.accept(0, response, 10));
+    TEST_ASSERT_EQUAL_UINT32(16, reassembly.delivered());
+
+    // Later held bytes land across the end of the window and come out in order
+    TEST_ASSERT_EQUAL(REASSEMBLY_DELIVERED, reassembly.accept(16, response + 16, 4));
+    TEST_ASSERT_EQUAL(REASSEMBLY_HELD, reassembly.accept(24, response + 24, 12));
+    TEST_ASSERT_EQUAL(REASSEMBLY_DELIVERED, reassembly.accept(20, response + 20, 4));
+    TEST_ASSERT_EQUAL_UINT32(36, reassembly.delivered());
+    assert_prefix(reassembly);
+}
+
+static void test_held_run_limit()
+{
+    uint8_t window[100];
+    DownlinkReassembly reassembly;
+    reassembly.begin(100, window, sizeof(window), sink, &sink_bytes);
+    for (int run = 0; run < REASSEMBLY_MAX_HELD; run++)
+        TEST_ASSERT_EQUAL(REASSEMBLY_HELD, reassembly.accept(2 + run * 4, response + 2 + run * 4, 2));
+    TEST_ASSERT_EQUAL(REASSEMBLY_DROPPED, reassembly.accept(60, response + 60, 2)); // would be a ninth run
+    TEST_ASSERT_EQUAL(REASSEMBLY_HELD, reassembly.accept(4, response + 4, 2));     // joins two runs
+
+    ByteRange missing[REASSEMBLY_MAX_HELD + 1];
+    size_t count = reassembly.missing(missing, REASSEMBLY_MAX_HELD + 1);
+    TEST_ASSERT_EQUAL_size_t(REASSEMBLY_MAX_HELD, count);
+    TEST_ASSERT_EQUAL_UINT32(0, missing[0].offset);
+    TEST_ASSERT_EQUAL_UINT32(2, missing[0].length);
+    TEST_ASSERT_EQUAL_size_t(3, reassembly.missing(missing, 3)); // capped at max
+
+    TEST_ASSERT_EQUAL(REASSEMBLY_DELIVERED, reassembly.accept(0, response, 2));
+    TEST_ASSERT_EQUAL_UINT32(8, reassembly.delivered());
+    assert_prefix(reassembly);
+}
+
+// Stand-in server: sends ranges of a response as AUDIO_CHUNK frames then AUDIO_COMPLETE,
+// through a link that drops, duplicates and swaps chunks, and can cut out altogether
+struct LinkFaults
+{
+    double drop;
+    double duplicate;
+    double swap;
+    double cut;
+};
+
+static uint32_t rng_state;
+
+static double chance()
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (rng_state >> 8) / 16777216.0;
+}
+
+static void serve(const std::vector<uint8_t> &audio, const std::vector<ByteRange> &ranges, size_t chunk_bytes,
+                  uint32_t *seq, const LinkFaults &faults, std::deque<std::vector<uint8_t> > *link, bool *cut)
+{
+    std::vector<std::vector<uint8_t> > frames;
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        uint32_t end = ranges[i].offset + ranges[i].length;
+        for (uint32_t offset = ranges[i].offset; offset < end; offset += chunk_bytes)
+        {
+            uint32_t n = end - offset < chunk_bytes ? end - offset : (uint32_t)chunk_bytes;
+            std::vector<uint8_t> frame(WIRE_HEADER_BYTES + 4 + n);
+            WireWriter w;
+            wire_writer_init(&w, frame.data() + WIRE_HEADER_BYTES, 4);
+            wire_put_u32(&w, offset);
+            memcpy(frame.data() + WIRE_HEADER_BYTES + 4, audio.data() + offset, n);
+            wire_finish(frame.data(), WIRE_AUDIO_CHUNK, 7, (*seq)++, 4 + n);
+            frames.push_back(frame);
+        }
+    }
+    for (size_t i = 0; i + 1 < frames.size(); i++)
+    {
+        if (chance() < faults.swap)
+            frames[i].swap(frames[i + 1]);
+    }
+    std::vector<uint8_t> complete(WIRE_HEADER_BYTES);
+    wire_finish(complete.data(), WIRE_AUDIO_COMPLETE, 7, (*seq)++, 0);
+    frames.push_back(complete);
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        if (chance() < faults.cut)
+        {
+            *cut = true; // nothing after this arrives
+            return;
+        }
+        bool audio_chunk = frames[i][2] == WIRE_AUDIO_CHUNK;
+        if (audio_chunk && chance() < faults.drop)
+            continue;
+        link->push_back(frames[i]);
+        if (audio_chunk && chance() < faults.duplicate)
+            link->push_back(frames[i]);
+    }
+}
+
+// The device side as main.cpp runs it: feed chunks in, and at audio_complete (up to three
+// times) or after a reconnect ask for the missing ranges with an AUDIO_RESEND frame
+static void test_stand_in_server_with_link_faults()
+{
+    const LinkFaults profiles[] = {
+        {0, 0, 0, 0}, {0.05, 0, 0, 0}, {0, 0.1, 0, 0}, {0, 0, 0.2, 0}, {0.05, 0.05, 0.2, 0}, {0.02, 0.02, 0.1, 0.01}, {0.2, 0.2, 0.5, 0.005},
+    };
+    const int trials = 100;
+    std::vector<uint8_t> window(64 * 1024);
+    rng_state = 1;
+
+    for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++)
+    {
+        const LinkFaults &faults = profiles[p];
+        int completed = 0;
+        int resends = 0;
+        for (int trial = 0; trial < trials; trial++)
+        {
+            std::vector<uint8_t> audio(1000 + (size_t)(chance() * 200000));
+            size_t chunk_bytes = 512 + (size_t)(chance() * 8192);
+            for (size_t i = 0; i < audio.size(); i++)
+                audio[i] = (uint8_t)(chance() * 256);
+
+            std::vector<uint8_t> played;
+            DownlinkReassembly reassembly;
+            reassembly.begin((uint32_t)audio.size(), window.data(), window.size(), sink, &played);
+
+            std::deque<std::vector<uint8_t> > link;
+            uint32_t seq = 0;
+            bool cut = false;
+            std::vector<ByteRange> whole(1);
+            whole[0].offset = 0;
+            whole[0].length = (uint32_t)audio.size();
+            serve(audio, whole, chunk_bytes, &seq, faults, &link, &cut);
+
+            int attempts = 0;
+            int reconnects = 0;
+            for (;;)
+            {
+                bool got_complete = false;
+                while (!link.empty() && !got_complete)
+                {
+                    std::vector<uint8_t> frame = link.front();
+                    link.pop_front();
+                    WireHeader header;
+                    const uint8_t *payload;
+                    TEST_ASSERT_EQUAL(WIRE_OK, wire_parse(frame.data(), frame.size(), &header, &payload));
+                    if (header.type == WIRE_AUDIO_COMPLETE)
+                    {
+                        got_complete = true;
+                        break;
+                    }
+                    WireReader r;
+                    wire_reader_init(&r, payload, header.length);
+                    uint32_t offset = wire_get_u32(&r);
+                    reassembly.accept(offset, payload + r.pos, header.length - r.pos);
+                }
+                link.clear();
+
+                if (got_complete && reassembly.complete())
+                    break;
+                if (cut)
+                {
+                    cut = false;
+                    attempts = 0;
+                    if (++reconnects > 20)
+                        break;
+                }
+                else if (!got_complete || attempts >= 3)
+                {
+                    break;
+                }
+
+                // Through the wire encoding, as request_missing_audio() builds it
+                ByteRange missing[16];
+                size_t count = reassembly.missing(missing, 16);
+                uint8_t request[WIRE_HEADER_BYTES + 1 + 16 * 8];
+                WireWriter w;
+                wire_writer_init(&w, request + WIRE_HEADER_BYTES, sizeof(request) - WIRE_HEADER_BYTES);
+                wire_put_u8(&w, (uint8_t)count);
+                for (size_t i = 0; i < count; i++)
+                {
+                    wire_put_u32(&w, missing[i].offset);
+                    wire_put_u32(&w, missing[i].length);
+                }
+                size_t len = wire_finish(request, WIRE_AUDIO_RESEND, 7, attempts, w.len);
+
+                WireHeader header;
+                const uint8_t *payload;
+                TEST_ASSERT_EQUAL(WIRE_OK, wire_parse(request, len, &header, &payload));
+                WireReader r;
+                wire_reader_init(&r, payload, header.length);
+                std::vector<ByteRange> ranges(wire_get_u8(&r));
+                for (size_t i = 0; i < ranges.size(); i++)
+                {
+                    ranges[i].offset = wire_get_u32(&r);
+                    ranges[i].length = wire_get_u32(&r);
+                }
+                TEST_ASSERT_TRUE(r.ok);
+                attempts++;
+                resends++;
+                serve(audio, ranges, chunk_bytes, &seq, faults, &link, &cut);
+            }
+
+            // Whatever played is exactly the start of the response, finished or not
+            TEST_ASSERT_EQUAL_size_t(reassembly.delivered(), played.size());
+            TEST_ASSERT_EQUAL_MEMORY(audio.data(), played.data(), played.size());
+            if (reassembly.complete())
+                completed++;
+        }
+
+        char report[128];
+        snprintf(report, sizeof(report), "drop %.2f dup %.2f swap %.2f cut %.3f: %d/%d complete, %d resend requests",
+                 faults.drop, faults.duplicate, faults.swap, faults.cut, completed, trials, resends);
+        TEST_MESSAGE(report);
+        if (p == 0)
+        {
+            TEST_ASSERT_EQUAL_INT(trials, completed); // a clean link never needs a resend
+            TEST_ASSERT_EQUAL_INT(0, resends);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_in_order_goes_straight_through);
+    RUN_TEST(test_duplicates_and_overlaps_are_skipped);
+    RUN_TEST(test_gap_is_held_then_released);
+    RUN_TEST(test_window_limits);
+    RUN_TEST(test_held_run_limit);
+    RUN_TEST(test_stand_in_server_with_link_faults);
+    return UNITY_END();
+}
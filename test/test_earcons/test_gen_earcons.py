@@ -0,0 +1,108 @@
+"""Host tests for scripts/gen_earcons.py: python -m unittest discover -s test/test_earcons"""
+
+import math
+import os
+import shutil
+import sys
+import tempfile
+import unittest
+import wave
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "..", "scripts"))
+import gen_earcons  # noqa: E402
+
+
+def write_wav(path, samples, rate=16000, channels=1):
+    with wave.open(path, "wb") as wav:
+        wav.setnchannels(channels)
+        wav.setsampwidth(2)
+        wav.setframerate(rate)
+        wav.writeframes(b"".join(int(s).to_bytes(2, "little", signed=True) for s in samples))
+
+
+class GenerateTest(unittest.TestCase):
+    def setUp(self):
+        self.project = tempfile.mkdtemp()
+        for sub in ("assets/earcons", "include", "src"):
+            os.makedirs(os.path.join(self.project, sub))
+        self.sources = os.path.join(self.project, "assets", "earcons")
+        write_wav(os.path.join(self.sources, "beep.wav"), [(i * 997) % 20000 - 10000 for i in range(301)])
+        write_wav(os.path.join(self.sources, "no-signal.wav"), [0] * 40)
+
+    def tearDown(self):
+        shutil.rmtree(self.project)
+
+    def read(self, path):
+        with open(os.path.join(self.project, path)) as f:
+            return f.read()
+
+    def test_writes_only_changed_outputs(self):
+        self.assertEqual(gen_earcons.generate(self.project), [gen_earcons.HEADER_OUTPUT, gen_earcons.SOURCE_OUTPUT])
+        self.assertEqual(gen_earcons.generate(self.project), [])
+
+    def test_header_declares_and_source_defines(self):
+        gen_earcons.generate(self.project)
+        header = self.read(gen_earcons.HEADER_OUTPUT)
+        source = self.read(gen_earcons.SOURCE_OUTPUT)
+        self.assertIn("EARCON_BEEP,", header)
+        self.assertIn("EARCON_NO_SIGNAL,", header)
+        self.assertIn("extern const EarconSource earcon_sources[EARCON_COUNT];", header)
+        self.assertNotIn("0x", header)  # no data in a header included by several files
+        self.assertIn("static const uint8_t earcon_beep_adpcm[155] = {", source)
+        self.assertIn('{"beep.wav", earcon_beep_adpcm, sizeof(earcon_beep_adpcm), 301, 16000},', source)
+
+    # Outputs newer than every source must not hide a change (a script edit shows up the same way)
+    def test_regenerates_regardless_of_mtime(self):
+        gen_earcons.generate(self.project)
+        beep = os.path.join(self.sources, "beep.wav")
+        write_wav(beep, [5000] * 64, rate=24000)
+        os.utime(beep, (0, 0))
+        self.assertIn(gen_earcons.SOURCE_OUTPUT, gen_earcons.generate(self.project))
+        self.assertIn("64, 24000}", self.read(gen_earcons.SOURCE_OUTPUT))
+
+    def test_deleted_source_is_dropped(self):
+        gen_earcons.generate(self.project)
+        os.remove(os.path.join(self.sources, "no-signal.wav"))
+        self.assertEqual(gen_earcons.generate(self.project), [gen_earcons.HEADER_OUTPUT, gen_earcons.SOURCE_OUTPUT])
+        self.assertNotIn("NO_SIGNAL", self.read(gen_earcons.HEADER_OUTPUT))
+        self.assertNotIn("no_signal", self.read(gen_earcons.SOURCE_OUTPUT))
+
+    def test_no_sources_is_an_error(self):
+        for name in os.listdir(self.sources):
+            os.remove(os.path.join(self.sources, name))
+        with self.assertRaises(ValueError):
+            gen_earcons.generate(self.project)
+
+    def test_stereo_is_folded_to_mono(self):
+        path = os.path.join(self.sources, "stereo.wav")
+        write_wav(path, [1000, 3000, -1000, -3001, 7, 8], channels=2)
+        self.assertEqual(gen_earcons.read_wav(path), (16000, [2000, -2001, 7]))
+
+
+class CodecTest(unittest.TestCase):
+    def test_frame_layout(self):
+        frame = gen_earcons.encode_frame([0] * 5)
+        self.assertEqual(len(frame), 4 + 3)
+        self.assertEqual(frame[:4], bytes([0, 0, 0, 1]))  # predictor, step index, odd-length flag
+        self.assertEqual(gen_earcons.encode_frame([0] * 4)[3], 0)
+
+    def test_round_trip_tracks_the_signal(self):
+        pcm = [int(12000 * math.sin(i * 0.1)) for i in range(801)]
+        decoded = gen_earcons.decode_frame(gen_earcons.encode_frame(pcm), len(pcm))
+        self.assertEqual(len(decoded), len(pcm))
+        error = max(abs(a - b) for a, b in zip(pcm[200:], decoded[200:]))
+        self.assertLess(error, 2500)
+
+    def test_decoder_matches_the_encoder_state(self):
+        # The encoder updates its state through decode_sample(), so decoding reproduces it exactly
+        state = gen_earcons.AdpcmState()
+        reconstructed = []
+        for sample in (0, 30000, -30000, 123, -32768, 32767, 5):
+            gen_earcons.encode_sample(state, sample)
+            reconstructed.append(state.predictor)
+        pcm = [0, 30000, -30000, 123, -32768, 32767, 5]
+        self.assertEqual(gen_earcons.decode_frame(gen_earcons.encode_frame(pcm), len(pcm)), reconstructed)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,140 @@
+#include <unity.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "earcons_data.h"
+#include "ima_adpcm.h"
+
+// The bank is generated from assets/earcons/*.wav by scripts/gen_earcons.py before the build;
+// test_gen_earcons.py next to this file covers when it is regenerated
+static std::string source_dir()
+{
+    std::string path = __FILE__;
+    size_t slash = path.find_last_of("/\\");
+    return (slash == std::string::npos ? std::string(".") : path.substr(0, slash)) + "/../../assets/earcons/";
+}
+
+void setUp() {}
+void tearDown() {}
+
+// 16-bit PCM, folded to mono the way the generator does it
+static bool read_wav(const std::string &path, std::vector<int16_t> *samples, uint32_t *rate)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    uint8_t riff[12];
+    bool ok = fread(riff, 1, 12, f) == 12 && memcmp(riff, "RIFF", 4) == 0 && memcmp(riff + 8, "WAVE", 4) == 0;
+    int channels = 0;
+    while (ok)
+    {
+        uint8_t chunk[8];
+        if (fread(chunk, 1, 8, f) != 8)
+        {
+            ok = false;
+            break;
+        }
+        uint32_t size = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[16];
+            ok = size >= 16 && fread(fmt, 1, 16, f) == 16 && fseek(f, size - 16, SEEK_CUR) == 0;
+            channels = fmt[2];
+            *rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            ok = ok && fmt[0] == 1 && (channels == 1 || channels == 2) && fmt[14] == 16;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            std::vector<int16_t> raw(size / 2);
+            ok = channels != 0 && fread(raw.data(), 2, raw.size(), f) == raw.size();
+            samples->clear();
+            for (size_t i = 0; i + channels <= raw.size(); i += channels)
+                samples->push_back(channels == 1 ? raw[i] : (int16_t)((raw[i] + raw[i + 1]) >> 1));
+            break;
+        }
+        else
+        {
+            ok = fseek(f, size + (size & 1), SEEK_CUR) == 0;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+static void test_bank_decodes_completely()
+{
+    TEST_ASSERT_GREATER_THAN(0, EARCON_COUNT);
+    for (int i = 0; i < EARCON_COUNT; i++)
+    {
+        const EarconSource &source = earcon_sources[i];
+        TEST_ASSERT_EQUAL_size_t_MESSAGE(ima_adpcm_frame_bytes(source.samples), source.adpcm_bytes, source.file);
+        TEST_ASSERT_EQUAL_size_t_MESSAGE(source.samples, ima_adpcm_frame_samples(source.adpcm, source.adpcm_bytes), source.file);
+
+        std::vector<int16_t> pcm(source.samples + 2);
+        TEST_ASSERT_EQUAL_size_t_MESSAGE(source.samples, ima_adpcm_decode_frame(source.adpcm, source.adpcm_bytes, pcm.data(), pcm.size()),
+                                         source.file);
+    }
+}
+
+// The generator's Python encoder is bit-for-bit ima_adpcm_encode_frame() from a reset state
+static void test_generator_matches_firmware_encoder()
+{
+    for (int i = 0; i < EARCON_COUNT; i++)
+    {
+        const EarconSource &source = earcon_sources[i];
+        std::vector<int16_t> pcm;
+        uint32_t rate = 0;
+        TEST_ASSERT_TRUE_MESSAGE(read_wav(source_dir() + source.file, &pcm, &rate), source.file);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(rate, source.sample_rate, source.file);
+        TEST_ASSERT_EQUAL_size_t_MESSAGE(pcm.size(), source.samples, source.file);
+
+        ImaAdpcmState state;
+        ima_adpcm_reset(&state);
+        std::vector<uint8_t> frame(ima_adpcm_frame_bytes(pcm.size()));
+        TEST_ASSERT_EQUAL_size_t(frame.size(), ima_adpcm_encode_frame(&state, pcm.data(), pcm.size(), frame.data()));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(frame.data(), source.adpcm, frame.size(), source.file);
+    }
+}
+
+// What plays back stays close to the source (the committed tones come out at about 30 dB)
+static void test_decoded_matches_source()
+{
+    for (int i = 0; i < EARCON_COUNT; i++)
+    {
+        const EarconSource &source = earcon_sources[i];
+        std::vector<int16_t> original;
+        uint32_t rate;
+        TEST_ASSERT_TRUE(read_wav(source_dir() + source.file, &original, &rate));
+
+        std::vector<int16_t> pcm(source.samples);
+        ima_adpcm_decode_frame(source.adpcm, source.adpcm_bytes, pcm.data(), pcm.size());
+        double signal = 0;
+        double noise = 0;
+        for (size_t n = 0; n < pcm.size(); n++)
+        {
+            signal += (double)original[n] * original[n];
+            noise += ((double)pcm[n] - original[n]) * ((double)pcm[n] - original[n]);
+        }
+
+        char report[96];
+        double snr = 10 * std::log10(signal / (noise + 1));
+        snprintf(report, sizeof(report), "%s: %u samples, %u bytes, SNR %.1f dB", source.file, (unsigned)source.samples,
+                 (unsigned)source.adpcm_bytes, snr);
+        TEST_MESSAGE(report);
+        TEST_ASSERT_GREATER_THAN_MESSAGE(25, (int)snr, source.file);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bank_decodes_completely);
+    RUN_TEST(test_generator_matches_firmware_encoder);
+    RUN_TEST(test_decoded_matches_source);
+    return UNITY_END();
+}
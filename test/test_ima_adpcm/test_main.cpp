@@ -0,0 +1,252 @@
+#include <unity.h>
+
+#include <cmath>
+#include <cstring>
+
+#include "ima_adpcm.h"
+
+void setUp() {}
+void tearDown() {}
+
+// A 440 Hz tone with a slow swell and a burst of noise, at 16 kHz
+static void make_signal(int16_t *pcm, size_t n)
+{
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < n; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        double swell = 0.2 + 0.8 * std::fabs(std::sin(M_PI * i / n));
+        double s = 20000 * swell * std::sin(2 * M_PI * 440 * i / 16000.0);
+        if (i > n / 2 && i < n / 2 + 200)
+            s += (int32_t)(seed >> 20) - 2048;
+        pcm[i] = (int16_t)s;
+    }
+}
+
+static double snr_db(const int16_t *ref, const int16_t *out, size_t n)
+{
+    double signal = 0;
+    double noise = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        signal += (double)ref[i] * ref[i];
+        noise += (double)(ref[i] - out[i]) * (ref[i] - out[i]);
+    }
+    return 10 * std::log10(signal / (noise > 0 ? noise : 1));
+}
+
+// Reference vectors from an independent IMA/DVI ADPCM implementation (CPython's audioop,
+// lin2adpcm/adpcm2lin), with its high-nibble-first bytes swapped to this codec's layout
+static const int16_t ref_pcm[64] = {
+    0, 3624, 7148, 10058, 11769, 11739, 9638, 5526, 0, -5786, -10292, -11999, -9977, -4455, 2915, 9368,
+    12000, 9182, 1760, -6788, -11769, -9895, -1760, 7725, 12000, 7498, -2915, -11142, -9977, 147, 10292, 10512,
+    0, -10651, -9638, 2485, 11769, 6543, -7148, -11439, 32767, 32767, 32767, 32767, -32768, -32768, 11640, -1322,
+    -12000, -1029, 11870, 2196, -11769, -2196, 11870, 1029, -12000, 1322, 11640, -4727, -9977, 8588, 6169, -11525};
+
+static const uint8_t ref_adpcm[32] = {
+    0x70, 0x77, 0x77, 0x77, 0xfe, 0x9b, 0x51, 0x34, 0xa1, 0xcc, 0x0a, 0x35, 0x91, 0xbd, 0x40, 0x03,
+    0xbc, 0x40, 0xa3, 0x9d, 0x37, 0x00, 0xbf, 0x95, 0x29, 0x91, 0x1a, 0xa3, 0x3b, 0xd3, 0x59, 0xc8};
+
+// ref_adpcm decoded from predictor 0, step index 0
+static const int16_t ref_decoded[64] = {
+    0, 11, 41, 104, 240, 533, 1164, 2521, -1, -5154, -10310, -12318, -10493, -4405, 2889, 9752,
+    12426, 8374, 1744, -6279, -11672, -10692, -886, 8250, 11809, 8574, -2212, -12261, -10956, -277, 9772, 11077,
+    398, -9651, -8346, 2333, 12382, 5856, -7196, -12407, 11282, 32767, 32767, 32767, -5388, -32768, 8198, -4088,
+    -15260, 1668, 10900, 2506, -10212, -3275, 11440, 1885, -10275, 779, 10828, -3529, -9262, 9848, 7305, -13507};
+
+// ref_adpcm decoded from predictor -20000, step index 60 (saturates at both rails)
+static const int16_t ref_decoded_mid_state[64] = {
+    -19716, -15843, -7541, 10257, 32767, 32767, 32767, 32767, -20478, -32768, -32768, -32768, -22612, 11243, 32767,
+    32767, 32767, 15839, -11861, -32768, -32768, -29044, 8198, 32767, 32767, 22611, -11244, -32768, -29044, 1427,
+    30096, 32767, 2296, -26373, -22649, 7822, 32767, 14146, -23096, -32768, 23095, 32767, 32767, 32767, -13399,
+    -32768, 8198, -4088, -15260, 1668, 10900, 2506, -10212, -3275, 11440, 1885, -10275, 779, 10828, -3529, -9262,
+    9848, 7305, -13507};
+
+static void test_encoder_matches_reference_vectors()
+{
+    ImaAdpcmState state;
+    ima_adpcm_reset(&state);
+    uint8_t frame[IMA_ADPCM_HEADER_BYTES + 32];
+    TEST_ASSERT_EQUAL_size_t(sizeof(frame), ima_adpcm_encode_frame(&state, ref_pcm, 64, frame));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(ref_adpcm, frame + IMA_ADPCM_HEADER_BYTES, 32);
+    TEST_ASSERT_EQUAL_INT32(-13507, state.predictor);
+    TEST_ASSERT_EQUAL_INT32(84, state.step_index);
+}
+
+static void test_decoder_matches_reference_vectors()
+{
+    uint8_t frame[IMA_ADPCM_HEADER_BYTES + 32] = {0, 0, 0, 0};
+    memcpy(frame + IMA_ADPCM_HEADER_BYTES, ref_adpcm, 32);
+    int16_t out[64];
+    TEST_ASSERT_EQUAL_size_t(64, ima_adpcm_decode_frame(frame, sizeof(frame), out, 64));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref_decoded, out, 64);
+
+    // -20000 = 0xb1e0
+    frame[0] = 0xe0;
+    frame[1] = 0xb1;
+    frame[2] = 60;
+    TEST_ASSERT_EQUAL_size_t(64, ima_adpcm_decode_frame(frame, sizeof(frame), out, 64));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref_decoded_mid_state, out, 64);
+
+    // The downlink's headerless stream decoder gives the same samples
+    ImaAdpcmState state;
+    ima_adpcm_reset(&state);
+    ima_adpcm_decode_stream(&state, ref_adpcm, 32, out);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref_decoded, out, 64);
+}
+
+// The decoder reproduces the encoder's own reconstruction exactly, frame after frame
+static void test_round_trip_is_bit_exact()
+{
+    const size_t frame_samples = 640;
+    int16_t pcm[frame_samples * 4];
+    make_signal(pcm, frame_samples * 4);
+
+    ImaAdpcmState state;
+    ima_adpcm_reset(&state);
+    for (size_t f = 0; f < 4; f++)
+    {
+        const int16_t *in = pcm + f * frame_samples;
+
+        // Reconstruction the encoder tracks internally
+        ImaAdpcmState shadow = state;
+        int16_t expected[frame_samples];
+        for (size_t i = 0; i < frame_samples; i++)
+        {
+            ima_adpcm_encode_sample(&shadow, in[i]);
+            expected[i] = (int16_t)shadow.predictor;
+        }
+
+        uint8_t frame[IMA_ADPCM_HEADER_BYTES + frame_samples / 2];
+        size_t bytes = ima_adpcm_encode_frame(&state, in, frame_samples, frame);
+        TEST_ASSERT_EQUAL_size_t(ima_adpcm_frame_bytes(frame_samples), bytes);
+        TEST_ASSERT_EQUAL_size_t(324, bytes); // 40 ms at 16 kHz
+        TEST_ASSERT_EQUAL_INT32(shadow.predictor, state.predictor);
+
+        int16_t out[frame_samples];
+        TEST_ASSERT_EQUAL_size_t(frame_samples, ima_adpcm_decode_frame(frame, bytes, out, frame_samples));
+        TEST_ASSERT_EQUAL_INT16_ARRAY(expected, out, frame_samples);
+        TEST_ASSERT_GREATER_THAN(25, (int)snr_db(in, out, frame_samples));
+    }
+}
+
+// Each frame carries its state, so one decodes alone exactly as it does in sequence
+static void test_frames_decode_independently()
+{
+    int16_t pcm[1280];
+    make_signal(pcm, 1280);
+
+    ImaAdpcmState state;
+    ima_adpcm_reset(&state);
+    uint8_t first[IMA_ADPCM_HEADER_BYTES + 320];
+    uint8_t second[IMA_ADPCM_HEADER_BYTES + 320];
+    ima_adpcm_encode_frame(&state, pcm, 640, first);
+    size_t bytes = ima_adpcm_encode_frame(&state, pcm + 640, 640, second);
+
+    int16_t out[640];
+    TEST_ASSERT_EQUAL_size_t(640, ima_adpcm_decode_frame(second, bytes, out, 640));
+    TEST_ASSERT_GREATER_THAN(25, (int)snr_db(pcm + 640, out, 640));
+}
+
+// An odd-length frame decodes to exactly its samples, not one padding sample more
+static void test_odd_frame_keeps_its_length()
+{
+    int16_t pcm[321];
+    make_signal(pcm, 321);
+
+    ImaAdpcmState state;
+    ima_adpcm_reset(&state);
+    uint8_t frame[IMA_ADPCM_HEADER_BYTES + 161];
+    size_t bytes = ima_adpcm_encode_frame(&state, pcm, 321, frame);
+    TEST_ASSERT_EQUAL_size_t(ima_adpcm_frame_bytes(321), bytes);
+    TEST_ASSERT_EQUAL_HEX8(IMA_ADPCM_FLAG_ODD, frame[3]);
+    TEST_ASSERT_EQUAL_size_t(321, ima_adpcm_frame_samples(frame, bytes));
+
+    int16_t out[322];
+    out[321] = 0x5555;
+    TEST_ASSERT_EQUAL_size_t(321, ima_adpcm_decode_frame(frame, bytes, out, 322));
+    TEST_ASSERT_EQUAL_INT16(0x5555, out[321]);
+
+    // Even frames leave the flag clear
+    ima_adpcm_reset(&state);
+    bytes = ima_adpcm_encode_frame(&state, pcm, 320, frame);
+    TEST_ASSERT_EQUAL_HEX8(0, frame[3]);
+    TEST_ASSERT_EQUAL_size_t(320, ima_adpcm_decode_frame(frame, bytes, out, 322));
+}
+
+static void test_decode_stops_at_max_samples()
+{
+    int16_t pcm[64];
+    make_signal(pcm, 64);
+
+    ImaAdpcmState state;
+    ima_adpcm_reset(&state);
+    uint8_t frame[IMA_ADPCM_HEADER_BYTES + 32];
+    size_t bytes = ima_adpcm_encode_frame(&state, pcm, 64, frame);
+
+    int16_t full[64];
+    int16_t part[17];
+    ima_adpcm_decode_frame(frame, bytes, full, 64);
+    TEST_ASSERT_EQUAL_size_t(17, ima_adpcm_decode_frame(frame, bytes, part, 17));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(full, part, 17);
+}
+
+static void test_bad_frames_are_rejected()
+{
+    int16_t out[8];
+    uint8_t short_frame[3] = {0, 0, 0};
+    TEST_ASSERT_EQUAL_size_t(0, ima_adpcm_decode_frame(short_frame, sizeof(short_frame), out, 8));
+
+    uint8_t bad_index[6] = {0, 0, 89, 0, 0x11, 0x22};
+    TEST_ASSERT_EQUAL_size_t(0, ima_adpcm_decode_frame(bad_index, sizeof(bad_index), out, 8));
+}
+
+// The headerless stream gives the same samples however the bytes are split
+static void test_stream_split_anywhere()
+{
+    int16_t pcm[1000];
+    make_signal(pcm, 1000);
+
+    ImaAdpcmState state;
+    ima_adpcm_reset(&state);
+    uint8_t stream[500];
+    for (size_t i = 0; i < 500; i++)
+    {
+        uint8_t lo = ima_adpcm_encode_sample(&state, pcm[2 * i]);
+        uint8_t hi = ima_adpcm_encode_sample(&state, pcm[2 * i + 1]);
+        stream[i] = (uint8_t)(lo | hi << 4);
+    }
+
+    int16_t whole[1000];
+    ima_adpcm_reset(&state);
+    TEST_ASSERT_EQUAL_size_t(1000, ima_adpcm_decode_stream(&state, stream, 500, whole));
+
+    int16_t pieces[1000];
+    ima_adpcm_reset(&state);
+    size_t pos = 0;
+    size_t sizes[] = {1, 7, 0, 128, 3, 361};
+    for (size_t k = 0; pos < 500; k++)
+    {
+        size_t n = sizes[k % 6];
+        if (n > 500 - pos)
+            n = 500 - pos;
+        ima_adpcm_decode_stream(&state, stream + pos, n, pieces + 2 * pos);
+        pos += n;
+    }
+    TEST_ASSERT_EQUAL_INT16_ARRAY(whole, pieces, 1000);
+    TEST_ASSERT_GREATER_THAN(25, (int)snr_db(pcm, whole, 1000));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_encoder_matches_reference_vectors);
+    RUN_TEST(test_decoder_matches_reference_vectors);
+    RUN_TEST(test_round_trip_is_bit_exact);
+    RUN_TEST(test_frames_decode_independently);
+    RUN_TEST(test_odd_frame_keeps_its_length);
+    RUN_TEST(test_decode_stops_at_max_samples);
+    RUN_TEST(test_bad_frames_are_rejected);
+    RUN_TEST(test_stream_split_anywhere);
+    return UNITY_END();
+}
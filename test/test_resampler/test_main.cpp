@@ -0,0 +1,163 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "resampler.h"
+
+static PolyphaseResampler resampler; // the coefficient table is too big for the stack
+
+void setUp() {}
+void tearDown() {}
+
+static std::vector<int16_t> tone(uint32_t rate, size_t n, double hz, double amplitude)
+{
+    std::vector<int16_t> in(n);
+    for (size_t i = 0; i < n; i++)
+        in[i] = (int16_t)lround(amplitude * std::sin(2 * M_PI * hz * i / rate));
+    return in;
+}
+
+// Feed in in pieces of piece samples into an output buffer of out_piece samples at a time
+static std::vector<int16_t> convert(const std::vector<int16_t> &in, size_t piece, size_t out_piece)
+{
+    std::vector<int16_t> out;
+    std::vector<int16_t> buf(out_piece);
+    size_t pos = 0;
+    while (pos < in.size())
+    {
+        size_t n = piece < in.size() - pos ? piece : in.size() - pos;
+        size_t off = 0;
+        while (off < n)
+        {
+            size_t used;
+            size_t produced = resampler.process(&in[pos + off], n - off, buf.data(), buf.size(), &used);
+            out.insert(out.end(), buf.begin(), buf.begin() + produced);
+            off += used;
+            if (produced == 0 && used == 0)
+                break;
+        }
+        pos += n;
+    }
+    return out;
+}
+
+// RMS error against an ideal sine, at the best fractional delay (the filter's group delay)
+static double sine_error(const std::vector<int16_t> &out, uint32_t rate, double hz, double amplitude)
+{
+    double best = 1e30;
+    for (double delay = 0; delay < 60; delay += 0.05)
+    {
+        double err = 0;
+        size_t count = 0;
+        for (size_t n = 200; n + 10 < out.size(); n++)
+        {
+            double ideal = amplitude * std::sin(2 * M_PI * hz * (n - delay) / rate);
+            err += (out[n] - ideal) * (out[n] - ideal);
+            count++;
+        }
+        if (err / count < best)
+            best = err / count;
+    }
+    return std::sqrt(best);
+}
+
+static void test_init_limits()
+{
+    TEST_ASSERT_FALSE(resampler.init(0, 48000));
+    TEST_ASSERT_FALSE(resampler.ready());
+    TEST_ASSERT_FALSE(resampler.init(44099, 48000)); // reduces to 48000/44099
+    TEST_ASSERT_TRUE(resampler.init(16000, 44100));  // 441/160
+    TEST_ASSERT_TRUE(resampler.ready());
+}
+
+static void test_rates_pass_a_tone_cleanly()
+{
+    const uint32_t pairs[][2] = {{24000, 48000}, {22050, 48000}, {16000, 44100}, {48000, 24000},
+                                 {16000, 48000}, {24000, 16000}, {8000, 48000}};
+    for (size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); p++)
+    {
+        uint32_t in_rate = pairs[p][0];
+        uint32_t out_rate = pairs[p][1];
+        TEST_ASSERT_TRUE(resampler.init(in_rate, out_rate));
+        std::vector<int16_t> out = convert(tone(in_rate, in_rate / 2, 1000, 10000), 97, 333);
+
+        // Exactly the rate ratio in length, and within -40 dB of the ideal tone
+        TEST_ASSERT_EQUAL_size_t(out_rate / 2, out.size());
+        TEST_ASSERT_LESS_THAN(60, (int)sine_error(out, out_rate, 1000, 10000));
+    }
+}
+
+static void test_unity_dc_gain()
+{
+    TEST_ASSERT_TRUE(resampler.init(22050, 48000));
+    std::vector<int16_t> in(2000, 10000);
+    std::vector<int16_t> out = convert(in, 2000, 8192);
+    for (size_t n = 100; n < out.size(); n++)
+        TEST_ASSERT_INT_WITHIN(1, 10000, out[n]);
+}
+
+// State carries across calls: arbitrary pieces give the same output as one call
+static void test_pieces_match_one_call()
+{
+    std::vector<int16_t> in = tone(24000, 3000, 700, 12000);
+    TEST_ASSERT_TRUE(resampler.init(24000, 44100));
+    std::vector<int16_t> whole = convert(in, in.size(), 8192);
+    resampler.reset();
+    std::vector<int16_t> pieces = convert(in, 7, 5);
+    TEST_ASSERT_EQUAL_size_t(whole.size(), pieces.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(whole.data(), pieces.data(), whole.size());
+}
+
+// Content above the output's Nyquist limit is filtered rather than aliased (at least 25 dB down)
+static void test_downsampling_rejects_aliases()
+{
+    TEST_ASSERT_TRUE(resampler.init(48000, 16000));
+    std::vector<int16_t> out = convert(tone(48000, 24000, 12000, 10000), 480, 512);
+    double energy = 0;
+    for (size_t n = 100; n < out.size(); n++)
+        energy += (double)out[n] * out[n];
+    TEST_ASSERT_LESS_THAN(397, (int)std::sqrt(energy / (out.size() - 100)));
+}
+
+// Host cost per output sample for the device's common conversions (reported, not asserted)
+static void test_benchmark()
+{
+    const uint32_t pairs[][2] = {{24000, 48000}, {16000, 48000}, {22050, 48000}};
+    for (size_t p = 0; p < 3; p++)
+    {
+        TEST_ASSERT_TRUE(resampler.init(pairs[p][0], pairs[p][1]));
+        std::vector<int16_t> in = tone(pairs[p][0], pairs[p][0] * 10, 1000, 10000);
+        std::vector<int16_t> out(1024);
+        size_t produced = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t pos = 0; pos < in.size();)
+        {
+            size_t used;
+            produced += resampler.process(&in[pos], in.size() - pos, out.data(), out.size(), &used);
+            pos += used;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        char report[96];
+        snprintf(report, sizeof(report), "%u -> %u Hz: %.2f ns per output sample (%u taps)", (unsigned)pairs[p][0],
+                 (unsigned)pairs[p][1], ns / produced, RESAMPLER_TAPS);
+        TEST_MESSAGE(report);
+        TEST_ASSERT_EQUAL_size_t((size_t)pairs[p][1] * 10, produced);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_limits);
+    RUN_TEST(test_rates_pass_a_tone_cleanly);
+    RUN_TEST(test_unity_dc_gain);
+    RUN_TEST(test_pieces_match_one_call);
+    RUN_TEST(test_downsampling_rejects_aliases);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,149 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "signal_stats.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_isqrt64_is_floor_sqrt()
+{
+    TEST_ASSERT_EQUAL_UINT32(0, isqrt64(0));
+    TEST_ASSERT_EQUAL_UINT32(1, isqrt64(1));
+    TEST_ASSERT_EQUAL_UINT32(1, isqrt64(3));
+    TEST_ASSERT_EQUAL_UINT32(2, isqrt64(4));
+    TEST_ASSERT_EQUAL_UINT32(9, isqrt64(99));
+    TEST_ASSERT_EQUAL_UINT32(10, isqrt64(100));
+    TEST_ASSERT_EQUAL_UINT32(32768, isqrt64(1073741824ull));
+    TEST_ASSERT_EQUAL_UINT32(4294967295u, isqrt64(18446744073709551615ull));
+    for (uint64_t r = 1; r < 70000; r += 97)
+    {
+        TEST_ASSERT_EQUAL_UINT32(r, isqrt64(r * r));
+        TEST_ASSERT_EQUAL_UINT32(r - 1, isqrt64(r * r - 1));
+    }
+}
+
+static void test_empty_stats_are_zero()
+{
+    SignalStats stats;
+    signal_stats_reset(&stats);
+    TEST_ASSERT_EQUAL_UINT32(0, signal_stats_rms(&stats));
+    TEST_ASSERT_EQUAL_INT32(0, signal_stats_dc(&stats));
+    TEST_ASSERT_EQUAL_UINT32(0, signal_stats_silence_permille(&stats));
+}
+
+// Chunked updates agree with a double-precision pass over the whole signal
+static void test_chunked_matches_reference()
+{
+    std::vector<int16_t> pcm(100000);
+    for (size_t i = 0; i < pcm.size(); i++)
+        pcm[i] = (int16_t)(100 + 20000 * std::sin(i * 0.01));
+    pcm[5] = -32768;
+    for (size_t i = 50000; i < 52000; i++)
+        pcm[i] = (int16_t)(i & 15) - 8; // a stretch of near silence
+
+    SignalStats stats;
+    signal_stats_reset(&stats);
+    for (size_t i = 0; i < pcm.size(); i += 777)
+        signal_stats_update(&stats, &pcm[i], pcm.size() - i < 777 ? pcm.size() - i : 777);
+
+    double squares = 0;
+    double sum = 0;
+    uint32_t silent = 0;
+    for (size_t i = 0; i < pcm.size(); i++)
+    {
+        squares += (double)pcm[i] * pcm[i];
+        sum += pcm[i];
+        silent += std::abs((int)pcm[i]) < SIGNAL_SILENCE_LEVEL;
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(pcm.size(), stats.samples);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)std::sqrt(squares / pcm.size()), signal_stats_rms(&stats));
+    TEST_ASSERT_INT_WITHIN(1, (int32_t)(sum / pcm.size()), signal_stats_dc(&stats));
+    TEST_ASSERT_EQUAL_UINT32(32768, stats.peak);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.clipped); // the sine peaks at 20100
+    TEST_ASSERT_EQUAL_UINT32(silent * 1000 / pcm.size(), signal_stats_silence_permille(&stats));
+}
+
+// Blocks longer than the int32 partial sum can hold are split internally
+static void test_long_update_keeps_exact_sum()
+{
+    std::vector<int16_t> pcm(200000, 32767);
+    SignalStats stats;
+    signal_stats_reset(&stats);
+    signal_stats_update(&stats, pcm.data(), pcm.size());
+    TEST_ASSERT_EQUAL_INT32(32767, signal_stats_dc(&stats));
+    TEST_ASSERT_EQUAL_UINT32(32767, signal_stats_rms(&stats));
+    TEST_ASSERT_EQUAL_UINT32(200000, stats.clipped);
+}
+
+// The check play_audio_response() ran before: byte parsing, uint64 and double sqrt over
+// the first 1024 samples once the whole response was buffered
+static bool baseline_validate(const uint8_t *data, size_t length, size_t limit)
+{
+    size_t samples = length / 2 < limit ? length / 2 : limit;
+    uint64_t sum_squares = 0;
+    int32_t peak = 0;
+    for (size_t i = 0; i < samples; ++i)
+    {
+        int16_t sample = (int16_t)(data[i * 2] | (data[i * 2 + 1] << 8));
+        int32_t mag = sample < 0 ? -sample : sample;
+        sum_squares += (uint64_t)mag * (uint64_t)mag;
+        if (mag > peak)
+            peak = mag;
+    }
+    double rms = std::sqrt((double)sum_squares / (double)samples);
+    return peak >= 300 || rms >= 40.0 || (peak > 0 && rms > 1.0);
+}
+
+// Micro-benchmark against the old check (reported, not asserted). The old check only
+// covered 1024 samples, so it is also timed over the whole response for a like-for-like
+// per-sample cost.
+static void test_benchmark_against_baseline()
+{
+    const size_t samples = 24000 * 5; // a 5 s response at 24 kHz
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; i++)
+        pcm[i] = (int16_t)(8000 * std::sin(i * 0.05) + (int)(i % 7) * 30);
+    const uint8_t *bytes = (const uint8_t *)pcm.data();
+    const int rounds = 50;
+
+    volatile bool sink = false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        sink = baseline_validate(bytes, samples * 2, samples);
+    double baseline_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    SignalStats stats;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        signal_stats_reset(&stats);
+        for (size_t i = 0; i < samples; i += 1024) // per arriving chunk
+            signal_stats_update(&stats, &pcm[i], samples - i < 1024 ? samples - i : 1024);
+        sink = signal_stats_rms(&stats) >= 40;
+    }
+    double stats_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    (void)sink;
+
+    char report[160];
+    snprintf(report, sizeof(report), "per sample: old check %.2f ns, signal_stats %.2f ns (with DC, clip and silence counts)",
+             baseline_ns / rounds / samples, stats_ns / rounds / samples);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_TRUE(baseline_validate(bytes, samples * 2, 1024));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_isqrt64_is_floor_sqrt);
+    RUN_TEST(test_empty_stats_are_zero);
+    RUN_TEST(test_chunked_matches_reference);
+    RUN_TEST(test_long_update_keeps_exact_sum);
+    RUN_TEST(test_benchmark_against_baseline);
+    return UNITY_END();
+}
@@ -0,0 +1,202 @@
+#include <unity.h>
+
+#include <thread>
+
+#include "spsc_ring_buffer.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_init_rejects_bad_capacity()
+{
+    int16_t storage[12];
+    SpscRingBuffer<int16_t> ring;
+    TEST_ASSERT_FALSE(ring.init(nullptr, 8));
+    TEST_ASSERT_FALSE(ring.init(storage, 0));
+    TEST_ASSERT_FALSE(ring.init(storage, 12));
+    TEST_ASSERT_TRUE(ring.init(storage, 8));
+    TEST_ASSERT_EQUAL_size_t(8, ring.capacity());
+    TEST_ASSERT_EQUAL_size_t(0, ring.available());
+    TEST_ASSERT_EQUAL_size_t(8, ring.free_space());
+}
+
+static void test_push_pop_wraps_in_order()
+{
+    int16_t storage[8];
+    SpscRingBuffer<int16_t> ring;
+    ring.init(storage, 8);
+
+    int16_t next_in = 0;
+    int16_t next_out = 0;
+    for (int round = 0; round < 20; round++)
+    {
+        int16_t in[5];
+        for (int i = 0; i < 5; i++)
+            in[i] = next_in++;
+        TEST_ASSERT_TRUE(ring.push(in, 5));
+        TEST_ASSERT_EQUAL_size_t(5, ring.available());
+
+        int16_t out[5];
+        TEST_ASSERT_EQUAL_size_t(5, ring.pop(out, 5));
+        for (int i = 0; i < 5; i++)
+            TEST_ASSERT_EQUAL_INT16(next_out++, out[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, ring.overflow_count());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.underflow_count());
+}
+
+static void test_push_is_all_or_nothing()
+{
+    int16_t storage[8];
+    SpscRingBuffer<int16_t> ring;
+    ring.init(storage, 8);
+
+    int16_t in[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    TEST_ASSERT_TRUE(ring.push(in, 6));
+    TEST_ASSERT_FALSE(ring.push(in, 3));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.overflow_count());
+    TEST_ASSERT_EQUAL_size_t(6, ring.available());
+    TEST_ASSERT_TRUE(ring.push(in, 2));
+    TEST_ASSERT_EQUAL_size_t(0, ring.free_space());
+}
+
+static void test_short_pop_counts_underflow()
+{
+    int16_t storage[8];
+    SpscRingBuffer<int16_t> ring;
+    ring.init(storage, 8);
+
+    int16_t in[3] = {7, 8, 9};
+    ring.push(in, 3);
+    int16_t out[8];
+    TEST_ASSERT_EQUAL_size_t(3, ring.pop(out, 8));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.underflow_count());
+    TEST_ASSERT_EQUAL_INT16(9, out[2]);
+    TEST_ASSERT_EQUAL_size_t(0, ring.pop(out, 1));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.underflow_count());
+}
+
+static void test_spans_stop_at_the_end_of_storage()
+{
+    int16_t storage[8];
+    SpscRingBuffer<int16_t> ring;
+    ring.init(storage, 8);
+
+    int16_t in[6] = {0, 1, 2, 3, 4, 5};
+    int16_t out[6];
+    ring.push(in, 6);
+    ring.pop(out, 6);
+
+    // Head and tail sit at index 6: only two slots are contiguous
+    int16_t *span;
+    TEST_ASSERT_EQUAL_size_t(2, ring.write_span(&span));
+    span[0] = 100;
+    span[1] = 101;
+    ring.commit(2);
+    TEST_ASSERT_EQUAL_size_t(6, ring.write_span(&span));
+    TEST_ASSERT_TRUE(span == storage);
+    span[0] = 102;
+    ring.commit(1);
+
+    TEST_ASSERT_EQUAL_size_t(2, ring.read_span(&span));
+    TEST_ASSERT_EQUAL_INT16(100, span[0]);
+    TEST_ASSERT_EQUAL_size_t(1, ring.read_span_at(1, &span));
+    TEST_ASSERT_EQUAL_INT16(101, span[0]);
+    TEST_ASSERT_EQUAL_size_t(1, ring.read_span_at(2, &span));
+    TEST_ASSERT_EQUAL_INT16(102, span[0]);
+    TEST_ASSERT_EQUAL_size_t(0, ring.read_span_at(3, &span));
+
+    ring.consume(2);
+    TEST_ASSERT_EQUAL_size_t(1, ring.read_span(&span));
+    TEST_ASSERT_EQUAL_INT16(102, span[0]);
+    ring.discard();
+    TEST_ASSERT_EQUAL_size_t(0, ring.available());
+}
+
+// An abort drops what was written before its mark but keeps what a new stream wrote since
+static void test_discard_to_keeps_later_writes()
+{
+    int16_t storage[8];
+    SpscRingBuffer<int16_t> ring;
+    ring.init(storage, 8);
+    const int16_t old_stream[] = {1, 2, 3, 4, 5, 6};
+    const int16_t new_stream[] = {7, 8, 9};
+    int16_t out[8];
+
+    ring.push(old_stream, 6);
+    ring.pop(out, 2);
+    size_t mark = ring.write_position();
+    ring.push(new_stream, 3); // wraps
+    ring.discard_to(mark);
+    TEST_ASSERT_EQUAL_size_t(3, ring.available());
+    TEST_ASSERT_EQUAL_size_t(3, ring.pop(out, 3));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(new_stream, out, 3);
+
+    ring.discard_to(mark); // already past it
+    ring.push(old_stream, 2);
+    ring.discard_to(mark);
+    TEST_ASSERT_EQUAL_size_t(2, ring.available());
+}
+
+// A producer and a consumer thread hammer a small ring; every value must come out once, in order
+static void test_threads_see_an_ordered_stream()
+{
+    static uint32_t storage[64];
+    SpscRingBuffer<uint32_t> ring;
+    ring.init(storage, 64);
+
+    const uint32_t count = 200000;
+    std::thread producer([&ring, count]() {
+        uint32_t next = 0;
+        while (next < count)
+        {
+            uint32_t block[7];
+            size_t n = 0;
+            while (n < 7 && next + n < count)
+            {
+                block[n] = next + (uint32_t)n;
+                n++;
+            }
+            if (ring.push(block, n))
+                next += (uint32_t)n;
+            else
+                std::this_thread::yield();
+        }
+    });
+
+    uint32_t expected = 0;
+    bool in_order = true;
+    while (expected < count)
+    {
+        uint32_t *span;
+        size_t n = ring.read_span(&span);
+        if (n == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            if (span[i] != expected++)
+                in_order = false;
+        }
+        ring.consume(n);
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(in_order);
+    TEST_ASSERT_EQUAL_size_t(0, ring.available());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_rejects_bad_capacity);
+    RUN_TEST(test_push_pop_wraps_in_order);
+    RUN_TEST(test_push_is_all_or_nothing);
+    RUN_TEST(test_short_pop_counts_underflow);
+    RUN_TEST(test_spans_stop_at_the_end_of_storage);
+    RUN_TEST(test_discard_to_keeps_later_writes);
+    RUN_TEST(test_threads_see_an_ordered_stream);
+    return UNITY_END();
+}
@@ -0,0 +1,220 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "time_stretch.h"
+
+#define RATE 24000
+
+static WsolaStretcher stretcher; // too big for the stack
+static std::vector<int16_t> speech_signal;
+
+void setUp() {}
+void tearDown() {}
+
+// Speech-like test signal: harmonics of a 140 Hz voice (with vibrato) shaped by
+// three formants, a 4 Hz syllable envelope and a pause every second
+static const std::vector<int16_t> &speech()
+{
+    if (!speech_signal.empty())
+        return speech_signal;
+
+    speech_signal.resize(RATE * 20);
+    double phase = 0;
+    for (size_t i = 0; i < speech_signal.size(); i++)
+    {
+        double t = (double)i / RATE;
+        double f0 = 140 + 20 * std::sin(2 * M_PI * 3 * t);
+        phase += 2 * M_PI * f0 / RATE;
+
+        double s = 0;
+        for (int h = 1; h <= 20; h++)
+        {
+            double f = h * f0;
+            double a = std::exp(-std::pow((f - 700) / 300, 2)) + 0.6 * std::exp(-std::pow((f - 1200) / 400, 2)) +
+                       0.3 * std::exp(-std::pow((f - 2500) / 500, 2));
+            s += a * std::sin(h * phase);
+        }
+        double envelope = 0.5 + 0.5 * std::sin(2 * M_PI * 4 * t);
+        if (std::fmod(t, 1.0) > 0.8)
+            envelope *= 0.02;
+        double v = 2500 * s * envelope;
+        speech_signal[i] = (int16_t)(v > 32000 ? 32000 : (v < -32000 ? -32000 : v));
+    }
+    return speech_signal;
+}
+
+// Feed in in pseudo-random pieces (as network chunks arrive), then finish and drain
+static std::vector<int16_t> stretch(const std::vector<int16_t> &in, uint32_t speed, size_t max_piece)
+{
+    TEST_ASSERT_TRUE(stretcher.init(RATE));
+    stretcher.set_speed(speed);
+
+    std::vector<int16_t> out;
+    out.reserve(in.size());
+    int16_t buf[1024];
+    uint32_t seed = 12345;
+    size_t pos = 0;
+    while (pos < in.size())
+    {
+        seed = seed * 1664525u + 1013904223u;
+        size_t piece = (seed >> 8) % max_piece + 1;
+        if (piece > in.size() - pos)
+            piece = in.size() - pos;
+        for (size_t off = 0; off < piece;)
+        {
+            size_t used;
+            size_t n = stretcher.process(&in[pos + off], piece - off, buf, sizeof(buf) / sizeof(buf[0]), &used);
+            out.insert(out.end(), buf, buf + n);
+            off += used;
+            if (used == 0 && n == 0)
+                break;
+        }
+        pos += piece;
+    }
+
+    // Blocks still due once the input is in (as drain_stretcher() does), then the unstretched rest
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+            stretcher.finish();
+        for (;;)
+        {
+            size_t used;
+            size_t n = stretcher.process(nullptr, 0, buf, sizeof(buf) / sizeof(buf[0]), &used);
+            if (n == 0)
+                break;
+            out.insert(out.end(), buf, buf + n);
+        }
+    }
+    return out;
+}
+
+// Autocorrelation pitch over a voiced stretch a quarter of the way in
+static double pitch(const std::vector<int16_t> &x)
+{
+    size_t start = x.size() / 4;
+    double best = 0;
+    int best_lag = 1;
+    for (int lag = RATE / 400; lag < RATE / 60; lag++)
+    {
+        double c = 0;
+        for (size_t i = 0; i < 2048; i++)
+            c += (double)x[start + i] * x[start + i + lag];
+        if (c > best)
+        {
+            best = c;
+            best_lag = lag;
+        }
+    }
+    return (double)RATE / best_lag;
+}
+
+static int32_t max_jump(const std::vector<int16_t> &x)
+{
+    int32_t jump = 0;
+    for (size_t i = 1; i < x.size(); i++)
+        jump = abs(x[i] - x[i - 1]) > jump ? abs(x[i] - x[i - 1]) : jump;
+    return jump;
+}
+
+static void test_init_limits()
+{
+    TEST_ASSERT_FALSE(stretcher.init(0));
+    TEST_ASSERT_FALSE(stretcher.ready());
+    TEST_ASSERT_FALSE(stretcher.init(96000)); // blocks would not fit
+    TEST_ASSERT_TRUE(stretcher.init(48000));
+    TEST_ASSERT_TRUE(stretcher.init(16000));
+    TEST_ASSERT_TRUE(stretcher.ready());
+}
+
+static void test_speed_is_clamped()
+{
+    stretcher.init(RATE);
+    stretcher.set_speed(50);
+    TEST_ASSERT_EQUAL_UINT32(TSM_MIN_SPEED, stretcher.speed());
+    stretcher.set_speed(400);
+    TEST_ASSERT_EQUAL_UINT32(TSM_MAX_SPEED, stretcher.speed());
+    stretcher.set_speed(130);
+    stretcher.init(16000); // the speed survives a new rate
+    TEST_ASSERT_EQUAL_UINT32(130, stretcher.speed());
+}
+
+// Output length follows the speed and the voice keeps its pitch, with no clicks
+static void test_length_pitch_and_continuity()
+{
+    const std::vector<int16_t> &in = speech();
+    double in_pitch = pitch(in);
+    int32_t in_jump = max_jump(in);
+
+    const uint32_t speeds[] = {100, 125, 150, 190};
+    for (size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++)
+    {
+        std::vector<int16_t> out = stretch(in, speeds[s], 3000);
+        double ratio = (double)in.size() / out.size();
+        double out_pitch = pitch(out);
+
+        char report[128];
+        snprintf(report, sizeof(report), "speed %u%%: x%.3f length, pitch %.1f -> %.1f Hz, max jump %d (input %d)",
+                 (unsigned)speeds[s], ratio, in_pitch, out_pitch, (int)max_jump(out), (int)in_jump);
+        TEST_MESSAGE(report);
+
+        TEST_ASSERT_TRUE_MESSAGE(std::fabs(ratio - speeds[s] / 100.0) < 0.02, report);
+        TEST_ASSERT_TRUE_MESSAGE(std::fabs(out_pitch - in_pitch) < in_pitch * 0.05, report);
+        TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(in_jump * 3 / 2, max_jump(out), report);
+    }
+}
+
+// At normal speed nothing is lost or reordered: blocks line up end to end
+static void test_normal_speed_passes_through()
+{
+    std::vector<int16_t> in(speech().begin(), speech().begin() + RATE);
+    std::vector<int16_t> out = stretch(in, 100, 700);
+    TEST_ASSERT_EQUAL_size_t(in.size(), out.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(in.data(), out.data(), in.size());
+}
+
+// How the input is split doesn't change the result
+static void test_pieces_match_one_call()
+{
+    std::vector<int16_t> in(speech().begin(), speech().begin() + RATE * 2);
+    std::vector<int16_t> small = stretch(in, 140, 37);
+    std::vector<int16_t> large = stretch(in, 140, 5000);
+    TEST_ASSERT_EQUAL_size_t(small.size(), large.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(small.data(), large.data(), small.size());
+}
+
+// Host real-time factor at 24 kHz mono (reported, not asserted)
+static void test_benchmark()
+{
+    const std::vector<int16_t> &in = speech();
+    const uint32_t speeds[] = {125, 150};
+    for (size_t s = 0; s < 2; s++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<int16_t> out = stretch(in, speeds[s], 3000);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        char report[128];
+        snprintf(report, sizeof(report), "speed %u%%: RTF %.5f (%.0fx real time), %.1f ns per output sample",
+                 (unsigned)speeds[s], seconds / (in.size() / (double)RATE), in.size() / (double)RATE / seconds,
+                 seconds * 1e9 / out.size());
+        TEST_MESSAGE(report);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_limits);
+    RUN_TEST(test_speed_is_clamped);
+    RUN_TEST(test_length_pitch_and_continuity);
+    RUN_TEST(test_normal_speed_passes_through);
+    RUN_TEST(test_pieces_match_one_call);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,262 @@
+#include <unity.h>
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tts_cache.h"
+
+// In-memory stand-in for the filesystem that counts writes
+class MemoryStorage : public TtsCacheStorage
+{
+public:
+    MemoryStorage() : writes(0) {}
+
+    bool write(const char *path, const uint8_t *data, size_t len) override
+    {
+        writes++;
+        files[path].assign(data, data + len);
+        return true;
+    }
+
+    bool append(const char *path, const uint8_t *data, size_t len) override
+    {
+        writes++;
+        std::vector<uint8_t> &file = files[path];
+        file.insert(file.end(), data, data + len);
+        return true;
+    }
+
+    size_t read(const char *path, size_t offset, uint8_t *dst, size_t len) override
+    {
+        std::map<std::string, std::vector<uint8_t> >::iterator it = files.find(path);
+        if (it == files.end() || offset > it->second.size())
+            return 0;
+        size_t n = len < it->second.size() - offset ? len : it->second.size() - offset;
+        memcpy(dst, it->second.data() + offset, n);
+        return n;
+    }
+
+    bool remove(const char *path) override
+    {
+        writes++;
+        return files.erase(path) > 0;
+    }
+
+    std::map<std::string, std::vector<uint8_t> > files;
+    int writes;
+};
+
+static MemoryStorage *storage;
+
+void setUp()
+{
+    storage = new MemoryStorage();
+}
+
+void tearDown()
+{
+    delete storage;
+}
+
+// Store bytes of audio under key, in pieces as service_tts_cache() does
+static bool put(TtsCache &cache, uint64_t key, uint32_t bytes)
+{
+    TtsAudioHeader header = {0, 1, 0, 24000, bytes};
+    if (!cache.store_begin(key, header))
+        return false;
+    std::vector<uint8_t> audio(bytes, (uint8_t)key);
+    for (uint32_t offset = 0; offset < bytes; offset += 700)
+    {
+        if (!cache.store_append(&audio[offset], bytes - offset < 700 ? bytes - offset : 700))
+            return false;
+    }
+    return cache.store_commit();
+}
+
+static void test_key_is_fnv1a()
+{
+    TEST_ASSERT_TRUE(TtsCache::key_for("") == 0xcbf29ce484222325ULL);
+    TEST_ASSERT_TRUE(TtsCache::key_for("a") == 0xaf63dc4c8601ec8cULL);
+    TEST_ASSERT_TRUE(TtsCache::key_for("hello") != TtsCache::key_for("hellp"));
+}
+
+static void test_store_and_replay()
+{
+    TtsCache cache;
+    TEST_ASSERT_TRUE(cache.begin(storage, 10000));
+    TEST_ASSERT_TRUE(put(cache, 7, 3000));
+
+    TtsAudioHeader header;
+    TEST_ASSERT_TRUE(cache.lookup(7, &header));
+    TEST_ASSERT_EQUAL_UINT32(3000, header.data_bytes);
+    TEST_ASSERT_EQUAL_UINT32(24000, header.sample_rate);
+
+    uint8_t audio[10];
+    TEST_ASSERT_EQUAL_size_t(10, cache.read_audio(7, 2990, audio, 10));
+    TEST_ASSERT_EQUAL_UINT8(7, audio[9]);
+    TEST_ASSERT_EQUAL_size_t(0, cache.read_audio(7, 3000, audio, 10));
+    TEST_ASSERT_FALSE(cache.lookup(8, &header));
+}
+
+static void test_evicts_least_recently_used()
+{
+    TtsCache cache;
+    cache.begin(storage, 10000);
+    TEST_ASSERT_TRUE(put(cache, 1, 3000));
+    TEST_ASSERT_TRUE(put(cache, 2, 3000));
+    TEST_ASSERT_TRUE(put(cache, 3, 3000));
+
+    TtsAudioHeader header;
+    TEST_ASSERT_TRUE(cache.lookup(1, &header)); // 2 is now the oldest
+    TEST_ASSERT_TRUE(put(cache, 4, 3000));
+
+    TEST_ASSERT_FALSE(cache.lookup(2, &header));
+    TEST_ASSERT_TRUE(cache.lookup(1, &header));
+    TEST_ASSERT_TRUE(cache.lookup(3, &header));
+    TEST_ASSERT_TRUE(cache.lookup(4, &header));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(10000, cache.used_bytes());
+    TEST_ASSERT_EQUAL_size_t(4, storage->files.size()); // three entries and the index
+}
+
+static void test_entry_limit()
+{
+    TtsCache cache;
+    cache.begin(storage, 1000000);
+    for (int i = 0; i < TTS_CACHE_MAX_ENTRIES + 12; i++)
+        TEST_ASSERT_TRUE(put(cache, 100 + i, 10));
+
+    TtsAudioHeader header;
+    TEST_ASSERT_EQUAL_size_t(TTS_CACHE_MAX_ENTRIES, cache.entries());
+    TEST_ASSERT_FALSE(cache.lookup(100, &header));
+    TEST_ASSERT_TRUE(cache.lookup(100 + TTS_CACHE_MAX_ENTRIES + 11, &header));
+}
+
+static void test_oversized_entry_is_refused()
+{
+    TtsCache cache;
+    cache.begin(storage, 10000);
+    TEST_ASSERT_TRUE(put(cache, 1, 3000));
+    TEST_ASSERT_FALSE(put(cache, 2, 20000));
+    TEST_ASSERT_EQUAL_size_t(1, cache.entries());
+}
+
+// The index survives a reboot, and a smaller budget trims the oldest entries
+static void test_index_persists_and_budget_shrinks()
+{
+    TtsAudioHeader header;
+    {
+        TtsCache cache;
+        cache.begin(storage, 10000);
+        put(cache, 1, 3000);
+        put(cache, 2, 3000);
+        put(cache, 3, 3000);
+        cache.lookup(1, &header);
+        TEST_ASSERT_TRUE(cache.flush());
+    }
+
+    TtsCache rebooted;
+    rebooted.begin(storage, 10000);
+    TEST_ASSERT_EQUAL_size_t(3, rebooted.entries());
+
+    TtsCache smaller;
+    smaller.begin(storage, 7000);
+    TEST_ASSERT_EQUAL_size_t(2, smaller.entries());
+    TEST_ASSERT_FALSE(smaller.lookup(2, &header));
+    TEST_ASSERT_TRUE(smaller.lookup(1, &header));
+    TEST_ASSERT_TRUE(smaller.lookup(3, &header));
+}
+
+// Hits only touch memory; the caller picks when the filesystem is written
+static void test_lookup_defers_writes_to_flush()
+{
+    TtsCache cache;
+    cache.begin(storage, 10000);
+    put(cache, 1, 3000);
+    put(cache, 2, 3000);
+    TEST_ASSERT_FALSE(cache.dirty());
+
+    int writes = storage->writes;
+    TtsAudioHeader header;
+    TEST_ASSERT_TRUE(cache.lookup(1, &header));
+    TEST_ASSERT_FALSE(cache.lookup(5, &header));
+    TEST_ASSERT_EQUAL_INT(writes, storage->writes);
+    TEST_ASSERT_TRUE(cache.dirty());
+
+    TEST_ASSERT_TRUE(cache.flush());
+    TEST_ASSERT_EQUAL_INT(writes + 1, storage->writes);
+    TEST_ASSERT_TRUE(cache.flush()); // nothing left to write
+    TEST_ASSERT_EQUAL_INT(writes + 1, storage->writes);
+
+    // The last-use order written by flush() decides eviction after a reboot
+    TtsCache rebooted;
+    rebooted.begin(storage, 5000);
+    TEST_ASSERT_TRUE(rebooted.lookup(1, &header));
+    TEST_ASSERT_FALSE(rebooted.lookup(2, &header));
+}
+
+static void test_abort_and_overflow_leave_nothing_behind()
+{
+    TtsCache cache;
+    cache.begin(storage, 10000);
+    TtsAudioHeader header = {0, 1, 0, 24000, 500};
+
+    TEST_ASSERT_TRUE(cache.store_begin(9, header));
+    cache.store_abort();
+    TEST_ASSERT_FALSE(cache.storing());
+    TEST_ASSERT_FALSE(cache.lookup(9, &header));
+
+    TEST_ASSERT_TRUE(cache.store_begin(9, header));
+    uint8_t audio[600] = {0};
+    TEST_ASSERT_FALSE(cache.store_append(audio, sizeof(audio)));
+    TEST_ASSERT_FALSE(cache.storing());
+
+    TEST_ASSERT_TRUE(cache.store_begin(9, header));
+    TEST_ASSERT_TRUE(cache.store_append(audio, 200));
+    TEST_ASSERT_FALSE(cache.store_commit()); // short
+    TEST_ASSERT_EQUAL_size_t(0, cache.entries());
+    TEST_ASSERT_EQUAL_size_t(1, storage->files.size()); // just the index
+}
+
+// A lost or damaged file is a miss and is evicted (file and all) before anything else
+static void test_damaged_entry_is_a_miss()
+{
+    TtsCache cache;
+    cache.begin(storage, 10000);
+    put(cache, 1, 3000);
+    put(cache, 2, 3000);
+    put(cache, 3, 3000);
+
+    std::string damaged;
+    for (std::map<std::string, std::vector<uint8_t> >::iterator it = storage->files.begin(); it != storage->files.end(); ++it)
+    {
+        if (it->first.find("0000000000000001") != std::string::npos)
+            damaged = it->first;
+    }
+    TEST_ASSERT_FALSE(damaged.empty());
+    storage->files[damaged].resize(8); // not even a whole header
+
+    TtsAudioHeader header;
+    TEST_ASSERT_FALSE(cache.lookup(1, &header));
+    TEST_ASSERT_TRUE(cache.lookup(2, &header));
+    TEST_ASSERT_TRUE(put(cache, 4, 3000));
+    TEST_ASSERT_EQUAL_size_t(0, storage->files.count(damaged));
+    TEST_ASSERT_TRUE(cache.lookup(2, &header));
+    TEST_ASSERT_TRUE(cache.lookup(3, &header));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_key_is_fnv1a);
+    RUN_TEST(test_store_and_replay);
+    RUN_TEST(test_evicts_least_recently_used);
+    RUN_TEST(test_entry_limit);
+    RUN_TEST(test_oversized_entry_is_refused);
+    RUN_TEST(test_index_persists_and_budget_shrinks);
+    RUN_TEST(test_lookup_defers_writes_to_flush);
+    RUN_TEST(test_abort_and_overflow_leave_nothing_behind);
+    RUN_TEST(test_damaged_entry_is_a_miss);
+    return UNITY_END();
+}
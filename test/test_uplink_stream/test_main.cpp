@@ -0,0 +1,272 @@
+#include <unity.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "uplink_stream.h"
+
+#define RATE 16000
+#define FRAME_SAMPLES 640  // 40 ms, as on the device
+#define CAPTURE_SAMPLES 320 // the capture task hands over 20 ms at a time
+
+void setUp() {}
+void tearDown() {}
+
+// Stand-in server at the far end of a link of fixed rate, on a virtual clock: a message
+// starts across once the one before it is through and arrives one latency later
+struct StandInServer
+{
+    double link_bytes_per_s;
+    double latency_s;
+    double now;       // sender's clock
+    double link_free; // when the link has sent everything handed to it
+    double last_arrival;
+
+    std::vector<std::vector<uint8_t> > messages;
+    std::vector<int16_t> samples; // PCM reassembled from utterance frames
+    std::vector<uint32_t> seqs;
+    std::vector<uint8_t> types;
+    uint32_t end_frames;
+    uint32_t end_samples;
+};
+
+static void server_init(StandInServer *server, double link_bytes_per_s)
+{
+    server->link_bytes_per_s = link_bytes_per_s;
+    server->latency_s = 0.005;
+    server->now = 0;
+    server->link_free = 0;
+    server->last_arrival = 0;
+    server->messages.clear();
+    server->samples.clear();
+    server->seqs.clear();
+    server->types.clear();
+    server->end_frames = 0;
+    server->end_samples = 0;
+}
+
+// WebSocket client frame header: 2 bytes, 2 or 8 more for longer payloads, and the 4-byte mask
+static size_t websocket_overhead(size_t len)
+{
+    return 6 + (len > 65535 ? 8 : len > 125 ? 2 : 0);
+}
+
+static bool server_receive(void *context, const uint8_t *data, size_t len)
+{
+    StandInServer *server = (StandInServer *)context;
+    double start = server->link_free > server->now ? server->link_free : server->now;
+    server->link_free = start + (len + websocket_overhead(len)) / server->link_bytes_per_s;
+    server->last_arrival = server->link_free + server->latency_s;
+    server->messages.push_back(std::vector<uint8_t>(data, data + len));
+
+    WireHeader header;
+    const uint8_t *payload;
+    if (wire_parse(data, len, &header, &payload) != WIRE_OK)
+        return true; // a bare frame; the test looks at messages itself
+
+    server->types.push_back(header.type);
+    server->seqs.push_back(header.seq);
+    if (header.type == WIRE_UTTERANCE_AUDIO)
+    {
+        const int16_t *pcm = (const int16_t *)payload;
+        server->samples.insert(server->samples.end(), pcm, pcm + header.length / sizeof(int16_t));
+    }
+    else if (header.type == WIRE_UTTERANCE_END)
+    {
+        WireReader r;
+        wire_reader_init(&r, payload, header.length);
+        server->end_frames = wire_get_u32(&r);
+        server->end_samples = wire_get_u32(&r);
+    }
+    return true;
+}
+
+// The recording so far; frames are handed out of it directly, copied into scratch every other time
+static std::vector<int16_t> recording;
+static int source_calls;
+
+static const int16_t *read_recording(void *context, size_t pos, size_t samples, int16_t *scratch)
+{
+    TEST_ASSERT_TRUE(pos + samples <= recording.size());
+    if (source_calls++ & 1)
+        return &recording[pos];
+    memcpy(scratch, &recording[pos], samples * sizeof(int16_t));
+    return scratch;
+}
+
+static void make_recording(size_t samples)
+{
+    recording.resize(samples);
+    for (size_t i = 0; i < samples; i++)
+        recording[i] = (int16_t)(6000 * std::sin(2 * M_PI * 300 * i / RATE) + (int)(i % 7) * 50);
+    source_calls = 0;
+}
+
+// Whole frames go out as the recording grows, the tail only on flush, framed and numbered in order
+static void test_frames_follow_the_recording()
+{
+    make_recording(FRAME_SAMPLES * 5 / 2);
+    StandInServer server;
+    server_init(&server, 1e9);
+    UplinkStream uplink;
+    TEST_ASSERT_TRUE(uplink.init(RATE, FRAME_SAMPLES, read_recording, server_receive, &server));
+
+    uplink.begin(42, UPLINK_CODEC_PCM16, true);
+    TEST_ASSERT_EQUAL_size_t(0, uplink.pump(FRAME_SAMPLES - 1, false));
+    TEST_ASSERT_EQUAL_size_t(1, uplink.pump(FRAME_SAMPLES + 10, false));
+    TEST_ASSERT_EQUAL_size_t(1, uplink.pump(recording.size(), false));
+    TEST_ASSERT_EQUAL_size_t(FRAME_SAMPLES * 2, uplink.sent_pos());
+    TEST_ASSERT_EQUAL_size_t(1, uplink.pump(recording.size(), true)); // the half-frame tail
+    TEST_ASSERT_EQUAL_size_t(0, uplink.pump(recording.size(), true));
+    uplink.end();
+
+    TEST_ASSERT_EQUAL_size_t(5, server.types.size());
+    TEST_ASSERT_EQUAL_UINT8(WIRE_UTTERANCE_START, server.types[0]);
+    for (size_t i = 1; i < 4; i++)
+        TEST_ASSERT_EQUAL_UINT8(WIRE_UTTERANCE_AUDIO, server.types[i]);
+    TEST_ASSERT_EQUAL_UINT8(WIRE_UTTERANCE_END, server.types[4]);
+    for (size_t i = 0; i < server.seqs.size(); i++)
+        TEST_ASSERT_EQUAL_UINT32(i, server.seqs[i]);
+
+    WireHeader header;
+    const uint8_t *payload;
+    TEST_ASSERT_EQUAL(WIRE_OK, wire_parse(server.messages[0].data(), server.messages[0].size(), &header, &payload));
+    TEST_ASSERT_EQUAL_UINT32(42, header.turn);
+    WireReader r;
+    wire_reader_init(&r, payload, header.length);
+    TEST_ASSERT_EQUAL_UINT32(RATE, wire_get_u32(&r));
+    TEST_ASSERT_EQUAL_UINT8(UPLINK_CODEC_PCM16, wire_get_u8(&r));
+    TEST_ASSERT_EQUAL_UINT16(40, wire_get_u16(&r));
+
+    TEST_ASSERT_EQUAL_UINT32(3, server.end_frames);
+    TEST_ASSERT_EQUAL_UINT32(recording.size(), server.end_samples);
+    TEST_ASSERT_EQUAL_size_t(recording.size(), server.samples.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(recording.data(), server.samples.data(), recording.size());
+}
+
+// Leading silence the VAD trims is never sent, and the totals count from the trim
+static void test_leading_trim()
+{
+    make_recording(FRAME_SAMPLES * 4);
+    StandInServer server;
+    server_init(&server, 1e9);
+    UplinkStream uplink;
+    uplink.init(RATE, FRAME_SAMPLES, read_recording, server_receive, &server);
+
+    uplink.begin(1, UPLINK_CODEC_PCM16, true);
+    uplink.skip_to(1000);
+    uplink.pump(recording.size(), true);
+    uplink.end();
+
+    TEST_ASSERT_EQUAL_size_t(1000, uplink.start_pos());
+    TEST_ASSERT_EQUAL_size_t(recording.size() - 1000, uplink.samples_sent());
+    TEST_ASSERT_EQUAL_UINT32(recording.size() - 1000, server.end_samples);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(&recording[1000], server.samples.data(), recording.size() - 1000);
+}
+
+// With JSON framing the frames go out bare and the control messages are the caller's
+static void test_bare_adpcm_frames()
+{
+    make_recording(FRAME_SAMPLES * 3 + 5);
+    StandInServer server;
+    server_init(&server, 1e9);
+    UplinkStream uplink;
+    uplink.init(RATE, FRAME_SAMPLES, read_recording, server_receive, &server);
+
+    uplink.begin(2, UPLINK_CODEC_IMA_ADPCM, false);
+    uplink.pump(recording.size(), true);
+    uplink.end();
+
+    TEST_ASSERT_EQUAL_size_t(4, server.messages.size());
+    TEST_ASSERT_EQUAL_size_t(0, server.types.size());
+
+    // The same frames the codec makes with its state carried from one to the next
+    ImaAdpcmState state;
+    ima_adpcm_reset(&state);
+    size_t decoded = 0;
+    for (size_t m = 0; m < server.messages.size(); m++)
+    {
+        size_t samples = m < 3 ? FRAME_SAMPLES : 5;
+        std::vector<uint8_t> expected(ima_adpcm_frame_bytes(samples));
+        ima_adpcm_encode_frame(&state, &recording[m * FRAME_SAMPLES], samples, expected.data());
+        TEST_ASSERT_EQUAL_size_t(expected.size(), server.messages[m].size());
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), server.messages[m].data(), expected.size());
+        decoded += ima_adpcm_frame_samples(server.messages[m].data(), server.messages[m].size());
+    }
+    TEST_ASSERT_EQUAL_size_t(recording.size(), decoded);
+}
+
+// Time from the stop tap until the server has the last byte of a 3 s (96 KB) utterance: streamed
+// while recording against the old single send at stop, over links of a few rates
+static double time_to_last_byte(bool streaming, double link_bytes_per_s, UplinkCodec codec)
+{
+    const size_t utterance_samples = RATE * 3;
+    make_recording(utterance_samples);
+    StandInServer server;
+    server_init(&server, link_bytes_per_s);
+    UplinkStream uplink;
+    uplink.init(RATE, FRAME_SAMPLES, read_recording, server_receive, &server);
+
+    if (streaming)
+    {
+        uplink.begin(3, codec, true);
+        for (size_t captured = CAPTURE_SAMPLES; captured <= utterance_samples; captured += CAPTURE_SAMPLES)
+        {
+            server.now = (double)captured / RATE; // each capture frame is handed over as it completes
+            uplink.pump(captured, false);
+        }
+    }
+
+    double stop = (double)utterance_samples / RATE;
+    server.now = stop;
+    if (streaming)
+    {
+        uplink.pump(utterance_samples, true);
+        uplink.end();
+        TEST_ASSERT_EQUAL_UINT32(utterance_samples, server.end_samples);
+    }
+    else
+    {
+        std::vector<uint8_t> blob(WIRE_HEADER_BYTES + utterance_samples * sizeof(int16_t));
+        memcpy(&blob[WIRE_HEADER_BYTES], recording.data(), utterance_samples * sizeof(int16_t));
+        size_t len = wire_finish(blob.data(), WIRE_UTTERANCE_AUDIO, 3, 0, utterance_samples * sizeof(int16_t));
+        server_receive(&server, blob.data(), len);
+        TEST_ASSERT_EQUAL_size_t(utterance_samples, server.samples.size());
+    }
+    return server.last_arrival - stop;
+}
+
+static void test_time_to_last_byte()
+{
+    const double rates_kb[] = {40, 64, 128, 512};
+    for (size_t i = 0; i < sizeof(rates_kb) / sizeof(rates_kb[0]); i++)
+    {
+        double rate = rates_kb[i] * 1000;
+        double blob = time_to_last_byte(false, rate, UPLINK_CODEC_PCM16);
+        double pcm = time_to_last_byte(true, rate, UPLINK_CODEC_PCM16);
+        double adpcm = time_to_last_byte(true, rate, UPLINK_CODEC_IMA_ADPCM);
+
+        char report[128];
+        snprintf(report, sizeof(report), "%4.0f KB/s link: single 96 KB send %5.0f ms, streamed PCM %3.0f ms, ADPCM %3.0f ms",
+                 rates_kb[i], blob * 1000, pcm * 1000, adpcm * 1000);
+        TEST_MESSAGE(report);
+
+        // Once the link keeps up with 32 KB/s of PCM, only the last frame is left at the stop
+        TEST_ASSERT_LESS_THAN_MESSAGE((int)(blob * 1000), (int)(pcm * 1000), report);
+        TEST_ASSERT_LESS_THAN_MESSAGE(60, (int)(adpcm * 1000), report);
+        if (rate >= 64000)
+            TEST_ASSERT_LESS_THAN_MESSAGE(60, (int)(pcm * 1000), report);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_frames_follow_the_recording);
+    RUN_TEST(test_leading_trim);
+    RUN_TEST(test_bare_adpcm_frames);
+    RUN_TEST(test_time_to_last_byte);
+    return UNITY_END();
+}
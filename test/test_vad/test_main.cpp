@@ -0,0 +1,259 @@
+#include <unity.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "vad.h"
+
+// Labelled 16 kHz mono fixtures from scripts/make_vad_fixtures.py (or recordings added alongside)
+static std::string fixture_dir()
+{
+    std::string path = __FILE__;
+    size_t slash = path.find_last_of("/\\");
+    return (slash == std::string::npos ? std::string(".") : path.substr(0, slash)) + "/fixtures/";
+}
+
+#define FRAME_SAMPLES 320 // 20 ms, as captured
+#define RATE 16000
+
+void setUp() {}
+void tearDown() {}
+
+static void fill_tone(int16_t *frame, int amplitude, int period)
+{
+    for (int i = 0; i < FRAME_SAMPLES; i++)
+        frame[i] = (int16_t)(amplitude * std::sin(2 * M_PI * i / period));
+}
+
+static void fill_noise(int16_t *frame, int amplitude, uint32_t *seed)
+{
+    for (int i = 0; i < FRAME_SAMPLES; i++)
+    {
+        *seed = *seed * 1664525u + 1013904223u;
+        frame[i] = (int16_t)((int32_t)(*seed >> 16) % (2 * amplitude + 1) - amplitude);
+    }
+}
+
+static void test_digital_silence_is_never_speech()
+{
+    VoiceActivityDetector vad;
+    vad.init(vad_default_config(RATE, FRAME_SAMPLES));
+    int16_t frame[FRAME_SAMPLES] = {0};
+    for (int i = 0; i < 200; i++)
+        TEST_ASSERT_EQUAL(VAD_EVENT_NONE, vad.process_frame(frame));
+    TEST_ASSERT_FALSE(vad.speech_detected());
+    TEST_ASSERT_EQUAL_size_t(4000, vad.trim_end(4000)); // no speech: nothing trimmed
+}
+
+static void test_tone_burst_starts_and_ends()
+{
+    VoiceActivityDetector vad;
+    vad.init(vad_default_config(RATE, FRAME_SAMPLES));
+    int16_t quiet[FRAME_SAMPLES];
+    int16_t loud[FRAME_SAMPLES];
+    uint32_t seed = 1;
+    fill_tone(loud, 8000, 80);
+
+    int start_frame = -1;
+    int end_frame = -1;
+    for (int i = 0; i < 150 && end_frame < 0; i++)
+    {
+        bool speaking = i >= 25 && i < 75; // 0.5 s to 1.5 s
+        fill_noise(quiet, 100, &seed);
+        VadEvent event = vad.process_frame(speaking ? loud : quiet);
+        if (event == VAD_EVENT_SPEECH_START)
+            start_frame = i;
+        else if (event == VAD_EVENT_SPEECH_END)
+            end_frame = i;
+    }
+
+    // Onset after min_speech_ms (3 frames); endpoint after 800 ms of trailing silence (40 frames)
+    TEST_ASSERT_EQUAL_INT(27, start_frame);
+    TEST_ASSERT_EQUAL_INT(114, end_frame);
+    TEST_ASSERT_EQUAL_size_t(25 * FRAME_SAMPLES, vad.speech_start_sample());
+    TEST_ASSERT_EQUAL_size_t(75 * FRAME_SAMPLES, vad.speech_end_sample());
+    TEST_ASSERT_EQUAL_size_t(25 * FRAME_SAMPLES - 200 * RATE / 1000, vad.trim_start());
+    TEST_ASSERT_EQUAL_size_t(75 * FRAME_SAMPLES + 150 * RATE / 1000, vad.trim_end(150 * FRAME_SAMPLES));
+}
+
+static void test_short_gap_is_bridged()
+{
+    VoiceActivityDetector vad;
+    vad.init(vad_default_config(RATE, FRAME_SAMPLES));
+    int16_t quiet[FRAME_SAMPLES] = {0};
+    int16_t loud[FRAME_SAMPLES];
+    fill_tone(loud, 8000, 80);
+
+    for (int i = 0; i < 10; i++)
+        vad.process_frame(quiet);
+    for (int i = 0; i < 10; i++)
+        vad.process_frame(loud);
+    // 300 ms pause: far short of the 800 ms that ends the utterance
+    for (int i = 0; i < 15; i++)
+        TEST_ASSERT_EQUAL(VAD_EVENT_NONE, vad.process_frame(quiet));
+    for (int i = 0; i < 10; i++)
+        vad.process_frame(loud);
+    TEST_ASSERT_TRUE(vad.in_speech());
+    TEST_ASSERT_FALSE(vad.ended());
+}
+
+// Speech already under way in the first frame must not become the noise floor
+static void test_loud_first_frame_does_not_seed_the_floor()
+{
+    VoiceActivityDetector vad;
+    vad.init(vad_default_config(RATE, FRAME_SAMPLES));
+    int16_t quiet[FRAME_SAMPLES];
+    int16_t loud[FRAME_SAMPLES];
+    uint32_t seed = 7;
+    fill_tone(loud, 8000, 80);
+
+    vad.process_frame(loud);
+    for (int i = 0; i < 4; i++)
+    {
+        fill_noise(quiet, 100, &seed);
+        vad.process_frame(quiet);
+    }
+    TEST_ASSERT_LESS_THAN_UINT32(10000, vad.noise_floor());
+
+    bool started = false;
+    for (int i = 0; i < 5; i++)
+        started |= vad.process_frame(loud) == VAD_EVENT_SPEECH_START;
+    TEST_ASSERT_TRUE(started);
+}
+
+static bool read_wav(const std::string &path, std::vector<int16_t> *samples)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    uint8_t riff[12];
+    bool ok = fread(riff, 1, 12, f) == 12 && memcmp(riff, "RIFF", 4) == 0 && memcmp(riff + 8, "WAVE", 4) == 0;
+    bool format_ok = false;
+    while (ok)
+    {
+        uint8_t chunk[8];
+        if (fread(chunk, 1, 8, f) != 8)
+        {
+            ok = false;
+            break;
+        }
+        uint32_t size = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[16];
+            ok = size >= 16 && fread(fmt, 1, 16, f) == 16 && fseek(f, size - 16, SEEK_CUR) == 0;
+            uint32_t rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            format_ok = fmt[0] == 1 && fmt[2] == 1 && rate == RATE && fmt[14] == 16;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            samples->resize(size / 2);
+            ok = format_ok && fread(samples->data(), 2, samples->size(), f) == samples->size();
+            break;
+        }
+        else
+        {
+            ok = fseek(f, size + (size & 1), SEEK_CUR) == 0;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Endpointing benchmark over the labelled fixtures. A false cut is an endpoint before the
+// labelled end of speech, or trimming that would remove any labelled speech; speech
+// detected in a clip labelled as having none is a false trigger.
+static void test_fixture_benchmark()
+{
+    std::string dir = fixture_dir();
+    FILE *labels = fopen((dir + "labels.csv").c_str(), "r");
+    TEST_ASSERT_NOT_NULL(labels);
+
+    VadConfig config = vad_default_config(RATE, FRAME_SAMPLES);
+    int fixtures = 0;
+    int false_cuts = 0;
+    int false_triggers = 0;
+    int missed = 0;
+    long latency_total_ms = 0;
+    int latency_count = 0;
+
+    char line[256];
+    while (fgets(line, sizeof(line), labels) != nullptr)
+    {
+        char name[128];
+        int start_ms;
+        int end_ms;
+        if (line[0] == '#' || sscanf(line, "%127[^,],%d,%d", name, &start_ms, &end_ms) != 3)
+            continue;
+
+        std::vector<int16_t> samples;
+        TEST_ASSERT_TRUE_MESSAGE(read_wav(dir + name, &samples), name);
+        fixtures++;
+
+        VoiceActivityDetector vad;
+        vad.init(config);
+        int endpoint_ms = -1;
+        size_t frames = samples.size() / FRAME_SAMPLES;
+        for (size_t i = 0; i < frames && endpoint_ms < 0; i++)
+        {
+            if (vad.process_frame(&samples[i * FRAME_SAMPLES]) == VAD_EVENT_SPEECH_END)
+                endpoint_ms = (int)(vad.samples_processed() * 1000 / RATE);
+        }
+
+        char report[200];
+        if (start_ms < 0)
+        {
+            bool triggered = vad.speech_detected();
+            false_triggers += triggered;
+            snprintf(report, sizeof(report), "%-24s no speech: %s", name, triggered ? "FALSE TRIGGER" : "ok");
+            TEST_MESSAGE(report);
+            continue;
+        }
+        if (!vad.speech_detected() || endpoint_ms < 0)
+        {
+            missed++;
+            snprintf(report, sizeof(report), "%-24s MISSED (no %s)", name, vad.speech_detected() ? "endpoint" : "onset");
+            TEST_MESSAGE(report);
+            continue;
+        }
+
+        size_t total = vad.samples_processed();
+        int trim_start_ms = (int)(vad.trim_start() * 1000 / RATE);
+        int trim_end_ms = (int)(vad.trim_end(total) * 1000 / RATE);
+        bool cut = endpoint_ms < end_ms || trim_start_ms > start_ms || trim_end_ms < end_ms;
+        false_cuts += cut;
+        latency_total_ms += endpoint_ms - end_ms;
+        latency_count++;
+        snprintf(report, sizeof(report), "%-24s speech %d-%d ms, kept %d-%d ms, endpoint latency %d ms%s", name,
+                 start_ms, end_ms, trim_start_ms, trim_end_ms, endpoint_ms - end_ms, cut ? " FALSE CUT" : "");
+        TEST_MESSAGE(report);
+    }
+    fclose(labels);
+
+    char summary[160];
+    snprintf(summary, sizeof(summary), "%d fixtures: %d false cuts, %d missed, %d false triggers, mean latency %ld ms",
+             fixtures, false_cuts, missed, false_triggers, latency_count ? latency_total_ms / latency_count : 0L);
+    TEST_MESSAGE(summary);
+
+    TEST_ASSERT_GREATER_THAN(0, fixtures);
+    TEST_ASSERT_EQUAL_INT(0, false_cuts);
+    TEST_ASSERT_EQUAL_INT(0, missed);
+    TEST_ASSERT_EQUAL_INT(0, false_triggers);
+    // The trailing silence plus at most one frame of detection delay and a little for the decay
+    TEST_ASSERT_LESS_OR_EQUAL(config.trailing_silence_ms + 100, latency_total_ms / latency_count);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_digital_silence_is_never_speech);
+    RUN_TEST(test_tone_burst_starts_and_ends);
+    RUN_TEST(test_short_gap_is_bridged);
+    RUN_TEST(test_loud_first_frame_does_not_seed_the_floor);
+    RUN_TEST(test_fixture_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,298 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "wake_word.h"
+
+// Labelled 16 kHz mono fixtures and the test model from scripts/make_wake_word_fixtures.py
+static std::string fixture_dir()
+{
+    std::string path = __FILE__;
+    size_t slash = path.find_last_of("/\\");
+    return (slash == std::string::npos ? std::string(".") : path.substr(0, slash)) + "/fixtures/";
+}
+
+#define RATE 16000
+#define THRESHOLD 0.85f        // WAKE_WORD_THRESHOLD
+#define DETECTION_WINDOW_MS 1000 // a detection this long after the keyword ends still counts
+
+static std::vector<uint32_t> model_storage; // the blob must be 4-byte aligned
+static size_t model_length = 0;
+
+void setUp() {}
+void tearDown() {}
+
+static bool load_model()
+{
+    if (model_length > 0)
+        return true;
+
+    FILE *f = fopen((fixture_dir() + "kws_test_model.bin").c_str(), "rb");
+    if (f == nullptr)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    model_storage.assign((size + 3) / 4, 0);
+    bool ok = size > 0 && fread(model_storage.data(), 1, size, f) == (size_t)size;
+    fclose(f);
+    model_length = ok ? (size_t)size : 0;
+    return ok;
+}
+
+static const uint8_t *model_blob()
+{
+    return (const uint8_t *)model_storage.data();
+}
+
+static bool read_wav(const std::string &path, std::vector<int16_t> *samples)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    uint8_t riff[12];
+    bool ok = fread(riff, 1, 12, f) == 12 && memcmp(riff, "RIFF", 4) == 0 && memcmp(riff + 8, "WAVE", 4) == 0;
+    bool format_ok = false;
+    while (ok)
+    {
+        uint8_t chunk[8];
+        if (fread(chunk, 1, 8, f) != 8)
+        {
+            ok = false;
+            break;
+        }
+        uint32_t size = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[16];
+            ok = size >= 16 && fread(fmt, 1, 16, f) == 16 && fseek(f, size - 16, SEEK_CUR) == 0;
+            uint32_t rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            format_ok = fmt[0] == 1 && fmt[2] == 1 && rate == RATE && fmt[14] == 16;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            samples->resize(size / 2);
+            ok = format_ok && fread(samples->data(), 2, samples->size(), f) == samples->size();
+            break;
+        }
+        else
+        {
+            ok = fseek(f, size + (size & 1), SEEK_CUR) == 0;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Run a clip through the detector as the task does, inferring every stride hops; returns detection times
+static std::vector<int> detect(WakeWordDetector *detector, const std::vector<int16_t> &samples, uint32_t stride)
+{
+    std::vector<int> detections;
+    uint32_t hops_since_inference = 0;
+    size_t hops = samples.size() / WAKE_WORD_HOP_SAMPLES;
+    for (size_t h = 0; h < hops; h++)
+    {
+        if (!detector->push_hop(&samples[h * WAKE_WORD_HOP_SAMPLES]) || ++hops_since_inference < stride)
+            continue;
+        hops_since_inference = 0;
+        if (detector->infer())
+            detections.push_back((int)((h + 1) * WAKE_WORD_HOP_SAMPLES * 1000 / RATE));
+    }
+    return detections;
+}
+
+static void test_model_blob_is_validated()
+{
+    TEST_ASSERT_TRUE(load_model());
+    KwsModel model;
+    TEST_ASSERT_TRUE(model.load(model_blob(), model_length));
+    TEST_ASSERT_EQUAL_UINT16(40, model.frames());
+    TEST_ASSERT_EQUAL_UINT16(LOG_MEL_BINS, model.mel_bins());
+    TEST_ASSERT_EQUAL_UINT32(2 * 40 * LOG_MEL_BINS, model.macs());
+
+    TEST_ASSERT_FALSE(model.load(model_blob(), model_length - 1)); // truncated weights
+    TEST_ASSERT_FALSE(model.load(model_blob(), 15));
+    TEST_ASSERT_FALSE(model.loaded());
+
+    std::vector<uint32_t> copy(model_storage.size() + 1, 0);
+    memcpy(copy.data(), model_blob(), model_length);
+    TEST_ASSERT_FALSE(model.load((const uint8_t *)copy.data() + 1, model_length)); // misaligned
+    ((uint8_t *)copy.data())[0] = 'X';
+    TEST_ASSERT_FALSE(model.load((const uint8_t *)copy.data(), model_length));
+
+    WakeWordDetector detector;
+    TEST_ASSERT_FALSE(detector.init((const uint8_t *)copy.data(), model_length, RATE, THRESHOLD));
+    TEST_ASSERT_TRUE(detector.init(model_blob(), model_length, RATE, THRESHOLD));
+}
+
+// A tone lands in the mel band that covers it, and the bands step up in frequency
+static void test_log_mel_tone()
+{
+    LogMelExtractor features;
+    TEST_ASSERT_TRUE(features.init(RATE, WAKE_WORD_HOP_SAMPLES, 20.0f, RATE / 2.0f));
+    const float tones[] = {300.0f, 1000.0f, 4000.0f};
+    int previous_band = -1;
+    for (int t = 0; t < 3; t++)
+    {
+        int16_t hop[WAKE_WORD_HOP_SAMPLES];
+        float log_mel[LOG_MEL_BINS];
+        size_t n = 0;
+        for (int h = 0; h < 4; h++) // fill the 512-sample window
+        {
+            for (int i = 0; i < WAKE_WORD_HOP_SAMPLES; i++, n++)
+                hop[i] = (int16_t)(8000 * std::sin(2 * M_PI * tones[t] * n / RATE));
+            features.push(hop, log_mel);
+        }
+        int band = 0;
+        for (int b = 1; b < LOG_MEL_BINS; b++)
+            band = log_mel[b] > log_mel[band] ? b : band;
+        TEST_ASSERT_GREATER_THAN(previous_band, band);
+        TEST_ASSERT_TRUE(log_mel[band] - log_mel[(band + LOG_MEL_BINS / 2) % LOG_MEL_BINS] > 8.0f);
+        previous_band = band;
+    }
+}
+
+// Detection over the labelled fixtures at the inference strides the task can pick. A hit is the
+// first detection from the start of a keyword to DETECTION_WINDOW_MS after its end; every other
+// detection is a false accept, counted per hour of audio outside those windows.
+static void test_fixture_benchmark()
+{
+    TEST_ASSERT_TRUE(load_model());
+    std::string dir = fixture_dir();
+    const uint32_t strides[] = {1, 2, 4};
+
+    for (size_t s = 0; s < sizeof(strides) / sizeof(strides[0]); s++)
+    {
+        FILE *labels = fopen((dir + "labels.csv").c_str(), "r");
+        TEST_ASSERT_NOT_NULL(labels);
+
+        int keywords = 0;
+        int hits = 0;
+        int false_accepts = 0;
+        double audio_s = 0;
+        double outside_s = 0;
+        double busy_s = 0;
+
+        // Lines for the same clip are consecutive; each clip is run once with all its labels
+        std::string clip;
+        std::vector<int> starts;
+        std::vector<int> ends;
+        char line[256];
+        bool more = true;
+        while (more)
+        {
+            more = fgets(line, sizeof(line), labels) != nullptr;
+            char name[128] = "";
+            int start_ms = 0;
+            int end_ms = 0;
+            if (more && (line[0] == '#' || sscanf(line, "%127[^,],%d,%d", name, &start_ms, &end_ms) != 3))
+                continue;
+            if (!clip.empty() && (!more || clip != name))
+            {
+                std::vector<int16_t> samples;
+                TEST_ASSERT_TRUE_MESSAGE(read_wav(dir + clip, &samples), clip.c_str());
+                WakeWordDetector detector;
+                TEST_ASSERT_TRUE(detector.init(model_blob(), model_length, RATE, THRESHOLD));
+
+                std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+                std::vector<int> detections = detect(&detector, samples, strides[s]);
+                busy_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+                double clip_s = (double)samples.size() / RATE;
+                audio_s += clip_s;
+                outside_s += clip_s;
+                int clip_hits = 0;
+                std::vector<bool> matched(starts.size(), false);
+                for (size_t d = 0; d < detections.size(); d++)
+                {
+                    bool hit = false;
+                    for (size_t k = 0; k < starts.size() && !hit; k++)
+                    {
+                        hit = !matched[k] && detections[d] >= starts[k] && detections[d] <= ends[k] + DETECTION_WINDOW_MS;
+                        matched[k] = matched[k] || hit;
+                    }
+                    clip_hits += hit;
+                    false_accepts += !hit;
+                }
+                for (size_t k = 0; k < starts.size(); k++)
+                    outside_s -= (ends[k] + DETECTION_WINDOW_MS - starts[k]) / 1000.0;
+                keywords += (int)starts.size();
+                hits += clip_hits;
+
+                if (s == 0)
+                {
+                    char report[160];
+                    snprintf(report, sizeof(report), "%-20s %d/%d keywords, %d false accepts", clip.c_str(), clip_hits,
+                             (int)starts.size(), (int)detections.size() - clip_hits);
+                    TEST_MESSAGE(report);
+                }
+                starts.clear();
+                ends.clear();
+            }
+            clip = name;
+            if (start_ms >= 0 && more)
+            {
+                starts.push_back(start_ms);
+                ends.push_back(end_ms);
+            }
+        }
+        fclose(labels);
+
+        double rate = keywords > 0 ? (double)hits / keywords : 0;
+        double per_hour = false_accepts * 3600.0 / outside_s;
+        char summary[200];
+        snprintf(summary, sizeof(summary),
+                 "stride %u: detected %d/%d (%.0f%%), %d false accepts in %.0f s (%.0f per hour), host RTF %.4f",
+                 strides[s], hits, keywords, rate * 100, false_accepts, outside_s, per_hour, busy_s / audio_s);
+        TEST_MESSAGE(summary);
+
+        TEST_ASSERT_GREATER_THAN(0, keywords);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(keywords, hits, summary);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(0, false_accepts, summary);
+    }
+}
+
+// One keyword triggers once: the context starts over and the refractory period holds
+static void test_one_detection_per_keyword()
+{
+    TEST_ASSERT_TRUE(load_model());
+    std::vector<int16_t> samples;
+    TEST_ASSERT_TRUE(read_wav(fixture_dir() + "keyword_quiet.wav", &samples));
+
+    // The first keyword, then the clip's first 2 s again straight after it
+    std::vector<int16_t> twice(samples.begin(), samples.begin() + 2 * RATE);
+    twice.insert(twice.end(), samples.begin(), samples.begin() + 2 * RATE);
+    WakeWordDetector detector;
+    detector.init(model_blob(), model_length, RATE, THRESHOLD);
+    std::vector<int> detections = detect(&detector, twice, 1);
+    TEST_ASSERT_EQUAL_size_t(2, detections.size());
+    TEST_ASSERT_GREATER_OR_EQUAL(2000 + WAKE_WORD_REFRACTORY_MS / 2, detections[1]);
+
+    // reset() forgets a half-heard keyword
+    detector.init(model_blob(), model_length, RATE, THRESHOLD);
+    size_t keyword_end_hop = 1784 * RATE / 1000 / WAKE_WORD_HOP_SAMPLES;
+    for (size_t h = 0; h + 10 < keyword_end_hop; h++)
+        detector.push_hop(&samples[h * WAKE_WORD_HOP_SAMPLES]);
+    detector.reset();
+    for (size_t h = keyword_end_hop - 10; h < keyword_end_hop + 40; h++)
+    {
+        if (detector.push_hop(&samples[h * WAKE_WORD_HOP_SAMPLES]))
+            TEST_ASSERT_FALSE(detector.infer());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_model_blob_is_validated);
+    RUN_TEST(test_log_mel_tone);
+    RUN_TEST(test_fixture_benchmark);
+    RUN_TEST(test_one_detection_per_keyword);
+    return UNITY_END();
+}
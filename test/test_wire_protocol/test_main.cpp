@@ -0,0 +1,263 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "wire_protocol.h"
+
+// pio fetches ArduinoJson for the native env (lib_deps) for the comparison benchmark
+#if defined(__has_include)
+#if __has_include(<ArduinoJson.h>)
+#include <ArduinoJson.h>
+#define HAVE_ARDUINOJSON 1
+#endif
+#endif
+
+static uint8_t frame[256];
+
+void setUp()
+{
+    memset(frame, 0, sizeof(frame));
+}
+
+void tearDown() {}
+
+// An audio_start frame as the server sends it
+static size_t audio_start_frame(uint8_t *out, size_t capacity)
+{
+    WireWriter w;
+    wire_writer_init(&w, out + WIRE_HEADER_BYTES, capacity - WIRE_HEADER_BYTES);
+    wire_put_u8(&w, 2);
+    wire_put_u8(&w, 1);
+    wire_put_u32(&w, 24000);
+    wire_put_u32(&w, 96000);
+    wire_put_u32(&w, 24);
+    wire_put_u32(&w, 4000);
+    TEST_ASSERT_TRUE(w.ok);
+    return wire_finish(out, WIRE_AUDIO_START, 7, 3, w.len);
+}
+
+static void test_crc32_check_value()
+{
+    const uint8_t *digits = (const uint8_t *)"123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, wire_crc32(0, digits, 9));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, wire_crc32(wire_crc32(0, digits, 4), digits + 4, 5)); // continued
+    TEST_ASSERT_EQUAL_HEX32(0, wire_crc32(0, digits, 0));
+}
+
+static void test_audio_start_round_trip()
+{
+    size_t len = audio_start_frame(frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_size_t(WIRE_HEADER_BYTES + 18, len);
+
+    WireHeader header;
+    const uint8_t *payload;
+    TEST_ASSERT_EQUAL(WIRE_OK, wire_parse(frame, len, &header, &payload));
+    TEST_ASSERT_EQUAL_UINT8(WIRE_AUDIO_START, header.type);
+    TEST_ASSERT_EQUAL_UINT32(7, header.turn);
+    TEST_ASSERT_EQUAL_UINT32(3, header.seq);
+    TEST_ASSERT_EQUAL_UINT32(18, header.length);
+
+    WireReader r;
+    wire_reader_init(&r, payload, header.length);
+    TEST_ASSERT_EQUAL_UINT8(2, wire_get_u8(&r));
+    TEST_ASSERT_EQUAL_UINT8(1, wire_get_u8(&r));
+    TEST_ASSERT_EQUAL_UINT32(24000, wire_get_u32(&r));
+    TEST_ASSERT_EQUAL_UINT32(96000, wire_get_u32(&r));
+    TEST_ASSERT_EQUAL_UINT32(24, wire_get_u32(&r));
+    TEST_ASSERT_EQUAL_UINT32(4000, wire_get_u32(&r));
+    TEST_ASSERT_TRUE(r.ok);
+
+    TEST_ASSERT_EQUAL_UINT8(0, wire_get_u8(&r)); // past the payload
+    TEST_ASSERT_FALSE(r.ok);
+    TEST_ASSERT_EQUAL_UINT32(0, wire_get_u32(&r));
+}
+
+static void test_every_bit_flip_is_rejected()
+{
+    size_t len = audio_start_frame(frame, sizeof(frame));
+    WireHeader header;
+    const uint8_t *payload;
+    for (size_t i = 0; i < len; i++)
+    {
+        for (int bit = 0; bit < 8; bit++)
+        {
+            frame[i] ^= (uint8_t)(1 << bit);
+            TEST_ASSERT_NOT_EQUAL(WIRE_OK, wire_parse(frame, len, &header, &payload));
+            frame[i] ^= (uint8_t)(1 << bit);
+        }
+    }
+    TEST_ASSERT_EQUAL(WIRE_OK, wire_parse(frame, len, &header, &payload));
+}
+
+static void test_length_magic_and_version()
+{
+    size_t len = audio_start_frame(frame, sizeof(frame));
+    WireHeader header;
+    const uint8_t *payload;
+
+    TEST_ASSERT_EQUAL(WIRE_BAD_LENGTH, wire_parse(frame, len - 1, &header, &payload)); // truncated
+    TEST_ASSERT_EQUAL(WIRE_BAD_LENGTH, wire_parse(frame, len + 40, &header, &payload)); // trailing bytes
+    TEST_ASSERT_EQUAL(WIRE_BAD_LENGTH, wire_parse(frame, WIRE_HEADER_BYTES - 1, &header, &payload));
+    TEST_ASSERT_EQUAL(WIRE_BAD_LENGTH, wire_parse(frame, 0, &header, &payload));
+
+    frame[0] = 0;
+    TEST_ASSERT_EQUAL(WIRE_BAD_MAGIC, wire_parse(frame, len, &header, &payload));
+    frame[0] = WIRE_MAGIC;
+
+    frame[1] = WIRE_VERSION - 1; // an older peer
+    TEST_ASSERT_EQUAL(WIRE_BAD_VERSION, wire_parse(frame, len, &header, &payload));
+    frame[1] = WIRE_VERSION + 1;
+    TEST_ASSERT_EQUAL(WIRE_BAD_VERSION, wire_parse(frame, len, &header, &payload));
+    frame[1] = WIRE_VERSION;
+    TEST_ASSERT_EQUAL(WIRE_OK, wire_parse(frame, len, &header, &payload));
+    TEST_ASSERT_EQUAL_STRING("unsupported version", wire_status_name(WIRE_BAD_VERSION));
+}
+
+// Binary framing is used only when the server echoes it at our version; otherwise JSON stays
+static void test_framing_falls_back_to_json()
+{
+    TEST_ASSERT_TRUE(wire_framing_accepted("binary", WIRE_VERSION));
+    TEST_ASSERT_FALSE(wire_framing_accepted(nullptr, WIRE_VERSION)); // a server that predates framing
+    TEST_ASSERT_FALSE(wire_framing_accepted("binary", 0));           // framingVersion missing
+    TEST_ASSERT_FALSE(wire_framing_accepted("binary", WIRE_VERSION - 1));
+    TEST_ASSERT_FALSE(wire_framing_accepted("binary", WIRE_VERSION + 1));
+    TEST_ASSERT_FALSE(wire_framing_accepted("json", WIRE_VERSION));
+    TEST_ASSERT_FALSE(wire_framing_accepted("", WIRE_VERSION));
+}
+
+static void test_strings()
+{
+    WireWriter w;
+    wire_writer_init(&w, frame + WIRE_HEADER_BYTES, sizeof(frame) - WIRE_HEADER_BYTES);
+    wire_put_str(&w, "what time is it");
+    wire_put_str(&w, "It is noon.");
+    wire_put_str(&w, nullptr);
+    wire_put_u32(&w, 99); // a field from a later minor version
+    size_t len = wire_finish(frame, WIRE_TRANSCRIPTION, 1, 0, w.len);
+
+    WireHeader header;
+    const uint8_t *payload;
+    TEST_ASSERT_EQUAL(WIRE_OK, wire_parse(frame, len, &header, &payload));
+    WireReader r;
+    wire_reader_init(&r, payload, header.length);
+    TEST_ASSERT_EQUAL_STRING("what time is it", wire_get_str(&r));
+    TEST_ASSERT_EQUAL_STRING("It is noon.", wire_get_str(&r));
+    TEST_ASSERT_EQUAL_STRING("", wire_get_str(&r));
+    TEST_ASSERT_TRUE(r.ok); // the trailing field is simply not read
+
+    const uint8_t unterminated[] = {3, 0, 'a', 'b', 'c'};
+    wire_reader_init(&r, unterminated, sizeof(unterminated));
+    TEST_ASSERT_EQUAL_STRING("", wire_get_str(&r));
+    TEST_ASSERT_FALSE(r.ok);
+
+    const uint8_t too_long[] = {9, 0, 'a', 'b', 0};
+    wire_reader_init(&r, too_long, sizeof(too_long));
+    TEST_ASSERT_EQUAL_STRING("", wire_get_str(&r));
+    TEST_ASSERT_FALSE(r.ok);
+}
+
+static void test_writer_overflow_and_byte_order()
+{
+    uint8_t small[8];
+    WireWriter w;
+    wire_writer_init(&w, small, sizeof(small));
+    wire_put_u64(&w, 1);
+    TEST_ASSERT_TRUE(w.ok);
+    wire_put_u8(&w, 1);
+    TEST_ASSERT_FALSE(w.ok);
+    TEST_ASSERT_EQUAL_size_t(8, w.len);
+    wire_put_u8(&w, 1); // stays failed
+    TEST_ASSERT_FALSE(w.ok);
+
+    wire_writer_init(&w, frame, sizeof(frame));
+    wire_put_u64(&w, 0x0123456789abcdefULL);
+    wire_put_u16(&w, 0x1234);
+    TEST_ASSERT_EQUAL_HEX8(0xef, frame[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, frame[7]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, frame[8]);
+
+    WireReader r;
+    wire_reader_init(&r, frame, w.len);
+    TEST_ASSERT_TRUE(wire_get_u64(&r) == 0x0123456789abcdefULL);
+    TEST_ASSERT_EQUAL_UINT16(0x1234, wire_get_u16(&r));
+    TEST_ASSERT_TRUE(r.ok);
+}
+
+// Host cost of the control and audio paths (reported, not asserted)
+static void test_benchmark()
+{
+    size_t len = audio_start_frame(frame, sizeof(frame));
+    const int iterations = 1000000;
+    volatile uint32_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        WireHeader header;
+        const uint8_t *payload;
+        if (wire_parse(frame, len, &header, &payload) != WIRE_OK)
+            continue;
+        WireReader r;
+        wire_reader_init(&r, payload, header.length);
+        sink += wire_get_u8(&r) + wire_get_u8(&r);
+        sink += wire_get_u32(&r) + wire_get_u32(&r) + wire_get_u32(&r) + wire_get_u32(&r);
+    }
+    double binary_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    char report[96];
+    snprintf(report, sizeof(report), "audio_start, binary parse + decode: %.1f ns", binary_ns);
+    TEST_MESSAGE(report);
+
+#ifdef HAVE_ARDUINOJSON
+    // The same message down the JSON path handle_transcription_message() takes
+    const char *json = "{\"type\":\"audio_start\",\"format\":\"ima_adpcm\",\"channels\":1,\"sampleRate\":24000,"
+                       "\"totalSize\":96000,\"chunks\":24,\"chunkSize\":4000}";
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations / 10; i++)
+    {
+        StaticJsonDocument<1024> doc;
+        if (deserializeJson(doc, json))
+            continue;
+        const char *type = doc["type"];
+        const char *format = doc["format"] | "pcm16";
+        sink += strcmp(type, "audio_start") == 0 && strcmp(format, "ima_adpcm") == 0;
+        sink += (uint32_t)(doc["channels"] | 1) + (uint32_t)(doc["sampleRate"] | 24000);
+        sink += (uint32_t)doc["totalSize"] + (uint32_t)doc["chunks"] + (uint32_t)doc["chunkSize"];
+    }
+    double json_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (iterations / 10);
+    snprintf(report, sizeof(report), "audio_start, ArduinoJson parse + lookups: %.1f ns (%.0fx binary)", json_ns, json_ns / binary_ns);
+    TEST_MESSAGE(report);
+#else
+    TEST_MESSAGE("ArduinoJson not available: JSON comparison skipped");
+#endif
+
+    std::vector<uint8_t> chunk(WIRE_HEADER_BYTES + 4096, 0x33);
+    size_t chunk_len = wire_finish(chunk.data(), WIRE_AUDIO_CHUNK, 7, 4, 4096);
+    const int chunk_iterations = 20000;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < chunk_iterations; i++)
+    {
+        WireHeader header;
+        const uint8_t *payload;
+        sink += wire_parse(chunk.data(), chunk_len, &header, &payload);
+    }
+    double chunk_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / chunk_iterations;
+    snprintf(report, sizeof(report), "4 KB audio chunk check: %.0f ns (%.0f MB/s)", chunk_ns, 4096 / chunk_ns * 1000);
+    TEST_MESSAGE(report);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_audio_start_round_trip);
+    RUN_TEST(test_every_bit_flip_is_rejected);
+    RUN_TEST(test_length_magic_and_version);
+    RUN_TEST(test_framing_falls_back_to_json);
+    RUN_TEST(test_strings);
+    RUN_TEST(test_writer_overflow_and_byte_order);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}